@@ -0,0 +1,199 @@
+#include "AsyncLogSink.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+namespace
+{
+	// How long the background thread sleeps once the queue is empty, bounds how late a message shows up
+	constexpr std::chrono::milliseconds IDLE_SLEEP(1);
+}
+
+AsyncLogSink::AsyncLogSink(spdlog::sink_ptr newTarget, const AsyncLogSettings& settings) :
+	target(std::move(newTarget)),
+	overflowPolicy(settings.overflowPolicy)
+{
+	const size_t capacity = std::bit_ceil(std::max<size_t>(settings.queueSize, 2));
+	slots = std::make_unique<Slot[]>(capacity);
+	for (size_t i = 0; i < capacity; i++)
+	{
+		slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	mask = capacity - 1;
+
+	running.store(true, std::memory_order_release);
+	worker = std::thread(&AsyncLogSink::run, this);
+}
+
+AsyncLogSink::~AsyncLogSink()
+{
+	stop();
+}
+
+void AsyncLogSink::log(const spdlog::details::log_msg& msg)
+{
+	// Counted before running is read, so either stop() waits for this push or this call sees the sink stopped
+	activeProducers.fetch_add(1, std::memory_order_seq_cst);
+	if (!running.load(std::memory_order_seq_cst))
+	{
+		activeProducers.fetch_sub(1, std::memory_order_release);
+		target->log(msg);
+		return;
+	}
+
+	while (!tryPush(msg))
+	{
+		if (overflowPolicy == LogOverflowPolicy::Drop)
+		{
+			droppedCount.fetch_add(1, std::memory_order_relaxed);
+			break;
+		}
+		// Once stopping, the drain in stop() is what makes room
+		std::this_thread::yield();
+	}
+	activeProducers.fetch_sub(1, std::memory_order_release);
+}
+
+void AsyncLogSink::flush()
+{
+	const size_t queued = enqueuePosition.load(std::memory_order_acquire);
+	while (running.load(std::memory_order_acquire) && writtenPosition.load(std::memory_order_acquire) < queued)
+	{
+		std::this_thread::yield();
+	}
+	target->flush();
+}
+
+void AsyncLogSink::set_pattern(const std::string& pattern)
+{
+	target->set_pattern(pattern);
+}
+
+void AsyncLogSink::set_formatter(std::unique_ptr<spdlog::formatter> sinkFormatter)
+{
+	target->set_formatter(std::move(sinkFormatter));
+}
+
+uint64_t AsyncLogSink::getDroppedCount()
+{
+	return droppedCount.load(std::memory_order_relaxed);
+}
+
+void AsyncLogSink::stop()
+{
+	if (!running.exchange(false, std::memory_order_seq_cst))
+	{
+		return;
+	}
+	worker.join();
+
+	// Whatever was pushed after the thread's last pass. A producer may have claimed a slot without publishing it
+	// yet, or be blocked on a full queue, so the drain goes on until none is left and every claimed slot is written
+	for (;;)
+	{
+		const bool producing = activeProducers.load(std::memory_order_seq_cst) != 0;
+		while (writeNext())
+		{
+		}
+		if (!producing && dequeuePosition == enqueuePosition.load(std::memory_order_acquire))
+		{
+			break;
+		}
+		std::this_thread::yield();
+	}
+	reportDrops();
+	target->flush();
+}
+
+bool AsyncLogSink::tryPush(const spdlog::details::log_msg& msg)
+{
+	size_t position = enqueuePosition.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		Slot& slot = slots[position & mask];
+		const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+		const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+		if (difference == 0)
+		{
+			if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				slot.level = msg.level;
+				slot.time = msg.time;
+				slot.threadId = msg.thread_id;
+				slot.loggerName = msg.logger_name;
+				slot.length = static_cast<uint32_t>(std::min(msg.payload.size(), MAX_MESSAGE_LENGTH));
+				std::memcpy(slot.text, msg.payload.data(), slot.length);
+				slot.sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0)
+		{
+			// The slot a full lap behind is still waiting to be written
+			return false;
+		}
+		else
+		{
+			position = enqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+bool AsyncLogSink::writeNext()
+{
+	Slot& slot = slots[dequeuePosition & mask];
+	if (slot.sequence.load(std::memory_order_acquire) != dequeuePosition + 1)
+	{
+		return false;
+	}
+
+	spdlog::details::log_msg message(slot.time, spdlog::source_loc{}, slot.loggerName, slot.level,
+		spdlog::string_view_t(slot.text, slot.length));
+	message.thread_id = slot.threadId;
+	target->log(message);
+
+	// Free again for the producer one lap ahead
+	slot.sequence.store(dequeuePosition + mask + 1, std::memory_order_release);
+	dequeuePosition++;
+	writtenPosition.store(dequeuePosition, std::memory_order_release);
+	return true;
+}
+
+void AsyncLogSink::reportDrops()
+{
+	const uint64_t dropped = droppedCount.load(std::memory_order_relaxed);
+	if (dropped == reportedDropCount)
+	{
+		return;
+	}
+
+	const std::string text = "Log queue full, dropped " + std::to_string(dropped - reportedDropCount) + " messages";
+	spdlog::details::log_msg message(spdlog::source_loc{}, "Log", spdlog::level::warn, text);
+	target->log(message);
+	reportedDropCount = dropped;
+}
+
+void AsyncLogSink::run()
+{
+	while (running.load(std::memory_order_acquire))
+	{
+		bool wrote = false;
+		while (writeNext())
+		{
+			wrote = true;
+		}
+		reportDrops();
+
+		if (wrote)
+		{
+			target->flush();
+		}
+		else
+		{
+			std::this_thread::sleep_for(IDLE_SLEEP);
+		}
+	}
+}
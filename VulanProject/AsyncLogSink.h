@@ -0,0 +1,84 @@
+#pragma once
+
+#include "spdlog/spdlog.h"
+#include "spdlog/sinks/sink.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// What a full queue does with the next message
+enum class LogOverflowPolicy
+{
+	// The message is lost and counted, the caller never waits
+	Drop,
+	// The caller waits for the background thread to make room
+	Block
+};
+
+struct AsyncLogSettings
+{
+	// Rounded up to a power of two, every slot is allocated up front
+	size_t queueSize = 8192;
+	LogOverflowPolicy overflowPolicy = LogOverflowPolicy::Drop;
+};
+
+// Copies each message into a fixed ring of slots without taking a lock and hands it to the wrapped sink from a
+// background thread, so logging from the frame loop or a validation callback never waits on console output.
+// Messages are still formatted by the caller, only the write is deferred.
+class AsyncLogSink : public spdlog::sinks::sink
+{
+public:
+	AsyncLogSink(spdlog::sink_ptr newTarget, const AsyncLogSettings& settings);
+	~AsyncLogSink() override;
+
+	void log(const spdlog::details::log_msg& msg) override;
+	// Waits until everything queued so far has been written
+	void flush() override;
+	void set_pattern(const std::string& pattern) override;
+	void set_formatter(std::unique_ptr<spdlog::formatter> sinkFormatter) override;
+
+	uint64_t getDroppedCount();
+	// Writes out what is still queued, including pushes already under way, and joins the background thread. Messages
+	// logged once it has started go straight to the target
+	void stop();
+private:
+	// Longer messages are cut short
+	static constexpr size_t MAX_MESSAGE_LENGTH = 472;
+
+	struct Slot
+	{
+		// Equal to the slot's position when free, one past it once a message has been written into it
+		std::atomic<size_t> sequence = 0;
+		spdlog::level::level_enum level = spdlog::level::info;
+		spdlog::log_clock::time_point time;
+		size_t threadId = 0;
+		// Points into the logger, which outlives its sink
+		spdlog::string_view_t loggerName;
+		uint32_t length = 0;
+		char text[MAX_MESSAGE_LENGTH];
+	};
+
+	spdlog::sink_ptr target;
+	LogOverflowPolicy overflowPolicy = LogOverflowPolicy::Drop;
+	std::unique_ptr<Slot[]> slots;
+	size_t mask = 0;
+
+	// Producers claim positions with a compare exchange, the background thread is the only consumer
+	alignas(64) std::atomic<size_t> enqueuePosition = 0;
+	alignas(64) std::atomic<size_t> writtenPosition = 0;
+	size_t dequeuePosition = 0;
+	std::atomic<uint64_t> droppedCount = 0;
+	uint64_t reportedDropCount = 0;
+
+	std::atomic<bool> running = false;
+	// Callers of log() that may still push, stop() waits for them before the last drain
+	std::atomic<uint32_t> activeProducers = 0;
+	std::thread worker;
+
+	bool tryPush(const spdlog::details::log_msg& msg);
+	bool writeNext();
+	void reportDrops();
+	void run();
+};
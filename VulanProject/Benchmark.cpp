@@ -0,0 +1,330 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "ClusteredLighting.h"
+#include "GltfLoader.h"
+#include "Log.h"
+#include "VulkanRenderer.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Results are reported through the logger directly, the VULKAN_CORE macros compile out of release builds
+	void report(const std::string& message)
+	{
+		Log::getLogger()->info(message);
+	}
+
+	struct GltfBenchmarkResult
+	{
+		double bestMilliseconds = 0.0;
+		double averageMilliseconds = 0.0;
+		GltfLoadStats bestStats;
+	};
+
+	GltfBenchmarkResult timeGltfLoad(const std::string& fileName, int iterations, uint32_t threadCount)
+	{
+		GltfLoadOptions options;
+		options.threadCount = threadCount;
+
+		GltfBenchmarkResult result;
+		result.bestMilliseconds = std::numeric_limits<double>::max();
+		double totalMilliseconds = 0.0;
+		for (int i = 0; i < iterations; i++)
+		{
+			GltfLoadStats stats;
+			const Clock::time_point start = Clock::now();
+			std::vector<MeshData> meshes = loadGltf(fileName, options, &stats);
+			const double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+			totalMilliseconds += milliseconds;
+			if (milliseconds < result.bestMilliseconds)
+			{
+				result.bestMilliseconds = milliseconds;
+				result.bestStats = stats;
+			}
+		}
+		result.averageMilliseconds = totalMilliseconds / iterations;
+		return result;
+	}
+
+	void logGltfResult(const char* label, uint32_t threadCount, const GltfBenchmarkResult& result)
+	{
+		const GltfLoadStats& stats = result.bestStats;
+		const double megabytesPerSecond = stats.fileBytes / (1024.0 * 1024.0) / (result.bestMilliseconds / 1000.0);
+		report(fmt::format("{} ({} threads): best {:.2f} ms, average {:.2f} ms, {:.1f} MB/s "
+			"[read {:.2f} ms, parse {:.2f} ms, convert {:.2f} ms]",
+			label, threadCount, result.bestMilliseconds, result.averageMilliseconds, megabytesPerSecond,
+			stats.readMilliseconds, stats.parseMilliseconds, stats.convertMilliseconds));
+	}
+
+	// Draws until the time runs out or the window is closed, returns false if it was closed
+	bool renderFor(VulkanRenderer& renderer, GLFWwindow* window, double seconds)
+	{
+		const Clock::time_point end = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+			std::chrono::duration<double>(seconds));
+		while (Clock::now() < end)
+		{
+			if (glfwWindowShouldClose(window))
+			{
+				return false;
+			}
+			renderer.waitForFrameStart();
+			glfwPollEvents();
+			renderer.draw();
+		}
+		return true;
+	}
+}
+
+int runGltfLoadBenchmark(const std::string& fileName, int iterations)
+{
+	iterations = std::max(iterations, 1);
+	const uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	try
+	{
+		// Untimed warm up so every run reads from the page cache
+		loadGltf(fileName);
+
+		GltfBenchmarkResult serial = timeGltfLoad(fileName, iterations, 1);
+		GltfBenchmarkResult parallel = timeGltfLoad(fileName, iterations, hardwareThreads);
+
+		const GltfLoadStats& stats = parallel.bestStats;
+		report(fmt::format("{}: {:.2f} MB, {} primitives, {} vertices, {} triangles, {} iterations",
+			fileName, stats.fileBytes / (1024.0 * 1024.0), stats.primitiveCount, stats.vertexCount,
+			stats.indexCount / 3, iterations));
+		logGltfResult("Serial", 1, serial);
+		logGltfResult("Parallel", hardwareThreads, parallel);
+		report(fmt::format("Parallel speed up: {:.2f}x", serial.bestMilliseconds / parallel.bestMilliseconds));
+	}
+	catch (const std::runtime_error& e)
+	{
+		Log::getLogger()->error(e.what());
+		return EXIT_FAILURE;
+	}
+	return 0;
+}
+
+int runFramesInFlightBenchmark(VulkanRenderer& renderer, GLFWwindow* window, double secondsPerSetting)
+{
+	secondsPerSetting = std::max(secondsPerSetting, 1.0);
+	const uint32_t originalFramesInFlight = renderer.getFramesInFlight();
+	const bool originalLowLatency = renderer.isLowLatencyMode();
+
+	try
+	{
+		bool windowOpen = true;
+		for (uint32_t framesInFlight = 1; framesInFlight <= MAX_FRAME_DRAWS && windowOpen; framesInFlight++)
+		{
+			for (bool lowLatency : { false, true })
+			{
+				renderer.setFramesInFlight(framesInFlight);
+				renderer.setLowLatencyMode(lowLatency);
+
+				// Let the queue and the pacing predictions settle before measuring
+				windowOpen = renderFor(renderer, window, 0.5);
+				renderer.resetFrameStatistics();
+				windowOpen = windowOpen && renderFor(renderer, window, secondsPerSetting);
+				if (!windowOpen)
+				{
+					break;
+				}
+
+				// Present latency needs VK_KHR_present_wait, otherwise only the latency to GPU completion is known
+				const FrameStatistics statistics = renderer.getFrameStatistics();
+				const double framesPerSecond = statistics.averageFrameMilliseconds > 0.0 ?
+					1000.0 / statistics.averageFrameMilliseconds : 0.0;
+				const std::string presentLatency = statistics.presentLatencyMeasured ?
+					fmt::format("{:.2f} ms (max {:.2f} ms)", statistics.averagePresentLatencyMilliseconds,
+						statistics.maxPresentLatencyMilliseconds) : "n/a";
+				report(fmt::format("{} frames in flight, {}: {:.1f} fps ({:.3f} ms), input to present {}, "
+					"input to GPU done {:.2f} ms (max {:.2f} ms), CPU {:.3f} ms, GPU {:.3f} ms, "
+					"GPU wait {:.3f} ms, pacing wait {:.3f} ms, {} descriptor sets per frame from {} pools, {} frames",
+					framesInFlight, lowLatency ? "low latency" : "throughput", framesPerSecond,
+					statistics.averageFrameMilliseconds, presentLatency, statistics.averageLatencyMilliseconds,
+					statistics.maxLatencyMilliseconds, statistics.averageCpuMilliseconds,
+					statistics.averageGpuMilliseconds, statistics.averageGpuWaitMilliseconds,
+					statistics.averagePacingWaitMilliseconds, statistics.descriptorSetsLastFrame,
+					statistics.descriptorPoolCount, statistics.frameCount));
+			}
+		}
+	}
+	catch (const std::runtime_error& e)
+	{
+		Log::getLogger()->error(e.what());
+		return EXIT_FAILURE;
+	}
+
+	renderer.setFramesInFlight(originalFramesInFlight);
+	renderer.setLowLatencyMode(originalLowLatency);
+	return 0;
+}
+
+int runDepthPrepassBenchmark(VulkanRenderer& renderer, GLFWwindow* window, double secondsPerSetting)
+{
+	secondsPerSetting = std::max(secondsPerSetting, 1.0);
+	const bool originalDepthPrepass = renderer.isDepthPrepass();
+
+	try
+	{
+		for (bool depthPrepass : { false, true })
+		{
+			renderer.setDepthPrepass(depthPrepass);
+			if (renderer.isDepthPrepass() != depthPrepass)
+			{
+				report("Depth prepass unavailable, skipping");
+				continue;
+			}
+
+			if (!renderFor(renderer, window, 0.5))
+			{
+				break;
+			}
+			renderer.resetFrameStatistics();
+			if (!renderFor(renderer, window, secondsPerSetting))
+			{
+				break;
+			}
+
+			// Fragment invocations need the pipelineStatisticsQuery feature, GPU time needs timestamp support
+			const FrameStatistics statistics = renderer.getFrameStatistics();
+			const std::string fragmentInvocations = statistics.fragmentInvocationsMeasured ?
+				fmt::format("{:.0f}", statistics.averageFragmentInvocations) : "n/a";
+			report(fmt::format("Depth prepass {}: GPU {:.3f} ms, CPU {:.3f} ms, {} fragment invocations per frame, "
+				"{} frames", depthPrepass ? "on" : "off", statistics.averageGpuMilliseconds,
+				statistics.averageCpuMilliseconds, fragmentInvocations, statistics.frameCount));
+		}
+	}
+	catch (const std::runtime_error& e)
+	{
+		Log::getLogger()->error(e.what());
+		return EXIT_FAILURE;
+	}
+
+	renderer.setDepthPrepass(originalDepthPrepass);
+	return 0;
+}
+
+int runClusteredLightingBenchmark(VulkanRenderer& renderer, GLFWwindow* window, double secondsPerSetting)
+{
+	secondsPerSetting = std::max(secondsPerSetting, 1.0);
+	if (!renderer.isClusteredShading())
+	{
+		report("Clustered lighting unavailable, skipping");
+		return EXIT_FAILURE;
+	}
+
+	int width = 0;
+	int height = 0;
+	glfwGetFramebufferSize(window, &width, &height);
+	const float aspectRatio = height > 0 ? static_cast<float>(width) / height : 1.0f;
+
+	const bool originalDeferredShading = renderer.isDeferredShading();
+	bool passed = true;
+	try
+	{
+		for (uint32_t lightCount : { 0u, 64u, 256u, 1024u, 4096u })
+		{
+			renderer.setLights(generateTestLights(renderer.getClusterSettings(), aspectRatio, lightCount));
+
+			// Borderline lights sit on a cluster boundary to within float precision and may land on either side
+			const ClusterValidationResult validation = renderer.validateClusteredLighting();
+			passed = passed && validation.passed;
+			report(fmt::format("{} lights: binning {}, {} clusters, {} light indices{}, {} mismatches, "
+				"{} borderline, CPU reference {:.2f} ms", lightCount, validation.passed ? "matches" : "DIFFERS",
+				validation.clusterCount, validation.lightIndexCount, validation.overflowed ? " (overflowed)" : "",
+				validation.mismatchCount, validation.borderlineCount, validation.referenceMilliseconds));
+
+			bool windowOpen = true;
+			for (bool deferred : { false, true })
+			{
+				renderer.setDeferredShading(deferred);
+				if (renderer.isDeferredShading() != deferred)
+				{
+					continue;
+				}
+				windowOpen = renderFor(renderer, window, 0.5);
+				renderer.resetFrameStatistics();
+				windowOpen = windowOpen && renderFor(renderer, window, secondsPerSetting);
+				if (!windowOpen)
+				{
+					break;
+				}
+
+				const FrameStatistics statistics = renderer.getFrameStatistics();
+				report(fmt::format("{} lights, {}: GPU {:.3f} ms, CPU {:.3f} ms, {} frames", lightCount,
+					deferred ? "deferred" : "forward", statistics.averageGpuMilliseconds,
+					statistics.averageCpuMilliseconds, statistics.frameCount));
+			}
+			if (!windowOpen)
+			{
+				break;
+			}
+		}
+	}
+	catch (const std::runtime_error& e)
+	{
+		Log::getLogger()->error(e.what());
+		return EXIT_FAILURE;
+	}
+
+	renderer.setDeferredShading(originalDeferredShading);
+	return passed ? 0 : EXIT_FAILURE;
+}
+
+int runOcclusionCullingBenchmark(VulkanRenderer& renderer, GLFWwindow* window, double secondsPerSetting)
+{
+	secondsPerSetting = std::max(secondsPerSetting, 1.0);
+	const bool originalOcclusionCulling = renderer.isOcclusionCulling();
+
+	try
+	{
+		for (bool occlusionCulling : { false, true })
+		{
+			renderer.setOcclusionCulling(occlusionCulling);
+			if (renderer.isOcclusionCulling() != occlusionCulling)
+			{
+				report("Occlusion culling unavailable, skipping");
+				continue;
+			}
+
+			// Visibility settles after the first culled frame, the warm up keeps that out of the averages
+			if (!renderFor(renderer, window, 0.5))
+			{
+				break;
+			}
+			renderer.resetFrameStatistics();
+			if (!renderFor(renderer, window, secondsPerSetting))
+			{
+				break;
+			}
+
+			// Invocation counts need the pipelineStatisticsQuery feature, GPU time needs timestamp support
+			const FrameStatistics statistics = renderer.getFrameStatistics();
+			const std::string vertexInvocations = statistics.fragmentInvocationsMeasured ?
+				fmt::format("{:.0f}", statistics.averageVertexInvocations) : "n/a";
+			const std::string fragmentInvocations = statistics.fragmentInvocationsMeasured ?
+				fmt::format("{:.0f}", statistics.averageFragmentInvocations) : "n/a";
+			report(fmt::format("Occlusion culling {}: GPU {:.3f} ms, CPU {:.3f} ms, {} vertex and {} fragment "
+				"invocations per frame, {} frames", occlusionCulling ? "on" : "off", statistics.averageGpuMilliseconds,
+				statistics.averageCpuMilliseconds, vertexInvocations, fragmentInvocations, statistics.frameCount));
+		}
+	}
+	catch (const std::runtime_error& e)
+	{
+		Log::getLogger()->error(e.what());
+		return EXIT_FAILURE;
+	}
+
+	renderer.setOcclusionCulling(originalOcclusionCulling);
+	return 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+class VulkanRenderer;
+struct GLFWwindow;
+
+// Command line benchmarks, each returns the process exit code
+
+// Times loading a glTF file single threaded and with every hardware thread
+int runGltfLoadBenchmark(const std::string& fileName, int iterations);
+
+// Renders with every frames in flight setting, with and without low latency pacing, and reports
+// throughput against latency for each
+int runFramesInFlightBenchmark(VulkanRenderer& renderer, GLFWwindow* window, double secondsPerSetting);
+
+// Renders the loaded scene with and without the depth prepass and reports GPU time and fragment shading for each
+int runDepthPrepassBenchmark(VulkanRenderer& renderer, GLFWwindow* window, double secondsPerSetting);
+
+// Renders with growing numbers of clustered lights, checking the GPU binning against the CPU reference for each,
+// and reports GPU time per light count for forward and, when available, deferred shading
+int runClusteredLightingBenchmark(VulkanRenderer& renderer, GLFWwindow* window, double secondsPerSetting);
+
+// Renders the loaded scene with and without occlusion culling and reports GPU time and vertex and fragment shading
+// for each
+int runOcclusionCullingBenchmark(VulkanRenderer& renderer, GLFWwindow* window, double secondsPerSetting);
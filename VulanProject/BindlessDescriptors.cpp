@@ -0,0 +1,181 @@
+#include "BindlessDescriptors.h"
+
+#include <stdexcept>
+
+#include "Log.h"
+
+BindlessDescriptorTable::BindlessDescriptorTable()
+{
+}
+
+void BindlessDescriptorTable::init(VkDevice newDevice, uint32_t newMaxTextures, bool useDescriptorIndexing)
+{
+	device = newDevice;
+	bindless = useDescriptorIndexing;
+	maxTextures = newMaxTextures;
+
+	if (bindless)
+	{
+		createDescriptorSetLayout(maxTextures);
+		createDescriptorSet();
+		VULKAN_CORE_INFO("Bindless descriptor table created with {} textures", maxTextures);
+	}
+	else
+	{
+		// Fallback layout with a single texture, so pipeline layouts keep the same set numbering
+		createDescriptorSetLayout(1);
+		VULKAN_CORE_INFO("Descriptor indexing unavailable, textures are only tracked on the CPU");
+	}
+}
+
+uint32_t BindlessDescriptorTable::addTexture(VkImageView imageView, VkSampler sampler)
+{
+	uint32_t index = takeTextureSlot();
+	if (index >= textureInfos.size())
+	{
+		textureInfos.resize(index + 1);
+	}
+
+	updateTexture(index, imageView, sampler);
+	return index;
+}
+
+void BindlessDescriptorTable::updateTexture(uint32_t index, VkImageView imageView, VkSampler sampler)
+{
+	VkDescriptorImageInfo& imageInfo = textureInfos[index];
+	imageInfo.imageView = imageView;
+	imageInfo.sampler = sampler;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	if (bindless)
+	{
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = descriptorSet;
+		write.dstBinding = BINDLESS_TEXTURE_BINDING;
+		write.dstArrayElement = index;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.descriptorCount = 1;
+		write.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	}
+}
+
+void BindlessDescriptorTable::removeTexture(uint32_t index)
+{
+	// Partially bound, so the stale descriptor is simply never indexed again
+	textureInfos[index] = {};
+	freeTextureSlots.push_back(index);
+}
+
+bool BindlessDescriptorTable::isBindless()
+{
+	return bindless;
+}
+
+VkDescriptorSetLayout BindlessDescriptorTable::getDescriptorSetLayout()
+{
+	return descriptorSetLayout;
+}
+
+VkDescriptorSet BindlessDescriptorTable::getDescriptorSet()
+{
+	return descriptorSet;
+}
+
+void BindlessDescriptorTable::cleanup()
+{
+	if (descriptorPool != VK_NULL_HANDLE)
+	{
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	}
+	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+	descriptorPool = VK_NULL_HANDLE;
+	descriptorSetLayout = VK_NULL_HANDLE;
+	descriptorSet = VK_NULL_HANDLE;
+	textureInfos.clear();
+	freeTextureSlots.clear();
+	nextTextureSlot = 0;
+}
+
+uint32_t BindlessDescriptorTable::takeTextureSlot()
+{
+	if (!freeTextureSlots.empty())
+	{
+		uint32_t slot = freeTextureSlots.back();
+		freeTextureSlots.pop_back();
+		return slot;
+	}
+
+	if (nextTextureSlot >= maxTextures)
+	{
+		throw std::runtime_error("Bindless descriptor table is full");
+	}
+	return nextTextureSlot++;
+}
+
+void BindlessDescriptorTable::createDescriptorSetLayout(uint32_t textureCount)
+{
+	VkDescriptorSetLayoutBinding layoutBinding = {};
+	layoutBinding.binding = BINDLESS_TEXTURE_BINDING;
+	layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	layoutBinding.descriptorCount = textureCount;
+	layoutBinding.stageFlags = VK_SHADER_STAGE_ALL;
+
+	// Unused slots may stay empty and slots can be written while the set is bound
+	const VkDescriptorBindingFlags bindingFlag = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+		VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo = {};
+	bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsCreateInfo.bindingCount = 1;
+	bindingFlagsCreateInfo.pBindingFlags = &bindingFlag;
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	if (bindless)
+	{
+		layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+		layoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	}
+	layoutCreateInfo.bindingCount = 1;
+	layoutCreateInfo.pBindings = &layoutBinding;
+
+	VkResult result = vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &descriptorSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the texture descriptor set layout");
+	}
+}
+
+void BindlessDescriptorTable::createDescriptorSet()
+{
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSize.descriptorCount = maxTextures;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolCreateInfo.maxSets = 1;
+	poolCreateInfo.poolSizeCount = 1;
+	poolCreateInfo.pPoolSizes = &poolSize;
+
+	VkResult result = vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &descriptorPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the bindless descriptor pool");
+	}
+
+	VkDescriptorSetAllocateInfo setAllocInfo = {};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool = descriptorPool;
+	setAllocInfo.descriptorSetCount = 1;
+	setAllocInfo.pSetLayouts = &descriptorSetLayout;
+
+	result = vkAllocateDescriptorSets(device, &setAllocInfo, &descriptorSet);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate the bindless descriptor set");
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+
+constexpr uint32_t INVALID_BINDLESS_INDEX = UINT32_MAX;
+
+constexpr uint32_t BINDLESS_TEXTURE_BINDING = 0;
+
+// Upper bound for the bindless texture array, clamped further by the device limits
+constexpr uint32_t BINDLESS_MAX_TEXTURES = 16384;
+
+// Owns the index space textures are referred to by. With descriptor indexing the indices live in one large
+// update-after-bind set, otherwise they are only tracked on the CPU
+class BindlessDescriptorTable
+{
+public:
+	BindlessDescriptorTable();
+	void init(VkDevice newDevice, uint32_t newMaxTextures, bool useDescriptorIndexing);
+
+	uint32_t addTexture(VkImageView imageView, VkSampler sampler);
+	// Points a texture index at a replacement image, no submitted frame may still be using the index
+	void updateTexture(uint32_t index, VkImageView imageView, VkSampler sampler);
+	void removeTexture(uint32_t index);
+
+	bool isBindless();
+	VkDescriptorSetLayout getDescriptorSetLayout();
+	VkDescriptorSet getDescriptorSet();
+
+	void cleanup();
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	bool bindless = false;
+	uint32_t maxTextures = 0;
+
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+	std::vector<VkDescriptorImageInfo> textureInfos;
+
+	// Slots are recycled, the next unused slot is only taken when the free list is empty
+	std::vector<uint32_t> freeTextureSlots;
+	uint32_t nextTextureSlot = 0;
+
+	uint32_t takeTextureSlot();
+	void createDescriptorSetLayout(uint32_t textureCount);
+	void createDescriptorSet();
+};
@@ -0,0 +1,171 @@
+#include "BlockDecoder.h"
+
+#include <algorithm>
+
+namespace
+{
+	void unpack565(uint16_t colour, uint8_t* rgb)
+	{
+		const uint8_t r = (colour >> 11) & 0x1F;
+		const uint8_t g = (colour >> 5) & 0x3F;
+		const uint8_t b = colour & 0x1F;
+		rgb[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+		rgb[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+		rgb[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+	}
+
+	// Writes the 16 texels of a BC1 style colour block, BC2/BC3 always use the four colour mode
+	void decodeColourBlock(const uint8_t* block, bool allowPunchThrough, uint8_t texels[16][4])
+	{
+		const uint16_t colour0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+		const uint16_t colour1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+
+		uint8_t palette[4][4] = {};
+		unpack565(colour0, palette[0]);
+		unpack565(colour1, palette[1]);
+		palette[0][3] = palette[1][3] = 255;
+
+		if (colour0 > colour1 || !allowPunchThrough)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+				palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+			}
+			palette[2][3] = palette[3][3] = 255;
+		}
+		else
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+			}
+			palette[2][3] = 255;
+			// Index 3 is transparent black
+		}
+
+		const uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+		for (int i = 0; i < 16; i++)
+		{
+			const uint8_t* colour = palette[(indices >> (i * 2)) & 0x3];
+			std::copy(colour, colour + 4, texels[i]);
+		}
+	}
+
+	// BC3 alpha / BC4 / BC5 channel block, eight bytes decoding to 16 single channel values
+	void decodeChannelBlock(const uint8_t* block, uint8_t values[16])
+	{
+		uint8_t palette[8];
+		palette[0] = block[0];
+		palette[1] = block[1];
+		if (palette[0] > palette[1])
+		{
+			for (int i = 1; i < 7; i++)
+			{
+				palette[i + 1] = static_cast<uint8_t>(((7 - i) * palette[0] + i * palette[1]) / 7);
+			}
+		}
+		else
+		{
+			for (int i = 1; i < 5; i++)
+			{
+				palette[i + 1] = static_cast<uint8_t>(((5 - i) * palette[0] + i * palette[1]) / 5);
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		uint64_t indices = 0;
+		for (int i = 0; i < 6; i++)
+		{
+			indices |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			values[i] = palette[(indices >> (i * 3)) & 0x7];
+		}
+	}
+
+	void decodeBlock(BlockFormat format, const uint8_t* block, uint8_t texels[16][4])
+	{
+		uint8_t channel[16];
+		switch (format)
+		{
+		case BlockFormat::BC1:
+			decodeColourBlock(block, true, texels);
+			break;
+		case BlockFormat::BC2:
+			decodeColourBlock(block + 8, false, texels);
+			for (int i = 0; i < 16; i++)
+			{
+				const uint8_t alpha = (block[i / 2] >> ((i % 2) * 4)) & 0xF;
+				texels[i][3] = static_cast<uint8_t>(alpha * 17);
+			}
+			break;
+		case BlockFormat::BC3:
+			decodeColourBlock(block + 8, false, texels);
+			decodeChannelBlock(block, channel);
+			for (int i = 0; i < 16; i++)
+			{
+				texels[i][3] = channel[i];
+			}
+			break;
+		case BlockFormat::BC4:
+			decodeChannelBlock(block, channel);
+			for (int i = 0; i < 16; i++)
+			{
+				texels[i][0] = channel[i];
+				texels[i][1] = texels[i][2] = 0;
+				texels[i][3] = 255;
+			}
+			break;
+		case BlockFormat::BC5:
+			decodeChannelBlock(block, channel);
+			for (int i = 0; i < 16; i++)
+			{
+				texels[i][0] = channel[i];
+				texels[i][2] = 0;
+				texels[i][3] = 255;
+			}
+			decodeChannelBlock(block + 8, channel);
+			for (int i = 0; i < 16; i++)
+			{
+				texels[i][1] = channel[i];
+			}
+			break;
+		}
+	}
+}
+
+uint32_t getBlockSize(BlockFormat format)
+{
+	return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+std::vector<uint8_t> decodeBlocks(BlockFormat format, const uint8_t* data, uint32_t width, uint32_t height)
+{
+	std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+	const uint32_t blocksWide = std::max(1u, (width + 3) / 4);
+	const uint32_t blocksHigh = std::max(1u, (height + 3) / 4);
+	const uint32_t blockSize = getBlockSize(format);
+
+	uint8_t texels[16][4];
+	for (uint32_t blockY = 0; blockY < blocksHigh; blockY++)
+	{
+		for (uint32_t blockX = 0; blockX < blocksWide; blockX++)
+		{
+			decodeBlock(format, data + (static_cast<size_t>(blockY) * blocksWide + blockX) * blockSize, texels);
+
+			// Edge blocks of non multiple of four levels are partially outside the image
+			for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; y++)
+			{
+				for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; x++)
+				{
+					uint8_t* pixel = &pixels[((static_cast<size_t>(blockY) * 4 + y) * width + blockX * 4 + x) * 4];
+					std::copy(texels[y * 4 + x], texels[y * 4 + x] + 4, pixel);
+				}
+			}
+		}
+	}
+	return pixels;
+}
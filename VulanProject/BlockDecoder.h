@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Block compressed formats that can be transcoded on the CPU when the device cannot sample them
+enum class BlockFormat
+{
+	BC1,
+	BC2,
+	BC3,
+	BC4,
+	BC5
+};
+
+uint32_t getBlockSize(BlockFormat format);
+
+// Decodes one mip level of 4x4 blocks into tightly packed RGBA8,
+// single and dual channel formats leave the unused channels at 0 and alpha at 255
+std::vector<uint8_t> decodeBlocks(BlockFormat format, const uint8_t* data, uint32_t width, uint32_t height);
@@ -0,0 +1,492 @@
+#include "BufferPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "Log.h"
+#include "Utilities.h"
+
+void logBufferPoolStatistics(const char* name, const BufferPoolStatistics& statistics)
+{
+	VULKAN_CORE_INFO("Buffer pool {}: {} buffers in {} blocks, {} of {} KiB used, largest free range {} of {} KiB, "
+		"fragmentation {:.2f}", name, statistics.bufferCount, statistics.blockCount, statistics.usedBytes / 1024,
+		statistics.blockBytes / 1024, statistics.largestFreeRange / 1024, statistics.freeBytes / 1024,
+		statistics.fragmentation);
+	VULKAN_CORE_INFO("Buffer pool {}: {} buffers moved, {} KiB copied, {} blocks freed", name,
+		statistics.movedBuffers, statistics.movedBytes / 1024, statistics.freedBlocks);
+}
+
+BufferPool::BufferPool()
+{
+}
+
+void BufferPool::init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* newMemoryBudget,
+	QueueTimeline* newTimeline, VkBufferUsageFlags newUsage, VkDeviceSize newBlockSize, MemoryCategory newCategory)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+	memoryBudget = newMemoryBudget;
+	timeline = newTimeline;
+	// Buffers are moved with transfers in and out
+	usage = newUsage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	blockSize = newBlockSize;
+	category = newCategory;
+
+	readStages = 0;
+	readAccess = 0;
+	if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)
+	{
+		readStages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		readAccess |= VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	}
+	if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
+	{
+		readStages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		readAccess |= VK_ACCESS_INDEX_READ_BIT;
+	}
+	if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+	{
+		readStages |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		readAccess |= VK_ACCESS_SHADER_READ_BIT;
+	}
+	if (readStages == 0)
+	{
+		readStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		readAccess = VK_ACCESS_MEMORY_READ_BIT;
+	}
+}
+
+BufferHandle BufferPool::createBuffer(VkDeviceSize size)
+{
+	releaseRetiredRanges(false);
+	defragmentStalled = false;
+
+	Allocation allocation = {};
+	allocation.size = size;
+	VkMemoryRequirements memoryRequirements;
+	allocation.buffer = createVkBuffer(size, &memoryRequirements);
+	allocation.allocatedSize = memoryRequirements.size;
+	allocation.alignment = memoryRequirements.alignment;
+
+	// The block being emptied only takes new buffers when nothing else has room
+	if (!findRange(allocation.allocatedSize, allocation.alignment, sourceBlock, &allocation.block, &allocation.offset))
+	{
+		if (sourceBlock != UINT32_MAX && allocateRange(sourceBlock, allocation.allocatedSize, allocation.alignment,
+			&allocation.offset))
+		{
+			allocation.block = sourceBlock;
+		}
+		else
+		{
+			allocation.block = createBlock(std::max(blockSize, allocation.allocatedSize));
+			allocateRange(allocation.block, allocation.allocatedSize, allocation.alignment, &allocation.offset);
+		}
+	}
+	vkBindBufferMemory(device, allocation.buffer, blocks[allocation.block].memory, allocation.offset);
+
+	Block& block = blocks[allocation.block];
+	block.usedBytes += allocation.allocatedSize;
+	block.bufferCount++;
+
+	BufferHandle handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+		allocations[handle] = allocation;
+	}
+	else
+	{
+		handle = static_cast<BufferHandle>(allocations.size());
+		allocations.push_back(allocation);
+	}
+	return handle;
+}
+
+void BufferPool::destroyBuffer(BufferHandle handle)
+{
+	if (handle == INVALID_BUFFER_HANDLE || allocations[handle].buffer == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	defragmentStalled = false;
+
+	Allocation& allocation = allocations[handle];
+	Block& block = blocks[allocation.block];
+	block.usedBytes -= allocation.allocatedSize;
+	block.bufferCount--;
+	block.retiredCount++;
+
+	// Frames already submitted may still draw from it
+	RetiredRange retired = {};
+	retired.buffer = allocation.buffer;
+	retired.block = allocation.block;
+	retired.offset = allocation.offset;
+	retired.size = allocation.allocatedSize;
+	retired.timelineValue = timeline->getLastSubmittedValue();
+	retiredRanges.push_back(retired);
+
+	allocation = Allocation();
+	freeHandles.push_back(handle);
+}
+
+VkBuffer BufferPool::getBuffer(BufferHandle handle)
+{
+	return handle == INVALID_BUFFER_HANDLE ? VK_NULL_HANDLE : allocations[handle].buffer;
+}
+
+void BufferPool::defragment(VkCommandBuffer commandBuffer, VkDeviceSize maxBytes, double maxMilliseconds)
+{
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	releaseRetiredRanges(false);
+
+	sourceBlock = defragmentStalled ? UINT32_MAX : chooseSourceBlock();
+	if (sourceBlock == UINT32_MAX)
+	{
+		// Emptied blocks are only freed once the last copies out of them finish, the cycle ends after that
+		if (defragmenting && retiredRanges.empty() && movedRanges.empty())
+		{
+			const BufferPoolStatistics statistics = getStatistics();
+			VULKAN_CORE_INFO("Defragmented {} buffers over {} frames: {} blocks and fragmentation {:.2f} before, "
+				"{} blocks and fragmentation {:.2f} after, {} buffers moved and {} blocks freed",
+				getMemoryCategoryName(category), cycleFrames, cycleStartStatistics.blockCount,
+				cycleStartStatistics.fragmentation, statistics.blockCount, statistics.fragmentation,
+				statistics.movedBuffers - cycleStartStatistics.movedBuffers,
+				statistics.freedBlocks - cycleStartStatistics.freedBlocks);
+			defragmenting = false;
+		}
+		return;
+	}
+	if (!defragmenting)
+	{
+		cycleStartStatistics = getStatistics();
+		cycleFrames = 0;
+		defragmenting = true;
+		VULKAN_CORE_INFO("Defragmenting {} buffers: {} blocks, {} of {} KiB used, fragmentation {:.2f}",
+			getMemoryCategoryName(category), cycleStartStatistics.blockCount, cycleStartStatistics.usedBytes / 1024,
+			cycleStartStatistics.blockBytes / 1024, cycleStartStatistics.fragmentation);
+	}
+	cycleFrames++;
+
+	VkDeviceSize frameBytes = 0;
+	bool moved = false;
+	for (Allocation& allocation : allocations)
+	{
+		if (allocation.buffer == VK_NULL_HANDLE || allocation.block != sourceBlock)
+		{
+			continue;
+		}
+		// Always moves at least one buffer so a budget smaller than a buffer still makes progress
+		if (moved && (frameBytes + allocation.size > maxBytes ||
+			std::chrono::duration<double, std::milli>(Clock::now() - start).count() >= maxMilliseconds))
+		{
+			break;
+		}
+
+		VkMemoryRequirements memoryRequirements;
+		VkBuffer newBuffer = createVkBuffer(allocation.size, &memoryRequirements);
+		uint32_t newBlock = 0;
+		VkDeviceSize newOffset = 0;
+		if (!findRange(memoryRequirements.size, memoryRequirements.alignment, sourceBlock, &newBlock, &newOffset))
+		{
+			// The free space left elsewhere is too broken up, try again once buffers come or go
+			vkDestroyBuffer(device, newBuffer, nullptr);
+			defragmentStalled = !moved;
+			break;
+		}
+		vkBindBufferMemory(device, newBuffer, blocks[newBlock].memory, newOffset);
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = allocation.size;
+		vkCmdCopyBuffer(commandBuffer, allocation.buffer, newBuffer, 1, &copyRegion);
+
+		// Copies in this frame read the old buffer, so its range stays taken until the frame finishes
+		RetiredRange retired = {};
+		retired.buffer = allocation.buffer;
+		retired.block = allocation.block;
+		retired.offset = allocation.offset;
+		retired.size = allocation.allocatedSize;
+		movedRanges.push_back(retired);
+
+		Block& oldBlock = blocks[allocation.block];
+		oldBlock.usedBytes -= allocation.allocatedSize;
+		oldBlock.bufferCount--;
+		oldBlock.retiredCount++;
+		blocks[newBlock].usedBytes += memoryRequirements.size;
+		blocks[newBlock].bufferCount++;
+
+		allocation.buffer = newBuffer;
+		allocation.allocatedSize = memoryRequirements.size;
+		allocation.alignment = memoryRequirements.alignment;
+		allocation.block = newBlock;
+		allocation.offset = newOffset;
+
+		frameBytes += allocation.size;
+		movedBuffers++;
+		movedBytes += allocation.size;
+		moved = true;
+	}
+
+	if (moved)
+	{
+		// Everything the frame draws afterwards reads the copies
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = readAccess;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, readStages, 0, 1, &barrier, 0, nullptr,
+			0, nullptr);
+	}
+}
+
+void BufferPool::frameSubmitted(uint64_t timelineValue)
+{
+	for (RetiredRange& retired : movedRanges)
+	{
+		retired.timelineValue = timelineValue;
+		retiredRanges.push_back(retired);
+	}
+	movedRanges.clear();
+}
+
+BufferPoolStatistics BufferPool::getStatistics()
+{
+	BufferPoolStatistics statistics = {};
+	for (const Block& block : blocks)
+	{
+		if (block.memory == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+		statistics.blockCount++;
+		statistics.bufferCount += block.bufferCount;
+		statistics.blockBytes += block.size;
+		statistics.usedBytes += block.usedBytes;
+		for (const auto& [offset, size] : block.freeRanges)
+		{
+			statistics.freeBytes += size;
+			statistics.largestFreeRange = std::max(statistics.largestFreeRange, size);
+		}
+	}
+	if (statistics.freeBytes > 0)
+	{
+		statistics.fragmentation = 1.0f - static_cast<float>(statistics.largestFreeRange) / statistics.freeBytes;
+	}
+	statistics.movedBuffers = movedBuffers;
+	statistics.movedBytes = movedBytes;
+	statistics.freedBlocks = freedBlocks;
+	return statistics;
+}
+
+void BufferPool::cleanup()
+{
+	for (const RetiredRange& retired : movedRanges)
+	{
+		vkDestroyBuffer(device, retired.buffer, nullptr);
+	}
+	movedRanges.clear();
+	releaseRetiredRanges(true);
+
+	for (const Allocation& allocation : allocations)
+	{
+		if (allocation.buffer != VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(device, allocation.buffer, nullptr);
+		}
+	}
+	allocations.clear();
+	freeHandles.clear();
+
+	for (const Block& block : blocks)
+	{
+		if (block.memory != VK_NULL_HANDLE)
+		{
+			freeMemory(device, block.memory, memoryBudget);
+		}
+	}
+	blocks.clear();
+}
+
+VkBuffer BufferPool::createVkBuffer(VkDeviceSize size, VkMemoryRequirements* memoryRequirements)
+{
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkBuffer buffer;
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a pooled buffer");
+	}
+	vkGetBufferMemoryRequirements(device, buffer, memoryRequirements);
+	return buffer;
+}
+
+uint32_t BufferPool::createBlock(VkDeviceSize size)
+{
+	// Buffers created with the same usage have the same memory types, so one request covers every buffer
+	VkMemoryRequirements memoryRequirements;
+	VkBuffer buffer = createVkBuffer(size, &memoryRequirements);
+	vkDestroyBuffer(device, buffer, nullptr);
+
+	Block block = {};
+	block.size = memoryRequirements.size;
+	const VkResult result = allocateMemory(physicalDevice, device, memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		memoryBudget, category, MemoryPriority::Required, &block.memory);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate a buffer pool block");
+	}
+	block.freeRanges[0] = block.size;
+
+	// Reuses the slot of a freed block
+	for (uint32_t i = 0; i < blocks.size(); i++)
+	{
+		if (blocks[i].memory == VK_NULL_HANDLE)
+		{
+			blocks[i] = std::move(block);
+			return i;
+		}
+	}
+	blocks.push_back(std::move(block));
+	return static_cast<uint32_t>(blocks.size()) - 1;
+}
+
+bool BufferPool::allocateRange(uint32_t blockIndex, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset)
+{
+	std::map<VkDeviceSize, VkDeviceSize>& freeRanges = blocks[blockIndex].freeRanges;
+	for (auto range = freeRanges.begin(); range != freeRanges.end(); ++range)
+	{
+		const VkDeviceSize rangeStart = range->first;
+		const VkDeviceSize rangeEnd = range->first + range->second;
+		const VkDeviceSize alignedStart = (rangeStart + alignment - 1) / alignment * alignment;
+		if (alignedStart + size > rangeEnd)
+		{
+			continue;
+		}
+
+		// Whatever is left either side of the buffer stays free
+		freeRanges.erase(range);
+		if (alignedStart > rangeStart)
+		{
+			freeRanges[rangeStart] = alignedStart - rangeStart;
+		}
+		if (alignedStart + size < rangeEnd)
+		{
+			freeRanges[alignedStart + size] = rangeEnd - alignedStart - size;
+		}
+		*offset = alignedStart;
+		return true;
+	}
+	return false;
+}
+
+void BufferPool::freeRange(uint32_t blockIndex, VkDeviceSize offset, VkDeviceSize size)
+{
+	std::map<VkDeviceSize, VkDeviceSize>& freeRanges = blocks[blockIndex].freeRanges;
+	auto range = freeRanges.emplace(offset, size).first;
+
+	auto next = std::next(range);
+	if (next != freeRanges.end() && range->first + range->second == next->first)
+	{
+		range->second += next->second;
+		freeRanges.erase(next);
+	}
+	if (range != freeRanges.begin())
+	{
+		auto previous = std::prev(range);
+		if (previous->first + previous->second == range->first)
+		{
+			previous->second += range->second;
+			freeRanges.erase(range);
+		}
+	}
+}
+
+bool BufferPool::findRange(VkDeviceSize size, VkDeviceSize alignment, uint32_t excludedBlock, uint32_t* blockIndex,
+	VkDeviceSize* offset)
+{
+	for (uint32_t i = 0; i < blocks.size(); i++)
+	{
+		if (i != excludedBlock && blocks[i].memory != VK_NULL_HANDLE && allocateRange(i, size, alignment, offset))
+		{
+			*blockIndex = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+uint32_t BufferPool::chooseSourceBlock()
+{
+	// Keeps emptying the same block until it is done
+	if (sourceBlock != UINT32_MAX && blocks[sourceBlock].memory != VK_NULL_HANDLE && blocks[sourceBlock].bufferCount > 0)
+	{
+		return sourceBlock;
+	}
+
+	VkDeviceSize totalFreeBytes = 0;
+	uint32_t emptiest = UINT32_MAX;
+	for (uint32_t i = 0; i < blocks.size(); i++)
+	{
+		if (blocks[i].memory == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+		for (const auto& [offset, size] : blocks[i].freeRanges)
+		{
+			totalFreeBytes += size;
+		}
+		if (blocks[i].bufferCount > 0 && (emptiest == UINT32_MAX || blocks[i].usedBytes < blocks[emptiest].usedBytes))
+		{
+			emptiest = i;
+		}
+	}
+	if (emptiest == UINT32_MAX)
+	{
+		return UINT32_MAX;
+	}
+
+	// Only worth moving when the other blocks already have the space for everything in it
+	VkDeviceSize blockFreeBytes = 0;
+	for (const auto& [offset, size] : blocks[emptiest].freeRanges)
+	{
+		blockFreeBytes += size;
+	}
+	return totalFreeBytes - blockFreeBytes >= blocks[emptiest].usedBytes ? emptiest : UINT32_MAX;
+}
+
+void BufferPool::releaseRetiredRanges(bool releaseAll)
+{
+	while (!retiredRanges.empty() && (releaseAll || timeline->isComplete(retiredRanges.front().timelineValue)))
+	{
+		const RetiredRange& retired = retiredRanges.front();
+		vkDestroyBuffer(device, retired.buffer, nullptr);
+		freeRange(retired.block, retired.offset, retired.size);
+		blocks[retired.block].retiredCount--;
+		retiredRanges.pop_front();
+	}
+	if (!releaseAll)
+	{
+		freeEmptyBlocks();
+	}
+}
+
+void BufferPool::freeEmptyBlocks()
+{
+	for (Block& block : blocks)
+	{
+		if (block.memory == VK_NULL_HANDLE || block.bufferCount > 0 || block.retiredCount > 0)
+		{
+			continue;
+		}
+		freeMemory(device, block.memory, memoryBudget);
+		block = Block();
+		freedBlocks++;
+	}
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "MemoryBudget.h"
+#include "QueueTimeline.h"
+
+// Stays the same when defragmentation moves the buffer behind it
+using BufferHandle = uint32_t;
+constexpr BufferHandle INVALID_BUFFER_HANDLE = UINT32_MAX;
+
+struct BufferPoolStatistics
+{
+	uint32_t blockCount = 0;
+	uint32_t bufferCount = 0;
+	VkDeviceSize blockBytes = 0;
+	VkDeviceSize usedBytes = 0;
+	VkDeviceSize freeBytes = 0;
+	VkDeviceSize largestFreeRange = 0;
+	// One minus the largest free range over all free bytes, zero when the free space is in one piece
+	float fragmentation = 0.0f;
+	// Totals since the pool was created
+	uint32_t movedBuffers = 0;
+	VkDeviceSize movedBytes = 0;
+	uint32_t freedBlocks = 0;
+};
+
+// Blocks, usage and fragmentation, then what defragmentation has moved and freed so far
+void logBufferPoolStatistics(const char* name, const BufferPoolStatistics& statistics);
+
+// Device local buffers of one usage placed in large shared memory blocks instead of an allocation each. Streaming
+// content in and out leaves blocks partly empty, defragment moves the buffers of the emptiest block into the free
+// space of the others a few at a time each frame and frees the block once nothing is left in it.
+class BufferPool
+{
+public:
+	BufferPool();
+	void init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* newMemoryBudget,
+		QueueTimeline* newTimeline, VkBufferUsageFlags newUsage, VkDeviceSize newBlockSize, MemoryCategory newCategory);
+
+	// Larger buffers than the block size get a block of their own
+	BufferHandle createBuffer(VkDeviceSize size);
+	// The buffer and its memory are released once every frame submitted so far has finished
+	void destroyBuffer(BufferHandle handle);
+	// The buffer can change between frames, look it up again for every frame recorded
+	VkBuffer getBuffer(BufferHandle handle);
+
+	// Records copies of buffers into compacted blocks, moving at most maxBytes and stopping once maxMilliseconds have
+	// been spent. Called before anything of the frame reads the buffers, the handles point at the copies straight away.
+	void defragment(VkCommandBuffer commandBuffer, VkDeviceSize maxBytes, double maxMilliseconds);
+	// Timeline value of the frame defragment recorded into, the buffers it moved are released once it finishes
+	void frameSubmitted(uint64_t timelineValue);
+
+	BufferPoolStatistics getStatistics();
+
+	void cleanup();
+private:
+	struct Block
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		// Offset to size, neighbouring ranges are merged when returned
+		std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+		VkDeviceSize usedBytes = 0;
+		uint32_t bufferCount = 0;
+		// Ranges of destroyed or moved buffers the GPU may still be reading
+		uint32_t retiredCount = 0;
+	};
+
+	struct Allocation
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		VkDeviceSize allocatedSize = 0;
+		VkDeviceSize alignment = 0;
+		uint32_t block = 0;
+		VkDeviceSize offset = 0;
+	};
+
+	struct RetiredRange
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		uint32_t block = 0;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		uint64_t timelineValue = 0;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryBudget* memoryBudget = nullptr;
+	QueueTimeline* timeline = nullptr;
+	VkBufferUsageFlags usage = 0;
+	VkDeviceSize blockSize = 0;
+	MemoryCategory category = MemoryCategory::Other;
+	// Where the moved buffers are read after the copies
+	VkPipelineStageFlags readStages = 0;
+	VkAccessFlags readAccess = 0;
+
+	// Freed blocks keep their slot so allocations can refer to them by index
+	std::vector<Block> blocks;
+	std::vector<Allocation> allocations;
+	std::vector<BufferHandle> freeHandles;
+	// Moved by the frame being recorded, stamped when it is submitted
+	std::vector<RetiredRange> movedRanges;
+	std::deque<RetiredRange> retiredRanges;
+
+	// Set while blocks are being emptied, so the metrics are logged once before and once after
+	bool defragmenting = false;
+	// Set when nothing could be moved, cleared when buffers are created or destroyed
+	bool defragmentStalled = false;
+	BufferPoolStatistics cycleStartStatistics;
+	uint32_t cycleFrames = 0;
+	// Block being emptied, new buffers go elsewhere while there is room
+	uint32_t sourceBlock = UINT32_MAX;
+	uint32_t movedBuffers = 0;
+	VkDeviceSize movedBytes = 0;
+	uint32_t freedBlocks = 0;
+
+	VkBuffer createVkBuffer(VkDeviceSize size, VkMemoryRequirements* memoryRequirements);
+	uint32_t createBlock(VkDeviceSize size);
+	bool allocateRange(uint32_t blockIndex, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset);
+	void freeRange(uint32_t blockIndex, VkDeviceSize offset, VkDeviceSize size);
+	// First fit in the block with the lowest index that has room, which keeps the buffers packed towards the start
+	bool findRange(VkDeviceSize size, VkDeviceSize alignment, uint32_t excludedBlock, uint32_t* blockIndex,
+		VkDeviceSize* offset);
+	uint32_t chooseSourceBlock();
+	void releaseRetiredRanges(bool releaseAll);
+	void freeEmptyBlocks();
+};
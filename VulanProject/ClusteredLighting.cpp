@@ -0,0 +1,518 @@
+#include "ClusteredLighting.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Log.h"
+#include "MappedFile.h"
+#include "Utilities.h"
+
+namespace
+{
+	// Matches local_size_x in cluster_lights.comp, one invocation bins one cluster
+	const uint32_t BINNING_GROUP_SIZE = 64;
+	// Lights closer than this fraction of their radius to a cluster's bounds may be binned either way by the GPU
+	const float BORDERLINE_TOLERANCE = 1e-4f;
+
+	// Start of the light buffer, matches the ClusterFrame block in the clustered shaders
+	struct GpuClusterHeader
+	{
+		glm::mat4 inverseProjection;
+		// Tiles across, tiles down, depth slices and the light count
+		glm::uvec4 grid;
+		// Extent followed by the near and far plane
+		glm::vec4 screen;
+		// Capacity of the light index list and the counter runs are reserved from
+		glm::uvec4 indexList;
+	};
+
+	struct ClusterBounds
+	{
+		glm::vec3 minimum;
+		glm::vec3 maximum;
+	};
+
+	VkDeviceSize getLightBufferSize(size_t lightCount)
+	{
+		return sizeof(GpuClusterHeader) + std::max<size_t>(lightCount, 1) * sizeof(PointLight);
+	}
+
+	uint32_t getIndexCapacity(const ClusterSettings& settings, uint32_t clusterCount)
+	{
+		return std::max(clusterCount * settings.averageLightsPerCluster, 1u);
+	}
+
+	// Point in view space through the pixel, scaled to a view depth of one
+	glm::vec3 getViewRay(const ClusterGrid& grid, float x, float y)
+	{
+		const glm::vec2 ndc = glm::vec2(x / grid.extent.width, y / grid.extent.height) * 2.0f - 1.0f;
+		const glm::vec4 view = grid.inverseProjection * glm::vec4(ndc, 1.0f, 1.0f);
+		const glm::vec3 point = glm::vec3(view) / view.w;
+		return point / -point.z;
+	}
+
+	float getSliceDepth(const ClusterGrid& grid, uint32_t slice)
+	{
+		return grid.nearPlane * std::pow(grid.farPlane / grid.nearPlane, static_cast<float>(slice) / grid.depthSlices);
+	}
+
+	// Must match the bounds computed in main() of cluster_lights.comp
+	ClusterBounds getClusterBounds(const ClusterGrid& grid, uint32_t cluster)
+	{
+		const uint32_t tileX = cluster % grid.tilesX;
+		const uint32_t tileY = (cluster / grid.tilesX) % grid.tilesY;
+		const uint32_t slice = cluster / (grid.tilesX * grid.tilesY);
+
+		const float tileWidth = static_cast<float>(grid.extent.width) / grid.tilesX;
+		const float tileHeight = static_cast<float>(grid.extent.height) / grid.tilesY;
+		const glm::vec3 rays[4] = {
+			getViewRay(grid, tileX * tileWidth, tileY * tileHeight),
+			getViewRay(grid, (tileX + 1) * tileWidth, tileY * tileHeight),
+			getViewRay(grid, tileX * tileWidth, (tileY + 1) * tileHeight),
+			getViewRay(grid, (tileX + 1) * tileWidth, (tileY + 1) * tileHeight)
+		};
+		const float depths[2] = { getSliceDepth(grid, slice), getSliceDepth(grid, slice + 1) };
+
+		ClusterBounds bounds = { glm::vec3(std::numeric_limits<float>::max()),
+			glm::vec3(-std::numeric_limits<float>::max()) };
+		for (const glm::vec3& ray : rays)
+		{
+			for (float depth : depths)
+			{
+				bounds.minimum = glm::min(bounds.minimum, ray * depth);
+				bounds.maximum = glm::max(bounds.maximum, ray * depth);
+			}
+		}
+		return bounds;
+	}
+
+	float getSquaredDistance(const ClusterBounds& bounds, const glm::vec3& point)
+	{
+		const glm::vec3 offset = glm::clamp(point, bounds.minimum, bounds.maximum) - point;
+		return glm::dot(offset, offset);
+	}
+
+	bool touchesCluster(const ClusterBounds& bounds, const PointLight& light)
+	{
+		return getSquaredDistance(bounds, light.position) <= light.radius * light.radius;
+	}
+}
+
+uint32_t ClusterGrid::getClusterCount() const
+{
+	return tilesX * tilesY * depthSlices;
+}
+
+ClusterGrid makeClusterGrid(const ClusterSettings& settings, VkExtent2D extent)
+{
+	ClusterGrid grid;
+	grid.tilesX = std::max(settings.tilesX, 1u);
+	grid.tilesY = std::max(settings.tilesY, 1u);
+	grid.depthSlices = std::max(settings.depthSlices, 1u);
+	grid.extent = { std::max(extent.width, 1u), std::max(extent.height, 1u) };
+	grid.nearPlane = settings.nearPlane;
+	grid.farPlane = settings.farPlane;
+
+	// Vulkan's 0 - 1 depth range, the geometry's clip space positions are unprojected with the inverse
+	const float aspectRatio = static_cast<float>(grid.extent.width) / grid.extent.height;
+	grid.inverseProjection = glm::inverse(glm::perspectiveRH_ZO(settings.verticalFieldOfView, aspectRatio,
+		settings.nearPlane, settings.farPlane));
+	return grid;
+}
+
+ClusterAssignment assignLightsReference(const ClusterGrid& grid, const std::vector<PointLight>& lights)
+{
+	const uint32_t clusterCount = grid.getClusterCount();
+	ClusterAssignment assignment;
+	assignment.clusters.resize(clusterCount);
+	for (uint32_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		const ClusterBounds bounds = getClusterBounds(grid, cluster);
+		const uint32_t offset = static_cast<uint32_t>(assignment.lightIndices.size());
+		for (uint32_t i = 0; i < lights.size(); i++)
+		{
+			if (touchesCluster(bounds, lights[i]))
+			{
+				assignment.lightIndices.push_back(i);
+			}
+		}
+		assignment.clusters[cluster] = glm::uvec2(offset, static_cast<uint32_t>(assignment.lightIndices.size()) - offset);
+	}
+	return assignment;
+}
+
+std::vector<PointLight> generateTestLights(const ClusterSettings& settings, float aspectRatio, uint32_t count,
+	uint32_t seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float tanHalfFieldOfView = std::tan(settings.verticalFieldOfView * 0.5f);
+
+	// Spread evenly over the depth slices, with radii growing with distance so each covers a similar area on screen
+	std::vector<PointLight> lights(count);
+	for (PointLight& light : lights)
+	{
+		const float depth = settings.nearPlane * std::pow(settings.farPlane / settings.nearPlane, unit(generator));
+		light.position.x = (unit(generator) * 2.0f - 1.0f) * tanHalfFieldOfView * aspectRatio * depth;
+		light.position.y = (unit(generator) * 2.0f - 1.0f) * tanHalfFieldOfView * depth;
+		light.position.z = -depth;
+		light.radius = depth * (0.05f + 0.1f * unit(generator));
+		light.colour = glm::vec3(unit(generator), unit(generator), unit(generator));
+		light.intensity = 1.0f;
+	}
+	return lights;
+}
+
+ClusteredLighting::ClusteredLighting()
+{
+}
+
+void ClusteredLighting::init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* newMemoryBudget,
+	DescriptorAllocator* newDescriptorAllocator, uint32_t newFrameCount, const ClusterSettings& newSettings)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+	memoryBudget = newMemoryBudget;
+	descriptorAllocator = newDescriptorAllocator;
+	settings = newSettings;
+
+	// Lights and grid, cluster runs and the light index list
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+	for (uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+	VkResult result = vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &descriptorSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the clustered lighting descriptor set layout");
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+	result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the light binning pipeline layout");
+	}
+
+	// Lighting is optional, without its shader the renderer stays unlit
+	VkShaderModule binningShaderModule = VK_NULL_HANDLE;
+	try
+	{
+		MappedFile binningShaderCode("Shaders/cluster_lights_comp.spv");
+		binningShaderModule = createShaderModule(device, binningShaderCode.getData());
+	}
+	catch (const std::runtime_error& e)
+	{
+		VULKAN_CORE_WARN("Clustered lighting unavailable: {}", e.what());
+	}
+
+	if (binningShaderModule != VK_NULL_HANDLE)
+	{
+		VkComputePipelineCreateInfo pipelineCreateInfo = {};
+		pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCreateInfo.stage.module = binningShaderModule;
+		pipelineCreateInfo.stage.pName = "main";
+		pipelineCreateInfo.layout = pipelineLayout;
+		result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &binningPipeline);
+		vkDestroyShaderModule(device, binningShaderModule, nullptr);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create the light binning pipeline");
+		}
+	}
+
+	setFrameCount(newFrameCount);
+	VULKAN_CORE_INFO("Clustered lighting: {}x{}x{} clusters, {} light indices per cluster on average, {}",
+		settings.tilesX, settings.tilesY, settings.depthSlices, settings.averageLightsPerCluster,
+		isAvailable() ? "available" : "unavailable");
+}
+
+bool ClusteredLighting::isAvailable() const
+{
+	return binningPipeline != VK_NULL_HANDLE;
+}
+
+VkDescriptorSetLayout ClusteredLighting::getDescriptorSetLayout() const
+{
+	return descriptorSetLayout;
+}
+
+const ClusterSettings& ClusteredLighting::getSettings() const
+{
+	return settings;
+}
+
+void ClusteredLighting::setLights(const std::vector<PointLight>& newLights)
+{
+	lights = newLights;
+}
+
+const std::vector<PointLight>& ClusteredLighting::getLights() const
+{
+	return lights;
+}
+
+void ClusteredLighting::setFrameCount(uint32_t newFrameCount)
+{
+	for (HostBuffer& frameBuffer : frameBuffers)
+	{
+		destroyHostBuffer(device, frameBuffer, memoryBudget);
+	}
+	// Buffers are created on each slot's first update, once the light count is known
+	frameBuffers.assign(newFrameCount, HostBuffer());
+	frameGrids.assign(newFrameCount, ClusterGrid());
+}
+
+void ClusteredLighting::update(uint32_t frameIndex, VkExtent2D extent)
+{
+	HostBuffer& frameBuffer = frameBuffers[frameIndex];
+	const VkDeviceSize size = getLightBufferSize(lights.size());
+	if (frameBuffer.size < size)
+	{
+		// The slot's previous frame has finished, nothing else uses its buffer. Every fragment reads the lights, so
+		// device local memory is asked for where the GPU has host visible memory of that kind
+		destroyHostBuffer(device, frameBuffer, memoryBudget);
+		frameBuffer = createHostBuffer(physicalDevice, device, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, memoryBudget,
+			true);
+	}
+
+	frameGrids[frameIndex] = makeClusterGrid(settings, extent);
+	writeFrame(frameBuffer, frameGrids[frameIndex]);
+}
+
+ClusterResources ClusteredLighting::addBinningPass(RenderGraph& graph, uint32_t frameIndex)
+{
+	const ClusterGrid& grid = frameGrids[frameIndex];
+	const uint32_t clusterCount = grid.getClusterCount();
+
+	ClusterResources resources;
+	resources.lights = graph.importBuffer("Lights", frameBuffers[frameIndex].buffer, frameBuffers[frameIndex].size);
+	resources.clusters = graph.createBuffer("Clusters", std::max(clusterCount, 1u) * sizeof(glm::uvec2));
+	resources.lightIndices = graph.createBuffer("LightIndices",
+		getIndexCapacity(settings, clusterCount) * sizeof(uint32_t));
+
+	// The light buffer's header holds the counter runs are reserved from, so it is written as well as read
+	graph.addPass("LightBinning", RenderGraphPassType::Compute)
+		.readStorageBuffer(resources.lights)
+		.writeStorageBuffer(resources.lights)
+		.writeStorageBuffer(resources.clusters)
+		.writeStorageBuffer(resources.lightIndices)
+		.setExecute([this, resources, frameIndex](const RenderGraphPassContext& context)
+		{
+			recordBinning(context.commandBuffer, createDescriptorSet(*context.graph, resources), frameGrids[frameIndex]);
+		});
+	return resources;
+}
+
+VkDescriptorSet ClusteredLighting::createDescriptorSet(const RenderGraph& graph, const ClusterResources& resources)
+{
+	VkDescriptorSet descriptorSet = descriptorAllocator->allocate(descriptorSetLayout);
+	writeDescriptorSet(descriptorSet, graph.getBuffer(resources.lights), graph.getBuffer(resources.clusters),
+		graph.getBuffer(resources.lightIndices));
+	return descriptorSet;
+}
+
+ClusterValidationResult ClusteredLighting::validate(VkCommandPool commandPool, QueueTimeline& timeline,
+	VkExtent2D extent)
+{
+	ClusterValidationResult validation;
+	if (!isAvailable())
+	{
+		return validation;
+	}
+
+	const ClusterGrid grid = makeClusterGrid(settings, extent);
+	const uint32_t clusterCount = grid.getClusterCount();
+	const uint32_t indexCapacity = getIndexCapacity(settings, clusterCount);
+	validation.clusterCount = clusterCount;
+
+	// Read back by the CPU, so host memory is what the binning writes to here
+	HostBuffer lightBuffer = createHostBuffer(physicalDevice, device, getLightBufferSize(lights.size()),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, memoryBudget);
+	HostBuffer clusterBuffer = createHostBuffer(physicalDevice, device, clusterCount * sizeof(glm::uvec2),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, memoryBudget);
+	HostBuffer indexBuffer = createHostBuffer(physicalDevice, device, indexCapacity * sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, memoryBudget);
+	writeFrame(lightBuffer, grid);
+
+	// The allocator's transient sets belong to frames, this runs outside of them with a pool of its own
+	VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 };
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.maxSets = 1;
+	poolCreateInfo.poolSizeCount = 1;
+	poolCreateInfo.pPoolSizes = &poolSize;
+	VkDescriptorPool descriptorPool;
+	VkResult result = vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &descriptorPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the cluster validation descriptor pool");
+	}
+
+	VkDescriptorSetAllocateInfo setAllocateInfo = {};
+	setAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocateInfo.descriptorPool = descriptorPool;
+	setAllocateInfo.descriptorSetCount = 1;
+	setAllocateInfo.pSetLayouts = &descriptorSetLayout;
+	VkDescriptorSet descriptorSet;
+	result = vkAllocateDescriptorSets(device, &setAllocateInfo, &descriptorSet);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate the cluster validation descriptor set");
+	}
+	writeDescriptorSet(descriptorSet, lightBuffer.buffer, clusterBuffer.buffer, indexBuffer.buffer);
+
+	VkCommandBuffer commandBuffer = beginCommandBuffer(device, commandPool);
+	recordBinning(commandBuffer, descriptorSet, grid);
+	// Waiting on the timeline does not make shader writes visible to the host by itself
+	VkMemoryBarrier hostBarrier = {};
+	hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	hostBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+		1, &hostBarrier, 0, nullptr, 0, nullptr);
+	endAndSubmitCommandBuffer(device, commandPool, timeline, commandBuffer);
+
+	const auto referenceStart = std::chrono::steady_clock::now();
+	const ClusterAssignment reference = assignLightsReference(grid, lights);
+	validation.referenceMilliseconds = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - referenceStart).count();
+
+	const GpuClusterHeader* header = static_cast<const GpuClusterHeader*>(lightBuffer.mapped);
+	const glm::uvec2* clusters = static_cast<const glm::uvec2*>(clusterBuffer.mapped);
+	const uint32_t* lightIndices = static_cast<const uint32_t*>(indexBuffer.mapped);
+	validation.lightIndexCount = header->indexList.y;
+	validation.overflowed = header->indexList.y > indexCapacity;
+
+	// Both sides list a cluster's lights in ascending order, only the position of the runs differs
+	for (uint32_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		const glm::uvec2 run = clusters[cluster];
+		const glm::uvec2 expectedRun = reference.clusters[cluster];
+		if (run.x + run.y > indexCapacity)
+		{
+			validation.mismatchCount += expectedRun.y;
+			continue;
+		}
+		const uint32_t* begin = lightIndices + run.x;
+		const uint32_t* expectedBegin = reference.lightIndices.data() + expectedRun.x;
+
+		std::vector<uint32_t> difference;
+		std::set_symmetric_difference(begin, begin + run.y, expectedBegin, expectedBegin + expectedRun.y,
+			std::back_inserter(difference));
+		const ClusterBounds bounds = getClusterBounds(grid, cluster);
+		for (uint32_t light : difference)
+		{
+			if (light >= lights.size())
+			{
+				validation.mismatchCount++;
+				continue;
+			}
+			const float radiusSquared = lights[light].radius * lights[light].radius;
+			if (std::abs(getSquaredDistance(bounds, lights[light].position) - radiusSquared) <=
+				BORDERLINE_TOLERANCE * radiusSquared)
+			{
+				validation.borderlineCount++;
+			}
+			else
+			{
+				if (validation.mismatchCount == 0)
+				{
+					VULKAN_CORE_WARN("Cluster {} disagrees with the reference about light {}", cluster, light);
+				}
+				validation.mismatchCount++;
+			}
+		}
+	}
+	validation.passed = !validation.overflowed && validation.mismatchCount == 0;
+
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	destroyHostBuffer(device, indexBuffer, memoryBudget);
+	destroyHostBuffer(device, clusterBuffer, memoryBudget);
+	destroyHostBuffer(device, lightBuffer, memoryBudget);
+	return validation;
+}
+
+void ClusteredLighting::cleanup()
+{
+	for (HostBuffer& frameBuffer : frameBuffers)
+	{
+		destroyHostBuffer(device, frameBuffer, memoryBudget);
+	}
+	frameBuffers.clear();
+	frameGrids.clear();
+	vkDestroyPipeline(device, binningPipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+	binningPipeline = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	descriptorSetLayout = VK_NULL_HANDLE;
+}
+
+void ClusteredLighting::writeFrame(HostBuffer& frameBuffer, const ClusterGrid& grid)
+{
+	GpuClusterHeader header = {};
+	header.inverseProjection = grid.inverseProjection;
+	header.grid = glm::uvec4(grid.tilesX, grid.tilesY, grid.depthSlices, static_cast<uint32_t>(lights.size()));
+	header.screen = glm::vec4(grid.extent.width, grid.extent.height, grid.nearPlane, grid.farPlane);
+	// The counter starts from zero every frame, the binning pass is the only one adding to it
+	header.indexList = glm::uvec4(getIndexCapacity(settings, grid.getClusterCount()), 0, 0, 0);
+
+	char* data = static_cast<char*>(frameBuffer.mapped);
+	std::memcpy(data, &header, sizeof(header));
+	std::memcpy(data + sizeof(header), lights.data(), lights.size() * sizeof(PointLight));
+}
+
+void ClusteredLighting::recordBinning(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet,
+	const ClusterGrid& grid)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, binningPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet,
+		0, nullptr);
+	vkCmdDispatch(commandBuffer, (grid.getClusterCount() + BINNING_GROUP_SIZE - 1) / BINNING_GROUP_SIZE, 1, 1);
+}
+
+void ClusteredLighting::writeDescriptorSet(VkDescriptorSet descriptorSet, VkBuffer lightBuffer,
+	VkBuffer clusterBuffer, VkBuffer lightIndexBuffer)
+{
+	const VkBuffer buffers[3] = { lightBuffer, clusterBuffer, lightIndexBuffer };
+	std::array<VkDescriptorBufferInfo, 3> bufferInfos = {};
+	std::array<VkWriteDescriptorSet, 3> writes = {};
+	for (uint32_t i = 0; i < writes.size(); i++)
+	{
+		bufferInfos[i].buffer = buffers[i];
+		bufferInfos[i].offset = 0;
+		bufferInfos[i].range = VK_WHOLE_SIZE;
+
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = descriptorSet;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "DescriptorAllocator.h"
+#include "MemoryBudget.h"
+#include "QueueTimeline.h"
+#include "RenderGraph.h"
+#include "Utilities.h"
+
+// Matches the Light struct in the clustered shaders, positions are in view space
+struct PointLight
+{
+	glm::vec3 position = glm::vec3(0.0f);
+	float radius = 1.0f;
+	glm::vec3 colour = glm::vec3(1.0f);
+	float intensity = 1.0f;
+};
+
+struct ClusterSettings
+{
+	// Screen tiles across and down, and depth slices between the near and far plane
+	uint32_t tilesX = 16;
+	uint32_t tilesY = 9;
+	uint32_t depthSlices = 24;
+	// Perspective the clip space geometry is lit with, depth slices are spaced exponentially between the planes
+	float verticalFieldOfView = glm::radians(60.0f);
+	float nearPlane = 0.1f;
+	float farPlane = 100.0f;
+	// Sizes the compact light index list, clusters binned after it fills up are written with fewer lights
+	uint32_t averageLightsPerCluster = 32;
+};
+
+// The froxel grid for one extent, shared by the CPU reference and the binning shader
+struct ClusterGrid
+{
+	uint32_t tilesX = 0;
+	uint32_t tilesY = 0;
+	uint32_t depthSlices = 0;
+	VkExtent2D extent = {};
+	glm::mat4 inverseProjection = glm::mat4(1.0f);
+	float nearPlane = 0.0f;
+	float farPlane = 0.0f;
+
+	uint32_t getClusterCount() const;
+};
+
+// Offset and count of each cluster's run in the light index list, in the layout the binning shader writes
+struct ClusterAssignment
+{
+	std::vector<glm::uvec2> clusters;
+	std::vector<uint32_t> lightIndices;
+};
+
+ClusterGrid makeClusterGrid(const ClusterSettings& settings, VkExtent2D extent);
+// CPU version of the binning shader, same cluster bounds and the same light order within each cluster. Runs are
+// packed in cluster order where the GPU packs them in whatever order the clusters finish.
+ClusterAssignment assignLightsReference(const ClusterGrid& grid, const std::vector<PointLight>& lights);
+// Lights spread through the view frustum, for testing how binning scales
+std::vector<PointLight> generateTestLights(const ClusterSettings& settings, float aspectRatio, uint32_t count,
+	uint32_t seed = 1);
+
+// GPU binning compared against the CPU reference, lights sitting on a cluster boundary to within float precision
+// can land on either side and are counted separately
+struct ClusterValidationResult
+{
+	bool passed = false;
+	uint32_t clusterCount = 0;
+	uint32_t lightIndexCount = 0;
+	bool overflowed = false;
+	uint32_t mismatchCount = 0;
+	uint32_t borderlineCount = 0;
+	double referenceMilliseconds = 0.0;
+};
+
+// Graph resources holding one frame's light assignment
+struct ClusterResources
+{
+	RenderGraphResource lights = 0;
+	RenderGraphResource clusters = 0;
+	RenderGraphResource lightIndices = 0;
+};
+
+// Bins point lights into a froxel grid with a compute pass every frame, so the forward pass only shades the
+// lights that can reach each cluster. The lights and grid parameters are written by the CPU into a host visible
+// buffer per frame in flight, the cluster runs and light index list are transient render graph buffers.
+class ClusteredLighting
+{
+public:
+	ClusteredLighting();
+	void init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* newMemoryBudget,
+		DescriptorAllocator* newDescriptorAllocator, uint32_t newFrameCount, const ClusterSettings& newSettings);
+	// False when the binning shader could not be loaded, the renderer then draws unlit
+	bool isAvailable() const;
+	// Binning pass and lit fragment shader share one layout
+	VkDescriptorSetLayout getDescriptorSetLayout() const;
+	const ClusterSettings& getSettings() const;
+
+	// Picked up by each frame slot on its next update
+	void setLights(const std::vector<PointLight>& newLights);
+	const std::vector<PointLight>& getLights() const;
+	// Every frame's buffers must no longer be in use
+	void setFrameCount(uint32_t newFrameCount);
+
+	// Writes the lights and grid of the frame slot, its previous submission has to have finished
+	void update(uint32_t frameIndex, VkExtent2D extent);
+	// Declares the binning pass, passes shading with the lights read the returned resources
+	ClusterResources addBinningPass(RenderGraph& graph, uint32_t frameIndex);
+	// Transient set for the current frame pointing at the graph's buffers
+	VkDescriptorSet createDescriptorSet(const RenderGraph& graph, const ClusterResources& resources);
+
+	// Bins the current lights on the GPU outside of any frame and compares the result with assignLightsReference
+	ClusterValidationResult validate(VkCommandPool commandPool, QueueTimeline& timeline, VkExtent2D extent);
+
+	void cleanup();
+private:
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryBudget* memoryBudget = nullptr;
+	DescriptorAllocator* descriptorAllocator = nullptr;
+	ClusterSettings settings;
+
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline binningPipeline = VK_NULL_HANDLE;
+
+	std::vector<PointLight> lights;
+	// Header and lights of each frame in flight, with the grid they were last written for
+	std::vector<HostBuffer> frameBuffers;
+	std::vector<ClusterGrid> frameGrids;
+
+	void writeFrame(HostBuffer& frameBuffer, const ClusterGrid& grid);
+	void recordBinning(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, const ClusterGrid& grid);
+	void writeDescriptorSet(VkDescriptorSet descriptorSet, VkBuffer lightBuffer, VkBuffer clusterBuffer,
+		VkBuffer lightIndexBuffer);
+};
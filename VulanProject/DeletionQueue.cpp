@@ -0,0 +1,60 @@
+#include "DeletionQueue.h"
+
+#include <algorithm>
+
+DeletionQueue::DeletionQueue()
+{
+}
+
+void DeletionQueue::init(QueueTimeline* newTimeline)
+{
+	timeline = newTimeline;
+}
+
+void DeletionQueue::retire(std::function<void()>&& destroy)
+{
+	retire(timeline->getLastSubmittedValue(), std::move(destroy));
+}
+
+void DeletionQueue::retire(uint64_t timelineValue, std::function<void()>&& destroy)
+{
+	// Almost always the newest value, an older one is slotted in so collect can stop at the first unfinished entry
+	auto position = std::upper_bound(entries.begin(), entries.end(), timelineValue,
+		[](uint64_t value, const Entry& entry)
+		{
+			return value < entry.timelineValue;
+		});
+	entries.insert(position, Entry{ timelineValue, std::move(destroy) });
+}
+
+void DeletionQueue::collect()
+{
+	while (!entries.empty() && timeline->isComplete(entries.front().timelineValue))
+	{
+		// Moved out first, a destroy function may retire something else in turn
+		std::function<void()> destroy = std::move(entries.front().destroy);
+		entries.pop_front();
+		destroy();
+	}
+}
+
+void DeletionQueue::flush()
+{
+	while (!entries.empty())
+	{
+		std::function<void()> destroy = std::move(entries.front().destroy);
+		entries.pop_front();
+		destroy();
+	}
+}
+
+size_t DeletionQueue::getPendingCount()
+{
+	return entries.size();
+}
+
+void DeletionQueue::cleanup()
+{
+	flush();
+	timeline = nullptr;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <deque>
+#include <functional>
+
+#include "QueueTimeline.h"
+
+// Destroys resources once the submissions that may still use them have finished, so replacing or unloading
+// something at runtime never has to wait for the device to go idle. Entries run in timeline order.
+class DeletionQueue
+{
+public:
+	DeletionQueue();
+	void init(QueueTimeline* newTimeline);
+
+	// Runs once everything submitted so far has finished, for resources no later submission will use
+	void retire(std::function<void()>&& destroy);
+	// Runs once the timeline reaches the value
+	void retire(uint64_t timelineValue, std::function<void()>&& destroy);
+
+	// Runs every entry whose work has finished, called once a frame
+	void collect();
+	// Runs every entry regardless, only once the device is idle
+	void flush();
+	size_t getPendingCount();
+
+	void cleanup();
+private:
+	struct Entry
+	{
+		uint64_t timelineValue = 0;
+		std::function<void()> destroy;
+	};
+
+	QueueTimeline* timeline = nullptr;
+	// Oldest timeline value first
+	std::deque<Entry> entries;
+};
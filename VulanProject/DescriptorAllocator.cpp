@@ -0,0 +1,279 @@
+#include "DescriptorAllocator.h"
+
+#include <array>
+#include <functional>
+#include <stdexcept>
+
+#include "Log.h"
+
+namespace
+{
+	constexpr uint32_t SETS_PER_POOL = 256;
+
+	// Descriptor count per set for each type, multiplied by SETS_PER_POOL when a pool is created
+	const std::array<std::pair<VkDescriptorType, float>, 6> poolSizeRatios = {{
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1.0f }
+	}};
+
+	void hashCombine(size_t& seed, size_t value)
+	{
+		seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	}
+
+	// Non-dispatchable handles are pointers on 64 bit and uint64_t on 32 bit
+	template <typename T>
+	size_t hashHandle(T handle)
+	{
+		return std::hash<uint64_t>()((uint64_t)handle);
+	}
+}
+
+bool DescriptorAllocator::CacheKey::operator==(const CacheKey& other) const
+{
+	if (layout != other.layout || bindings.size() != other.bindings.size())
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < bindings.size(); i++)
+	{
+		const DescriptorBinding& a = bindings[i];
+		const DescriptorBinding& b = other.bindings[i];
+		if (a.binding != b.binding || a.type != b.type ||
+			a.bufferInfo.buffer != b.bufferInfo.buffer || a.bufferInfo.offset != b.bufferInfo.offset ||
+			a.bufferInfo.range != b.bufferInfo.range || a.imageInfo.sampler != b.imageInfo.sampler ||
+			a.imageInfo.imageView != b.imageInfo.imageView || a.imageInfo.imageLayout != b.imageInfo.imageLayout)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t DescriptorAllocator::CacheKeyHash::operator()(const CacheKey& key) const
+{
+	size_t seed = hashHandle(key.layout);
+	for (const auto& binding : key.bindings)
+	{
+		hashCombine(seed, binding.binding);
+		hashCombine(seed, binding.type);
+		hashCombine(seed, hashHandle(binding.bufferInfo.buffer));
+		hashCombine(seed, binding.bufferInfo.offset);
+		hashCombine(seed, binding.bufferInfo.range);
+		hashCombine(seed, hashHandle(binding.imageInfo.imageView));
+		hashCombine(seed, hashHandle(binding.imageInfo.sampler));
+		hashCombine(seed, binding.imageInfo.imageLayout);
+	}
+	return seed;
+}
+
+DescriptorAllocator::DescriptorAllocator()
+{
+}
+
+void DescriptorAllocator::init(VkDevice newDevice, uint32_t newFrameCount)
+{
+	device = newDevice;
+	frameCount = newFrameCount;
+	currentFrame = 0;
+	framePools.resize(frameCount);
+}
+
+void DescriptorAllocator::beginFrame(uint32_t frameIndex)
+{
+	allocationsLastFrame = allocationsThisFrame;
+	allocationsThisFrame = 0;
+	currentFrame = frameIndex;
+
+	// Reset the whole frame at once instead of freeing sets individually
+	PoolList& poolList = framePools[currentFrame];
+	for (VkDescriptorPool pool : poolList.usedPools)
+	{
+		vkResetDescriptorPool(device, pool, 0);
+		poolList.freePools.push_back(pool);
+	}
+	poolList.usedPools.clear();
+	if (poolList.currentPool != VK_NULL_HANDLE)
+	{
+		vkResetDescriptorPool(device, poolList.currentPool, 0);
+	}
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+	return allocateFromList(framePools[currentFrame], layout);
+}
+
+VkDescriptorSet DescriptorAllocator::allocateStatic(VkDescriptorSetLayout layout, const std::vector<DescriptorBinding>& bindings)
+{
+	CacheKey key = { layout, bindings };
+	auto cached = staticSetCache.find(key);
+	if (cached != staticSetCache.end())
+	{
+		return cached->second;
+	}
+
+	VkDescriptorSet set = allocateFromList(staticPools, layout);
+
+	std::vector<VkWriteDescriptorSet> writes(bindings.size());
+	for (size_t i = 0; i < bindings.size(); i++)
+	{
+		writes[i] = {};
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = set;
+		writes[i].dstBinding = bindings[i].binding;
+		writes[i].dstArrayElement = 0;
+		writes[i].descriptorType = bindings[i].type;
+		writes[i].descriptorCount = 1;
+		if (bindings[i].bufferInfo.buffer != VK_NULL_HANDLE)
+		{
+			writes[i].pBufferInfo = &bindings[i].bufferInfo;
+		}
+		else
+		{
+			writes[i].pImageInfo = &bindings[i].imageInfo;
+		}
+	}
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	staticSetCache.emplace(std::move(key), set);
+	return set;
+}
+
+uint32_t DescriptorAllocator::getAllocationsLastFrame()
+{
+	return allocationsLastFrame;
+}
+
+uint32_t DescriptorAllocator::getPoolCount()
+{
+	auto countList = [](const PoolList& poolList)
+	{
+		return static_cast<uint32_t>(poolList.usedPools.size() + poolList.freePools.size()) +
+			(poolList.currentPool != VK_NULL_HANDLE ? 1 : 0);
+	};
+
+	uint32_t count = countList(staticPools);
+	for (const auto& poolList : framePools)
+	{
+		count += countList(poolList);
+	}
+	return count;
+}
+
+void DescriptorAllocator::setFrameCount(uint32_t newFrameCount)
+{
+	// Static sets outlive the change, only the per frame pools are rebuilt
+	for (auto& poolList : framePools)
+	{
+		destroyPoolList(poolList);
+	}
+	frameCount = newFrameCount;
+	currentFrame = 0;
+	framePools.clear();
+	framePools.resize(frameCount);
+}
+
+void DescriptorAllocator::cleanup()
+{
+	for (auto& poolList : framePools)
+	{
+		destroyPoolList(poolList);
+	}
+	destroyPoolList(staticPools);
+	framePools.clear();
+	staticSetCache.clear();
+}
+
+void DescriptorAllocator::destroyPoolList(PoolList& poolList)
+{
+	for (VkDescriptorPool pool : poolList.usedPools)
+	{
+		vkDestroyDescriptorPool(device, pool, nullptr);
+	}
+	for (VkDescriptorPool pool : poolList.freePools)
+	{
+		vkDestroyDescriptorPool(device, pool, nullptr);
+	}
+	if (poolList.currentPool != VK_NULL_HANDLE)
+	{
+		vkDestroyDescriptorPool(device, poolList.currentPool, nullptr);
+	}
+	poolList = {};
+}
+
+VkDescriptorSet DescriptorAllocator::allocateFromList(PoolList& poolList, VkDescriptorSetLayout layout)
+{
+	if (poolList.currentPool == VK_NULL_HANDLE)
+	{
+		poolList.currentPool = grabPool(poolList);
+	}
+
+	VkDescriptorSetAllocateInfo setAllocInfo = {};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool = poolList.currentPool;
+	setAllocInfo.descriptorSetCount = 1;
+	setAllocInfo.pSetLayouts = &layout;
+
+	VkDescriptorSet set;
+	VkResult result = vkAllocateDescriptorSets(device, &setAllocInfo, &set);
+	// A full or fragmented pool is only reported as such from 1.1 or VK_KHR_maintenance1 on, a 1.0 device may return
+	// an out of memory error instead. Every failure is retried once in a fresh pool, only failing there is an error
+	if (result != VK_SUCCESS)
+	{
+		// Current pool is full, retire it and try again with a fresh one
+		poolList.usedPools.push_back(poolList.currentPool);
+		poolList.currentPool = grabPool(poolList);
+		setAllocInfo.descriptorPool = poolList.currentPool;
+		result = vkAllocateDescriptorSets(device, &setAllocInfo, &set);
+	}
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate a descriptor set");
+	}
+
+	allocationsThisFrame++;
+	return set;
+}
+
+VkDescriptorPool DescriptorAllocator::grabPool(PoolList& poolList)
+{
+	if (!poolList.freePools.empty())
+	{
+		VkDescriptorPool pool = poolList.freePools.back();
+		poolList.freePools.pop_back();
+		return pool;
+	}
+	return createPool();
+}
+
+VkDescriptorPool DescriptorAllocator::createPool()
+{
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	poolSizes.reserve(poolSizeRatios.size());
+	for (const auto& ratio : poolSizeRatios)
+	{
+		poolSizes.push_back({ ratio.first, static_cast<uint32_t>(ratio.second * SETS_PER_POOL) });
+	}
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.maxSets = SETS_PER_POOL;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+
+	VkDescriptorPool pool;
+	VkResult result = vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &pool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a descriptor pool");
+	}
+	VULKAN_CORE_TRACE("Created descriptor pool, {} pools in use", getPoolCount() + 1);
+	return pool;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <unordered_map>
+#include <vector>
+
+// A single descriptor write used both to fill a set and to key the immutable set cache
+struct DescriptorBinding
+{
+	uint32_t binding = 0;
+	VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	VkDescriptorBufferInfo bufferInfo = {};
+	VkDescriptorImageInfo imageInfo = {};
+};
+
+class DescriptorAllocator
+{
+public:
+	DescriptorAllocator();
+	void init(VkDevice newDevice, uint32_t newFrameCount);
+
+	// Resets every pool owned by the given frame, the frame's previous sets must no longer be in use
+	void beginFrame(uint32_t frameIndex);
+	// Changes the number of frames in flight, every frame's transient sets must no longer be in use
+	void setFrameCount(uint32_t newFrameCount);
+
+	// Transient set that is only valid until the current frame index comes around again
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+	// Long lived set, identical layout + bindings return the same set
+	VkDescriptorSet allocateStatic(VkDescriptorSetLayout layout, const std::vector<DescriptorBinding>& bindings);
+
+	uint32_t getAllocationsLastFrame();
+	uint32_t getPoolCount();
+
+	void cleanup();
+private:
+	struct PoolList
+	{
+		std::vector<VkDescriptorPool> usedPools;
+		std::vector<VkDescriptorPool> freePools;
+		VkDescriptorPool currentPool = VK_NULL_HANDLE;
+	};
+
+	struct CacheKey
+	{
+		VkDescriptorSetLayout layout;
+		std::vector<DescriptorBinding> bindings;
+
+		bool operator==(const CacheKey& other) const;
+	};
+
+	struct CacheKeyHash
+	{
+		size_t operator()(const CacheKey& key) const;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	uint32_t frameCount = 0;
+	uint32_t currentFrame = 0;
+
+	std::vector<PoolList> framePools;
+	PoolList staticPools;
+	std::unordered_map<CacheKey, VkDescriptorSet, CacheKeyHash> staticSetCache;
+
+	uint32_t allocationsThisFrame = 0;
+	uint32_t allocationsLastFrame = 0;
+
+	VkDescriptorSet allocateFromList(PoolList& poolList, VkDescriptorSetLayout layout);
+	VkDescriptorPool grabPool(PoolList& poolList);
+	VkDescriptorPool createPool();
+	void destroyPoolList(PoolList& poolList);
+};
@@ -0,0 +1,488 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+#include "Log.h"
+
+namespace
+{
+	// Weight of the newest sample in the smoothed CPU and GPU predictions
+	const double PREDICTION_SMOOTHING = 0.1;
+	// Slack left between the predicted end of the CPU work and the GPU running dry
+	const double LOW_LATENCY_MARGIN_MILLISECONDS = 1.0;
+	// Upper bound on any single pacing wait, a bad prediction can only ever cost this much
+	const double MAX_PACING_WAIT_MILLISECONDS = 50.0;
+	// Present ids that were never waited on are dropped past this, e.g. when nothing polls them
+	const size_t MAX_PENDING_PRESENTS = 16;
+
+	double toMilliseconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	std::chrono::steady_clock::duration fromMilliseconds(double milliseconds)
+	{
+		return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double, std::milli>(milliseconds));
+	}
+
+	double smooth(double prediction, double sample)
+	{
+		return prediction == 0.0 ? sample : prediction + (sample - prediction) * PREDICTION_SMOOTHING;
+	}
+
+	// OS sleeps overshoot by up to a scheduler tick, so the last stretch is spent yielding instead
+	void sleepUntil(std::chrono::steady_clock::time_point target)
+	{
+		const auto spinThreshold = std::chrono::milliseconds(2);
+		if (target - std::chrono::steady_clock::now() > spinThreshold)
+		{
+			std::this_thread::sleep_until(target - spinThreshold);
+		}
+		while (std::chrono::steady_clock::now() < target)
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+FramePacer::FramePacer()
+{
+}
+
+void FramePacer::init(VkPhysicalDevice physicalDevice, VkDevice newDevice, uint32_t queueFamilyIndex,
+	bool presentWaitSupported, bool pipelineStatisticsSupported, uint32_t newFrameCount)
+{
+	device = newDevice;
+	frameCount = newFrameCount;
+	pipelineStatistics = pipelineStatisticsSupported;
+
+	// vkWaitForPresentKHR is not exported by the loader, it has to come from the device
+	waitForPresent = nullptr;
+	if (presentWaitSupported)
+	{
+		waitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(device, "vkWaitForPresentKHR");
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	const uint32_t validBits = queueFamilies[queueFamilyIndex].timestampValidBits;
+	timestampPeriod = validBits > 0 ? properties.limits.timestampPeriod : 0.0;
+	timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	createQueryPools();
+	resetStatistics();
+	VULKAN_CORE_INFO("Frame pacing: GPU timestamps {}, present wait {}, pipeline statistics {}", timestampPeriod > 0.0,
+		waitForPresent != nullptr, pipelineStatistics);
+}
+
+void FramePacer::setFrameCount(uint32_t newFrameCount)
+{
+	destroyQueryPools();
+	frameCount = newFrameCount;
+	createQueryPools();
+	resetStatistics();
+}
+
+void FramePacer::createQueryPools()
+{
+	frameSlots.assign(frameCount, FrameSlot());
+	if (timestampPeriod > 0.0)
+	{
+		// A begin and end timestamp per frame slot
+		VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCreateInfo.queryCount = frameCount * 2;
+
+		VkResult result = vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &timestampPool);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create timestamp query pool");
+		}
+	}
+
+	if (pipelineStatistics)
+	{
+		// One query spanning the whole frame per frame slot
+		VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+		queryPoolCreateInfo.queryCount = frameCount;
+		queryPoolCreateInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+		VkResult result = vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &statisticsPool);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline statistics query pool");
+		}
+	}
+}
+
+void FramePacer::destroyQueryPools()
+{
+	if (timestampPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(device, timestampPool, nullptr);
+		timestampPool = VK_NULL_HANDLE;
+	}
+	if (statisticsPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(device, statisticsPool, nullptr);
+		statisticsPool = VK_NULL_HANDLE;
+	}
+}
+
+void FramePacer::setLowLatency(bool enabled)
+{
+	if (enabled == lowLatency)
+	{
+		return;
+	}
+	lowLatency = enabled;
+
+#ifdef _WIN32
+	// The default scheduler tick is far too coarse to pace frames with
+	if (lowLatency)
+	{
+		timeBeginPeriod(1);
+	}
+	else
+	{
+		timeEndPeriod(1);
+	}
+#endif
+	VULKAN_CORE_INFO("Low latency frame pacing {}", lowLatency ? "enabled" : "disabled");
+}
+
+bool FramePacer::isLowLatency()
+{
+	return lowLatency;
+}
+
+bool FramePacer::isPresentWaitSupported()
+{
+	return waitForPresent != nullptr;
+}
+
+void FramePacer::waitForFrameStart(VkSwapchainKHR swapchain)
+{
+	const Clock::time_point waitStart = Clock::now();
+
+	if (lowLatency)
+	{
+		// Keep no more than the last submitted frame queued for the display
+		if (waitForPresent != nullptr && !pendingPresents.empty() && nextPresentId > 2)
+		{
+			const uint64_t presentId = nextPresentId - 2;
+			if (pendingPresents.front().presentId <= presentId)
+			{
+				const uint64_t timeout = static_cast<uint64_t>(MAX_PACING_WAIT_MILLISECONDS * 1000000.0);
+				const VkResult result = waitForPresent(device, swapchain, presentId, timeout);
+				if (result == VK_SUCCESS)
+				{
+					completePresents(presentId, Clock::now());
+				}
+				else
+				{
+					// Timed out or the swapchain went away, the frame will never be reported
+					completePresents(presentId, Clock::time_point());
+				}
+			}
+		}
+
+		// Start late enough that the frame's CPU work finishes just as the GPU runs out of queued work
+		if (predictedGpuIdleTime != Clock::time_point())
+		{
+			const Clock::time_point now = Clock::now();
+			const Clock::time_point target = predictedGpuIdleTime -
+				fromMilliseconds(predictedCpuMilliseconds + LOW_LATENCY_MARGIN_MILLISECONDS);
+			sleepUntil(std::min(target, now + fromMilliseconds(MAX_PACING_WAIT_MILLISECONDS)));
+		}
+	}
+
+	frameStartTime = Clock::now();
+	frameStarted = true;
+	totalPacingWaitMilliseconds += toMilliseconds(frameStartTime - waitStart);
+}
+
+void FramePacer::beginFrame()
+{
+	if (!frameStarted)
+	{
+		frameStartTime = Clock::now();
+	}
+	frameStarted = false;
+
+	if (lastFrameStartTime != Clock::time_point())
+	{
+		totalFrameMilliseconds += toMilliseconds(frameStartTime - lastFrameStartTime);
+		timedFrameCount++;
+	}
+	lastFrameStartTime = frameStartTime;
+}
+
+void FramePacer::collectCompletedFrames(uint64_t completedTimelineValue)
+{
+	const Clock::time_point now = Clock::now();
+	for (uint32_t i = 0; i < frameCount; i++)
+	{
+		if (frameSlots[i].pending && frameSlots[i].timelineValue <= completedTimelineValue)
+		{
+			completeFrame(i, now);
+		}
+	}
+}
+
+void FramePacer::frameSlotCompleted(uint32_t frameSlot, double gpuWaitMilliseconds)
+{
+	totalGpuWaitMilliseconds += gpuWaitMilliseconds;
+	if (frameSlots[frameSlot].pending)
+	{
+		completeFrame(frameSlot, Clock::now());
+	}
+}
+
+void FramePacer::addGpuWait(double milliseconds)
+{
+	totalGpuWaitMilliseconds += milliseconds;
+}
+
+void FramePacer::completeFrame(uint32_t frameSlot, Clock::time_point completionTime)
+{
+	FrameSlot& slot = frameSlots[frameSlot];
+	slot.pending = false;
+
+	const double latency = toMilliseconds(completionTime - slot.startTime);
+	totalLatencyMilliseconds += latency;
+	maxLatencyMilliseconds = std::max(maxLatencyMilliseconds, latency);
+	latencySampleCount++;
+
+	// Nothing was queued behind the newest frame, so the GPU went idle no later than now
+	if (slot.submitTime == lastSubmitTime)
+	{
+		predictedGpuIdleTime = std::min(predictedGpuIdleTime, completionTime);
+	}
+
+	double gpuMilliseconds = 0.0;
+	if (slot.timestampsWritten)
+	{
+		uint64_t timestamps[2];
+		const VkResult result = vkGetQueryPoolResults(device, timestampPool, frameSlot * 2, 2, sizeof(timestamps),
+			timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (result == VK_SUCCESS)
+		{
+			gpuMilliseconds = ((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriod / 1000000.0;
+			totalGpuMilliseconds += gpuMilliseconds;
+			gpuSampleCount++;
+		}
+	}
+	else
+	{
+		// Without timestamps the time from submit to seeing the frame complete is the best available estimate
+		gpuMilliseconds = toMilliseconds(completionTime - slot.submitTime);
+	}
+	predictedGpuMilliseconds = smooth(predictedGpuMilliseconds, gpuMilliseconds);
+
+	if (slot.statisticsWritten)
+	{
+		// Written in the order of the statistic bits, vertex before fragment
+		uint64_t invocations[2] = {};
+		const VkResult result = vkGetQueryPoolResults(device, statisticsPool, frameSlot, 1, sizeof(invocations),
+			invocations, sizeof(invocations), VK_QUERY_RESULT_64_BIT);
+		if (result == VK_SUCCESS)
+		{
+			totalVertexInvocations += static_cast<double>(invocations[0]);
+			totalFragmentInvocations += static_cast<double>(invocations[1]);
+			statisticsSampleCount++;
+		}
+	}
+}
+
+void FramePacer::writeBeginQueries(VkCommandBuffer commandBuffer, uint32_t frameSlot)
+{
+	if (timestampPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, timestampPool, frameSlot * 2, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, frameSlot * 2);
+	}
+	if (statisticsPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, statisticsPool, frameSlot, 1);
+		vkCmdBeginQuery(commandBuffer, statisticsPool, frameSlot, 0);
+	}
+}
+
+void FramePacer::writeEndQueries(VkCommandBuffer commandBuffer, uint32_t frameSlot)
+{
+	if (statisticsPool != VK_NULL_HANDLE)
+	{
+		vkCmdEndQuery(commandBuffer, statisticsPool, frameSlot);
+		frameSlots[frameSlot].statisticsWritten = true;
+	}
+	if (timestampPool != VK_NULL_HANDLE)
+	{
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, frameSlot * 2 + 1);
+		frameSlots[frameSlot].timestampsWritten = true;
+	}
+}
+
+uint64_t FramePacer::frameSubmitted(uint32_t frameSlot, uint64_t timelineValue, VkSwapchainKHR swapchain)
+{
+	const Clock::time_point now = Clock::now();
+	FrameSlot& slot = frameSlots[frameSlot];
+	slot.startTime = frameStartTime;
+	slot.submitTime = now;
+	slot.timelineValue = timelineValue;
+	slot.pending = true;
+	lastSubmitTime = now;
+
+	const double cpuMilliseconds = toMilliseconds(now - frameStartTime);
+	totalCpuMilliseconds += cpuMilliseconds;
+	predictedCpuMilliseconds = smooth(predictedCpuMilliseconds, cpuMilliseconds);
+	// The GPU starts this frame once it is through everything queued before it
+	predictedGpuIdleTime = std::max(now, predictedGpuIdleTime) + fromMilliseconds(predictedGpuMilliseconds);
+	submittedFrameCount++;
+
+	if (waitForPresent == nullptr)
+	{
+		return 0;
+	}
+
+	pollPresents(swapchain);
+	if (pendingPresents.size() >= MAX_PENDING_PRESENTS)
+	{
+		pendingPresents.pop_front();
+	}
+	pendingPresents.push_back({ nextPresentId, frameStartTime });
+	return nextPresentId++;
+}
+
+void FramePacer::pollPresents(VkSwapchainKHR swapchain)
+{
+	// Ids complete in order, so the newest one that has been presented accounts for everything before it
+	uint64_t presentedId = 0;
+	for (const PendingPresent& pending : pendingPresents)
+	{
+		if (waitForPresent(device, swapchain, pending.presentId, 0) != VK_SUCCESS)
+		{
+			break;
+		}
+		presentedId = pending.presentId;
+	}
+	if (presentedId != 0)
+	{
+		completePresents(presentedId, Clock::now());
+	}
+}
+
+void FramePacer::completePresents(uint64_t presentId, Clock::time_point presentTime)
+{
+	while (!pendingPresents.empty() && pendingPresents.front().presentId <= presentId)
+	{
+		if (presentTime != Clock::time_point())
+		{
+			const double latency = toMilliseconds(presentTime - pendingPresents.front().startTime);
+			totalPresentLatencyMilliseconds += latency;
+			maxPresentLatencyMilliseconds = std::max(maxPresentLatencyMilliseconds, latency);
+			presentSampleCount++;
+		}
+		pendingPresents.pop_front();
+	}
+}
+
+void FramePacer::swapchainChanged()
+{
+	pendingPresents.clear();
+}
+
+FrameStatistics FramePacer::getStatistics()
+{
+	FrameStatistics statistics;
+	statistics.frameCount = timedFrameCount;
+	if (timedFrameCount > 0)
+	{
+		statistics.averageFrameMilliseconds = totalFrameMilliseconds / timedFrameCount;
+		statistics.averageGpuWaitMilliseconds = totalGpuWaitMilliseconds / timedFrameCount;
+		statistics.averagePacingWaitMilliseconds = totalPacingWaitMilliseconds / timedFrameCount;
+	}
+	if (submittedFrameCount > 0)
+	{
+		statistics.averageCpuMilliseconds = totalCpuMilliseconds / submittedFrameCount;
+	}
+	if (gpuSampleCount > 0)
+	{
+		statistics.averageGpuMilliseconds = totalGpuMilliseconds / gpuSampleCount;
+	}
+	if (latencySampleCount > 0)
+	{
+		statistics.averageLatencyMilliseconds = totalLatencyMilliseconds / latencySampleCount;
+		statistics.maxLatencyMilliseconds = maxLatencyMilliseconds;
+	}
+	if (presentSampleCount > 0)
+	{
+		statistics.presentLatencyMeasured = true;
+		statistics.averagePresentLatencyMilliseconds = totalPresentLatencyMilliseconds / presentSampleCount;
+		statistics.maxPresentLatencyMilliseconds = maxPresentLatencyMilliseconds;
+	}
+	if (statisticsSampleCount > 0)
+	{
+		statistics.fragmentInvocationsMeasured = true;
+		statistics.averageVertexInvocations = totalVertexInvocations / statisticsSampleCount;
+		statistics.averageFragmentInvocations = totalFragmentInvocations / statisticsSampleCount;
+	}
+	return statistics;
+}
+
+void FramePacer::resetStatistics()
+{
+	// Predictions are kept, only the accumulated measurements start over
+	lastFrameStartTime = Clock::time_point();
+	timedFrameCount = 0;
+	latencySampleCount = 0;
+	presentSampleCount = 0;
+	gpuSampleCount = 0;
+	submittedFrameCount = 0;
+	statisticsSampleCount = 0;
+	totalFrameMilliseconds = 0.0;
+	totalCpuMilliseconds = 0.0;
+	totalGpuMilliseconds = 0.0;
+	totalLatencyMilliseconds = 0.0;
+	maxLatencyMilliseconds = 0.0;
+	totalPresentLatencyMilliseconds = 0.0;
+	maxPresentLatencyMilliseconds = 0.0;
+	totalGpuWaitMilliseconds = 0.0;
+	totalPacingWaitMilliseconds = 0.0;
+	totalVertexInvocations = 0.0;
+	totalFragmentInvocations = 0.0;
+	for (FrameSlot& slot : frameSlots)
+	{
+		slot.pending = false;
+	}
+	pendingPresents.clear();
+}
+
+void FramePacer::cleanup()
+{
+	setLowLatency(false);
+	destroyQueryPools();
+	frameSlots.clear();
+	pendingPresents.clear();
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <deque>
+#include <vector>
+
+// Frame pacing since the last reset
+struct FrameStatistics
+{
+	uint64_t frameCount = 0;
+	double averageFrameMilliseconds = 0.0;
+	// From the start of the frame to its submit
+	double averageCpuMilliseconds = 0.0;
+	// Between the frame's first and last GPU command, zero without timestamp support
+	double averageGpuMilliseconds = 0.0;
+	// From the start of the frame until its timeline value is seen complete, an upper bound at the granularity of the checks
+	double averageLatencyMilliseconds = 0.0;
+	double maxLatencyMilliseconds = 0.0;
+	// From the start of the frame until VK_KHR_present_wait reports it presented
+	bool presentLatencyMeasured = false;
+	double averagePresentLatencyMilliseconds = 0.0;
+	double maxPresentLatencyMilliseconds = 0.0;
+	// Time the CPU spent blocked on earlier frames still using the frame slot or swapchain image
+	double averageGpuWaitMilliseconds = 0.0;
+	// Time spent holding back the start of the frame in low latency mode
+	double averagePacingWaitMilliseconds = 0.0;
+	// Vertex and fragment shader invocations per frame, need the pipelineStatisticsQuery feature
+	bool fragmentInvocationsMeasured = false;
+	double averageVertexInvocations = 0.0;
+	double averageFragmentInvocations = 0.0;
+	// Filled in by the renderer, transient descriptor sets allocated while recording the previous frame and the
+	// pools every set comes from
+	uint32_t descriptorSetsLastFrame = 0;
+	uint32_t descriptorPoolCount = 0;
+};
+
+// Measures CPU, GPU and input to present times for the renderer. In low latency mode the start of each
+// frame, and with it the input sampled for it, is held back until just before the GPU will need the frame.
+class FramePacer
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	FramePacer();
+	void init(VkPhysicalDevice physicalDevice, VkDevice newDevice, uint32_t queueFamilyIndex, bool presentWaitSupported,
+		bool pipelineStatisticsSupported, uint32_t newFrameCount);
+	// Only valid while the device is idle
+	void setFrameCount(uint32_t newFrameCount);
+
+	void setLowLatency(bool enabled);
+	bool isLowLatency();
+	bool isPresentWaitSupported();
+
+	// Blocks until the next frame should start, input sampled after this returns is as fresh as pacing allows
+	void waitForFrameStart(VkSwapchainKHR swapchain);
+	// Called at the start of draw(), frames that did not go through waitForFrameStart start here
+	void beginFrame();
+	// Picks up frames that completed since the last check without blocking
+	void collectCompletedFrames(uint64_t completedTimelineValue);
+	// The frame slot's previous frame has just been waited on
+	void frameSlotCompleted(uint32_t frameSlot, double gpuWaitMilliseconds);
+	void addGpuWait(double milliseconds);
+
+	// Recorded outside of any render pass at the start and end of the frame's command buffer, the pipeline
+	// statistics query covers everything in between
+	void writeBeginQueries(VkCommandBuffer commandBuffer, uint32_t frameSlot);
+	void writeEndQueries(VkCommandBuffer commandBuffer, uint32_t frameSlot);
+
+	// Returns the id to present the frame with, zero when present wait is not supported
+	uint64_t frameSubmitted(uint32_t frameSlot, uint64_t timelineValue, VkSwapchainKHR swapchain);
+	// Ids presented to a replaced swapchain can no longer be waited on
+	void swapchainChanged();
+
+	FrameStatistics getStatistics();
+	void resetStatistics();
+
+	void cleanup();
+private:
+	struct FrameSlot
+	{
+		Clock::time_point startTime;
+		Clock::time_point submitTime;
+		uint64_t timelineValue = 0;
+		bool pending = false;
+		bool timestampsWritten = false;
+		bool statisticsWritten = false;
+	};
+
+	struct PendingPresent
+	{
+		uint64_t presentId;
+		Clock::time_point startTime;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+	VkQueryPool timestampPool = VK_NULL_HANDLE;
+	// Nanoseconds per tick, zero when the queue cannot write timestamps
+	double timestampPeriod = 0.0;
+	uint64_t timestampMask = 0;
+	bool pipelineStatistics = false;
+	VkQueryPool statisticsPool = VK_NULL_HANDLE;
+
+	uint32_t frameCount = 0;
+	std::vector<FrameSlot> frameSlots;
+	bool lowLatency = false;
+	bool frameStarted = false;
+	Clock::time_point frameStartTime;
+	Clock::time_point lastFrameStartTime;
+
+	uint64_t nextPresentId = 1;
+	std::deque<PendingPresent> pendingPresents;
+
+	// Smoothed predictions driving the low latency delay
+	double predictedCpuMilliseconds = 0.0;
+	double predictedGpuMilliseconds = 0.0;
+	Clock::time_point predictedGpuIdleTime;
+	Clock::time_point lastSubmitTime;
+
+	uint64_t timedFrameCount = 0;
+	uint64_t latencySampleCount = 0;
+	uint64_t presentSampleCount = 0;
+	uint64_t gpuSampleCount = 0;
+	uint64_t submittedFrameCount = 0;
+	uint64_t statisticsSampleCount = 0;
+	double totalFrameMilliseconds = 0.0;
+	double totalCpuMilliseconds = 0.0;
+	double totalGpuMilliseconds = 0.0;
+	double totalLatencyMilliseconds = 0.0;
+	double maxLatencyMilliseconds = 0.0;
+	double totalPresentLatencyMilliseconds = 0.0;
+	double maxPresentLatencyMilliseconds = 0.0;
+	double totalGpuWaitMilliseconds = 0.0;
+	double totalPacingWaitMilliseconds = 0.0;
+	double totalVertexInvocations = 0.0;
+	double totalFragmentInvocations = 0.0;
+
+	void createQueryPools();
+	void destroyQueryPools();
+	void completeFrame(uint32_t frameSlot, Clock::time_point completionTime);
+	void completePresents(uint64_t presentId, Clock::time_point presentTime);
+	void pollPresents(VkSwapchainKHR swapchain);
+};
@@ -0,0 +1,510 @@
+#include "GltfLoader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <span>
+#include <stdexcept>
+#include <thread>
+
+#include "Json.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "MeshSimplifier.h"
+
+namespace
+{
+	constexpr uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+	constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+	constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+	constexpr uint32_t COMPONENT_UNSIGNED_BYTE = 5121;
+	constexpr uint32_t COMPONENT_UNSIGNED_SHORT = 5123;
+	constexpr uint32_t COMPONENT_UNSIGNED_INT = 5125;
+	constexpr uint32_t COMPONENT_FLOAT = 5126;
+
+	constexpr uint32_t PRIMITIVE_TRIANGLES = 4;
+
+	using Clock = std::chrono::steady_clock;
+
+	double getMilliseconds(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	uint32_t readUint32(const uint8_t* data)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(uint32_t));
+		return value;
+	}
+
+	uint32_t getComponentSize(uint32_t componentType)
+	{
+		switch (componentType)
+		{
+		case 5120:
+		case COMPONENT_UNSIGNED_BYTE:
+			return 1;
+		case 5122:
+		case COMPONENT_UNSIGNED_SHORT:
+			return 2;
+		case COMPONENT_UNSIGNED_INT:
+		case COMPONENT_FLOAT:
+			return 4;
+		default:
+			throw std::runtime_error("Unknown glTF component type");
+		}
+	}
+
+	uint32_t getComponentCount(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		if (type == "MAT2") return 4;
+		if (type == "MAT3") return 9;
+		if (type == "MAT4") return 16;
+		throw std::runtime_error("Unknown glTF accessor type: " + type);
+	}
+
+	std::vector<uint8_t> decodeBase64(std::string_view text)
+	{
+		auto decodeCharacter = [](char character) -> int
+		{
+			if (character >= 'A' && character <= 'Z') return character - 'A';
+			if (character >= 'a' && character <= 'z') return character - 'a' + 26;
+			if (character >= '0' && character <= '9') return character - '0' + 52;
+			if (character == '+') return 62;
+			if (character == '/') return 63;
+			return -1;
+		};
+
+		std::vector<uint8_t> output;
+		output.reserve(text.size() * 3 / 4);
+		uint32_t accumulator = 0;
+		int bits = 0;
+		for (char character : text)
+		{
+			if (character == '=')
+			{
+				break;
+			}
+			const int value = decodeCharacter(character);
+			if (value < 0)
+			{
+				throw std::runtime_error("Invalid base64 data in glTF buffer");
+			}
+			accumulator = (accumulator << 6) | static_cast<uint32_t>(value);
+			bits += 6;
+			if (bits >= 8)
+			{
+				bits -= 8;
+				output.push_back(static_cast<uint8_t>((accumulator >> bits) & 0xFF));
+			}
+		}
+		return output;
+	}
+
+	std::string decodeUri(const std::string& uri)
+	{
+		std::string decoded;
+		for (size_t i = 0; i < uri.size(); i++)
+		{
+			if (uri[i] == '%' && i + 2 < uri.size())
+			{
+				const char* first = uri.data() + i + 1;
+				const char* last = first + 2;
+				uint8_t value = 0;
+				const std::from_chars_result result = std::from_chars(first, last, value, 16);
+				if (result.ec != std::errc() || result.ptr != last)
+				{
+					throw std::runtime_error("Malformed percent escape in glTF uri: " + uri);
+				}
+				decoded += static_cast<char>(value);
+				i += 2;
+			}
+			else
+			{
+				decoded += uri[i];
+			}
+		}
+		return decoded;
+	}
+
+	// Strided view of an accessor inside a buffer, bounds are checked once up front
+	struct AccessorView
+	{
+		const uint8_t* data = nullptr;
+		size_t count = 0;
+		size_t stride = 0;
+		uint32_t componentType = 0;
+		uint32_t componentCount = 0;
+		bool normalized = false;
+	};
+
+	class GltfDocument
+	{
+	public:
+		void load(const std::string& fileName, GltfLoadStats& stats)
+		{
+			Clock::time_point start = Clock::now();
+			file.open(fileName);
+			stats.fileBytes = file.getSize();
+
+			std::string_view jsonText;
+			std::span<const uint8_t> binaryChunk;
+			if (file.getSize() >= 12 && readUint32(file.getBytes()) == GLB_MAGIC)
+			{
+				readGlbChunks(&jsonText, &binaryChunk);
+			}
+			else
+			{
+				jsonText = std::string_view(file.getData().data(), file.getSize());
+			}
+			stats.readMilliseconds += getMilliseconds(start);
+
+			start = Clock::now();
+			document = parseJson(jsonText);
+			stats.parseMilliseconds = getMilliseconds(start);
+
+			start = Clock::now();
+			const std::string directory = fileName.substr(0, fileName.find_last_of("/\\") + 1);
+			loadBuffers(directory, binaryChunk);
+			stats.readMilliseconds += getMilliseconds(start);
+		}
+
+		const JsonValue& getDocument() const
+		{
+			return document;
+		}
+
+		AccessorView getAccessor(uint32_t accessorIndex) const
+		{
+			const JsonValue& accessor = document["accessors"][accessorIndex];
+			if (accessor.find("sparse") != nullptr)
+			{
+				throw std::runtime_error("Sparse glTF accessors are not supported");
+			}
+
+			AccessorView view;
+			view.count = accessor["count"].asUint();
+			view.componentType = accessor["componentType"].asUint();
+			view.componentCount = getComponentCount(accessor["type"].asString());
+			view.normalized = accessor.getBool("normalized", false);
+			const size_t elementSize = static_cast<size_t>(getComponentSize(view.componentType)) * view.componentCount;
+
+			const JsonValue* bufferViewIndex = accessor.find("bufferView");
+			if (bufferViewIndex == nullptr)
+			{
+				throw std::runtime_error("glTF accessors without a buffer view are not supported");
+			}
+			const JsonValue& bufferView = document["bufferViews"][bufferViewIndex->asUint()];
+			std::span<const uint8_t> buffer = buffers.at(bufferView["buffer"].asUint());
+
+			const size_t viewOffset = bufferView.getUint("byteOffset", 0);
+			const size_t viewLength = bufferView["byteLength"].asUint();
+			const size_t accessorOffset = accessor.getUint("byteOffset", 0);
+			view.stride = bufferView.getUint("byteStride", 0);
+			if (view.stride == 0)
+			{
+				view.stride = elementSize;
+			}
+
+			const size_t accessorLength = view.count == 0 ? 0 : (view.count - 1) * view.stride + elementSize;
+			if (viewOffset + viewLength > buffer.size() || accessorOffset + accessorLength > viewLength)
+			{
+				throw std::runtime_error("glTF accessor is out of bounds");
+			}
+			view.data = buffer.data() + viewOffset + accessorOffset;
+			return view;
+		}
+	private:
+		MappedFile file;
+		JsonValue document;
+		std::vector<MappedFile> externalFiles;
+		std::vector<std::vector<uint8_t>> embeddedBuffers;
+		std::vector<std::span<const uint8_t>> buffers;
+
+		void readGlbChunks(std::string_view* jsonText, std::span<const uint8_t>* binaryChunk)
+		{
+			const uint8_t* data = file.getBytes();
+			if (readUint32(data + 4) != 2)
+			{
+				throw std::runtime_error("Only glTF 2.0 binary files are supported");
+			}
+			const size_t length = std::min<size_t>(readUint32(data + 8), file.getSize());
+
+			size_t offset = 12;
+			while (offset + 8 <= length)
+			{
+				const uint32_t chunkLength = readUint32(data + offset);
+				const uint32_t chunkType = readUint32(data + offset + 4);
+				offset += 8;
+				if (offset + chunkLength > length)
+				{
+					throw std::runtime_error("glTF binary chunk is out of bounds");
+				}
+
+				if (chunkType == GLB_CHUNK_JSON && jsonText->empty())
+				{
+					*jsonText = std::string_view(reinterpret_cast<const char*>(data + offset), chunkLength);
+				}
+				else if (chunkType == GLB_CHUNK_BIN && binaryChunk->empty())
+				{
+					*binaryChunk = std::span<const uint8_t>(data + offset, chunkLength);
+				}
+				offset += (chunkLength + 3) & ~3u;
+			}
+
+			if (jsonText->empty())
+			{
+				throw std::runtime_error("glTF binary file has no JSON chunk");
+			}
+		}
+
+		void loadBuffers(const std::string& directory, std::span<const uint8_t> binaryChunk)
+		{
+			const JsonValue* bufferList = document.find("buffers");
+			if (bufferList == nullptr)
+			{
+				return;
+			}
+
+			for (const auto& buffer : bufferList->getValues())
+			{
+				const JsonValue* uri = buffer.find("uri");
+				if (uri == nullptr)
+				{
+					// The first buffer of a .glb refers to its binary chunk
+					buffers.push_back(binaryChunk);
+					continue;
+				}
+
+				const std::string& uriText = uri->asString();
+				if (uriText.starts_with("data:"))
+				{
+					const size_t dataStart = uriText.find(";base64,");
+					if (dataStart == std::string::npos)
+					{
+						throw std::runtime_error("Only base64 data URIs are supported in glTF buffers");
+					}
+					embeddedBuffers.push_back(decodeBase64(std::string_view(uriText).substr(dataStart + 8)));
+					buffers.push_back(embeddedBuffers.back());
+				}
+				else
+				{
+					// External buffers are mapped and read in place like the main file
+					externalFiles.emplace_back(directory + decodeUri(uriText));
+					buffers.push_back(std::span<const uint8_t>(externalFiles.back().getBytes(), externalFiles.back().getSize()));
+				}
+			}
+		}
+	};
+
+	struct PrimitiveRef
+	{
+		uint32_t meshIndex;
+		uint32_t primitiveIndex;
+	};
+
+	// Reads component i of element as a float, applying the normalisation rules of the spec
+	float readComponent(const AccessorView& view, size_t element, uint32_t component)
+	{
+		const uint8_t* data = view.data + element * view.stride;
+		switch (view.componentType)
+		{
+		case COMPONENT_FLOAT:
+		{
+			float value;
+			memcpy(&value, data + component * sizeof(float), sizeof(float));
+			return value;
+		}
+		case COMPONENT_UNSIGNED_BYTE:
+			return view.normalized ? data[component] / 255.0f : data[component];
+		case COMPONENT_UNSIGNED_SHORT:
+		{
+			uint16_t value;
+			memcpy(&value, data + component * sizeof(uint16_t), sizeof(uint16_t));
+			return view.normalized ? value / 65535.0f : value;
+		}
+		default:
+			throw std::runtime_error("Unsupported glTF vertex attribute component type");
+		}
+	}
+
+	uint32_t readIndex(const AccessorView& view, size_t element)
+	{
+		const uint8_t* data = view.data + element * view.stride;
+		switch (view.componentType)
+		{
+		case COMPONENT_UNSIGNED_BYTE:
+			return data[0];
+		case COMPONENT_UNSIGNED_SHORT:
+		{
+			uint16_t value;
+			memcpy(&value, data, sizeof(uint16_t));
+			return value;
+		}
+		case COMPONENT_UNSIGNED_INT:
+			return readUint32(data);
+		default:
+			throw std::runtime_error("Unsupported glTF index component type");
+		}
+	}
+
+	MeshData convertPrimitive(const GltfDocument& gltf, const JsonValue& primitive)
+	{
+		const JsonValue& attributes = primitive["attributes"];
+		const AccessorView positions = gltf.getAccessor(attributes["POSITION"].asUint());
+		if (positions.componentType != COMPONENT_FLOAT || positions.componentCount != 3)
+		{
+			throw std::runtime_error("glTF positions must be float VEC3");
+		}
+
+		MeshData meshData;
+		meshData.vertices.resize(positions.count);
+		for (size_t i = 0; i < positions.count; i++)
+		{
+			memcpy(meshData.vertices[i].position, positions.data + i * positions.stride, sizeof(float) * 3);
+		}
+
+		// The renderer's only other attribute is a vertex colour, untextured content is white
+		const JsonValue* colourAccessor = attributes.find("COLOR_0");
+		if (colourAccessor != nullptr)
+		{
+			const AccessorView colours = gltf.getAccessor(colourAccessor->asUint());
+			if (colours.count != positions.count || colours.componentCount < 3)
+			{
+				throw std::runtime_error("glTF COLOR_0 does not match the vertex positions");
+			}
+			for (size_t i = 0; i < colours.count; i++)
+			{
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					meshData.vertices[i].colour[c] = readComponent(colours, i, c);
+				}
+			}
+		}
+		else
+		{
+			for (auto& vertex : meshData.vertices)
+			{
+				vertex.colour[0] = vertex.colour[1] = vertex.colour[2] = 1.0f;
+			}
+		}
+
+		const JsonValue* indexAccessor = primitive.find("indices");
+		if (indexAccessor != nullptr)
+		{
+			const AccessorView indices = gltf.getAccessor(indexAccessor->asUint());
+			meshData.indices.resize(indices.count);
+			if (indices.componentType == COMPONENT_UNSIGNED_INT && indices.stride == sizeof(uint32_t))
+			{
+				memcpy(meshData.indices.data(), indices.data, indices.count * sizeof(uint32_t));
+			}
+			else
+			{
+				for (size_t i = 0; i < indices.count; i++)
+				{
+					meshData.indices[i] = readIndex(indices, i);
+				}
+			}
+
+			for (uint32_t index : meshData.indices)
+			{
+				if (index >= positions.count)
+				{
+					throw std::runtime_error("glTF index references a missing vertex");
+				}
+			}
+		}
+		else
+		{
+			meshData.indices.resize(positions.count);
+			for (uint32_t i = 0; i < positions.count; i++)
+			{
+				meshData.indices[i] = i;
+			}
+		}
+		meshData.indices.resize(meshData.indices.size() - meshData.indices.size() % 3);
+		return meshData;
+	}
+}
+
+std::vector<MeshData> loadGltf(const std::string& fileName, const GltfLoadOptions& options, GltfLoadStats* stats)
+{
+	GltfLoadStats loadStats;
+	GltfDocument gltf;
+	gltf.load(fileName, loadStats);
+
+	const Clock::time_point convertStart = Clock::now();
+	std::vector<PrimitiveRef> primitives;
+	const JsonValue& document = gltf.getDocument();
+	if (const JsonValue* meshes = document.find("meshes"))
+	{
+		for (uint32_t meshIndex = 0; meshIndex < meshes->size(); meshIndex++)
+		{
+			const JsonValue& primitiveList = (*meshes)[meshIndex]["primitives"];
+			for (uint32_t primitiveIndex = 0; primitiveIndex < primitiveList.size(); primitiveIndex++)
+			{
+				if (primitiveList[primitiveIndex].getUint("mode", PRIMITIVE_TRIANGLES) != PRIMITIVE_TRIANGLES)
+				{
+					VULKAN_CORE_WARN("Skipping non triangle primitive {} of mesh {} in {}", primitiveIndex, meshIndex, fileName);
+					continue;
+				}
+				primitives.push_back({ meshIndex, primitiveIndex });
+			}
+		}
+	}
+
+	// Primitives are independent once the document is parsed, each worker converts a contiguous range
+	std::vector<MeshData> meshData(primitives.size());
+	uint32_t threadCount = options.threadCount != 0 ? options.threadCount : std::max(1u, std::thread::hardware_concurrency());
+	threadCount = static_cast<uint32_t>(std::min<size_t>(threadCount, std::max<size_t>(primitives.size(), 1)));
+
+	auto convertRange = [&](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			const JsonValue& primitive = document["meshes"][primitives[i].meshIndex]["primitives"][primitives[i].primitiveIndex];
+			meshData[i] = convertPrimitive(gltf, primitive);
+			if (options.generateLods)
+			{
+				generateLods(meshData[i]);
+			}
+		}
+	};
+
+	std::vector<std::future<void>> workers;
+	const size_t rangeSize = (primitives.size() + threadCount - 1) / threadCount;
+	for (uint32_t thread = 1; thread < threadCount; thread++)
+	{
+		const size_t first = std::min(primitives.size(), thread * rangeSize);
+		const size_t last = std::min(primitives.size(), first + rangeSize);
+		workers.push_back(std::async(std::launch::async, convertRange, first, last));
+	}
+	convertRange(0, std::min(primitives.size(), rangeSize));
+	// get() rethrows the first failure from a worker
+	for (auto& worker : workers)
+	{
+		worker.get();
+	}
+	loadStats.convertMilliseconds = getMilliseconds(convertStart);
+
+	loadStats.primitiveCount = meshData.size();
+	for (const auto& mesh : meshData)
+	{
+		loadStats.vertexCount += mesh.vertices.size();
+		// Source triangles only, generated LODs are appended to the same index list
+		loadStats.indexCount += mesh.lods.empty() ? mesh.indices.size() : mesh.lods[0].indexCount;
+	}
+	if (stats != nullptr)
+	{
+		*stats = loadStats;
+	}
+	return meshData;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MeshFile.h"
+
+struct GltfLoadOptions
+{
+	// Worker threads converting primitives, zero uses every hardware thread
+	uint32_t threadCount = 0;
+	// Builds each primitive's LOD chain on the worker threads as part of the import
+	bool generateLods = true;
+};
+
+struct GltfLoadStats
+{
+	double readMilliseconds = 0.0;
+	double parseMilliseconds = 0.0;
+	double convertMilliseconds = 0.0;
+	size_t fileBytes = 0;
+	size_t primitiveCount = 0;
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+};
+
+// Loads every triangle primitive of a glTF 2.0 file (.gltf with external or embedded buffers, or .glb)
+// as one MeshData each, already in the renderer's vertex layout. The JSON is parsed once, accessors are
+// read in place from the mapped buffers and primitives are converted in parallel.
+// Node transforms, materials and skinning are not imported.
+std::vector<MeshData> loadGltf(const std::string& fileName, const GltfLoadOptions& options = GltfLoadOptions(),
+	GltfLoadStats* stats = nullptr);
@@ -0,0 +1,234 @@
+#include "ImageLoader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+#include "MappedFile.h"
+
+namespace
+{
+	// Larger than any device can create, keeps pixel counts well inside size_t
+	constexpr uint32_t MAX_IMAGE_DIMENSION = 65536;
+
+	struct TgaHeader
+	{
+		uint8_t idLength;
+		uint8_t colourMapType;
+		uint8_t imageType;
+		uint16_t colourMapLength;
+		uint8_t colourMapEntrySize;
+		uint16_t width;
+		uint16_t height;
+		uint8_t bitsPerPixel;
+		uint8_t descriptor;
+	};
+
+	uint16_t readU16(const uint8_t* data)
+	{
+		return static_cast<uint16_t>(data[0] | (data[1] << 8));
+	}
+
+	void writeTgaPixel(const uint8_t* source, uint8_t bytesPerPixel, uint8_t* destination)
+	{
+		if (bytesPerPixel == 1)
+		{
+			destination[0] = destination[1] = destination[2] = source[0];
+			destination[3] = 255;
+			return;
+		}
+
+		// TGA stores BGR(A)
+		destination[0] = source[2];
+		destination[1] = source[1];
+		destination[2] = source[0];
+		destination[3] = bytesPerPixel == 4 ? source[3] : 255;
+	}
+
+	ImageData decodeTga(const uint8_t* data, size_t size)
+	{
+		if (size < 18)
+		{
+			throw std::runtime_error("TGA file is truncated");
+		}
+
+		TgaHeader header = {};
+		header.idLength = data[0];
+		header.colourMapType = data[1];
+		header.imageType = data[2];
+		header.colourMapLength = readU16(data + 5);
+		header.colourMapEntrySize = data[7];
+		header.width = readU16(data + 12);
+		header.height = readU16(data + 14);
+		header.bitsPerPixel = data[16];
+		header.descriptor = data[17];
+
+		const bool rle = header.imageType == 10 || header.imageType == 11;
+		const bool supportedType = header.imageType == 2 || header.imageType == 3 || rle;
+		const uint8_t bytesPerPixel = header.bitsPerPixel / 8;
+		if (!supportedType || header.colourMapType != 0 || (bytesPerPixel != 1 && bytesPerPixel != 3 && bytesPerPixel != 4))
+		{
+			throw std::runtime_error("Unsupported TGA format, only true colour and greyscale images are supported");
+		}
+		if (header.width == 0 || header.height == 0)
+		{
+			throw std::runtime_error("TGA image has no pixels");
+		}
+
+		size_t offset = 18 + header.idLength + header.colourMapLength * ((header.colourMapEntrySize + 7) / 8);
+		const size_t pixelCount = static_cast<size_t>(header.width) * header.height;
+
+		ImageData image;
+		image.width = header.width;
+		image.height = header.height;
+		image.pixels.resize(pixelCount * 4);
+
+		size_t pixel = 0;
+		while (pixel < pixelCount)
+		{
+			size_t runLength = 1;
+			bool repeat = false;
+			if (rle)
+			{
+				if (offset >= size)
+				{
+					throw std::runtime_error("TGA file is truncated");
+				}
+				const uint8_t packet = data[offset++];
+				runLength = (packet & 0x7F) + 1;
+				repeat = (packet & 0x80) != 0;
+			}
+
+			runLength = std::min(runLength, pixelCount - pixel);
+			for (size_t i = 0; i < runLength; i++)
+			{
+				if (offset + bytesPerPixel > size)
+				{
+					throw std::runtime_error("TGA file is truncated");
+				}
+				writeTgaPixel(data + offset, bytesPerPixel, &image.pixels[(pixel + i) * 4]);
+				if (!repeat || i == runLength - 1)
+				{
+					offset += bytesPerPixel;
+				}
+			}
+			pixel += runLength;
+		}
+
+		// Bit 5 of the descriptor set means rows are already stored top to bottom
+		if ((header.descriptor & 0x20) == 0)
+		{
+			const size_t rowSize = static_cast<size_t>(image.width) * 4;
+			for (uint32_t row = 0; row < image.height / 2; row++)
+			{
+				std::swap_ranges(image.pixels.begin() + row * rowSize, image.pixels.begin() + (row + 1) * rowSize,
+					image.pixels.begin() + (image.height - 1 - row) * rowSize);
+			}
+		}
+
+		return image;
+	}
+
+	// Skips whitespace and comments between PPM header fields
+	uint32_t readPpmField(const uint8_t* data, size_t size, size_t& offset)
+	{
+		while (offset < size && (isspace(data[offset]) || data[offset] == '#'))
+		{
+			if (data[offset] == '#')
+			{
+				while (offset < size && data[offset] != '\n')
+				{
+					offset++;
+				}
+			}
+			else
+			{
+				offset++;
+			}
+		}
+
+		uint32_t value = 0;
+		bool hasDigits = false;
+		while (offset < size && isdigit(data[offset]))
+		{
+			value = value * 10 + (data[offset] - '0');
+			offset++;
+			hasDigits = true;
+			if (value > MAX_IMAGE_DIMENSION)
+			{
+				throw std::runtime_error("PPM header value is out of range");
+			}
+		}
+
+		if (!hasDigits)
+		{
+			throw std::runtime_error("Malformed PPM header");
+		}
+		return value;
+	}
+
+	ImageData decodePpm(const uint8_t* data, size_t size)
+	{
+		size_t offset = 2;
+		ImageData image;
+		image.width = readPpmField(data, size, offset);
+		image.height = readPpmField(data, size, offset);
+		const uint32_t maxValue = readPpmField(data, size, offset);
+		offset++;
+
+		if (image.width == 0 || image.height == 0)
+		{
+			throw std::runtime_error("PPM image has no pixels");
+		}
+
+		const size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+		if (maxValue != 255 || offset > size || pixelCount > (size - offset) / 3)
+		{
+			throw std::runtime_error("Unsupported or truncated PPM file");
+		}
+
+		image.pixels.resize(pixelCount * 4);
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			image.pixels[i * 4 + 0] = data[offset + i * 3 + 0];
+			image.pixels[i * 4 + 1] = data[offset + i * 3 + 1];
+			image.pixels[i * 4 + 2] = data[offset + i * 3 + 2];
+			image.pixels[i * 4 + 3] = 255;
+		}
+		return image;
+	}
+
+	bool hasExtension(const std::string& fileName, const char* extension)
+	{
+		const size_t extensionLength = strlen(extension);
+		if (fileName.size() < extensionLength)
+		{
+			return false;
+		}
+
+		std::string fileExtension = fileName.substr(fileName.size() - extensionLength);
+		std::transform(fileExtension.begin(), fileExtension.end(), fileExtension.begin(),
+			[](unsigned char c) { return static_cast<char>(tolower(c)); });
+		return fileExtension == extension;
+	}
+}
+
+ImageData loadImage(const std::string& fileName)
+{
+	MappedFile file(fileName);
+	return decodeImage(fileName, file.getBytes(), file.getSize());
+}
+
+ImageData decodeImage(const std::string& fileName, const uint8_t* data, size_t size)
+{
+	if (size >= 2 && data[0] == 'P' && data[1] == '6')
+	{
+		return decodePpm(data, size);
+	}
+	if (hasExtension(fileName, ".tga"))
+	{
+		return decodeTga(data, size);
+	}
+	throw std::runtime_error("Unsupported image format: " + fileName);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Decoded image, always expanded to 8 bit RGBA with the first row at the top
+struct ImageData
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+};
+
+// Supports TGA (uncompressed and RLE, 8/24/32 bit) and binary PPM (P6)
+ImageData loadImage(const std::string& fileName);
+ImageData decodeImage(const std::string& fileName, const uint8_t* data, size_t size);
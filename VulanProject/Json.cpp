@@ -0,0 +1,415 @@
+#include "Json.h"
+
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+
+class JsonParser
+{
+public:
+	explicit JsonParser(std::string_view newText) : text(newText)
+	{
+	}
+
+	JsonValue parseDocument()
+	{
+		JsonValue value = parseValue(0);
+		skipWhitespace();
+		if (position != text.size())
+		{
+			fail("Unexpected trailing characters");
+		}
+		return value;
+	}
+private:
+	// Guards against stack exhaustion on hostile input
+	static constexpr int MAX_DEPTH = 256;
+
+	std::string_view text;
+	size_t position = 0;
+
+	[[noreturn]] void fail(const char* message)
+	{
+		throw std::runtime_error(std::string("JSON parse error at offset ") + std::to_string(position) + ": " + message);
+	}
+
+	void skipWhitespace()
+	{
+		while (position < text.size() &&
+			(text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r'))
+		{
+			position++;
+		}
+	}
+
+	char peek()
+	{
+		skipWhitespace();
+		if (position >= text.size())
+		{
+			fail("Unexpected end of input");
+		}
+		return text[position];
+	}
+
+	void expect(char character)
+	{
+		if (peek() != character)
+		{
+			fail("Unexpected character");
+		}
+		position++;
+	}
+
+	void expectLiteral(std::string_view literal)
+	{
+		if (text.substr(position, literal.size()) != literal)
+		{
+			fail("Invalid literal");
+		}
+		position += literal.size();
+	}
+
+	JsonValue parseValue(int depth)
+	{
+		if (depth > MAX_DEPTH)
+		{
+			fail("Nesting is too deep");
+		}
+
+		JsonValue value;
+		const char character = peek();
+		switch (character)
+		{
+		case '{':
+			parseObject(value, depth);
+			break;
+		case '[':
+			parseArray(value, depth);
+			break;
+		case '"':
+			value.type = JsonValue::Type::String;
+			value.stringValue = parseString();
+			break;
+		case 't':
+			expectLiteral("true");
+			value.type = JsonValue::Type::Bool;
+			value.boolValue = true;
+			break;
+		case 'f':
+			expectLiteral("false");
+			value.type = JsonValue::Type::Bool;
+			break;
+		case 'n':
+			expectLiteral("null");
+			break;
+		default:
+			value.type = JsonValue::Type::Number;
+			value.numberValue = parseNumber();
+			break;
+		}
+		return value;
+	}
+
+	void parseObject(JsonValue& value, int depth)
+	{
+		value.type = JsonValue::Type::Object;
+		expect('{');
+		if (peek() == '}')
+		{
+			position++;
+			return;
+		}
+		while (true)
+		{
+			if (peek() != '"')
+			{
+				fail("Expected an object key");
+			}
+			value.keys.push_back(parseString());
+			expect(':');
+			value.values.push_back(parseValue(depth + 1));
+
+			if (peek() == ',')
+			{
+				position++;
+				continue;
+			}
+			expect('}');
+			return;
+		}
+	}
+
+	void parseArray(JsonValue& value, int depth)
+	{
+		value.type = JsonValue::Type::Array;
+		expect('[');
+		if (peek() == ']')
+		{
+			position++;
+			return;
+		}
+		while (true)
+		{
+			value.values.push_back(parseValue(depth + 1));
+
+			if (peek() == ',')
+			{
+				position++;
+				continue;
+			}
+			expect(']');
+			return;
+		}
+	}
+
+	double parseNumber()
+	{
+		// from_chars does not accept a leading '+', neither does JSON
+		double number = 0.0;
+		auto [end, error] = std::from_chars(text.data() + position, text.data() + text.size(), number);
+		if (error != std::errc() || !std::isfinite(number))
+		{
+			fail("Invalid number");
+		}
+		position = end - text.data();
+		return number;
+	}
+
+	uint32_t parseHexQuad()
+	{
+		if (position + 4 > text.size())
+		{
+			fail("Truncated unicode escape");
+		}
+		uint32_t codePoint = 0;
+		auto [end, error] = std::from_chars(text.data() + position, text.data() + position + 4, codePoint, 16);
+		if (error != std::errc() || end != text.data() + position + 4)
+		{
+			fail("Invalid unicode escape");
+		}
+		position += 4;
+		return codePoint;
+	}
+
+	static void appendUtf8(std::string& output, uint32_t codePoint)
+	{
+		if (codePoint < 0x80)
+		{
+			output += static_cast<char>(codePoint);
+		}
+		else if (codePoint < 0x800)
+		{
+			output += static_cast<char>(0xC0 | (codePoint >> 6));
+			output += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+		else if (codePoint < 0x10000)
+		{
+			output += static_cast<char>(0xE0 | (codePoint >> 12));
+			output += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+			output += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+		else
+		{
+			output += static_cast<char>(0xF0 | (codePoint >> 18));
+			output += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+			output += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+			output += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+	}
+
+	std::string parseString()
+	{
+		expect('"');
+		std::string output;
+		while (true)
+		{
+			if (position >= text.size())
+			{
+				fail("Unterminated string");
+			}
+			const char character = text[position++];
+			if (character == '"')
+			{
+				return output;
+			}
+			if (character != '\\')
+			{
+				output += character;
+				continue;
+			}
+
+			if (position >= text.size())
+			{
+				fail("Unterminated escape");
+			}
+			const char escape = text[position++];
+			switch (escape)
+			{
+			case '"': output += '"'; break;
+			case '\\': output += '\\'; break;
+			case '/': output += '/'; break;
+			case 'b': output += '\b'; break;
+			case 'f': output += '\f'; break;
+			case 'n': output += '\n'; break;
+			case 'r': output += '\r'; break;
+			case 't': output += '\t'; break;
+			case 'u':
+			{
+				uint32_t codePoint = parseHexQuad();
+				// Surrogate pairs encode code points above the basic multilingual plane
+				if (codePoint >= 0xD800 && codePoint < 0xDC00 && text.substr(position, 2) == "\\u")
+				{
+					position += 2;
+					const uint32_t lowSurrogate = parseHexQuad();
+					if (lowSurrogate < 0xDC00 || lowSurrogate >= 0xE000)
+					{
+						fail("Invalid surrogate pair");
+					}
+					codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowSurrogate - 0xDC00);
+				}
+				appendUtf8(output, codePoint);
+				break;
+			}
+			default:
+				fail("Invalid escape");
+			}
+		}
+	}
+};
+
+JsonValue::JsonValue()
+{
+}
+
+JsonValue::Type JsonValue::getType() const
+{
+	return type;
+}
+
+bool JsonValue::isNull() const
+{
+	return type == Type::Null;
+}
+
+bool JsonValue::isObject() const
+{
+	return type == Type::Object;
+}
+
+bool JsonValue::isArray() const
+{
+	return type == Type::Array;
+}
+
+bool JsonValue::asBool() const
+{
+	if (type != Type::Bool)
+	{
+		throw std::runtime_error("JSON value is not a bool");
+	}
+	return boolValue;
+}
+
+double JsonValue::asNumber() const
+{
+	if (type != Type::Number)
+	{
+		throw std::runtime_error("JSON value is not a number");
+	}
+	return numberValue;
+}
+
+uint32_t JsonValue::asUint() const
+{
+	const double number = asNumber();
+	if (number < 0.0 || number > 4294967295.0 || number != std::floor(number))
+	{
+		throw std::runtime_error("JSON value is not an unsigned integer");
+	}
+	return static_cast<uint32_t>(number);
+}
+
+const std::string& JsonValue::asString() const
+{
+	if (type != Type::String)
+	{
+		throw std::runtime_error("JSON value is not a string");
+	}
+	return stringValue;
+}
+
+size_t JsonValue::size() const
+{
+	return values.size();
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+	if (type != Type::Array || index >= values.size())
+	{
+		throw std::runtime_error("JSON array index out of range");
+	}
+	return values[index];
+}
+
+const JsonValue* JsonValue::find(std::string_view key) const
+{
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		if (keys[i] == key)
+		{
+			return &values[i];
+		}
+	}
+	return nullptr;
+}
+
+const JsonValue& JsonValue::operator[](std::string_view key) const
+{
+	const JsonValue* value = find(key);
+	if (value == nullptr)
+	{
+		throw std::runtime_error("Missing JSON member: " + std::string(key));
+	}
+	return *value;
+}
+
+uint32_t JsonValue::getUint(std::string_view key, uint32_t defaultValue) const
+{
+	const JsonValue* value = find(key);
+	return value != nullptr ? value->asUint() : defaultValue;
+}
+
+double JsonValue::getNumber(std::string_view key, double defaultValue) const
+{
+	const JsonValue* value = find(key);
+	return value != nullptr ? value->asNumber() : defaultValue;
+}
+
+bool JsonValue::getBool(std::string_view key, bool defaultValue) const
+{
+	const JsonValue* value = find(key);
+	return value != nullptr ? value->asBool() : defaultValue;
+}
+
+std::string JsonValue::getString(std::string_view key, const std::string& defaultValue) const
+{
+	const JsonValue* value = find(key);
+	return value != nullptr ? value->asString() : defaultValue;
+}
+
+const std::vector<std::string>& JsonValue::getKeys() const
+{
+	return keys;
+}
+
+const std::vector<JsonValue>& JsonValue::getValues() const
+{
+	return values;
+}
+
+JsonValue parseJson(std::string_view text)
+{
+	return JsonParser(text).parseDocument();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Minimal JSON document model, enough for asset manifests such as glTF.
+// Objects keep their members in file order, lookups are linear which suits the small objects assets use.
+class JsonValue
+{
+public:
+	enum class Type
+	{
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	JsonValue();
+
+	Type getType() const;
+	bool isNull() const;
+	bool isObject() const;
+	bool isArray() const;
+
+	bool asBool() const;
+	double asNumber() const;
+	uint32_t asUint() const;
+	const std::string& asString() const;
+
+	// Array elements or object values
+	size_t size() const;
+	const JsonValue& operator[](size_t index) const;
+
+	// Nullptr when the member is missing
+	const JsonValue* find(std::string_view key) const;
+	const JsonValue& operator[](std::string_view key) const;
+
+	uint32_t getUint(std::string_view key, uint32_t defaultValue) const;
+	double getNumber(std::string_view key, double defaultValue) const;
+	bool getBool(std::string_view key, bool defaultValue) const;
+	std::string getString(std::string_view key, const std::string& defaultValue) const;
+
+	const std::vector<std::string>& getKeys() const;
+	const std::vector<JsonValue>& getValues() const;
+private:
+	friend class JsonParser;
+
+	Type type = Type::Null;
+	bool boolValue = false;
+	double numberValue = 0.0;
+	std::string stringValue;
+	std::vector<std::string> keys;
+	std::vector<JsonValue> values;
+};
+
+JsonValue parseJson(std::string_view text);
@@ -0,0 +1,74 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+#include <cmath>
+
+float getPixelsPerUnit(float viewportHeight, float verticalFieldOfView, float distance)
+{
+	return viewportHeight / (2.0f * std::tan(verticalFieldOfView * 0.5f) * std::max(distance, 1e-4f));
+}
+
+LodSelector::LodSelector()
+{
+}
+
+void LodSelector::init(const LodSettings& newSettings)
+{
+	settings = newSettings;
+	currentLods.clear();
+}
+
+void LodSelector::beginFrame()
+{
+	selectedTriangleCount = 0;
+	fullDetailTriangleCount = 0;
+}
+
+uint32_t LodSelector::selectLod(uint32_t drawId, const std::vector<MeshFileLod>& lods, float boundingRadius, float pixelsPerUnit)
+{
+	if (drawId >= currentLods.size())
+	{
+		currentLods.resize(drawId + 1, 0);
+	}
+	const uint32_t lodCount = static_cast<uint32_t>(lods.size());
+	uint32_t& currentLod = currentLods[drawId];
+	currentLod = std::min(currentLod, lodCount - 1);
+
+	uint32_t selectedLod = 0;
+	if (boundingRadius * 2.0f * pixelsPerUnit < settings.minScreenSize)
+	{
+		selectedLod = lodCount - 1;
+	}
+	else
+	{
+		// Coarser LODs are only taken once comfortably under the threshold, and the current one is only
+		// abandoned for a finer one once it is comfortably over
+		for (uint32_t lod = 1; lod < lodCount; lod++)
+		{
+			const float projectedError = lods[lod].error * pixelsPerUnit;
+			const float threshold = lod <= currentLod ?
+				settings.maxScreenError * (1.0f + settings.hysteresis) :
+				settings.maxScreenError * (1.0f - settings.hysteresis);
+			if (projectedError > threshold)
+			{
+				break;
+			}
+			selectedLod = lod;
+		}
+	}
+
+	currentLod = selectedLod;
+	selectedTriangleCount += lods[selectedLod].indexCount / 3;
+	fullDetailTriangleCount += lods[0].indexCount / 3;
+	return selectedLod;
+}
+
+uint64_t LodSelector::getSelectedTriangleCount()
+{
+	return selectedTriangleCount;
+}
+
+uint64_t LodSelector::getFullDetailTriangleCount()
+{
+	return fullDetailTriangleCount;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "MeshFile.h"
+
+struct LodSettings
+{
+	// Largest acceptable simplification error once projected to the screen, in pixels
+	float maxScreenError = 1.0f;
+	// Fraction the projected error has to move past the threshold before the LOD changes,
+	// stops objects near a boundary from popping back and forth every frame
+	float hysteresis = 0.25f;
+	// Objects whose bounds project smaller than this many pixels use their coarsest LOD
+	float minScreenSize = 2.0f;
+};
+
+// Screen pixels covered by one object space unit at the given view distance for a perspective projection
+float getPixelsPerUnit(float viewportHeight, float verticalFieldOfView, float distance);
+
+// Picks a LOD per draw from its projected size each frame, remembering the previous choice for hysteresis
+class LodSelector
+{
+public:
+	LodSelector();
+	void init(const LodSettings& newSettings);
+
+	// Call once per frame before selecting, resets the statistics
+	void beginFrame();
+	uint32_t selectLod(uint32_t drawId, const std::vector<MeshFileLod>& lods, float boundingRadius, float pixelsPerUnit);
+
+	uint64_t getSelectedTriangleCount();
+	uint64_t getFullDetailTriangleCount();
+private:
+	LodSettings settings;
+	std::vector<uint32_t> currentLods;
+	uint64_t selectedTriangleCount = 0;
+	uint64_t fullDetailTriangleCount = 0;
+};
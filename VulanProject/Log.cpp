@@ -1,6 +1,7 @@
 #include "Log.h"
 
 std::shared_ptr<spdlog::logger> Log::s_coreLogger;
+std::shared_ptr<AsyncLogSink> Log::s_asyncSink;
 
 void Log::init()
 {
@@ -8,3 +9,25 @@ void Log::init()
 	s_coreLogger = spdlog::stdout_color_mt("Vulkan");
 	s_coreLogger->set_level(spdlog::level::trace);
 }
+
+void Log::enableAsync(const AsyncLogSettings& settings)
+{
+	if (s_asyncSink)
+	{
+		return;
+	}
+
+	// The console sink keeps the pattern, it is just written to from the background thread
+	s_asyncSink = std::make_shared<AsyncLogSink>(s_coreLogger->sinks().front(), settings);
+	auto asyncLogger = std::make_shared<spdlog::logger>(s_coreLogger->name(), s_asyncSink);
+	asyncLogger->set_level(s_coreLogger->level());
+	s_coreLogger = asyncLogger;
+}
+
+void Log::shutdown()
+{
+	if (s_asyncSink)
+	{
+		s_asyncSink->stop();
+	}
+}
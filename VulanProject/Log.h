@@ -4,16 +4,23 @@
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include <memory>
 
+#include "AsyncLogSink.h"
+
 class Log
 {
 public:
 	static void init();
+	// Moves console output onto a background thread, call before any other thread starts logging
+	static void enableAsync(const AsyncLogSettings& settings);
+	// Writes out whatever is still queued and stops the background thread
+	static void shutdown();
 	inline static std::shared_ptr<spdlog::logger>& getLogger()
 	{
 		return s_coreLogger;
 	}
 private:
 	static std::shared_ptr<spdlog::logger> s_coreLogger;
+	static std::shared_ptr<AsyncLogSink> s_asyncSink;
 };
 
 #ifdef NDEBUG
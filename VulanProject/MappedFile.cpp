@@ -0,0 +1,180 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::MappedFile(const std::string& fileName)
+{
+	open(fileName);
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		data = std::exchange(other.data, nullptr);
+		size = std::exchange(other.size, 0);
+		opened = std::exchange(other.opened, false);
+#ifdef _WIN32
+		fileHandle = std::exchange(other.fileHandle, nullptr);
+		mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#else
+		fileDescriptor = std::exchange(other.fileDescriptor, -1);
+#endif
+	}
+	return *this;
+}
+
+void MappedFile::open(const std::string& fileName)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Failed to open a file: " + fileName);
+	}
+	fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		close();
+		throw std::runtime_error("Failed to query the size of a file: " + fileName);
+	}
+	size = static_cast<size_t>(fileSize.QuadPart);
+	opened = true;
+
+	// Zero length files cannot be mapped, they are simply an empty span
+	if (size == 0)
+	{
+		return;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		close();
+		throw std::runtime_error("Failed to create a file mapping: " + fileName);
+	}
+	mappingHandle = mapping;
+
+	data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (data == nullptr)
+	{
+		close();
+		throw std::runtime_error("Failed to map a file: " + fileName);
+	}
+#else
+	fileDescriptor = ::open(fileName.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		throw std::runtime_error("Failed to open a file: " + fileName);
+	}
+
+	struct stat fileStat;
+	if (fstat(fileDescriptor, &fileStat) != 0)
+	{
+		close();
+		throw std::runtime_error("Failed to query the size of a file: " + fileName);
+	}
+	size = static_cast<size_t>(fileStat.st_size);
+	opened = true;
+
+	if (size == 0)
+	{
+		return;
+	}
+
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (mapping == MAP_FAILED)
+	{
+		close();
+		throw std::runtime_error("Failed to map a file: " + fileName);
+	}
+	// Assets are read front to back exactly once
+	madvise(mapping, size, MADV_SEQUENTIAL);
+	data = static_cast<const char*>(mapping);
+#endif
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (data != nullptr)
+	{
+		UnmapViewOfFile(data);
+	}
+	if (mappingHandle != nullptr)
+	{
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle != nullptr)
+	{
+		CloseHandle(fileHandle);
+	}
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+#else
+	if (data != nullptr)
+	{
+		munmap(const_cast<char*>(data), size);
+	}
+	if (fileDescriptor >= 0)
+	{
+		::close(fileDescriptor);
+	}
+	fileDescriptor = -1;
+#endif
+	data = nullptr;
+	size = 0;
+	opened = false;
+}
+
+std::span<const char> MappedFile::getData() const
+{
+	return std::span<const char>(data, size);
+}
+
+const uint8_t* MappedFile::getBytes() const
+{
+	return reinterpret_cast<const uint8_t*>(data);
+}
+
+size_t MappedFile::getSize() const
+{
+	return size;
+}
+
+bool MappedFile::isOpen() const
+{
+	return opened;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+// Read-only memory mapping of a whole file, pages are faulted in by the OS on first access
+// so asset bytes are copied once, straight from the page cache into their destination
+class MappedFile
+{
+public:
+	MappedFile();
+	explicit MappedFile(const std::string& fileName);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	void open(const std::string& fileName);
+	void close();
+
+	// Valid until the file is closed, the mapping is page aligned so SPIR-V can be read as uint32_t
+	std::span<const char> getData() const;
+	const uint8_t* getBytes() const;
+	size_t getSize() const;
+	bool isOpen() const;
+private:
+	const char* data = nullptr;
+	size_t size = 0;
+	bool opened = false;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+};
@@ -0,0 +1,380 @@
+#include "MemoryBudget.h"
+
+#include <algorithm>
+#include <string>
+
+#include "Log.h"
+
+namespace
+{
+	// Without VK_EXT_memory_budget the driver, the compositor and other processes are assumed to need the rest
+	constexpr double ESTIMATED_BUDGET_FRACTION = 0.8;
+	// A heap past this share of its budget is evicted from until it is back under the target
+	constexpr double EVICTION_THRESHOLD = 0.9;
+	constexpr double EVICTION_TARGET = 0.8;
+
+	constexpr VkDeviceSize MEBIBYTE = 1024 * 1024;
+}
+
+const char* getMemoryCategoryName(MemoryCategory category)
+{
+	switch (category)
+	{
+	case MemoryCategory::Geometry:
+		return "geometry";
+	case MemoryCategory::Textures:
+		return "textures";
+	case MemoryCategory::RenderTargets:
+		return "render targets";
+	case MemoryCategory::Staging:
+		return "staging";
+	case MemoryCategory::FrameData:
+		return "frame data";
+	default:
+		return "other";
+	}
+}
+
+void logMemoryBudgetStatistics(const MemoryBudgetStatistics& statistics)
+{
+	for (size_t i = 0; i < statistics.heaps.size(); i++)
+	{
+		const MemoryHeapStatistics& heap = statistics.heaps[i];
+		if (heap.allocationCount == 0)
+		{
+			continue;
+		}
+
+		std::string categories;
+		for (size_t c = 0; c < MEMORY_CATEGORY_COUNT; c++)
+		{
+			if (heap.categoryBytes[c] > 0)
+			{
+				categories += fmt::format(", {} {} KiB", getMemoryCategoryName(static_cast<MemoryCategory>(c)),
+					heap.categoryBytes[c] / 1024);
+			}
+		}
+		VULKAN_CORE_INFO("Memory heap {}: {} of {} MiB, {} allocations{}", i, heap.usage / MEBIBYTE,
+			heap.budget / MEBIBYTE, heap.allocationCount, categories);
+	}
+	VULKAN_CORE_INFO("Memory budget: {} refused, {} spilled, {} evictions freeing {} KiB", statistics.refusedAllocations,
+		statistics.spilledAllocations, statistics.evictions, statistics.evictedBytes / 1024);
+}
+
+MemoryBudget::MemoryBudget()
+{
+}
+
+void MemoryBudget::init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, bool memoryBudgetSupported)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+	driverBudget = memoryBudgetSupported;
+
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	heaps.assign(memoryProperties.memoryHeapCount, Heap());
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		heaps[i].deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		heaps[i].size = memoryProperties.memoryHeaps[i].size;
+	}
+	refreshBudgets();
+
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		VULKAN_CORE_INFO("Memory heap {}: {} MiB{}, budget {} MiB {}", i, heaps[i].size / MEBIBYTE,
+			heaps[i].deviceLocal ? " device local" : "", heaps[i].budget / MEBIBYTE,
+			driverBudget ? "from the driver" : "estimated");
+	}
+}
+
+void MemoryBudget::setBudgetLimit(VkDeviceSize limit)
+{
+	budgetLimit = limit;
+	refreshBudgets();
+}
+
+void MemoryBudget::addEvictionHandler(const MemoryEvictionHandler& handler)
+{
+	evictionHandlers.push_back(handler);
+}
+
+void MemoryBudget::update()
+{
+	refreshBudgets();
+
+	for (uint32_t i = 0; i < static_cast<uint32_t>(heaps.size()); i++)
+	{
+		const VkDeviceSize threshold = static_cast<VkDeviceSize>(heaps[i].budget * EVICTION_THRESHOLD);
+		if (getUsage(heaps[i]) > threshold)
+		{
+			const VkDeviceSize target = static_cast<VkDeviceSize>(heaps[i].budget * EVICTION_TARGET);
+			evict(i, getUsage(heaps[i]) - target);
+		}
+
+		const bool overBudget = getUsage(heaps[i]) > heaps[i].budget;
+		if (overBudget && !heaps[i].overBudget)
+		{
+			VULKAN_CORE_WARN("Memory heap {} is over budget, {} of {} MiB in use", i, getUsage(heaps[i]) / MEBIBYTE,
+				heaps[i].budget / MEBIBYTE);
+		}
+		heaps[i].overBudget = overBudget;
+	}
+}
+
+bool MemoryBudget::findMemoryTypeIndex(uint32_t allowedTypes, VkMemoryPropertyFlags properties, VkDeviceSize size,
+	uint32_t* memoryTypeIndex)
+{
+	auto matches = [this, allowedTypes](uint32_t i, VkMemoryPropertyFlags flags)
+	{
+		return (allowedTypes & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & flags) == flags;
+	};
+	auto isDeviceLocal = [this](uint32_t i)
+	{
+		return (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0;
+	};
+
+	// First choice is a type with every property on a heap with room
+	uint32_t overBudgetType = memoryProperties.memoryTypeCount;
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		if (!matches(i, properties))
+		{
+			continue;
+		}
+		if (hasRoom(memoryProperties.memoryTypes[i].heapIndex, size))
+		{
+			*memoryTypeIndex = i;
+			return true;
+		}
+		overBudgetType = std::min(overBudgetType, i);
+	}
+
+	// Device local memory is only a preference, system memory the GPU can reach beats going over budget
+	const VkMemoryPropertyFlags spillProperties = properties & ~VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	uint32_t overBudgetSpillType = memoryProperties.memoryTypeCount;
+	if (spillProperties != properties)
+	{
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			if (!matches(i, spillProperties) || isDeviceLocal(i))
+			{
+				continue;
+			}
+			if (hasRoom(memoryProperties.memoryTypes[i].heapIndex, size))
+			{
+				if (overBudgetType < memoryProperties.memoryTypeCount)
+				{
+					spilledAllocations++;
+					VULKAN_CORE_WARN("Device local memory over budget, {} KiB placed in system memory", size / 1024);
+				}
+				*memoryTypeIndex = i;
+				return true;
+			}
+			overBudgetSpillType = std::min(overBudgetSpillType, i);
+		}
+	}
+
+	// Nothing has room, the allocation goes over budget where it was asked for
+	if (overBudgetType < memoryProperties.memoryTypeCount)
+	{
+		*memoryTypeIndex = overBudgetType;
+		return true;
+	}
+	if (overBudgetSpillType < memoryProperties.memoryTypeCount)
+	{
+		*memoryTypeIndex = overBudgetSpillType;
+		return true;
+	}
+	return false;
+}
+
+VkResult MemoryBudget::allocate(const VkMemoryAllocateInfo& allocateInfo, MemoryCategory category,
+	MemoryPriority priority, VkDeviceMemory* memory)
+{
+	const uint32_t heapIndex = memoryProperties.memoryTypes[allocateInfo.memoryTypeIndex].heapIndex;
+	if (!hasRoom(heapIndex, allocateInfo.allocationSize))
+	{
+		if (priority == MemoryPriority::Optional)
+		{
+			refusedAllocations++;
+			return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+		}
+		const VkDeviceSize available = heaps[heapIndex].budget - std::min(getUsage(heaps[heapIndex]),
+			heaps[heapIndex].budget);
+		evict(heapIndex, allocateInfo.allocationSize - available);
+	}
+
+	VkResult result = vkAllocateMemory(device, &allocateInfo, nullptr, memory);
+	if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY && priority == MemoryPriority::Required &&
+		evict(heapIndex, allocateInfo.allocationSize) > 0)
+	{
+		result = vkAllocateMemory(device, &allocateInfo, nullptr, memory);
+	}
+	if (result != VK_SUCCESS)
+	{
+		return result;
+	}
+
+	Allocation allocation = {};
+	allocation.size = allocateInfo.allocationSize;
+	allocation.heapIndex = heapIndex;
+	allocation.category = category;
+	allocations[*memory] = allocation;
+
+	Heap& heap = heaps[heapIndex];
+	heap.trackedBytes += allocation.size;
+	heap.allocationCount++;
+	heap.categoryBytes[static_cast<size_t>(category)] += allocation.size;
+	return VK_SUCCESS;
+}
+
+void MemoryBudget::free(VkDeviceMemory memory)
+{
+	if (memory == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	auto allocation = allocations.find(memory);
+	if (allocation != allocations.end())
+	{
+		Heap& heap = heaps[allocation->second.heapIndex];
+		heap.trackedBytes -= allocation->second.size;
+		heap.allocationCount--;
+		heap.categoryBytes[static_cast<size_t>(allocation->second.category)] -= allocation->second.size;
+		allocations.erase(allocation);
+	}
+	vkFreeMemory(device, memory, nullptr);
+}
+
+uint32_t MemoryBudget::getHeapIndex(VkDeviceMemory memory)
+{
+	return allocations.at(memory).heapIndex;
+}
+
+VkDeviceSize MemoryBudget::getAllocationSize(VkDeviceMemory memory)
+{
+	return allocations.at(memory).size;
+}
+
+MemoryBudgetStatistics MemoryBudget::getStatistics()
+{
+	MemoryBudgetStatistics statistics = {};
+	statistics.driverBudget = driverBudget;
+	statistics.refusedAllocations = refusedAllocations;
+	statistics.spilledAllocations = spilledAllocations;
+	statistics.evictions = evictions;
+	statistics.evictedBytes = evictedBytes;
+	for (const Heap& heap : heaps)
+	{
+		MemoryHeapStatistics heapStatistics = {};
+		heapStatistics.deviceLocal = heap.deviceLocal;
+		heapStatistics.size = heap.size;
+		heapStatistics.budget = heap.budget;
+		heapStatistics.usage = getUsage(heap);
+		heapStatistics.allocationCount = heap.allocationCount;
+		heapStatistics.categoryBytes = heap.categoryBytes;
+		statistics.heaps.push_back(heapStatistics);
+	}
+	return statistics;
+}
+
+void MemoryBudget::cleanup()
+{
+	if (!allocations.empty())
+	{
+		VULKAN_CORE_WARN("{} device memory allocations were never freed", allocations.size());
+	}
+	allocations.clear();
+	evictionHandlers.clear();
+	heaps.clear();
+}
+
+void MemoryBudget::refreshBudgets()
+{
+	if (driverBudget)
+	{
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 memoryProperties2 = {};
+		memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memoryProperties2.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+
+		for (size_t i = 0; i < heaps.size(); i++)
+		{
+			heaps[i].budget = budgetProperties.heapBudget[i];
+			heaps[i].reportedUsage = budgetProperties.heapUsage[i];
+			heaps[i].trackedAtReport = heaps[i].trackedBytes;
+		}
+	}
+	else
+	{
+		for (Heap& heap : heaps)
+		{
+			heap.budget = static_cast<VkDeviceSize>(heap.size * ESTIMATED_BUDGET_FRACTION);
+		}
+	}
+
+	if (budgetLimit > 0)
+	{
+		for (Heap& heap : heaps)
+		{
+			if (heap.deviceLocal)
+			{
+				heap.budget = std::min(heap.budget, budgetLimit);
+			}
+		}
+	}
+}
+
+VkDeviceSize MemoryBudget::getUsage(const Heap& heap)
+{
+	if (!driverBudget)
+	{
+		return heap.trackedBytes;
+	}
+
+	// The driver's figure is only as fresh as the last refresh, what was allocated or freed since is added on top
+	if (heap.trackedBytes >= heap.trackedAtReport)
+	{
+		return heap.reportedUsage + (heap.trackedBytes - heap.trackedAtReport);
+	}
+	return heap.reportedUsage - std::min(heap.reportedUsage, heap.trackedAtReport - heap.trackedBytes);
+}
+
+bool MemoryBudget::hasRoom(uint32_t heapIndex, VkDeviceSize size)
+{
+	return getUsage(heaps[heapIndex]) + size <= heaps[heapIndex].budget;
+}
+
+VkDeviceSize MemoryBudget::evict(uint32_t heapIndex, VkDeviceSize bytes)
+{
+	// Handlers allocate the smaller replacements of what they evict, those must not evict in turn
+	if (evicting || bytes == 0)
+	{
+		return 0;
+	}
+
+	evicting = true;
+	VkDeviceSize freed = 0;
+	for (const MemoryEvictionHandler& handler : evictionHandlers)
+	{
+		if (freed >= bytes)
+		{
+			break;
+		}
+		freed += handler(heapIndex, bytes - freed);
+	}
+	evicting = false;
+
+	if (freed > 0)
+	{
+		evictions++;
+		evictedBytes += freed;
+		VULKAN_CORE_INFO("Evicted {} KiB from memory heap {}, {} of {} MiB in use", freed / 1024, heapIndex,
+			getUsage(heaps[heapIndex]) / MEBIBYTE, heaps[heapIndex].budget / MEBIBYTE);
+	}
+	return freed;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <array>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "MemoryCategory.h"
+
+struct MemoryHeapStatistics
+{
+	bool deviceLocal = false;
+	VkDeviceSize size = 0;
+	VkDeviceSize budget = 0;
+	// Whole process usage as last reported by the driver plus what was allocated since, or only what is tracked
+	// here without VK_EXT_memory_budget
+	VkDeviceSize usage = 0;
+	uint32_t allocationCount = 0;
+	std::array<VkDeviceSize, MEMORY_CATEGORY_COUNT> categoryBytes = {};
+};
+
+struct MemoryBudgetStatistics
+{
+	// False when the budgets are estimated from the heap sizes
+	bool driverBudget = false;
+	std::vector<MemoryHeapStatistics> heaps;
+	uint32_t refusedAllocations = 0;
+	// Device local allocations placed in another heap because theirs was over budget
+	uint32_t spilledAllocations = 0;
+	uint32_t evictions = 0;
+	VkDeviceSize evictedBytes = 0;
+};
+
+// One line per heap in use, then the refusals, spills and evictions so far
+void logMemoryBudgetStatistics(const MemoryBudgetStatistics& statistics);
+
+// Frees memory in the heap and returns how many bytes it managed to free
+using MemoryEvictionHandler = std::function<VkDeviceSize(uint32_t heapIndex, VkDeviceSize bytes)>;
+
+// Tracks every device memory allocation against the budget of its heap. Budgets come from VK_EXT_memory_budget,
+// which also counts other processes, or are a fixed share of each heap without it. New allocations prefer heaps
+// with room left, optional ones are refused when nothing fits, and when a heap gets close to its budget the
+// eviction handlers are asked to give memory back before the driver runs out.
+class MemoryBudget
+{
+public:
+	MemoryBudget();
+	void init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, bool memoryBudgetSupported);
+	// Caps every device local heap's budget, zero removes the cap
+	void setBudgetLimit(VkDeviceSize limit);
+
+	// Handlers are asked in the order they were added
+	void addEvictionHandler(const MemoryEvictionHandler& handler);
+
+	// Refreshes the driver's budgets and evicts from heaps that are close to theirs. Called at the start of a frame,
+	// the handlers may have to wait for the queue to go idle.
+	void update();
+
+	// Memory type with the properties on a heap with room for the size. A device local request falls back to
+	// another heap when no device local one has room. False when no allowed type has the properties.
+	bool findMemoryTypeIndex(uint32_t allowedTypes, VkMemoryPropertyFlags properties, VkDeviceSize size,
+		uint32_t* memoryTypeIndex);
+	// Optional allocations are refused with VK_ERROR_OUT_OF_DEVICE_MEMORY when they would take the heap over budget,
+	// a required one the driver fails is retried once after evicting
+	VkResult allocate(const VkMemoryAllocateInfo& allocateInfo, MemoryCategory category, MemoryPriority priority,
+		VkDeviceMemory* memory);
+	void free(VkDeviceMemory memory);
+
+	uint32_t getHeapIndex(VkDeviceMemory memory);
+	VkDeviceSize getAllocationSize(VkDeviceMemory memory);
+	MemoryBudgetStatistics getStatistics();
+
+	void cleanup();
+private:
+	struct Allocation
+	{
+		VkDeviceSize size = 0;
+		uint32_t heapIndex = 0;
+		MemoryCategory category = MemoryCategory::Other;
+	};
+
+	struct Heap
+	{
+		bool deviceLocal = false;
+		VkDeviceSize size = 0;
+		VkDeviceSize budget = 0;
+		// Driver reported usage and what was tracked at the time, usage is estimated in between refreshes
+		VkDeviceSize reportedUsage = 0;
+		VkDeviceSize trackedAtReport = 0;
+		VkDeviceSize trackedBytes = 0;
+		uint32_t allocationCount = 0;
+		std::array<VkDeviceSize, MEMORY_CATEGORY_COUNT> categoryBytes = {};
+		// Warned once each time the heap goes over budget
+		bool overBudget = false;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	bool driverBudget = false;
+	VkDeviceSize budgetLimit = 0;
+
+	VkPhysicalDeviceMemoryProperties memoryProperties = {};
+	std::vector<Heap> heaps;
+	std::unordered_map<VkDeviceMemory, Allocation> allocations;
+	std::vector<MemoryEvictionHandler> evictionHandlers;
+	bool evicting = false;
+
+	uint32_t refusedAllocations = 0;
+	uint32_t spilledAllocations = 0;
+	uint32_t evictions = 0;
+	VkDeviceSize evictedBytes = 0;
+
+	void refreshBudgets();
+	VkDeviceSize getUsage(const Heap& heap);
+	bool hasRoom(uint32_t heapIndex, VkDeviceSize size);
+	VkDeviceSize evict(uint32_t heapIndex, VkDeviceSize bytes);
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+// What an allocation is for, usage is reported per category
+enum class MemoryCategory
+{
+	Geometry,
+	Textures,
+	RenderTargets,
+	Staging,
+	FrameData,
+	Other,
+	Count
+};
+
+constexpr size_t MEMORY_CATEGORY_COUNT = static_cast<size_t>(MemoryCategory::Count);
+
+const char* getMemoryCategoryName(MemoryCategory category);
+
+// Optional allocations have a fallback, e.g. a texture without its largest mip levels, and are refused instead of
+// taking a heap over its budget
+enum class MemoryPriority
+{
+	Optional,
+	Required
+};
@@ -1,17 +1,50 @@
 ﻿#include "Mesh.h"
 
-#include <spdlog/fmt/bundled/core.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+static_assert(sizeof(Vertex) == sizeof(MeshFileVertex) && offsetof(Vertex, col) == offsetof(MeshFileVertex, colour),
+    "Mesh files are uploaded without conversion, Vertex must match MeshFileVertex");
 
 Mesh::Mesh()
 {
 }
 
-Mesh::Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, std::vector<Vertex>* vertices) :
+Mesh::Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* memoryBudget, BufferPool* newBufferPool,
+    QueueTimeline* transferTimeline, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices,
+    std::vector<uint32_t>* indices) :
+    physicalDevice(newPhysicalDevice),
+    device(newDevice),
+    bufferPool(newBufferPool)
+{
+    UploadBatch uploadBatch;
+    uploadBatch.begin(physicalDevice, device, memoryBudget, transferTimeline, transferCommandPool, getUploadSize(vertices->size(), indices->size()));
+    create_buffers(uploadBatch, std::span<const MeshFileVertex>(reinterpret_cast<const MeshFileVertex*>(vertices->data()), vertices->size()),
+        *indices, {});
+    uploadBatch.submit();
+}
+
+Mesh::Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* memoryBudget, BufferPool* newBufferPool,
+    QueueTimeline* transferTimeline, VkCommandPool transferCommandPool, const MeshFile& meshFile) :
     physicalDevice(newPhysicalDevice),
-    device(newDevice)
+    device(newDevice),
+    bufferPool(newBufferPool)
 {
-    vertexCount = vertices->size();
-    create_vertex_buffer(vertices);
+    UploadBatch uploadBatch;
+    uploadBatch.begin(physicalDevice, device, memoryBudget, transferTimeline, transferCommandPool,
+        getUploadSize(meshFile.getVertices().size(), meshFile.getIndices().size()));
+    create_buffers(uploadBatch, meshFile.getVertices(), meshFile.getIndices(), meshFile.getLods());
+    uploadBatch.submit();
+}
+
+Mesh::Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, BufferPool* newBufferPool, UploadBatch& uploadBatch,
+    std::span<const MeshFileVertex> vertices, std::span<const uint32_t> indices, std::span<const MeshFileLod> meshLods) :
+    physicalDevice(newPhysicalDevice),
+    device(newDevice),
+    bufferPool(newBufferPool)
+{
+    create_buffers(uploadBatch, vertices, indices, meshLods);
 }
 
 int Mesh::getVertexCount()
@@ -21,33 +54,86 @@ int Mesh::getVertexCount()
 
 VkBuffer Mesh::getVertexBuffer()
 {
-    return vertexBuffer;
+    return bufferPool->getBuffer(vertexBuffer);
+}
+
+int Mesh::getIndexCount()
+{
+    return indexCount;
+}
+
+VkBuffer Mesh::getIndexBuffer()
+{
+    return bufferPool->getBuffer(indexBuffer);
 }
 
-void Mesh::destroyVertexBuffer()
+bool Mesh::isLoaded()
 {
-    vkDestroyBuffer(device, vertexBuffer, nullptr);
-    vkFreeMemory(device, vertexBufferMemory, nullptr);
+    return vertexBuffer != INVALID_BUFFER_HANDLE;
 }
 
-void Mesh::create_vertex_buffer(std::vector<Vertex>* vertices)
+const std::vector<MeshFileLod>& Mesh::getLods()
 {
-    const VkDeviceSize bufferSize = sizeof(Vertex) * vertices->size();
+    return lods;
+}
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    
-    createBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &stagingBuffer, &stagingBufferMemory);
-    
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices->data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
+float Mesh::getBoundingRadius()
+{
+    return boundingRadius;
+}
 
-    createBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &vertexBuffer, &vertexBufferMemory);
+glm::vec3 Mesh::getBoundingCentre()
+{
+    return boundingCentre;
 }
 
+void Mesh::destroyBuffers()
+{
+    bufferPool->destroyBuffer(indexBuffer);
+    indexBuffer = INVALID_BUFFER_HANDLE;
+    bufferPool->destroyBuffer(vertexBuffer);
+    vertexBuffer = INVALID_BUFFER_HANDLE;
+}
 
+VkDeviceSize Mesh::getUploadSize(size_t meshVertexCount, size_t meshIndexCount)
+{
+    return UploadBatch::getAlignedSize(sizeof(MeshFileVertex) * meshVertexCount) + UploadBatch::getAlignedSize(sizeof(uint32_t) * meshIndexCount);
+}
+
+void Mesh::create_buffers(UploadBatch& uploadBatch, std::span<const MeshFileVertex> vertices, std::span<const uint32_t> indices,
+    std::span<const MeshFileLod> meshLods)
+{
+    vertexCount = static_cast<int>(vertices.size());
+    indexCount = static_cast<int>(indices.size());
+    lods.assign(meshLods.begin(), meshLods.end());
+    if (lods.empty())
+    {
+        lods.push_back({ 0, static_cast<uint32_t>(indexCount), 0.0f, 0 });
+    }
+
+    if (!vertices.empty())
+    {
+        float boundsMin[3] = { vertices[0].position[0], vertices[0].position[1], vertices[0].position[2] };
+        float boundsMax[3] = { boundsMin[0], boundsMin[1], boundsMin[2] };
+        for (const auto& vertex : vertices)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                boundsMin[axis] = std::min(boundsMin[axis], vertex.position[axis]);
+                boundsMax[axis] = std::max(boundsMax[axis], vertex.position[axis]);
+            }
+        }
+        const float extent[3] = { boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2] };
+        boundingRadius = 0.5f * std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+        boundingCentre = 0.5f * glm::vec3(boundsMin[0] + boundsMax[0], boundsMin[1] + boundsMax[1], boundsMin[2] + boundsMax[2]);
+    }
+
+    const VkDeviceSize vertexDataSize = vertices.size_bytes();
+    const VkDeviceSize indexDataSize = indices.size_bytes();
+
+    vertexBuffer = bufferPool->createBuffer(vertexDataSize);
+    indexBuffer = bufferPool->createBuffer(indexDataSize);
+
+    uploadBatch.uploadBuffer(bufferPool->getBuffer(vertexBuffer), vertices.data(), vertexDataSize);
+    uploadBatch.uploadBuffer(bufferPool->getBuffer(indexBuffer), indices.data(), indexDataSize);
+}
@@ -3,24 +3,55 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <span>
 #include <vector>
 
+#include "BufferPool.h"
+#include "MeshFile.h"
+#include "UploadBatch.h"
 #include "Utilities.h"
 
 class Mesh
 {
 public:
     Mesh();
-    Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, std::vector<Vertex>* vertices);
+    // The budget only tracks the staging memory, the buffers themselves come from the pool
+    Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* memoryBudget, BufferPool* newBufferPool,
+        QueueTimeline* transferTimeline, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices,
+        std::vector<uint32_t>* indices);
+    // Uploads the vertex and index streams straight from the mapped file
+    Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* memoryBudget, BufferPool* newBufferPool,
+        QueueTimeline* transferTimeline, VkCommandPool transferCommandPool, const MeshFile& meshFile);
+    // Records the upload into a batch shared with other meshes, the buffers are usable once the batch is submitted
+    Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, BufferPool* newBufferPool, UploadBatch& uploadBatch,
+        std::span<const MeshFileVertex> vertices, std::span<const uint32_t> indices, std::span<const MeshFileLod> meshLods);
     int getVertexCount();
+    // Looked up in the pool every frame, defragmentation can move the buffers
     VkBuffer getVertexBuffer();
-    void destroyVertexBuffer();
+    int getIndexCount();
+    VkBuffer getIndexBuffer();
+    // False once the buffers have been destroyed
+    bool isLoaded();
+    const std::vector<MeshFileLod>& getLods();
+    // Radius of a sphere around the centre of the bounding box, used to size LOD selection
+    float getBoundingRadius();
+    glm::vec3 getBoundingCentre();
+    void destroyBuffers();
+
+    // Staging space create_buffers needs for a mesh of this size
+    static VkDeviceSize getUploadSize(size_t meshVertexCount, size_t meshIndexCount);
 private:
-    int vertexCount;
-    VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
+    int vertexCount = 0;
+    BufferHandle vertexBuffer = INVALID_BUFFER_HANDLE;
+    int indexCount = 0;
+    BufferHandle indexBuffer = INVALID_BUFFER_HANDLE;
+    std::vector<MeshFileLod> lods;
+    float boundingRadius = 0.0f;
+    glm::vec3 boundingCentre = glm::vec3(0.0f);
     VkPhysicalDevice physicalDevice;
     VkDevice device;
+    BufferPool* bufferPool = nullptr;
 
-    void create_vertex_buffer(std::vector<Vertex>* vertices);
+    void create_buffers(UploadBatch& uploadBatch, std::span<const MeshFileVertex> vertices, std::span<const uint32_t> indices,
+        std::span<const MeshFileLod> meshLods);
 };
@@ -0,0 +1,128 @@
+#include "MeshConverter.h"
+
+#include <charconv>
+#include <stdexcept>
+#include <string_view>
+
+#include "Log.h"
+#include "MappedFile.h"
+#include "MeshSimplifier.h"
+
+namespace
+{
+	void skipSpaces(std::string_view& text)
+	{
+		while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+		{
+			text.remove_prefix(1);
+		}
+	}
+
+	bool readFloat(std::string_view& text, float* value)
+	{
+		skipSpaces(text);
+		auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), *value);
+		if (error != std::errc())
+		{
+			return false;
+		}
+		text.remove_prefix(end - text.data());
+		return true;
+	}
+
+	// Face corners are "v", "v/vt", "v//vn" or "v/vt/vn", only the position index is used
+	bool readFaceIndex(std::string_view& text, size_t positionCount, uint32_t* index)
+	{
+		skipSpaces(text);
+		long long value = 0;
+		auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+		if (error != std::errc())
+		{
+			return false;
+		}
+		text.remove_prefix(end - text.data());
+		while (!text.empty() && text.front() != ' ' && text.front() != '\t')
+		{
+			text.remove_prefix(1);
+		}
+
+		// Negative indices are relative to the end of the position list
+		const long long resolved = value < 0 ? static_cast<long long>(positionCount) + value : value - 1;
+		if (value == 0 || resolved < 0 || resolved >= static_cast<long long>(positionCount))
+		{
+			throw std::runtime_error("OBJ face references a missing vertex");
+		}
+		*index = static_cast<uint32_t>(resolved);
+		return true;
+	}
+}
+
+MeshData loadObj(const std::string& fileName)
+{
+	MappedFile file(fileName);
+	std::string_view text(file.getData().data(), file.getSize());
+
+	MeshData meshData;
+	while (!text.empty())
+	{
+		const size_t lineEnd = text.find('\n');
+		std::string_view line = text.substr(0, lineEnd);
+		text.remove_prefix(lineEnd == std::string_view::npos ? text.size() : lineEnd + 1);
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.remove_suffix(1);
+		}
+
+		if (line.starts_with("v "))
+		{
+			line.remove_prefix(2);
+			MeshFileVertex vertex = {};
+			if (!readFloat(line, &vertex.position[0]) || !readFloat(line, &vertex.position[1]) ||
+				!readFloat(line, &vertex.position[2]))
+			{
+				throw std::runtime_error("Malformed OBJ vertex in " + fileName);
+			}
+			// Vertices without a colour are white
+			if (!readFloat(line, &vertex.colour[0]) || !readFloat(line, &vertex.colour[1]) ||
+				!readFloat(line, &vertex.colour[2]))
+			{
+				vertex.colour[0] = vertex.colour[1] = vertex.colour[2] = 1.0f;
+			}
+			meshData.vertices.push_back(vertex);
+		}
+		else if (line.starts_with("f "))
+		{
+			line.remove_prefix(2);
+			uint32_t first;
+			uint32_t previous;
+			if (!readFaceIndex(line, meshData.vertices.size(), &first) ||
+				!readFaceIndex(line, meshData.vertices.size(), &previous))
+			{
+				throw std::runtime_error("Malformed OBJ face in " + fileName);
+			}
+
+			uint32_t current;
+			while (readFaceIndex(line, meshData.vertices.size(), &current))
+			{
+				meshData.indices.insert(meshData.indices.end(), { first, previous, current });
+				previous = current;
+			}
+		}
+	}
+
+	if (meshData.indices.empty())
+	{
+		throw std::runtime_error("OBJ file has no faces: " + fileName);
+	}
+	return meshData;
+}
+
+void convertMesh(const std::string& sourceFileName, const std::string& destinationFileName)
+{
+	MeshData meshData = loadObj(sourceFileName);
+	const size_t triangleCount = meshData.indices.size() / 3;
+	generateLods(meshData);
+	writeMeshFile(destinationFileName, meshData);
+	VULKAN_CORE_INFO("Converted {} to {}: {} vertices, {} triangles, {} LODs", sourceFileName, destinationFileName,
+		meshData.vertices.size(), triangleCount, meshData.lods.size());
+}
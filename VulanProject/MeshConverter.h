@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+
+#include "MeshFile.h"
+
+// Wavefront OBJ, positions may carry an optional "v x y z r g b" vertex colour.
+// Faces are fan triangulated, texture coordinates and normals are ignored.
+MeshData loadObj(const std::string& fileName);
+
+// Offline conversion of a source mesh into the binary mesh format the renderer loads, LODs are generated here
+void convertMesh(const std::string& sourceFileName, const std::string& destinationFileName);
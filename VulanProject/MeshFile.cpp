@@ -0,0 +1,159 @@
+#include "MeshFile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+	uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + MESH_FILE_ALIGNMENT - 1) & ~(MESH_FILE_ALIGNMENT - 1);
+	}
+
+	bool isSectionValid(uint64_t offset, uint64_t size, size_t fileSize)
+	{
+		return offset % MESH_FILE_ALIGNMENT == 0 && offset <= fileSize && size <= fileSize - offset;
+	}
+
+	void writeSection(std::ofstream& file, uint64_t offset, const void* data, uint64_t size)
+	{
+		static const char padding[MESH_FILE_ALIGNMENT] = {};
+		const uint64_t position = static_cast<uint64_t>(file.tellp());
+		file.write(padding, static_cast<std::streamsize>(offset - position));
+		file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+	}
+}
+
+void writeMeshFile(const std::string& fileName, const MeshData& meshData)
+{
+	std::vector<MeshFileLod> lods = meshData.lods;
+	if (lods.empty())
+	{
+		MeshFileLod lod = {};
+		lod.indexCount = static_cast<uint32_t>(meshData.indices.size());
+		lods.push_back(lod);
+	}
+
+	MeshFileHeader header = {};
+	header.vertexCount = static_cast<uint32_t>(meshData.vertices.size());
+	header.indexCount = static_cast<uint32_t>(meshData.indices.size());
+	header.lodCount = static_cast<uint32_t>(lods.size());
+
+	if (!meshData.vertices.empty())
+	{
+		std::copy(meshData.vertices[0].position, meshData.vertices[0].position + 3, header.boundsMin);
+		std::copy(meshData.vertices[0].position, meshData.vertices[0].position + 3, header.boundsMax);
+	}
+	for (const auto& vertex : meshData.vertices)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			header.boundsMin[axis] = std::min(header.boundsMin[axis], vertex.position[axis]);
+			header.boundsMax[axis] = std::max(header.boundsMax[axis], vertex.position[axis]);
+		}
+	}
+
+	header.lodTableOffset = alignOffset(sizeof(MeshFileHeader));
+	header.vertexDataOffset = alignOffset(header.lodTableOffset + lods.size() * sizeof(MeshFileLod));
+	header.vertexDataSize = meshData.vertices.size() * sizeof(MeshFileVertex);
+	header.indexDataOffset = alignOffset(header.vertexDataOffset + header.vertexDataSize);
+	header.indexDataSize = meshData.indices.size() * sizeof(uint32_t);
+
+	std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open a mesh file for writing: " + fileName);
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(MeshFileHeader));
+	writeSection(file, header.lodTableOffset, lods.data(), lods.size() * sizeof(MeshFileLod));
+	writeSection(file, header.vertexDataOffset, meshData.vertices.data(), header.vertexDataSize);
+	writeSection(file, header.indexDataOffset, meshData.indices.data(), header.indexDataSize);
+	if (!file)
+	{
+		throw std::runtime_error("Failed to write a mesh file: " + fileName);
+	}
+}
+
+MeshFile::MeshFile()
+{
+}
+
+MeshFile::MeshFile(const std::string& fileName)
+{
+	open(fileName);
+}
+
+void MeshFile::open(const std::string& fileName)
+{
+	header = nullptr;
+	file.open(fileName);
+
+	if (file.getSize() < sizeof(MeshFileHeader))
+	{
+		throw std::runtime_error("Mesh file is truncated: " + fileName);
+	}
+	const MeshFileHeader* fileHeader = reinterpret_cast<const MeshFileHeader*>(file.getBytes());
+	if (fileHeader->magic != MESH_FILE_MAGIC)
+	{
+		throw std::runtime_error("Not a mesh file: " + fileName);
+	}
+	if (fileHeader->version != MESH_FILE_VERSION || fileHeader->vertexStride != sizeof(MeshFileVertex))
+	{
+		throw std::runtime_error("Mesh file was written by an incompatible converter, re-run the conversion: " + fileName);
+	}
+
+	// Validation is all that happens on load, the sections are used in place
+	const size_t fileSize = file.getSize();
+	if (!isSectionValid(fileHeader->lodTableOffset, static_cast<uint64_t>(fileHeader->lodCount) * sizeof(MeshFileLod), fileSize) ||
+		!isSectionValid(fileHeader->vertexDataOffset, fileHeader->vertexDataSize, fileSize) ||
+		!isSectionValid(fileHeader->indexDataOffset, fileHeader->indexDataSize, fileSize) ||
+		fileHeader->vertexDataSize != static_cast<uint64_t>(fileHeader->vertexCount) * sizeof(MeshFileVertex) ||
+		fileHeader->indexDataSize != static_cast<uint64_t>(fileHeader->indexCount) * sizeof(uint32_t))
+	{
+		throw std::runtime_error("Mesh file sections are out of bounds: " + fileName);
+	}
+	header = fileHeader;
+
+	for (const auto& lod : getLods())
+	{
+		if (static_cast<uint64_t>(lod.firstIndex) + lod.indexCount > header->indexCount)
+		{
+			header = nullptr;
+			throw std::runtime_error("Mesh file LOD is out of bounds: " + fileName);
+		}
+	}
+
+	// One pass over the indices, every LOD draws from the same list
+	for (const uint32_t index : getIndices())
+	{
+		if (index >= header->vertexCount)
+		{
+			header = nullptr;
+			throw std::runtime_error("Mesh file index is out of bounds: " + fileName);
+		}
+	}
+}
+
+const MeshFileHeader& MeshFile::getHeader() const
+{
+	return *header;
+}
+
+std::span<const MeshFileLod> MeshFile::getLods() const
+{
+	return std::span<const MeshFileLod>(reinterpret_cast<const MeshFileLod*>(file.getBytes() + header->lodTableOffset),
+		header->lodCount);
+}
+
+std::span<const MeshFileVertex> MeshFile::getVertices() const
+{
+	return std::span<const MeshFileVertex>(reinterpret_cast<const MeshFileVertex*>(file.getBytes() + header->vertexDataOffset),
+		header->vertexCount);
+}
+
+std::span<const uint32_t> MeshFile::getIndices() const
+{
+	return std::span<const uint32_t>(reinterpret_cast<const uint32_t*>(file.getBytes() + header->indexDataOffset),
+		header->indexCount);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+// Binary mesh layout: header, LOD table, vertex stream, index stream.
+// Every section starts on MESH_FILE_ALIGNMENT so it can be copied into staging memory straight from the mapping.
+constexpr uint32_t MESH_FILE_MAGIC = 0x4853454D; // "MESH"
+constexpr uint32_t MESH_FILE_VERSION = 1;
+constexpr uint64_t MESH_FILE_ALIGNMENT = 16;
+
+// Interleaved vertex stream, must match the Vertex layout the pipeline consumes
+struct MeshFileVertex
+{
+	float position[3];
+	float colour[3];
+};
+
+struct MeshFileLod
+{
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	// Object space error introduced by simplification, zero for the source mesh
+	float error = 0.0f;
+	uint32_t padding = 0;
+};
+
+struct MeshFileHeader
+{
+	uint32_t magic = MESH_FILE_MAGIC;
+	uint32_t version = MESH_FILE_VERSION;
+	uint32_t vertexCount = 0;
+	uint32_t vertexStride = sizeof(MeshFileVertex);
+	uint32_t indexCount = 0;
+	uint32_t lodCount = 0;
+	float boundsMin[3] = {};
+	float boundsMax[3] = {};
+	uint64_t lodTableOffset = 0;
+	uint64_t vertexDataOffset = 0;
+	uint64_t vertexDataSize = 0;
+	uint64_t indexDataOffset = 0;
+	uint64_t indexDataSize = 0;
+};
+
+static_assert(sizeof(MeshFileVertex) == 24, "Mesh file vertex layout changed, bump MESH_FILE_VERSION");
+static_assert(sizeof(MeshFileLod) == 16, "Mesh file LOD layout changed, bump MESH_FILE_VERSION");
+static_assert(sizeof(MeshFileHeader) == 88, "Mesh file header layout changed, bump MESH_FILE_VERSION");
+
+// Source data for writing a mesh file, indices are 32 bit triangle lists
+struct MeshData
+{
+	std::vector<MeshFileVertex> vertices;
+	std::vector<uint32_t> indices;
+	// Empty means a single LOD covering every index
+	std::vector<MeshFileLod> lods;
+};
+
+void writeMeshFile(const std::string& fileName, const MeshData& meshData);
+
+// Validated view of a mapped mesh file, nothing is parsed or copied on load
+class MeshFile
+{
+public:
+	MeshFile();
+	explicit MeshFile(const std::string& fileName);
+
+	void open(const std::string& fileName);
+
+	const MeshFileHeader& getHeader() const;
+	std::span<const MeshFileLod> getLods() const;
+	std::span<const MeshFileVertex> getVertices() const;
+	std::span<const uint32_t> getIndices() const;
+private:
+	MappedFile file;
+	const MeshFileHeader* header = nullptr;
+};
@@ -0,0 +1,454 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+	// LODs are not worth a draw call below this many triangles
+	constexpr size_t MIN_LOD_TRIANGLES = 16;
+	// Each LOD must remove at least this fraction of the previous one
+	constexpr float MIN_LOD_REDUCTION = 0.2f;
+	// Border planes are weighted above surface planes so silhouettes hold their shape
+	constexpr double BORDER_WEIGHT = 10.0;
+
+	struct Vector3
+	{
+		double x = 0.0;
+		double y = 0.0;
+		double z = 0.0;
+	};
+
+	Vector3 subtract(const Vector3& a, const Vector3& b)
+	{
+		return { a.x - b.x, a.y - b.y, a.z - b.z };
+	}
+
+	Vector3 cross(const Vector3& a, const Vector3& b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	double dot(const Vector3& a, const Vector3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	double length(const Vector3& v)
+	{
+		return std::sqrt(dot(v, v));
+	}
+
+	// Symmetric 4x4 plane quadric plus the total weight, so the error can be normalised to a squared distance
+	struct Quadric
+	{
+		double a2 = 0, ab = 0, ac = 0, ad = 0;
+		double b2 = 0, bc = 0, bd = 0;
+		double c2 = 0, cd = 0;
+		double d2 = 0;
+		double weight = 0;
+
+		void addPlane(const Vector3& normal, double d, double planeWeight)
+		{
+			a2 += normal.x * normal.x * planeWeight;
+			ab += normal.x * normal.y * planeWeight;
+			ac += normal.x * normal.z * planeWeight;
+			ad += normal.x * d * planeWeight;
+			b2 += normal.y * normal.y * planeWeight;
+			bc += normal.y * normal.z * planeWeight;
+			bd += normal.y * d * planeWeight;
+			c2 += normal.z * normal.z * planeWeight;
+			cd += normal.z * d * planeWeight;
+			d2 += d * d * planeWeight;
+			weight += planeWeight;
+		}
+
+		void add(const Quadric& other)
+		{
+			a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+			b2 += other.b2; bc += other.bc; bd += other.bd;
+			c2 += other.c2; cd += other.cd;
+			d2 += other.d2;
+			weight += other.weight;
+		}
+
+		double evaluate(const Vector3& p) const
+		{
+			const double error = a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x +
+				b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y +
+				c2 * p.z * p.z + 2 * cd * p.z + d2;
+			return weight > 0 ? std::max(error, 0.0) / weight : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+
+	uint64_t getEdgeKey(uint32_t a, uint32_t b)
+	{
+		return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+	}
+
+	class Simplifier
+	{
+	public:
+		Simplifier(std::span<const MeshFileVertex> vertices, std::span<const uint32_t> indices)
+		{
+			positions.resize(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				positions[i] = { vertices[i].position[0], vertices[i].position[1], vertices[i].position[2] };
+			}
+			weldPositions(vertices);
+
+			triangles.reserve(indices.size());
+			for (uint32_t index : indices)
+			{
+				triangles.push_back(weld[index]);
+			}
+			removeDegenerateTriangles();
+
+			collapseTarget.resize(vertices.size());
+			for (uint32_t i = 0; i < collapseTarget.size(); i++)
+			{
+				collapseTarget[i] = i;
+			}
+			computeQuadrics();
+		}
+
+		std::vector<uint32_t> simplify(std::span<const uint32_t> indices, size_t targetIndexCount, float* resultError)
+		{
+			while (triangles.size() > targetIndexCount)
+			{
+				if (!collapsePass(targetIndexCount))
+				{
+					break;
+				}
+				removeDegenerateTriangles();
+			}
+
+			// Vertices that were never collapsed keep their own attributes, welded seams only matter once they move
+			std::vector<uint32_t> result;
+			result.reserve(triangles.size());
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				uint32_t corners[3];
+				for (int c = 0; c < 3; c++)
+				{
+					const uint32_t original = indices[i + c];
+					const uint32_t collapsed = resolve(weld[original]);
+					corners[c] = collapsed == weld[original] ? original : collapsed;
+				}
+				if (resolve(weld[corners[0]]) != resolve(weld[corners[1]]) &&
+					resolve(weld[corners[1]]) != resolve(weld[corners[2]]) &&
+					resolve(weld[corners[0]]) != resolve(weld[corners[2]]))
+				{
+					result.insert(result.end(), corners, corners + 3);
+				}
+			}
+
+			*resultError = static_cast<float>(std::sqrt(maxError));
+			return result;
+		}
+	private:
+		std::vector<Vector3> positions;
+		std::vector<uint32_t> weld;
+		std::vector<uint32_t> collapseTarget;
+		std::vector<Quadric> quadrics;
+		std::vector<uint32_t> triangles;
+		double maxError = 0.0;
+
+		void weldPositions(std::span<const MeshFileVertex> vertices)
+		{
+			struct PositionHash
+			{
+				size_t operator()(const std::array<float, 3>& p) const
+				{
+					uint32_t bits[3];
+					memcpy(bits, p.data(), sizeof(bits));
+					return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+				}
+			};
+			std::unordered_map<std::array<float, 3>, uint32_t, PositionHash> firstVertex;
+			weld.resize(vertices.size());
+			for (uint32_t i = 0; i < vertices.size(); i++)
+			{
+				const std::array<float, 3> position = { vertices[i].position[0], vertices[i].position[1], vertices[i].position[2] };
+				weld[i] = firstVertex.emplace(position, i).first->second;
+			}
+		}
+
+		uint32_t resolve(uint32_t vertex) const
+		{
+			while (collapseTarget[vertex] != vertex)
+			{
+				vertex = collapseTarget[vertex];
+			}
+			return vertex;
+		}
+
+		void removeDegenerateTriangles()
+		{
+			size_t write = 0;
+			for (size_t i = 0; i < triangles.size(); i += 3)
+			{
+				const uint32_t a = triangles[i];
+				const uint32_t b = triangles[i + 1];
+				const uint32_t c = triangles[i + 2];
+				if (a != b && b != c && a != c)
+				{
+					triangles[write++] = a;
+					triangles[write++] = b;
+					triangles[write++] = c;
+				}
+			}
+			triangles.resize(write);
+		}
+
+		Vector3 getNormal(uint32_t a, uint32_t b, uint32_t c) const
+		{
+			return cross(subtract(positions[b], positions[a]), subtract(positions[c], positions[a]));
+		}
+
+		std::unordered_map<uint64_t, uint32_t> countEdges() const
+		{
+			std::unordered_map<uint64_t, uint32_t> edgeCounts;
+			edgeCounts.reserve(triangles.size());
+			for (size_t i = 0; i < triangles.size(); i += 3)
+			{
+				for (int e = 0; e < 3; e++)
+				{
+					edgeCounts[getEdgeKey(triangles[i + e], triangles[i + (e + 1) % 3])]++;
+				}
+			}
+			return edgeCounts;
+		}
+
+		void computeQuadrics()
+		{
+			quadrics.assign(positions.size(), Quadric());
+			const std::unordered_map<uint64_t, uint32_t> edgeCounts = countEdges();
+
+			for (size_t i = 0; i < triangles.size(); i += 3)
+			{
+				const Vector3 normal = getNormal(triangles[i], triangles[i + 1], triangles[i + 2]);
+				const double area = length(normal);
+				if (area == 0.0)
+				{
+					continue;
+				}
+				const Vector3 unitNormal = { normal.x / area, normal.y / area, normal.z / area };
+				const double d = -dot(unitNormal, positions[triangles[i]]);
+				for (int c = 0; c < 3; c++)
+				{
+					quadrics[triangles[i + c]].addPlane(unitNormal, d, area * 0.5);
+				}
+
+				// A plane through each border edge, perpendicular to the face, pins the border in place
+				for (int e = 0; e < 3; e++)
+				{
+					const uint32_t a = triangles[i + e];
+					const uint32_t b = triangles[i + (e + 1) % 3];
+					if (edgeCounts.at(getEdgeKey(a, b)) != 1)
+					{
+						continue;
+					}
+					const Vector3 edge = subtract(positions[b], positions[a]);
+					const double edgeLength = length(edge);
+					Vector3 borderNormal = cross(edge, unitNormal);
+					const double borderLength = length(borderNormal);
+					if (edgeLength == 0.0 || borderLength == 0.0)
+					{
+						continue;
+					}
+					borderNormal = { borderNormal.x / borderLength, borderNormal.y / borderLength, borderNormal.z / borderLength };
+					const double borderD = -dot(borderNormal, positions[a]);
+					quadrics[a].addPlane(borderNormal, borderD, edgeLength * edgeLength * BORDER_WEIGHT);
+					quadrics[b].addPlane(borderNormal, borderD, edgeLength * edgeLength * BORDER_WEIGHT);
+				}
+			}
+		}
+
+		// Rejects collapses that would flip or fold a triangle around the removed vertex
+		bool isCollapseValid(uint32_t from, uint32_t to, const std::vector<uint32_t>& adjacencyOffsets,
+			const std::vector<uint32_t>& adjacency) const
+		{
+			for (uint32_t t = adjacencyOffsets[from]; t < adjacencyOffsets[from + 1]; t++)
+			{
+				const uint32_t* triangle = &triangles[adjacency[t] * 3];
+				if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+				{
+					continue;
+				}
+
+				uint32_t moved[3] = { triangle[0], triangle[1], triangle[2] };
+				for (auto& corner : moved)
+				{
+					if (corner == from)
+					{
+						corner = to;
+					}
+				}
+				const Vector3 before = getNormal(triangle[0], triangle[1], triangle[2]);
+				const Vector3 after = getNormal(moved[0], moved[1], moved[2]);
+				if (dot(before, after) <= 0.25 * length(before) * length(after))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool collapsePass(size_t targetIndexCount)
+		{
+			const std::unordered_map<uint64_t, uint32_t> edgeCounts = countEdges();
+			const uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+
+			// Vertex to triangle adjacency, rebuilt every pass
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+			for (uint32_t index : triangles)
+			{
+				adjacencyOffsets[index + 1]++;
+			}
+			for (uint32_t v = 0; v < vertexCount; v++)
+			{
+				adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+			}
+			std::vector<uint32_t> adjacency(triangles.size());
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < triangles.size(); i++)
+			{
+				adjacency[fill[triangles[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			std::vector<bool> border(vertexCount, false);
+			for (const auto& [key, count] : edgeCounts)
+			{
+				if (count == 1)
+				{
+					border[key >> 32] = true;
+					border[key & 0xFFFFFFFF] = true;
+				}
+			}
+
+			// Each edge is considered once, in whichever direction is cheaper
+			std::vector<Collapse> collapses;
+			collapses.reserve(edgeCounts.size());
+			for (const auto& [key, count] : edgeCounts)
+			{
+				const uint32_t a = static_cast<uint32_t>(key >> 32);
+				const uint32_t b = static_cast<uint32_t>(key & 0xFFFFFFFF);
+				Quadric combined = quadrics[a];
+				combined.add(quadrics[b]);
+
+				// Border vertices may only slide along the border, never inwards
+				const bool borderEdge = count == 1;
+				const bool canCollapseA = !border[a] || borderEdge;
+				const bool canCollapseB = !border[b] || borderEdge;
+				const double costAToB = canCollapseA ? combined.evaluate(positions[b]) : -1.0;
+				const double costBToA = canCollapseB ? combined.evaluate(positions[a]) : -1.0;
+				if (costAToB >= 0.0 && (costBToA < 0.0 || costAToB <= costBToA))
+				{
+					collapses.push_back({ a, b, costAToB });
+				}
+				else if (costBToA >= 0.0)
+				{
+					collapses.push_back({ b, a, costBToA });
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs)
+			{
+				return lhs.cost < rhs.cost;
+			});
+
+			// Greedily apply the cheapest collapses, one per neighbourhood so the validity checks stay accurate
+			std::vector<bool> locked(vertexCount, false);
+			size_t remainingIndices = triangles.size();
+			bool collapsed = false;
+			for (const Collapse& collapse : collapses)
+			{
+				if (remainingIndices <= targetIndexCount)
+				{
+					break;
+				}
+				if (locked[collapse.from] || locked[collapse.to] ||
+					!isCollapseValid(collapse.from, collapse.to, adjacencyOffsets, adjacency))
+				{
+					continue;
+				}
+
+				for (uint32_t t = adjacencyOffsets[collapse.from]; t < adjacencyOffsets[collapse.from + 1]; t++)
+				{
+					uint32_t* triangle = &triangles[adjacency[t] * 3];
+					bool removed = false;
+					for (int c = 0; c < 3; c++)
+					{
+						locked[triangle[c]] = true;
+						removed |= triangle[c] == collapse.to;
+					}
+					if (removed)
+					{
+						remainingIndices -= 3;
+					}
+					for (int c = 0; c < 3; c++)
+					{
+						if (triangle[c] == collapse.from)
+						{
+							triangle[c] = collapse.to;
+						}
+					}
+				}
+
+				collapseTarget[collapse.from] = collapse.to;
+				quadrics[collapse.to].add(quadrics[collapse.from]);
+				maxError = std::max(maxError, collapse.cost);
+				collapsed = true;
+			}
+			return collapsed;
+		}
+	};
+}
+
+std::vector<uint32_t> simplifyMesh(std::span<const MeshFileVertex> vertices, std::span<const uint32_t> indices,
+	size_t targetIndexCount, float* resultError)
+{
+	Simplifier simplifier(vertices, indices);
+	return simplifier.simplify(indices, targetIndexCount - targetIndexCount % 3, resultError);
+}
+
+void generateLods(MeshData& meshData)
+{
+	const std::vector<uint32_t> baseIndices = meshData.indices;
+	meshData.lods.clear();
+	meshData.lods.push_back({ 0, static_cast<uint32_t>(baseIndices.size()), 0.0f, 0 });
+
+	size_t previousIndexCount = baseIndices.size();
+	float previousError = 0.0f;
+	while (meshData.lods.size() < MESH_MAX_LODS && previousIndexCount / 3 / 2 >= MIN_LOD_TRIANGLES)
+	{
+		// Always simplify the source mesh so errors do not compound through the chain
+		float error = 0.0f;
+		std::vector<uint32_t> lodIndices = simplifyMesh(meshData.vertices, baseIndices, previousIndexCount / 2, &error);
+		if (lodIndices.empty() || lodIndices.size() > previousIndexCount * (1.0f - MIN_LOD_REDUCTION))
+		{
+			break;
+		}
+
+		MeshFileLod lod = {};
+		lod.firstIndex = static_cast<uint32_t>(meshData.indices.size());
+		lod.indexCount = static_cast<uint32_t>(lodIndices.size());
+		lod.error = std::max(error, previousError);
+		meshData.lods.push_back(lod);
+		meshData.indices.insert(meshData.indices.end(), lodIndices.begin(), lodIndices.end());
+
+		previousIndexCount = lodIndices.size();
+		previousError = lod.error;
+	}
+}
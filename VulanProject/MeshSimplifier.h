@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "MeshFile.h"
+
+// Longest LOD chain generated, including the source mesh
+constexpr uint32_t MESH_MAX_LODS = 6;
+
+// Quadric error edge collapse. Vertices only ever collapse onto a neighbour, so the result indexes the
+// original vertex buffer and every LOD can share it. Borders are kept in place, colour seams are welded
+// by position. Returns at most targetIndexCount indices unless the mesh cannot be reduced further, and
+// writes the largest object space distance any collapse moved the surface.
+std::vector<uint32_t> simplifyMesh(std::span<const MeshFileVertex> vertices, std::span<const uint32_t> indices,
+	size_t targetIndexCount, float* resultError);
+
+// Appends a chain of progressively halved LODs to the index buffer and fills in the LOD table,
+// stopping once simplification no longer removes a worthwhile number of triangles
+void generateLods(MeshData& meshData);
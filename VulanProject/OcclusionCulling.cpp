@@ -0,0 +1,515 @@
+#include "OcclusionCulling.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+
+#include "Log.h"
+#include "MappedFile.h"
+#include "Utilities.h"
+
+namespace
+{
+	// Match the local sizes in depth_pyramid.comp and occlusion_cull.comp
+	const uint32_t PYRAMID_GROUP_SIZE = 8;
+	const uint32_t CULL_GROUP_SIZE = 64;
+	const VkFormat PYRAMID_FORMAT = VK_FORMAT_R32_SFLOAT;
+
+	// Matches the CullingObject struct in occlusion_cull.comp
+	struct GpuCullingObject
+	{
+		glm::vec4 sphere;
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		uint32_t padding[2];
+	};
+
+	struct CullPushConstant
+	{
+		uint32_t objectCount;
+		uint32_t levelCount;
+		glm::vec2 pyramidSize;
+	};
+
+	struct PyramidPushConstant
+	{
+		glm::ivec2 sourceSize;
+		glm::ivec2 destinationSize;
+	};
+
+	// Rounded down so every level halves exactly, a texel of the first level covers up to two of depth across
+	uint32_t getPreviousPowerOfTwo(uint32_t value)
+	{
+		uint32_t result = 1;
+		while (result * 2 <= value)
+		{
+			result *= 2;
+		}
+		return result;
+	}
+
+	uint32_t getLevelCount(VkExtent2D extent)
+	{
+		uint32_t levelCount = 1;
+		while ((std::max(extent.width, extent.height) >> levelCount) > 0)
+		{
+			levelCount++;
+		}
+		return levelCount;
+	}
+
+	VkExtent2D getLevelExtent(VkExtent2D extent, uint32_t level)
+	{
+		return { std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u) };
+	}
+
+	VkDescriptorSetLayout createSetLayout(VkDevice device, std::span<const VkDescriptorType> types)
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings(types.size());
+		for (uint32_t i = 0; i < bindings.size(); i++)
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = types[i];
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+		layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutCreateInfo.pBindings = bindings.data();
+		VkDescriptorSetLayout setLayout;
+		VkResult result = vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &setLayout);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create an occlusion culling descriptor set layout");
+		}
+		return setLayout;
+	}
+
+	VkPipelineLayout createPipelineLayout(VkDevice device, std::span<const VkDescriptorSetLayout> setLayouts,
+		uint32_t pushConstantSize)
+	{
+		VkPushConstantRange pushConstantRange = {};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = pushConstantSize;
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+		pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutCreateInfo.pSetLayouts = setLayouts.data();
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VkPipelineLayout pipelineLayout;
+		VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create an occlusion culling pipeline layout");
+		}
+		return pipelineLayout;
+	}
+}
+
+OcclusionCulling::OcclusionCulling()
+{
+}
+
+void OcclusionCulling::init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* newMemoryBudget,
+	QueueTimeline* newTimeline, DescriptorAllocator* newDescriptorAllocator, uint32_t newFrameCount)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+	memoryBudget = newMemoryBudget;
+	timeline = newTimeline;
+	descriptorAllocator = newDescriptorAllocator;
+
+	// Only read with texelFetch, the sampler just completes the combined image sampler descriptors
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+	VkResult result = vkCreateSampler(device, &samplerCreateInfo, nullptr, &sampler);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the depth pyramid sampler");
+	}
+
+	// Source level and the level written for the pyramid, objects, visibility and commands for culling with the
+	// pyramid in a set of its own that the early phase does not bind
+	const std::array<VkDescriptorType, 2> pyramidTypes = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		VK_DESCRIPTOR_TYPE_STORAGE_IMAGE };
+	const std::array<VkDescriptorType, 3> cullTypes = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
+	const std::array<VkDescriptorType, 1> pyramidReadTypes = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER };
+	pyramidSetLayout = createSetLayout(device, pyramidTypes);
+	cullSetLayout = createSetLayout(device, cullTypes);
+	pyramidReadSetLayout = createSetLayout(device, pyramidReadTypes);
+
+	pyramidPipelineLayout = createPipelineLayout(device, std::span<const VkDescriptorSetLayout>(&pyramidSetLayout, 1),
+		sizeof(PyramidPushConstant));
+	const std::array<VkDescriptorSetLayout, 2> cullSetLayouts = { cullSetLayout, pyramidReadSetLayout };
+	cullPipelineLayout = createPipelineLayout(device, cullSetLayouts, sizeof(CullPushConstant));
+
+	// Culling is optional, without its shaders every mesh is drawn
+	try
+	{
+		pyramidPipeline = createComputePipeline("Shaders/depth_pyramid_comp.spv", pyramidPipelineLayout);
+		earlyCullPipeline = createComputePipeline("Shaders/occlusion_cull_comp.spv", cullPipelineLayout);
+		lateCullPipeline = createComputePipeline("Shaders/occlusion_cull_late_comp.spv", cullPipelineLayout);
+	}
+	catch (const std::runtime_error& e)
+	{
+		VULKAN_CORE_WARN("Occlusion culling unavailable: {}", e.what());
+	}
+
+	setFrameCount(newFrameCount);
+	VULKAN_CORE_INFO("Occlusion culling: {}", isAvailable() ? "available" : "unavailable");
+}
+
+bool OcclusionCulling::isAvailable() const
+{
+	return pyramidPipeline != VK_NULL_HANDLE && earlyCullPipeline != VK_NULL_HANDLE &&
+		lateCullPipeline != VK_NULL_HANDLE;
+}
+
+void OcclusionCulling::setFrameCount(uint32_t newFrameCount)
+{
+	for (HostBuffer& frameBuffer : frameBuffers)
+	{
+		destroyHostBuffer(device, frameBuffer, memoryBudget);
+	}
+	// Buffers are created on each slot's first update, once the object count is known
+	frameBuffers.assign(newFrameCount, HostBuffer());
+	frameObjectCounts.assign(newFrameCount, 0);
+}
+
+void OcclusionCulling::update(uint32_t frameIndex, const std::vector<CullingObject>& objects, VkExtent2D newDepthExtent)
+{
+	destroyRetiredObjects(false);
+
+	HostBuffer& frameBuffer = frameBuffers[frameIndex];
+	const VkDeviceSize objectSize = std::max<size_t>(objects.size(), 1) * sizeof(GpuCullingObject);
+	if (frameBuffer.size < objectSize)
+	{
+		// The slot's previous frame has finished, nothing else uses its buffer
+		destroyHostBuffer(device, frameBuffer, memoryBudget);
+		frameBuffer = createHostBuffer(physicalDevice, device, objectSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			memoryBudget);
+	}
+	GpuCullingObject* gpuObjects = static_cast<GpuCullingObject*>(frameBuffer.mapped);
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		gpuObjects[i] = { glm::vec4(objects[i].centre, objects[i].radius), objects[i].indexCount,
+			objects[i].firstIndex, { 0, 0 } };
+	}
+	frameObjectCounts[frameIndex] = static_cast<uint32_t>(objects.size());
+
+	// Both are shared by every frame in flight, so the old ones wait for the frames already submitted
+	const VkDeviceSize visibilitySize = std::max<size_t>(objects.size(), 1) * sizeof(uint32_t);
+	const VkExtent2D pyramidExtent = { getPreviousPowerOfTwo(std::max(newDepthExtent.width, 1u)),
+		getPreviousPowerOfTwo(std::max(newDepthExtent.height, 1u)) };
+	const bool visibilityGrown = visibility.size < visibilitySize;
+	const bool pyramidResized = pyramid.extent.width != pyramidExtent.width ||
+		pyramid.extent.height != pyramidExtent.height;
+	if (visibilityGrown || pyramidResized)
+	{
+		RetiredObjects retired;
+		retired.timelineValue = timeline->getLastSubmittedValue();
+		if (visibilityGrown)
+		{
+			// Starts with every object hidden, the late phase tests them all and draws the visible ones
+			retired.visibility = visibility;
+			visibility = createHostBuffer(physicalDevice, device, visibilitySize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				memoryBudget);
+			std::memset(visibility.mapped, 0, static_cast<size_t>(visibilitySize));
+		}
+		if (pyramidResized)
+		{
+			retired.pyramid = pyramid;
+			pyramid = createPyramid(pyramidExtent);
+		}
+		retiredObjects.push_back(std::move(retired));
+	}
+	depthExtent = newDepthExtent;
+}
+
+OcclusionCullingResources OcclusionCulling::addEarlyCullPass(RenderGraph& graph, uint32_t frameIndex)
+{
+	const uint32_t objectCount = frameObjectCounts[frameIndex];
+	const VkDeviceSize commandSize = std::max(objectCount, 1u) * sizeof(VkDrawIndexedIndirectCommand);
+
+	OcclusionCullingResources resources;
+	resources.objects = graph.importBuffer("CullingObjects", frameBuffers[frameIndex].buffer,
+		frameBuffers[frameIndex].size);
+	resources.visibility = graph.importBuffer("Visibility", visibility.buffer, visibility.size);
+	resources.earlyCommands = graph.createBuffer("EarlyDrawCommands", commandSize);
+
+	graph.addPass("EarlyCull", RenderGraphPassType::Compute)
+		.readStorageBuffer(resources.objects)
+		.readStorageBuffer(resources.visibility)
+		.writeStorageBuffer(resources.earlyCommands)
+		.setExecute([this, resources, objectCount](const RenderGraphPassContext& context)
+		{
+			const VkDescriptorSet cullSet = createCullDescriptorSet(context.graph->getBuffer(resources.objects),
+				context.graph->getBuffer(resources.visibility), context.graph->getBuffer(resources.earlyCommands));
+			recordCull(context.commandBuffer, earlyCullPipeline, cullSet, VK_NULL_HANDLE, objectCount);
+		});
+	return resources;
+}
+
+void OcclusionCulling::addLateCullPasses(RenderGraph& graph, uint32_t frameIndex, RenderGraphResource depth,
+	OcclusionCullingResources& resources)
+{
+	const uint32_t objectCount = frameObjectCounts[frameIndex];
+	const VkDeviceSize commandSize = std::max(objectCount, 1u) * sizeof(VkDrawIndexedIndirectCommand);
+
+	// Rebuilt from nothing every frame, only the previous frame's late cull has to be done reading it
+	RenderGraphImportedImage pyramidImage = {};
+	pyramidImage.image = pyramid.image;
+	pyramidImage.imageView = pyramid.imageView;
+	pyramidImage.desc.format = PYRAMID_FORMAT;
+	pyramidImage.desc.extent = pyramid.extent;
+	pyramidImage.initialStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	resources.pyramid = graph.importImage("DepthPyramid", pyramidImage);
+	resources.lateCommands = graph.createBuffer("LateDrawCommands", commandSize);
+
+	graph.addPass("DepthPyramid", RenderGraphPassType::Compute)
+		.readTexture(depth)
+		.writeStorageImage(resources.pyramid)
+		.setExecute([this, depth](const RenderGraphPassContext& context)
+		{
+			recordPyramid(context.commandBuffer, context.graph->getImageView(depth));
+		});
+
+	// The pyramid is sampled in general layout, declared as a storage read so it stays in the layout it was built in
+	graph.addPass("LateCull", RenderGraphPassType::Compute)
+		.readStorageBuffer(resources.objects)
+		.readStorageBuffer(resources.visibility)
+		.writeStorageBuffer(resources.visibility)
+		.readStorageImage(resources.pyramid)
+		.writeStorageBuffer(resources.lateCommands)
+		.setExecute([this, resources, objectCount](const RenderGraphPassContext& context)
+		{
+			const VkDescriptorSet cullSet = createCullDescriptorSet(context.graph->getBuffer(resources.objects),
+				context.graph->getBuffer(resources.visibility), context.graph->getBuffer(resources.lateCommands));
+			const VkDescriptorSet pyramidSet = createImageDescriptorSet(pyramidReadSetLayout, pyramid.imageView,
+				VK_IMAGE_LAYOUT_GENERAL, VK_NULL_HANDLE);
+			recordCull(context.commandBuffer, lateCullPipeline, cullSet, pyramidSet, objectCount);
+		});
+}
+
+void OcclusionCulling::cleanup()
+{
+	destroyRetiredObjects(true);
+	for (HostBuffer& frameBuffer : frameBuffers)
+	{
+		destroyHostBuffer(device, frameBuffer, memoryBudget);
+	}
+	frameBuffers.clear();
+	frameObjectCounts.clear();
+	destroyHostBuffer(device, visibility, memoryBudget);
+	destroyPyramid(pyramid);
+
+	vkDestroyPipeline(device, lateCullPipeline, nullptr);
+	vkDestroyPipeline(device, earlyCullPipeline, nullptr);
+	vkDestroyPipeline(device, pyramidPipeline, nullptr);
+	vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(device, pyramidPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, pyramidReadSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, cullSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, pyramidSetLayout, nullptr);
+	vkDestroySampler(device, sampler, nullptr);
+	lateCullPipeline = VK_NULL_HANDLE;
+	earlyCullPipeline = VK_NULL_HANDLE;
+	pyramidPipeline = VK_NULL_HANDLE;
+	cullPipelineLayout = VK_NULL_HANDLE;
+	pyramidPipelineLayout = VK_NULL_HANDLE;
+	pyramidReadSetLayout = VK_NULL_HANDLE;
+	cullSetLayout = VK_NULL_HANDLE;
+	pyramidSetLayout = VK_NULL_HANDLE;
+	sampler = VK_NULL_HANDLE;
+}
+
+VkPipeline OcclusionCulling::createComputePipeline(const char* fileName, VkPipelineLayout layout)
+{
+	MappedFile shaderCode(fileName);
+	VkShaderModule shaderModule = createShaderModule(device, shaderCode.getData());
+
+	VkComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineCreateInfo.stage.module = shaderModule;
+	pipelineCreateInfo.stage.pName = "main";
+	pipelineCreateInfo.layout = layout;
+	VkPipeline pipeline;
+	VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline);
+	vkDestroyShaderModule(device, shaderModule, nullptr);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create an occlusion culling pipeline");
+	}
+	return pipeline;
+}
+
+void OcclusionCulling::recordCull(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkDescriptorSet cullSet,
+	VkDescriptorSet pyramidSet, uint32_t objectCount)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	const std::array<VkDescriptorSet, 2> descriptorSets = { cullSet, pyramidSet };
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0,
+		pyramidSet != VK_NULL_HANDLE ? 2 : 1, descriptorSets.data(), 0, nullptr);
+
+	const CullPushConstant pushConstant = { objectCount, static_cast<uint32_t>(pyramid.levelViews.size()),
+		glm::vec2(pyramid.extent.width, pyramid.extent.height) };
+	vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstant),
+		&pushConstant);
+	vkCmdDispatch(commandBuffer, (objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+}
+
+void OcclusionCulling::recordPyramid(VkCommandBuffer commandBuffer, VkImageView depthView)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipeline);
+
+	// The graph moved the depth into shader read only layout and every level into general layout, only the
+	// dependencies between levels are recorded here
+	VkExtent2D sourceExtent = depthExtent;
+	for (uint32_t level = 0; level < pyramid.levelViews.size(); level++)
+	{
+		const VkDescriptorSet descriptorSet = level == 0 ?
+			createImageDescriptorSet(pyramidSetLayout, depthView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				pyramid.levelViews[level]) :
+			createImageDescriptorSet(pyramidSetLayout, pyramid.levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL,
+				pyramid.levelViews[level]);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipelineLayout, 0, 1,
+			&descriptorSet, 0, nullptr);
+
+		const VkExtent2D levelExtent = getLevelExtent(pyramid.extent, level);
+		const PyramidPushConstant pushConstant = { glm::ivec2(sourceExtent.width, sourceExtent.height),
+			glm::ivec2(levelExtent.width, levelExtent.height) };
+		vkCmdPushConstants(commandBuffer, pyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstant),
+			&pushConstant);
+		vkCmdDispatch(commandBuffer, (levelExtent.width + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+			(levelExtent.height + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+
+		if (level + 1 < pyramid.levelViews.size())
+		{
+			VkMemoryBarrier memoryBarrier = {};
+			memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+		sourceExtent = levelExtent;
+	}
+}
+
+VkDescriptorSet OcclusionCulling::createCullDescriptorSet(VkBuffer objectBuffer, VkBuffer visibilityBuffer,
+	VkBuffer commandBuffer)
+{
+	// Transient, the command buffers are the graph's and can change between frames
+	VkDescriptorSet descriptorSet = descriptorAllocator->allocate(cullSetLayout);
+
+	const VkBuffer buffers[3] = { objectBuffer, visibilityBuffer, commandBuffer };
+	std::array<VkDescriptorBufferInfo, 3> bufferInfos = {};
+	std::array<VkWriteDescriptorSet, 3> writes = {};
+	for (uint32_t i = 0; i < writes.size(); i++)
+	{
+		bufferInfos[i].buffer = buffers[i];
+		bufferInfos[i].offset = 0;
+		bufferInfos[i].range = VK_WHOLE_SIZE;
+
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = descriptorSet;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	return descriptorSet;
+}
+
+VkDescriptorSet OcclusionCulling::createImageDescriptorSet(VkDescriptorSetLayout layout, VkImageView sampledView,
+	VkImageLayout sampledLayout, VkImageView storageView)
+{
+	VkDescriptorSet descriptorSet = descriptorAllocator->allocate(layout);
+
+	// The sampled image at binding 0, followed by the storage image when there is one
+	std::array<VkDescriptorImageInfo, 2> imageInfos = {};
+	imageInfos[0].sampler = sampler;
+	imageInfos[0].imageView = sampledView;
+	imageInfos[0].imageLayout = sampledLayout;
+	imageInfos[1].imageView = storageView;
+	imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	std::array<VkWriteDescriptorSet, 2> writes = {};
+	for (uint32_t i = 0; i < writes.size(); i++)
+	{
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = descriptorSet;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		writes[i].pImageInfo = &imageInfos[i];
+	}
+	vkUpdateDescriptorSets(device, storageView != VK_NULL_HANDLE ? 2 : 1, writes.data(), 0, nullptr);
+	return descriptorSet;
+}
+
+OcclusionCulling::Pyramid OcclusionCulling::createPyramid(VkExtent2D extent)
+{
+	Pyramid newPyramid;
+	newPyramid.extent = extent;
+	const uint32_t levelCount = getLevelCount(extent);
+	createImage(physicalDevice, device, extent.width, extent.height, levelCount, PYRAMID_FORMAT,
+		VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &newPyramid.image, &newPyramid.memory, memoryBudget,
+		MemoryCategory::RenderTargets);
+
+	// The culling pass samples every level, building it writes one at a time
+	newPyramid.imageView = createImageView(device, newPyramid.image, PYRAMID_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT,
+		levelCount);
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		newPyramid.levelViews.push_back(createImageView(device, newPyramid.image, PYRAMID_FORMAT,
+			VK_IMAGE_ASPECT_COLOR_BIT, 1, level));
+	}
+	return newPyramid;
+}
+
+void OcclusionCulling::destroyPyramid(Pyramid& oldPyramid)
+{
+	for (VkImageView levelView : oldPyramid.levelViews)
+	{
+		vkDestroyImageView(device, levelView, nullptr);
+	}
+	vkDestroyImageView(device, oldPyramid.imageView, nullptr);
+	vkDestroyImage(device, oldPyramid.image, nullptr);
+	freeMemory(device, oldPyramid.memory, memoryBudget);
+	oldPyramid = Pyramid();
+}
+
+void OcclusionCulling::destroyRetiredObjects(bool destroyAll)
+{
+	while (!retiredObjects.empty())
+	{
+		RetiredObjects& retired = retiredObjects.front();
+		if (!destroyAll && !timeline->isComplete(retired.timelineValue))
+		{
+			break;
+		}
+		destroyHostBuffer(device, retired.visibility, memoryBudget);
+		destroyPyramid(retired.pyramid);
+		retiredObjects.pop_front();
+	}
+}
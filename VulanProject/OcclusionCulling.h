@@ -0,0 +1,115 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <deque>
+#include <vector>
+
+#include "DescriptorAllocator.h"
+#include "MemoryBudget.h"
+#include "QueueTimeline.h"
+#include "RenderGraph.h"
+#include "Utilities.h"
+
+// Bounding sphere and index range of one draw, in the clip space the meshes are drawn in
+struct CullingObject
+{
+	glm::vec3 centre = glm::vec3(0.0f);
+	float radius = 0.0f;
+	uint32_t indexCount = 0;
+	uint32_t firstIndex = 0;
+};
+
+// Graph resources of one frame's culling. The command buffers hold a VkDrawIndexedIndirectCommand per object,
+// in the order the objects were given.
+struct OcclusionCullingResources
+{
+	RenderGraphResource objects = 0;
+	RenderGraphResource visibility = 0;
+	RenderGraphResource pyramid = 0;
+	RenderGraphResource earlyCommands = 0;
+	RenderGraphResource lateCommands = 0;
+};
+
+// Two phase occlusion culling against a hierarchical depth pyramid. The early phase draws the objects that were
+// visible last frame, the pyramid is built from the depth they leave, and the late phase tests every object against
+// it and draws the ones the early phase missed. Culled objects get an instance count of zero, so their draws never
+// reach the vertex stage. Which objects were visible carries over between frames in a buffer indexed like the objects.
+class OcclusionCulling
+{
+public:
+	OcclusionCulling();
+	void init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* newMemoryBudget,
+		QueueTimeline* newTimeline, DescriptorAllocator* newDescriptorAllocator, uint32_t newFrameCount);
+	// False when the culling shaders could not be loaded
+	bool isAvailable() const;
+	// Every frame's buffers must no longer be in use
+	void setFrameCount(uint32_t newFrameCount);
+
+	// Writes the objects of the frame slot, its previous submission has to have finished. The pyramid follows the
+	// depth buffer's extent, replaced objects are destroyed once the frames using them have finished.
+	void update(uint32_t frameIndex, const std::vector<CullingObject>& objects, VkExtent2D depthExtent);
+	// Declares the early cull, the first draw reads the early commands
+	OcclusionCullingResources addEarlyCullPass(RenderGraph& graph, uint32_t frameIndex);
+	// Builds the pyramid from the depth the first draw left and declares the late cull, the second draw reads the
+	// late commands. The depth has to be single sampled with a depth only format.
+	void addLateCullPasses(RenderGraph& graph, uint32_t frameIndex, RenderGraphResource depth,
+		OcclusionCullingResources& resources);
+
+	void cleanup();
+private:
+	// Farthest depth over each texel, every level half the size of the one before
+	struct Pyramid
+	{
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView imageView = VK_NULL_HANDLE;
+		std::vector<VkImageView> levelViews;
+		VkExtent2D extent = {};
+	};
+
+	// Replaced while earlier frames could still be using them
+	struct RetiredObjects
+	{
+		uint64_t timelineValue = 0;
+		HostBuffer visibility;
+		Pyramid pyramid;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryBudget* memoryBudget = nullptr;
+	QueueTimeline* timeline = nullptr;
+	DescriptorAllocator* descriptorAllocator = nullptr;
+
+	VkSampler sampler = VK_NULL_HANDLE;
+	VkDescriptorSetLayout pyramidSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pyramidPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pyramidPipeline = VK_NULL_HANDLE;
+	VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout pyramidReadSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline earlyCullPipeline = VK_NULL_HANDLE;
+	VkPipeline lateCullPipeline = VK_NULL_HANDLE;
+
+	// Objects of each frame in flight, with how many were last written
+	std::vector<HostBuffer> frameBuffers;
+	std::vector<uint32_t> frameObjectCounts;
+	HostBuffer visibility;
+	Pyramid pyramid;
+	VkExtent2D depthExtent = {};
+	std::deque<RetiredObjects> retiredObjects;
+
+	VkPipeline createComputePipeline(const char* fileName, VkPipelineLayout layout);
+	void recordCull(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkDescriptorSet cullSet,
+		VkDescriptorSet pyramidSet, uint32_t objectCount);
+	void recordPyramid(VkCommandBuffer commandBuffer, VkImageView depthView);
+	VkDescriptorSet createCullDescriptorSet(VkBuffer objectBuffer, VkBuffer visibilityBuffer, VkBuffer commandBuffer);
+	VkDescriptorSet createImageDescriptorSet(VkDescriptorSetLayout layout, VkImageView sampledView,
+		VkImageLayout sampledLayout, VkImageView storageView);
+	Pyramid createPyramid(VkExtent2D extent);
+	void destroyPyramid(Pyramid& oldPyramid);
+	void destroyRetiredObjects(bool destroyAll);
+};
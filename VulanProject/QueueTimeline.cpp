@@ -0,0 +1,289 @@
+#include "QueueTimeline.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+	// Semaphores a single submit can wait on or signal, binary and timeline together
+	const size_t MAX_SUBMIT_SEMAPHORES = 8;
+}
+
+QueueTimeline::QueueTimeline()
+{
+}
+
+void QueueTimeline::init(VkDevice newDevice, VkQueue newQueue, bool timelineSemaphoreSupported)
+{
+	device = newDevice;
+	queue = newQueue;
+	lastSubmittedValue = 0;
+	completedValue = 0;
+	if (!timelineSemaphoreSupported)
+	{
+		return;
+	}
+
+	// Core in 1.2, VK_KHR_timeline_semaphore before that
+	getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValue");
+	waitSemaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(device, "vkWaitSemaphores");
+	if (getSemaphoreCounterValue == nullptr || waitSemaphores == nullptr)
+	{
+		getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(device,
+			"vkGetSemaphoreCounterValueKHR");
+		waitSemaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+	}
+	if (getSemaphoreCounterValue == nullptr || waitSemaphores == nullptr)
+	{
+		throw std::runtime_error("Failed to load the timeline semaphore functions");
+	}
+
+	VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {};
+	semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	semaphoreTypeCreateInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+
+	VkResult result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a timeline semaphore");
+	}
+}
+
+uint64_t QueueTimeline::submit(const TimelineSubmitInfo& submitInfo)
+{
+	if (submitInfo.waitSemaphores.size() + submitInfo.timelineWaits.size() > MAX_SUBMIT_SEMAPHORES ||
+		submitInfo.signalSemaphores.size() + 1 > MAX_SUBMIT_SEMAPHORES)
+	{
+		throw std::runtime_error("Too many semaphores in a single submit");
+	}
+
+	// Binary and timeline semaphores share the arrays, the values of binary ones are ignored
+	VkSemaphore waitSemaphoreHandles[MAX_SUBMIT_SEMAPHORES];
+	VkPipelineStageFlags waitStageMasks[MAX_SUBMIT_SEMAPHORES];
+	uint64_t waitValues[MAX_SUBMIT_SEMAPHORES];
+	uint32_t waitCount = 0;
+	for (size_t i = 0; i < submitInfo.waitSemaphores.size(); i++)
+	{
+		waitSemaphoreHandles[waitCount] = submitInfo.waitSemaphores[i];
+		waitStageMasks[waitCount] = submitInfo.waitStageMasks[i];
+		waitValues[waitCount] = 0;
+		waitCount++;
+	}
+	for (const TimelineWait& timelineWait : submitInfo.timelineWaits)
+	{
+		if (timelineWait.timeline->isComplete(timelineWait.value))
+		{
+			continue;
+		}
+		if (timelineWait.timeline->semaphore == VK_NULL_HANDLE)
+		{
+			// Fences cannot be waited on by the GPU, the dependency is resolved on the CPU instead
+			timelineWait.timeline->wait(timelineWait.value);
+			continue;
+		}
+		waitSemaphoreHandles[waitCount] = timelineWait.timeline->semaphore;
+		waitStageMasks[waitCount] = timelineWait.stageMask;
+		waitValues[waitCount] = timelineWait.value;
+		waitCount++;
+	}
+
+	const uint64_t signalValue = lastSubmittedValue + 1;
+	VkSemaphore signalSemaphoreHandles[MAX_SUBMIT_SEMAPHORES];
+	uint64_t signalValues[MAX_SUBMIT_SEMAPHORES];
+	uint32_t signalCount = 0;
+	for (VkSemaphore signalSemaphore : submitInfo.signalSemaphores)
+	{
+		signalSemaphoreHandles[signalCount] = signalSemaphore;
+		signalValues[signalCount] = 0;
+		signalCount++;
+	}
+
+	VkSubmitInfo queueSubmitInfo = {};
+	queueSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	queueSubmitInfo.waitSemaphoreCount = waitCount;
+	queueSubmitInfo.pWaitSemaphores = waitSemaphoreHandles;
+	queueSubmitInfo.pWaitDstStageMask = waitStageMasks;
+	queueSubmitInfo.commandBufferCount = static_cast<uint32_t>(submitInfo.commandBuffers.size());
+	queueSubmitInfo.pCommandBuffers = submitInfo.commandBuffers.data();
+
+	VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+	timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	VkFence fence = VK_NULL_HANDLE;
+	if (semaphore != VK_NULL_HANDLE)
+	{
+		signalSemaphoreHandles[signalCount] = semaphore;
+		signalValues[signalCount] = signalValue;
+		signalCount++;
+
+		timelineSubmitInfo.waitSemaphoreValueCount = waitCount;
+		timelineSubmitInfo.pWaitSemaphoreValues = waitValues;
+		timelineSubmitInfo.signalSemaphoreValueCount = signalCount;
+		timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+		queueSubmitInfo.pNext = &timelineSubmitInfo;
+	}
+	else
+	{
+		fence = acquireFence();
+	}
+	queueSubmitInfo.signalSemaphoreCount = signalCount;
+	queueSubmitInfo.pSignalSemaphores = signalSemaphoreHandles;
+
+	VkResult result = vkQueueSubmit(queue, 1, &queueSubmitInfo, fence);
+	if (result != VK_SUCCESS)
+	{
+		if (fence != VK_NULL_HANDLE)
+		{
+			freeFences.push_back(fence);
+		}
+		throw std::runtime_error("Failed to submit command buffer to queue");
+	}
+
+	if (fence != VK_NULL_HANDLE)
+	{
+		pendingFences.push_back({ signalValue, fence });
+	}
+	lastSubmittedValue = signalValue;
+	return signalValue;
+}
+
+VkQueue QueueTimeline::getQueue()
+{
+	return queue;
+}
+
+uint64_t QueueTimeline::getLastSubmittedValue()
+{
+	return lastSubmittedValue;
+}
+
+uint64_t QueueTimeline::getCompletedValue()
+{
+	if (semaphore != VK_NULL_HANDLE)
+	{
+		uint64_t value = 0;
+		if (getSemaphoreCounterValue(device, semaphore, &value) == VK_SUCCESS)
+		{
+			completedValue = std::max(completedValue, value);
+		}
+	}
+	else
+	{
+		retireFences();
+	}
+	return completedValue;
+}
+
+bool QueueTimeline::isComplete(uint64_t value)
+{
+	// The cached value answers most queries without touching the device
+	return value <= completedValue || value <= getCompletedValue();
+}
+
+void QueueTimeline::wait(uint64_t value)
+{
+	if (value <= completedValue)
+	{
+		return;
+	}
+	if (value > lastSubmittedValue)
+	{
+		throw std::runtime_error("Waiting on a timeline value that was never submitted");
+	}
+
+	if (semaphore != VK_NULL_HANDLE)
+	{
+		VkSemaphoreWaitInfo waitInfo = {};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &semaphore;
+		waitInfo.pValues = &value;
+		VkResult result = waitSemaphores(device, &waitInfo, std::numeric_limits<uint64_t>::max());
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to wait on a timeline semaphore");
+		}
+		completedValue = std::max(completedValue, value);
+		return;
+	}
+
+	// A fence only covers its own submit, so every earlier one still pending is waited on as well
+	std::vector<VkFence> fences;
+	for (const PendingFence& pendingFence : pendingFences)
+	{
+		if (pendingFence.value > value)
+		{
+			break;
+		}
+		fences.push_back(pendingFence.fence);
+	}
+	VkResult result = vkWaitForFences(device, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE,
+		std::numeric_limits<uint64_t>::max());
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to wait on a fence");
+	}
+	retireFences();
+}
+
+void QueueTimeline::waitIdle()
+{
+	wait(lastSubmittedValue);
+}
+
+VkFence QueueTimeline::acquireFence()
+{
+	retireFences();
+	if (!freeFences.empty())
+	{
+		VkFence fence = freeFences.back();
+		freeFences.pop_back();
+		return fence;
+	}
+
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	VkFence fence;
+	VkResult result = vkCreateFence(device, &fenceCreateInfo, nullptr, &fence);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a fence");
+	}
+	return fence;
+}
+
+void QueueTimeline::retireFences()
+{
+	// The counter only advances past a submit once everything before it has finished too
+	while (!pendingFences.empty() && vkGetFenceStatus(device, pendingFences.front().fence) == VK_SUCCESS)
+	{
+		completedValue = pendingFences.front().value;
+		vkResetFences(device, 1, &pendingFences.front().fence);
+		freeFences.push_back(pendingFences.front().fence);
+		pendingFences.pop_front();
+	}
+}
+
+void QueueTimeline::cleanup()
+{
+	for (const PendingFence& pendingFence : pendingFences)
+	{
+		vkDestroyFence(device, pendingFence.fence, nullptr);
+	}
+	for (VkFence fence : freeFences)
+	{
+		vkDestroyFence(device, fence, nullptr);
+	}
+	pendingFences.clear();
+	freeFences.clear();
+	if (semaphore != VK_NULL_HANDLE)
+	{
+		vkDestroySemaphore(device, semaphore, nullptr);
+		semaphore = VK_NULL_HANDLE;
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <deque>
+#include <span>
+#include <vector>
+
+class QueueTimeline;
+
+// Work already submitted to a queue that a submission has to wait for
+struct TimelineWait
+{
+	QueueTimeline* timeline = nullptr;
+	uint64_t value = 0;
+	VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+};
+
+struct TimelineSubmitInfo
+{
+	std::span<const VkCommandBuffer> commandBuffers;
+	// Binary semaphores, only needed where the swapchain is involved
+	std::span<const VkSemaphore> waitSemaphores;
+	std::span<const VkPipelineStageFlags> waitStageMasks;
+	std::span<const VkSemaphore> signalSemaphores;
+	std::span<const TimelineWait> timelineWaits;
+};
+
+// A single monotonically increasing counter for everything submitted to one queue. Every submit signals
+// the next value, so whether some work, and every resource it used, has finished is a comparison against
+// the completed value. Backed by a timeline semaphore, or by a fence per submit on devices without them.
+class QueueTimeline
+{
+public:
+	QueueTimeline();
+	void init(VkDevice newDevice, VkQueue newQueue, bool timelineSemaphoreSupported);
+
+	// Returns the value that is signalled once the submitted work has finished
+	uint64_t submit(const TimelineSubmitInfo& submitInfo);
+
+	VkQueue getQueue();
+	uint64_t getLastSubmittedValue();
+	uint64_t getCompletedValue();
+	bool isComplete(uint64_t value);
+	// Blocks until the value is reached, zero is always complete
+	void wait(uint64_t value);
+	void waitIdle();
+
+	void cleanup();
+private:
+	struct PendingFence
+	{
+		uint64_t value;
+		VkFence fence;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	PFN_vkGetSemaphoreCounterValue getSemaphoreCounterValue = nullptr;
+	PFN_vkWaitSemaphores waitSemaphores = nullptr;
+
+	uint64_t lastSubmittedValue = 0;
+	uint64_t completedValue = 0;
+
+	// Fallback only, oldest submit first
+	std::deque<PendingFence> pendingFences;
+	std::vector<VkFence> freeFences;
+
+	VkFence acquireFence();
+	void retireFences();
+};
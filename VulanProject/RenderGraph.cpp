@@ -0,0 +1,1692 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "Log.h"
+#include "Utilities.h"
+
+namespace
+{
+	const VkAccessFlags WRITE_ACCESS_MASK = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |
+		VK_ACCESS_MEMORY_WRITE_BIT;
+	const size_t NOT_USED = ~size_t(0);
+	const uint32_t NO_ALIAS_SLOT = ~0u;
+	const RenderGraphResource NO_RESOURCE = ~0u;
+
+	struct UsageState
+	{
+		VkPipelineStageFlags stageMask;
+		VkAccessFlags accessMask;
+		VkImageLayout layout;
+	};
+
+	// What has touched a resource since its last write, and who that write has been made visible to
+	struct ResourceState
+	{
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags writeStages = 0;
+		VkAccessFlags writeAccess = 0;
+		VkPipelineStageFlags readStages = 0;
+		VkPipelineStageFlags visibleStages = 0;
+		VkAccessFlags visibleAccess = 0;
+	};
+
+	UsageState getUsageState(RenderGraphUsage usage, RenderGraphPassType type)
+	{
+		const VkPipelineStageFlags shaderStages = type == RenderGraphPassType::Compute ?
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT :
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		const VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+		switch (usage)
+		{
+		case RenderGraphUsage::ColourAttachment:
+			return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		case RenderGraphUsage::DepthAttachment:
+			return { depthStages,
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+		case RenderGraphUsage::DepthAttachmentReadOnly:
+			return { depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+		case RenderGraphUsage::ResolveAttachment:
+			return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		case RenderGraphUsage::InputAttachment:
+			return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		case RenderGraphUsage::DepthInputAttachment:
+			return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+		case RenderGraphUsage::SampledImage:
+			return { shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		case RenderGraphUsage::StorageImageRead:
+			return { shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL };
+		case RenderGraphUsage::StorageImageWrite:
+			return { shaderStages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+		case RenderGraphUsage::StorageBufferRead:
+			return { shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+		case RenderGraphUsage::StorageBufferWrite:
+			return { shaderStages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+		case RenderGraphUsage::IndirectBuffer:
+			return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+		}
+		throw std::runtime_error("Unknown render graph usage");
+	}
+
+	bool isWrite(RenderGraphUsage usage)
+	{
+		return usage == RenderGraphUsage::ColourAttachment || usage == RenderGraphUsage::DepthAttachment ||
+			usage == RenderGraphUsage::ResolveAttachment || usage == RenderGraphUsage::StorageImageWrite ||
+			usage == RenderGraphUsage::StorageBufferWrite;
+	}
+
+	bool isAttachment(RenderGraphUsage usage)
+	{
+		return usage == RenderGraphUsage::ColourAttachment || usage == RenderGraphUsage::DepthAttachment ||
+			usage == RenderGraphUsage::DepthAttachmentReadOnly || usage == RenderGraphUsage::ResolveAttachment ||
+			usage == RenderGraphUsage::InputAttachment || usage == RenderGraphUsage::DepthInputAttachment;
+	}
+
+	bool isInputAttachment(RenderGraphUsage usage)
+	{
+		return usage == RenderGraphUsage::InputAttachment || usage == RenderGraphUsage::DepthInputAttachment;
+	}
+
+	// Attachments drawn into without a clear build on what is already there
+	bool replacesContents(RenderGraphUsage usage, bool clear)
+	{
+		return isWrite(usage) && (!isAttachment(usage) || clear || usage == RenderGraphUsage::ResolveAttachment);
+	}
+
+	VkImageUsageFlags getImageUsage(RenderGraphUsage usage)
+	{
+		switch (usage)
+		{
+		case RenderGraphUsage::ColourAttachment:
+		case RenderGraphUsage::ResolveAttachment:
+			return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		case RenderGraphUsage::DepthAttachment:
+		case RenderGraphUsage::DepthAttachmentReadOnly:
+			return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		case RenderGraphUsage::InputAttachment:
+		case RenderGraphUsage::DepthInputAttachment:
+			return VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+		case RenderGraphUsage::SampledImage:
+			return VK_IMAGE_USAGE_SAMPLED_BIT;
+		case RenderGraphUsage::StorageImageRead:
+		case RenderGraphUsage::StorageImageWrite:
+			return VK_IMAGE_USAGE_STORAGE_BIT;
+		default:
+			throw std::runtime_error("Buffer usage declared on a render graph image");
+		}
+	}
+
+	VkBufferUsageFlags getBufferUsage(RenderGraphUsage usage)
+	{
+		switch (usage)
+		{
+		case RenderGraphUsage::StorageBufferRead:
+		case RenderGraphUsage::StorageBufferWrite:
+			return VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		case RenderGraphUsage::IndirectBuffer:
+			return VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+		default:
+			throw std::runtime_error("Image usage declared on a render graph buffer");
+		}
+	}
+
+	bool hasStencil(VkFormat format)
+	{
+		return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+			format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_S8_UINT;
+	}
+
+	VkImageAspectFlags getAspectMask(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT;
+		case VK_FORMAT_S8_UINT:
+			return VK_IMAGE_ASPECT_STENCIL_BIT;
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		default:
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+		}
+	}
+
+	bool findLazyMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, uint32_t* memoryTypeIndex)
+	{
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+		const VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			if ((allowedTypes & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			{
+				*memoryTypeIndex = i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Moves the state on to the new usage, returns true when a barrier has to come first
+	bool transitionState(ResourceState& state, const UsageState& usage, bool write, bool isImage, bool discard,
+		VkPipelineStageFlags& srcStageMask, VkAccessFlags& srcAccessMask, VkImageLayout& oldLayout)
+	{
+		bool needsBarrier = false;
+		srcStageMask = 0;
+		srcAccessMask = 0;
+		oldLayout = state.layout;
+		if (isImage && usage.layout != state.layout)
+		{
+			// A layout transition is a write of its own, it has to wait for every earlier access
+			needsBarrier = true;
+			srcStageMask = state.writeStages | state.readStages;
+			srcAccessMask = state.writeAccess;
+			if (discard)
+			{
+				oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			}
+		}
+		else if (write)
+		{
+			// Write after write needs the earlier write made available, write after read only execution order
+			needsBarrier = (state.writeStages | state.readStages) != 0;
+			srcStageMask = state.writeStages | state.readStages;
+			srcAccessMask = state.writeAccess;
+		}
+		else if (state.writeAccess != 0 && ((usage.stageMask & ~state.visibleStages) != 0 ||
+			(usage.accessMask & ~state.visibleAccess) != 0))
+		{
+			// Read after write, unless an earlier barrier already made the write visible to this reader
+			needsBarrier = true;
+			srcStageMask = state.writeStages;
+			srcAccessMask = state.writeAccess;
+		}
+
+		if (isImage)
+		{
+			state.layout = usage.layout;
+		}
+		if (write)
+		{
+			state.writeStages = usage.stageMask;
+			state.writeAccess = usage.accessMask & WRITE_ACCESS_MASK;
+			state.readStages = 0;
+			state.visibleStages = 0;
+			state.visibleAccess = 0;
+		}
+		else
+		{
+			state.readStages |= usage.stageMask;
+			if (needsBarrier)
+			{
+				state.visibleStages |= usage.stageMask;
+				state.visibleAccess |= usage.accessMask;
+			}
+		}
+
+		if (srcStageMask == 0)
+		{
+			srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		}
+		return needsBarrier;
+	}
+}
+
+RenderGraphPass& RenderGraphPass::writeColour(RenderGraphResource resource)
+{
+	return addAccess(resource, RenderGraphUsage::ColourAttachment, nullptr);
+}
+
+RenderGraphPass& RenderGraphPass::writeColour(RenderGraphResource resource, const VkClearColorValue& clearColour)
+{
+	VkClearValue clearValue = {};
+	clearValue.color = clearColour;
+	return addAccess(resource, RenderGraphUsage::ColourAttachment, &clearValue);
+}
+
+RenderGraphPass& RenderGraphPass::writeDepth(RenderGraphResource resource)
+{
+	return addAccess(resource, RenderGraphUsage::DepthAttachment, nullptr);
+}
+
+RenderGraphPass& RenderGraphPass::writeDepth(RenderGraphResource resource, const VkClearDepthStencilValue& clearDepth)
+{
+	VkClearValue clearValue = {};
+	clearValue.depthStencil = clearDepth;
+	return addAccess(resource, RenderGraphUsage::DepthAttachment, &clearValue);
+}
+
+RenderGraphPass& RenderGraphPass::readDepth(RenderGraphResource resource)
+{
+	return addAccess(resource, RenderGraphUsage::DepthAttachmentReadOnly, nullptr);
+}
+
+RenderGraphPass& RenderGraphPass::resolveColour(RenderGraphResource resource)
+{
+	return addAccess(resource, RenderGraphUsage::ResolveAttachment, nullptr);
+}
+
+RenderGraphPass& RenderGraphPass::readInput(RenderGraphResource resource)
+{
+	return addAccess(resource, RenderGraphUsage::InputAttachment, nullptr);
+}
+
+RenderGraphPass& RenderGraphPass::readDepthInput(RenderGraphResource resource)
+{
+	return addAccess(resource, RenderGraphUsage::DepthInputAttachment, nullptr);
+}
+
+RenderGraphPass& RenderGraphPass::nextSubpass()
+{
+	subpassCount++;
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::readTexture(RenderGraphResource resource)
+{
+	return addAccess(resource, RenderGraphUsage::SampledImage, nullptr);
+}
+
+RenderGraphPass& RenderGraphPass::readStorageImage(RenderGraphResource resource)
+{
+	return addAccess(resource, RenderGraphUsage::StorageImageRead, nullptr);
+}
+
+RenderGraphPass& RenderGraphPass::writeStorageImage(RenderGraphResource resource)
+{
+	return addAccess(resource, RenderGraphUsage::StorageImageWrite, nullptr);
+}
+
+RenderGraphPass& RenderGraphPass::readStorageBuffer(RenderGraphResource resource)
+{
+	return addAccess(resource, RenderGraphUsage::StorageBufferRead, nullptr);
+}
+
+RenderGraphPass& RenderGraphPass::writeStorageBuffer(RenderGraphResource resource)
+{
+	return addAccess(resource, RenderGraphUsage::StorageBufferWrite, nullptr);
+}
+
+RenderGraphPass& RenderGraphPass::readIndirectBuffer(RenderGraphResource resource)
+{
+	return addAccess(resource, RenderGraphUsage::IndirectBuffer, nullptr);
+}
+
+RenderGraphPass& RenderGraphPass::setSideEffects()
+{
+	sideEffects = true;
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::setExecute(std::function<void(const RenderGraphPassContext&)> newExecute)
+{
+	execute = std::move(newExecute);
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::addAccess(RenderGraphResource resource, RenderGraphUsage usage,
+	const VkClearValue* clearValue)
+{
+	Access access = {};
+	access.resource = resource;
+	access.usage = usage;
+	access.clear = clearValue != nullptr;
+	if (clearValue != nullptr)
+	{
+		access.clearValue = *clearValue;
+	}
+	access.subpass = subpassCount - 1;
+	accesses.push_back(access);
+	return *this;
+}
+
+RenderGraph::RenderGraph()
+{
+}
+
+void RenderGraph::init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* newMemoryBudget,
+	QueueTimeline* newTimeline, bool dynamicRenderingSupported)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+	memoryBudget = newMemoryBudget;
+	timeline = newTimeline;
+
+	// Extension commands are not exported by the loader, they have to come from the device
+	cmdBeginRendering = nullptr;
+	cmdEndRendering = nullptr;
+	if (dynamicRenderingSupported)
+	{
+		cmdBeginRendering = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR");
+		cmdEndRendering = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR");
+	}
+	dynamicRendering = cmdBeginRendering != nullptr && cmdEndRendering != nullptr;
+	VULKAN_CORE_INFO("Render graph: {}", dynamicRendering ? "dynamic rendering" : "render passes");
+}
+
+bool RenderGraph::isDynamicRendering() const
+{
+	return dynamicRendering;
+}
+
+void RenderGraph::reset()
+{
+	resources.clear();
+	passes.clear();
+}
+
+RenderGraphResource RenderGraph::importImage(const std::string& name, const RenderGraphImportedImage& image)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = true;
+	resource.imageDesc = image.desc;
+	resource.importedImage = image;
+	resources.push_back(resource);
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::createImage(const std::string& name, const RenderGraphImageDesc& desc)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = false;
+	resource.imageDesc = desc;
+	resources.push_back(resource);
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::importBuffer(const std::string& name, VkBuffer buffer, VkDeviceSize size)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.isImage = false;
+	resource.imported = true;
+	resource.bufferSize = size;
+	resource.importedBuffer = buffer;
+	resources.push_back(resource);
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::createBuffer(const std::string& name, VkDeviceSize size)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.isImage = false;
+	resource.imported = false;
+	resource.bufferSize = size;
+	resources.push_back(resource);
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphPass& RenderGraph::addPass(const std::string& name, RenderGraphPassType type)
+{
+	passes.emplace_back();
+	RenderGraphPass& pass = passes.back();
+	pass.name = name;
+	pass.type = type;
+	return pass;
+}
+
+bool RenderGraph::compile()
+{
+	std::vector<uint64_t> topology = buildTopology();
+	if (topology == compiledTopology)
+	{
+		return false;
+	}
+	compiledTopology = std::move(topology);
+	compiledPasses.clear();
+	finalBarriers.clear();
+	barrierCount = 0;
+
+	for (const RenderGraphPass& pass : passes)
+	{
+		if (pass.subpassCount > 1 && pass.type != RenderGraphPassType::Graphics)
+		{
+			throw std::runtime_error("Render graph pass " + pass.name + " has subpasses outside a graphics pass");
+		}
+		std::vector<uint32_t> colourCounts(pass.subpassCount, 0);
+		std::vector<uint32_t> resolveCounts(pass.subpassCount, 0);
+		std::vector<uint32_t> depthCounts(pass.subpassCount, 0);
+		for (const RenderGraphPass::Access& access : pass.accesses)
+		{
+			if (access.resource >= resources.size())
+			{
+				throw std::runtime_error("Render graph pass " + pass.name + " uses an undeclared resource");
+			}
+			if (isAttachment(access.usage) && pass.type != RenderGraphPassType::Graphics)
+			{
+				throw std::runtime_error("Render graph pass " + pass.name + " uses an attachment outside a graphics pass");
+			}
+			colourCounts[access.subpass] += access.usage == RenderGraphUsage::ColourAttachment ? 1 : 0;
+			resolveCounts[access.subpass] += access.usage == RenderGraphUsage::ResolveAttachment ? 1 : 0;
+			depthCounts[access.subpass] += access.usage == RenderGraphUsage::DepthAttachment ||
+				access.usage == RenderGraphUsage::DepthAttachmentReadOnly ? 1 : 0;
+		}
+		for (uint32_t s = 0; s < pass.subpassCount; s++)
+		{
+			if (depthCounts[s] > 1)
+			{
+				throw std::runtime_error("Render graph pass " + pass.name + " has more than one depth attachment");
+			}
+			// Resolves pair up with the colour attachments in declaration order, the rest are left unresolved
+			if (resolveCounts[s] > colourCounts[s])
+			{
+				throw std::runtime_error("Render graph pass " + pass.name + " resolves more attachments than it draws");
+			}
+		}
+	}
+
+	// Walk back from the imported resources, which outlive the frame. A pass is kept when something later
+	// needs what it writes, and a write that replaces the whole resource ends the need for earlier writers.
+	std::vector<bool> needed(resources.size(), false);
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		needed[i] = resources[i].imported;
+	}
+	std::vector<bool> live(passes.size(), false);
+	for (size_t i = passes.size(); i-- > 0;)
+	{
+		const RenderGraphPass& pass = passes[i];
+		bool isLive = pass.sideEffects;
+		for (const RenderGraphPass::Access& access : pass.accesses)
+		{
+			isLive |= isWrite(access.usage) && needed[access.resource];
+		}
+		if (!isLive)
+		{
+			continue;
+		}
+		live[i] = true;
+
+		for (const RenderGraphPass::Access& access : pass.accesses)
+		{
+			if (replacesContents(access.usage, access.clear))
+			{
+				needed[access.resource] = false;
+			}
+		}
+		for (uint32_t a = 0; a < pass.accesses.size(); a++)
+		{
+			// Attachments that are not cleared load whatever an earlier pass left in them, inputs written by an
+			// earlier subpass only see that subpass's contents
+			const RenderGraphPass::Access& access = pass.accesses[a];
+			if (!replacesContents(access.usage, access.clear) && !isWrittenInEarlierSubpass(pass, a))
+			{
+				needed[access.resource] = true;
+			}
+		}
+	}
+
+	imageUsages.assign(resources.size(), 0);
+	bufferUsages.assign(resources.size(), 0);
+	std::vector<size_t> firstUse(resources.size(), NOT_USED);
+	std::vector<size_t> lastUse(resources.size(), 0);
+	tileOnly.assign(resources.size(), true);
+	for (size_t i = 0; i < passes.size(); i++)
+	{
+		if (!live[i])
+		{
+			continue;
+		}
+		for (const RenderGraphPass::Access& access : passes[i].accesses)
+		{
+			if (resources[access.resource].isImage)
+			{
+				imageUsages[access.resource] |= getImageUsage(access.usage);
+			}
+			else
+			{
+				bufferUsages[access.resource] |= getBufferUsage(access.usage);
+			}
+			firstUse[access.resource] = std::min(firstUse[access.resource], i);
+			lastUse[access.resource] = i;
+			tileOnly[access.resource] = tileOnly[access.resource] && isAttachment(access.usage);
+		}
+	}
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		// Attachments used by a single pass are never loaded or stored, so they can live in tile memory only
+		tileOnly[i] = tileOnly[i] && !resources[i].imported && resources[i].isImage && firstUse[i] == lastUse[i];
+	}
+
+	// Transient resources whose lifetimes do not overlap share memory. Taken in order of first use, each one goes
+	// to the slot that has been free the longest, keeping images, buffers and tile only attachments apart.
+	struct AliasSlot
+	{
+		size_t lastUse;
+		bool isImage;
+		bool tileOnly;
+		RenderGraphResource lastResource;
+	};
+	std::vector<AliasSlot> slots;
+	std::vector<RenderGraphResource> aliasOrder;
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		if (!resources[i].imported && firstUse[i] != NOT_USED)
+		{
+			aliasOrder.push_back(static_cast<RenderGraphResource>(i));
+		}
+	}
+	std::stable_sort(aliasOrder.begin(), aliasOrder.end(), [&firstUse](RenderGraphResource a, RenderGraphResource b)
+	{
+		return firstUse[a] < firstUse[b];
+	});
+	aliasSlots.assign(resources.size(), NO_ALIAS_SLOT);
+	std::vector<RenderGraphResource> aliasPredecessors(resources.size(), NO_RESOURCE);
+	for (RenderGraphResource resource : aliasOrder)
+	{
+		uint32_t bestSlot = NO_ALIAS_SLOT;
+		for (uint32_t s = 0; s < slots.size(); s++)
+		{
+			if (slots[s].isImage == resources[resource].isImage && slots[s].tileOnly == tileOnly[resource] &&
+				slots[s].lastUse < firstUse[resource] &&
+				(bestSlot == NO_ALIAS_SLOT || slots[s].lastUse < slots[bestSlot].lastUse))
+			{
+				bestSlot = s;
+			}
+		}
+		if (bestSlot == NO_ALIAS_SLOT)
+		{
+			bestSlot = static_cast<uint32_t>(slots.size());
+			slots.push_back({ lastUse[resource], resources[resource].isImage, tileOnly[resource], resource });
+		}
+		else
+		{
+			aliasPredecessors[resource] = slots[bestSlot].lastResource;
+			slots[bestSlot].lastUse = lastUse[resource];
+			slots[bestSlot].lastResource = resource;
+		}
+		aliasSlots[resource] = bestSlot;
+	}
+	aliasSlotCount = static_cast<uint32_t>(slots.size());
+	physicalResourcesDirty = true;
+
+	// Transient memory is shared by the frames in flight, so the first use of a slot has to wait for the previous
+	// frame's last one. The frame is walked once to find that state, then again to build the barriers.
+	// Later resources in a slot wait for the one before them instead.
+	std::vector<ResourceState> states(resources.size());
+	std::vector<ResourceState> slotEndStates(aliasSlotCount);
+	for (uint32_t sweep = 0; sweep < 2; sweep++)
+	{
+		std::vector<bool> written(resources.size(), false);
+		std::vector<bool> touched(resources.size(), false);
+		for (size_t i = 0; i < resources.size(); i++)
+		{
+			const Resource& resource = resources[i];
+			if (resource.imported && resource.isImage)
+			{
+				states[i] = {};
+				states[i].layout = resource.importedImage.initialLayout;
+				states[i].readStages = resource.importedImage.initialStageMask;
+				written[i] = resource.importedImage.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+			}
+			else if (resource.imported)
+			{
+				// Imported buffers are the same every frame and pick up where the last frame left them
+				states[i].visibleStages = 0;
+				states[i].visibleAccess = 0;
+				written[i] = true;
+			}
+			else
+			{
+				// Contents never carry over between frames, the previous layout does not matter
+				states[i] = {};
+				if (aliasSlots[i] != NO_ALIAS_SLOT && aliasPredecessors[i] == NO_RESOURCE)
+				{
+					states[i].writeStages = slotEndStates[aliasSlots[i]].writeStages;
+					states[i].writeAccess = slotEndStates[aliasSlots[i]].writeAccess;
+					states[i].readStages = slotEndStates[aliasSlots[i]].readStages;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < passes.size(); i++)
+		{
+			if (!live[i])
+			{
+				continue;
+			}
+			const RenderGraphPass& pass = passes[i];
+			CompiledPass compiledPass = {};
+			compiledPass.passIndex = static_cast<uint32_t>(i);
+			std::vector<VkAttachmentLoadOp> loadOps;
+			std::vector<VkAttachmentStoreOp> storeOps;
+
+			for (uint32_t a = 0; a < pass.accesses.size(); a++)
+			{
+				const RenderGraphPass::Access& access = pass.accesses[a];
+				const Resource& resource = resources[access.resource];
+				const bool loads = isAttachment(access.usage) && !replacesContents(access.usage, access.clear) &&
+					written[access.resource];
+
+				// Every access of the pass to one resource is covered by a single barrier at the first of them
+				bool firstAccess = true;
+				for (uint32_t b = 0; b < a; b++)
+				{
+					firstAccess &= pass.accesses[b].resource != access.resource;
+				}
+				if (!touched[access.resource] && aliasPredecessors[access.resource] != NO_RESOURCE)
+				{
+					// Aliased memory is only handed over once the previous resource's last use has finished
+					const ResourceState& previous = states[aliasPredecessors[access.resource]];
+					states[access.resource].writeStages |= previous.writeStages;
+					states[access.resource].writeAccess |= previous.writeAccess;
+					states[access.resource].readStages |= previous.readStages;
+				}
+				touched[access.resource] = true;
+
+				if (firstAccess)
+				{
+					UsageState usageState = getUsageState(access.usage, pass.type);
+					bool write = isWrite(access.usage);
+					bool keepsContents = !write || loads;
+					// The barrier moves the image into the layout of its first subpass, the render pass moves it
+					// through the later ones
+					VkImageLayout lastLayout = usageState.layout;
+					uint32_t lastLayoutSubpass = access.subpass;
+					for (uint32_t b = a + 1; b < pass.accesses.size(); b++)
+					{
+						const RenderGraphPass::Access& other = pass.accesses[b];
+						if (other.resource != access.resource)
+						{
+							continue;
+						}
+						const UsageState otherState = getUsageState(other.usage, pass.type);
+						if (resource.isImage && otherState.layout != lastLayout)
+						{
+							if (other.subpass == lastLayoutSubpass || !isAttachment(other.usage) ||
+								!isAttachment(access.usage))
+							{
+								throw std::runtime_error("Render graph pass " + pass.name + " uses " + resource.name +
+									" in two different layouts");
+							}
+							lastLayout = otherState.layout;
+							lastLayoutSubpass = other.subpass;
+						}
+						usageState.stageMask |= otherState.stageMask;
+						usageState.accessMask |= otherState.accessMask;
+						write |= isWrite(other.usage);
+						keepsContents |= !isWrite(other.usage) && !isWrittenInEarlierSubpass(pass, b);
+					}
+
+					Barrier barrier = {};
+					barrier.resource = access.resource;
+					if (transitionState(states[access.resource], usageState, write, resource.isImage, !keepsContents,
+						barrier.srcStageMask, barrier.srcAccessMask, barrier.oldLayout))
+					{
+						barrier.dstStageMask = usageState.stageMask;
+						barrier.dstAccessMask = usageState.accessMask;
+						barrier.newLayout = resource.isImage ? usageState.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+						compiledPass.barriers.push_back(barrier);
+					}
+					if (resource.isImage)
+					{
+						states[access.resource].layout = lastLayout;
+					}
+				}
+
+				if (firstAccess && isAttachment(access.usage))
+				{
+					compiledPass.attachments.push_back(access.resource);
+					compiledPass.attachmentAccesses.push_back(a);
+					loadOps.push_back(access.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR :
+						loads ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+					// Nothing after the last use looks at a transient attachment, so it never has to leave the tile
+					storeOps.push_back(resource.imported || lastUse[access.resource] > i ?
+						VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE);
+				}
+				written[access.resource] = written[access.resource] || isWrite(access.usage);
+			}
+
+			if (sweep == 1)
+			{
+				// Only a render pass keeps attachments in tile memory from one subpass to the next
+				if (!compiledPass.attachments.empty() && (!dynamicRendering || pass.subpassCount > 1))
+				{
+					compiledPass.renderPass = getOrCreateRenderPass(pass, compiledPass.attachments,
+						compiledPass.attachmentAccesses, loadOps, storeOps);
+				}
+				compiledPass.loadOps = std::move(loadOps);
+				compiledPass.storeOps = std::move(storeOps);
+				barrierCount += static_cast<uint32_t>(compiledPass.barriers.size());
+				compiledPasses.push_back(std::move(compiledPass));
+			}
+		}
+
+		for (size_t i = 0; i < resources.size(); i++)
+		{
+			if (sweep == 0 && aliasSlots[i] != NO_ALIAS_SLOT)
+			{
+				ResourceState& slotEndState = slotEndStates[aliasSlots[i]];
+				slotEndState.writeStages |= states[i].writeStages;
+				slotEndState.writeAccess |= states[i].writeAccess;
+				slotEndState.readStages |= states[i].readStages;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		const Resource& resource = resources[i];
+		if (!resource.imported || !resource.isImage || resource.importedImage.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED)
+		{
+			continue;
+		}
+		const UsageState finalState = { resource.importedImage.finalStageMask, 0, resource.importedImage.finalLayout };
+		Barrier barrier = {};
+		barrier.resource = static_cast<RenderGraphResource>(i);
+		if (transitionState(states[i], finalState, false, true, false, barrier.srcStageMask, barrier.srcAccessMask,
+			barrier.oldLayout))
+		{
+			barrier.dstStageMask = finalState.stageMask;
+			barrier.dstAccessMask = 0;
+			barrier.newLayout = finalState.layout;
+			finalBarriers.push_back(barrier);
+		}
+	}
+	barrierCount += static_cast<uint32_t>(finalBarriers.size());
+
+	VULKAN_CORE_INFO("Compiled render graph: {} passes, {} culled, {} barriers", getPassCount(), getCulledPassCount(),
+		barrierCount);
+	return true;
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+	destroyRetiredObjects(false);
+	createPhysicalResources();
+
+	for (const CompiledPass& compiledPass : compiledPasses)
+	{
+		const RenderGraphPass& pass = passes[compiledPass.passIndex];
+		recordBarriers(commandBuffer, compiledPass.barriers);
+
+		RenderGraphPassContext context = {};
+		context.commandBuffer = commandBuffer;
+		context.graph = this;
+		if (compiledPass.attachments.empty())
+		{
+			if (pass.execute)
+			{
+				pass.execute(context);
+			}
+			continue;
+		}
+
+		// Every attachment of a pass has to match in size, the first one decides the render area
+		const VkExtent2D extent = resources[compiledPass.attachments[0]].imageDesc.extent;
+		if (compiledPass.renderPass == VK_NULL_HANDLE)
+		{
+			beginRendering(commandBuffer, compiledPass, extent);
+		}
+		else
+		{
+			beginRenderPass(commandBuffer, compiledPass, extent);
+		}
+
+		VkViewport viewport = {};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(extent.width);
+		viewport.height = static_cast<float>(extent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = {};
+		scissor.offset = { 0, 0 };
+		scissor.extent = extent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		context.renderPass = compiledPass.renderPass;
+		context.extent = extent;
+		for (uint32_t subpass = 0; subpass < pass.subpassCount; subpass++)
+		{
+			if (subpass > 0)
+			{
+				vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+			}
+			context.subpass = subpass;
+			if (pass.execute)
+			{
+				pass.execute(context);
+			}
+		}
+		if (compiledPass.renderPass == VK_NULL_HANDLE)
+		{
+			cmdEndRendering(commandBuffer);
+		}
+		else
+		{
+			vkCmdEndRenderPass(commandBuffer);
+		}
+	}
+	recordBarriers(commandBuffer, finalBarriers);
+}
+
+VkRenderPass RenderGraph::getRenderPass(const std::string& passName) const
+{
+	for (const CompiledPass& compiledPass : compiledPasses)
+	{
+		if (passes[compiledPass.passIndex].name == passName)
+		{
+			return compiledPass.renderPass;
+		}
+	}
+	return VK_NULL_HANDLE;
+}
+
+RenderGraphPipelineTarget RenderGraph::getPipelineTarget(const std::string& passName, uint32_t subpass) const
+{
+	RenderGraphPipelineTarget target;
+	for (const CompiledPass& compiledPass : compiledPasses)
+	{
+		const RenderGraphPass& pass = passes[compiledPass.passIndex];
+		if (pass.name != passName)
+		{
+			continue;
+		}
+
+		target.renderPass = compiledPass.renderPass;
+		target.subpass = subpass;
+		for (const RenderGraphPass::Access& access : pass.accesses)
+		{
+			if (access.subpass != subpass)
+			{
+				continue;
+			}
+			const VkFormat format = resources[access.resource].imageDesc.format;
+			const RenderGraphUsage usage = access.usage;
+			if (usage == RenderGraphUsage::ColourAttachment)
+			{
+				target.colourFormats.push_back(format);
+			}
+			else if (usage == RenderGraphUsage::DepthAttachment || usage == RenderGraphUsage::DepthAttachmentReadOnly)
+			{
+				target.depthFormat = (getAspectMask(format) & VK_IMAGE_ASPECT_DEPTH_BIT) != 0 ? format : VK_FORMAT_UNDEFINED;
+				target.stencilFormat = hasStencil(format) ? format : VK_FORMAT_UNDEFINED;
+			}
+		}
+		break;
+	}
+	return target;
+}
+
+VkImage RenderGraph::getImage(RenderGraphResource resource) const
+{
+	if (resources[resource].imported)
+	{
+		return resources[resource].importedImage.image;
+	}
+	return physicalImages[resource].image;
+}
+
+VkImageView RenderGraph::getImageView(RenderGraphResource resource) const
+{
+	if (resources[resource].imported)
+	{
+		return resources[resource].importedImage.imageView;
+	}
+	return physicalImages[resource].imageView;
+}
+
+VkBuffer RenderGraph::getBuffer(RenderGraphResource resource) const
+{
+	if (resources[resource].imported)
+	{
+		return resources[resource].importedBuffer;
+	}
+	return physicalBuffers[resource].buffer;
+}
+
+void RenderGraph::releaseFramebuffers()
+{
+	if (framebufferCache.empty())
+	{
+		return;
+	}
+	RetiredObjects retired;
+	for (const auto& entry : framebufferCache)
+	{
+		retired.framebuffers.push_back(entry.second);
+	}
+	framebufferCache.clear();
+	retire(std::move(retired));
+}
+
+uint32_t RenderGraph::getPassCount() const
+{
+	return static_cast<uint32_t>(compiledPasses.size());
+}
+
+uint32_t RenderGraph::getCulledPassCount() const
+{
+	return static_cast<uint32_t>(passes.size() - compiledPasses.size());
+}
+
+uint32_t RenderGraph::getBarrierCount() const
+{
+	return barrierCount;
+}
+
+RenderGraphMemoryStatistics RenderGraph::getMemoryStatistics() const
+{
+	return memoryStatistics;
+}
+
+void RenderGraph::cleanup()
+{
+	releasePhysicalResources();
+	releaseFramebuffers();
+	destroyRetiredObjects(true);
+
+	for (const auto& entry : renderPassCache)
+	{
+		vkDestroyRenderPass(device, entry.second, nullptr);
+	}
+	renderPassCache.clear();
+	compiledTopology.clear();
+	compiledPasses.clear();
+	finalBarriers.clear();
+	aliasSlots.clear();
+	aliasSlotCount = 0;
+	physicalResourcesDirty = true;
+	reset();
+}
+
+std::vector<uint64_t> RenderGraph::buildTopology() const
+{
+	// Everything compiling depends on, handles, extents and clear values can change without a rebuild
+	std::vector<uint64_t> topology;
+	topology.push_back(resources.size());
+	for (const Resource& resource : resources)
+	{
+		topology.push_back((resource.isImage ? 1u : 0u) | (resource.imported ? 2u : 0u));
+		if (resource.isImage)
+		{
+			topology.push_back(resource.imageDesc.format);
+			topology.push_back(resource.imageDesc.samples);
+		}
+		if (resource.imported && resource.isImage)
+		{
+			topology.push_back(resource.importedImage.initialLayout);
+			topology.push_back(resource.importedImage.initialStageMask);
+			topology.push_back(resource.importedImage.finalLayout);
+			topology.push_back(resource.importedImage.finalStageMask);
+		}
+	}
+	topology.push_back(passes.size());
+	for (const RenderGraphPass& pass : passes)
+	{
+		topology.push_back(static_cast<uint64_t>(pass.type));
+		topology.push_back(pass.sideEffects ? 1 : 0);
+		topology.push_back(pass.subpassCount);
+		topology.push_back(pass.accesses.size());
+		for (const RenderGraphPass::Access& access : pass.accesses)
+		{
+			topology.push_back(access.resource);
+			topology.push_back(static_cast<uint64_t>(access.usage));
+			topology.push_back(access.clear ? 1 : 0);
+			topology.push_back(access.subpass);
+		}
+	}
+	return topology;
+}
+
+bool RenderGraph::isWrittenInEarlierSubpass(const RenderGraphPass& pass, uint32_t accessIndex) const
+{
+	const RenderGraphPass::Access& access = pass.accesses[accessIndex];
+	for (uint32_t i = 0; i < accessIndex; i++)
+	{
+		const RenderGraphPass::Access& earlier = pass.accesses[i];
+		if (earlier.resource == access.resource && earlier.subpass < access.subpass && isWrite(earlier.usage))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+VkRenderPass RenderGraph::getOrCreateRenderPass(const RenderGraphPass& pass,
+	const std::vector<RenderGraphResource>& attachments, const std::vector<uint32_t>& attachmentAccesses,
+	const std::vector<VkAttachmentLoadOp>& loadOps, const std::vector<VkAttachmentStoreOp>& storeOps)
+{
+	std::vector<VkAttachmentDescription> attachmentDescriptions(attachments.size());
+	std::vector<uint32_t> key;
+
+	for (uint32_t i = 0; i < attachments.size(); i++)
+	{
+		const RenderGraphImageDesc& desc = resources[attachments[i]].imageDesc;
+		VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		for (const RenderGraphPass::Access& access : pass.accesses)
+		{
+			if (access.resource == attachments[i])
+			{
+				finalLayout = getUsageState(access.usage, pass.type).layout;
+			}
+		}
+
+		// The graph has already moved the image into the layout of its first subpass, the render pass leaves it in
+		// the layout of its last
+		VkAttachmentDescription& description = attachmentDescriptions[i];
+		description.format = desc.format;
+		description.samples = desc.samples;
+		description.loadOp = loadOps[i];
+		description.storeOp = storeOps[i];
+		description.stencilLoadOp = hasStencil(desc.format) ? loadOps[i] : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		description.stencilStoreOp = hasStencil(desc.format) ? storeOps[i] : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		description.initialLayout = getUsageState(pass.accesses[attachmentAccesses[i]].usage, pass.type).layout;
+		description.finalLayout = finalLayout;
+
+		key.push_back(desc.format);
+		key.push_back(desc.samples);
+		key.push_back(loadOps[i]);
+		key.push_back(storeOps[i]);
+	}
+
+	struct SubpassReferences
+	{
+		std::vector<VkAttachmentReference> colour;
+		std::vector<VkAttachmentReference> resolve;
+		std::vector<VkAttachmentReference> input;
+		std::vector<uint32_t> preserve;
+		VkAttachmentReference depth = {};
+		bool hasDepth = false;
+		std::vector<bool> used;
+	};
+	std::vector<SubpassReferences> subpassReferences(pass.subpassCount);
+	for (SubpassReferences& references : subpassReferences)
+	{
+		references.used.assign(attachments.size(), false);
+	}
+	std::vector<uint32_t> firstSubpass(attachments.size(), pass.subpassCount);
+	std::vector<uint32_t> lastSubpass(attachments.size(), 0);
+	key.push_back(pass.subpassCount);
+	for (const RenderGraphPass::Access& access : pass.accesses)
+	{
+		if (!isAttachment(access.usage))
+		{
+			continue;
+		}
+		const uint32_t index = static_cast<uint32_t>(
+			std::find(attachments.begin(), attachments.end(), access.resource) - attachments.begin());
+		VkAttachmentReference reference = {};
+		reference.attachment = index;
+		reference.layout = getUsageState(access.usage, pass.type).layout;
+
+		SubpassReferences& references = subpassReferences[access.subpass];
+		if (access.usage == RenderGraphUsage::ColourAttachment)
+		{
+			references.colour.push_back(reference);
+		}
+		else if (access.usage == RenderGraphUsage::ResolveAttachment)
+		{
+			references.resolve.push_back(reference);
+		}
+		else if (isInputAttachment(access.usage))
+		{
+			references.input.push_back(reference);
+		}
+		else
+		{
+			references.depth = reference;
+			references.hasDepth = true;
+		}
+		references.used[index] = true;
+		firstSubpass[index] = std::min(firstSubpass[index], access.subpass);
+		lastSubpass[index] = std::max(lastSubpass[index], access.subpass);
+
+		key.push_back(access.subpass);
+		key.push_back(index);
+		key.push_back(static_cast<uint32_t>(access.usage));
+	}
+
+	auto cached = renderPassCache.find(key);
+	if (cached != renderPassCache.end())
+	{
+		return cached->second;
+	}
+
+	std::vector<VkSubpassDescription> subpasses(pass.subpassCount);
+	for (uint32_t s = 0; s < pass.subpassCount; s++)
+	{
+		SubpassReferences& references = subpassReferences[s];
+
+		// Colour attachments after the last resolve are left unresolved
+		if (!references.resolve.empty())
+		{
+			VkAttachmentReference unused = {};
+			unused.attachment = VK_ATTACHMENT_UNUSED;
+			unused.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			references.resolve.resize(references.colour.size(), unused);
+		}
+		// Attachments skipping a subpass between two that use them have to keep their contents through it
+		for (uint32_t i = 0; i < attachments.size(); i++)
+		{
+			if (!references.used[i] && firstSubpass[i] < s && lastSubpass[i] > s)
+			{
+				references.preserve.push_back(i);
+			}
+		}
+
+		VkSubpassDescription& subpass = subpasses[s];
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.inputAttachmentCount = static_cast<uint32_t>(references.input.size());
+		subpass.pInputAttachments = references.input.empty() ? nullptr : references.input.data();
+		subpass.colorAttachmentCount = static_cast<uint32_t>(references.colour.size());
+		subpass.pColorAttachments = references.colour.data();
+		subpass.pResolveAttachments = references.resolve.empty() ? nullptr : references.resolve.data();
+		subpass.pDepthStencilAttachment = references.hasDepth ? &references.depth : nullptr;
+		subpass.preserveAttachmentCount = static_cast<uint32_t>(references.preserve.size());
+		subpass.pPreserveAttachments = references.preserve.empty() ? nullptr : references.preserve.data();
+	}
+
+	// The graph records the barriers around the pass itself. Inside it each subpass waits for the attachment
+	// writes of the one before, only at the same pixel so tiled GPUs never have to flush the tile.
+	std::vector<VkSubpassDependency> dependencies;
+	for (uint32_t s = 1; s < pass.subpassCount; s++)
+	{
+		VkSubpassDependency dependency = {};
+		dependency.srcSubpass = s - 1;
+		dependency.dstSubpass = s;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		dependencies.push_back(dependency);
+	}
+
+	VkRenderPassCreateInfo renderPassCreateInfo = {};
+	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+	renderPassCreateInfo.pAttachments = attachmentDescriptions.data();
+	renderPassCreateInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+	renderPassCreateInfo.pSubpasses = subpasses.data();
+	renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassCreateInfo.pDependencies = dependencies.empty() ? nullptr : dependencies.data();
+
+	VkRenderPass renderPass;
+	VkResult result = vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a render pass");
+	}
+	renderPassCache[key] = renderPass;
+	return renderPass;
+}
+
+VkFramebuffer RenderGraph::getOrCreateFramebuffer(const CompiledPass& compiledPass, VkExtent2D extent)
+{
+	std::vector<VkImageView> attachmentViews;
+	std::vector<uint64_t> key;
+	key.push_back((uint64_t)compiledPass.renderPass);
+	key.push_back(extent.width);
+	key.push_back(extent.height);
+	for (RenderGraphResource attachment : compiledPass.attachments)
+	{
+		attachmentViews.push_back(getImageView(attachment));
+		key.push_back((uint64_t)attachmentViews.back());
+	}
+
+	auto cached = framebufferCache.find(key);
+	if (cached != framebufferCache.end())
+	{
+		return cached->second;
+	}
+
+	VkFramebufferCreateInfo framebufferCreateInfo = {};
+	framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferCreateInfo.renderPass = compiledPass.renderPass;
+	framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(attachmentViews.size());
+	framebufferCreateInfo.pAttachments = attachmentViews.data();
+	framebufferCreateInfo.width = extent.width;
+	framebufferCreateInfo.height = extent.height;
+	framebufferCreateInfo.layers = 1;
+
+	VkFramebuffer framebuffer;
+	VkResult result = vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &framebuffer);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a framebuffer");
+	}
+	framebufferCache[key] = framebuffer;
+	return framebuffer;
+}
+
+void RenderGraph::beginRenderPass(VkCommandBuffer commandBuffer, const CompiledPass& compiledPass, VkExtent2D extent)
+{
+	const RenderGraphPass& pass = passes[compiledPass.passIndex];
+	std::vector<VkClearValue> clearValues;
+	for (uint32_t accessIndex : compiledPass.attachmentAccesses)
+	{
+		clearValues.push_back(pass.accesses[accessIndex].clearValue);
+	}
+
+	VkRenderPassBeginInfo renderPassBeginInfo = {};
+	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassBeginInfo.renderPass = compiledPass.renderPass;
+	renderPassBeginInfo.framebuffer = getOrCreateFramebuffer(compiledPass, extent);
+	renderPassBeginInfo.renderArea.offset = { 0, 0 };
+	renderPassBeginInfo.renderArea.extent = extent;
+	renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+	renderPassBeginInfo.pClearValues = clearValues.data();
+	vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void RenderGraph::beginRendering(VkCommandBuffer commandBuffer, const CompiledPass& compiledPass, VkExtent2D extent)
+{
+	// The barriers have already moved every attachment into the layout it is rendered in
+	const RenderGraphPass& pass = passes[compiledPass.passIndex];
+	std::vector<VkRenderingAttachmentInfoKHR> colourAttachments;
+	std::vector<RenderGraphResource> resolveTargets;
+	VkRenderingAttachmentInfoKHR depthAttachment = {};
+	depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+	VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+	for (uint32_t i = 0; i < compiledPass.attachments.size(); i++)
+	{
+		const RenderGraphPass::Access& access = pass.accesses[compiledPass.attachmentAccesses[i]];
+		if (access.usage == RenderGraphUsage::ResolveAttachment)
+		{
+			resolveTargets.push_back(access.resource);
+			continue;
+		}
+
+		VkRenderingAttachmentInfoKHR attachment = {};
+		attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		attachment.imageView = getImageView(access.resource);
+		attachment.imageLayout = getUsageState(access.usage, pass.type).layout;
+		attachment.loadOp = compiledPass.loadOps[i];
+		attachment.storeOp = compiledPass.storeOps[i];
+		attachment.clearValue = access.clearValue;
+		if (access.usage == RenderGraphUsage::ColourAttachment)
+		{
+			colourAttachments.push_back(attachment);
+		}
+		else
+		{
+			depthAttachment = attachment;
+			depthFormat = resources[access.resource].imageDesc.format;
+		}
+	}
+	for (size_t i = 0; i < resolveTargets.size(); i++)
+	{
+		colourAttachments[i].resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT_KHR;
+		colourAttachments[i].resolveImageView = getImageView(resolveTargets[i]);
+		colourAttachments[i].resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	}
+
+	VkRenderingInfoKHR renderingInfo = {};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+	renderingInfo.renderArea.offset = { 0, 0 };
+	renderingInfo.renderArea.extent = extent;
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colourAttachments.size());
+	renderingInfo.pColorAttachments = colourAttachments.data();
+	if (depthFormat != VK_FORMAT_UNDEFINED)
+	{
+		const bool hasDepthAspect = (getAspectMask(depthFormat) & VK_IMAGE_ASPECT_DEPTH_BIT) != 0;
+		renderingInfo.pDepthAttachment = hasDepthAspect ? &depthAttachment : nullptr;
+		renderingInfo.pStencilAttachment = hasStencil(depthFormat) ? &depthAttachment : nullptr;
+	}
+	cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void RenderGraph::createPhysicalResources()
+{
+	// Aliased resources are placed together, so they are all recreated whenever any of them changes
+	bool changed = physicalResourcesDirty;
+	for (size_t i = 0; i < resources.size() && !changed; i++)
+	{
+		if (aliasSlots[i] == NO_ALIAS_SLOT)
+		{
+			continue;
+		}
+		if (resources[i].isImage)
+		{
+			const RenderGraphImageDesc& current = physicalImages[i].desc;
+			const RenderGraphImageDesc& desc = resources[i].imageDesc;
+			changed = current.format != desc.format || current.samples != desc.samples ||
+				current.extent.width != desc.extent.width || current.extent.height != desc.extent.height;
+		}
+		else
+		{
+			changed = physicalBuffers[i].size != resources[i].bufferSize;
+		}
+	}
+	if (!changed)
+	{
+		return;
+	}
+	releasePhysicalResources();
+	physicalResourcesDirty = false;
+	physicalImages.assign(resources.size(), {});
+	physicalBuffers.assign(resources.size(), {});
+	memoryStatistics = {};
+
+	std::vector<VkMemoryRequirements> memoryRequirements(resources.size());
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		if (aliasSlots[i] == NO_ALIAS_SLOT)
+		{
+			continue;
+		}
+		if (resources[i].isImage)
+		{
+			PhysicalImage& image = physicalImages[i];
+			image.desc = resources[i].imageDesc;
+
+			VkImageCreateInfo imageCreateInfo = {};
+			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageCreateInfo.extent.width = image.desc.extent.width;
+			imageCreateInfo.extent.height = image.desc.extent.height;
+			imageCreateInfo.extent.depth = 1;
+			imageCreateInfo.mipLevels = 1;
+			imageCreateInfo.arrayLayers = 1;
+			imageCreateInfo.format = image.desc.format;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageCreateInfo.usage = imageUsages[i] | (tileOnly[i] ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+			imageCreateInfo.samples = image.desc.samples;
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			VkResult result = vkCreateImage(device, &imageCreateInfo, nullptr, &image.image);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create render graph image " + resources[i].name);
+			}
+			vkGetImageMemoryRequirements(device, image.image, &memoryRequirements[i]);
+		}
+		else
+		{
+			PhysicalBuffer& buffer = physicalBuffers[i];
+			buffer.size = resources[i].bufferSize;
+
+			VkBufferCreateInfo bufferInfo = {};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = buffer.size;
+			bufferInfo.usage = bufferUsages[i];
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			VkResult result = vkCreateBuffer(device, &bufferInfo, nullptr, &buffer.buffer);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create render graph buffer " + resources[i].name);
+			}
+			vkGetBufferMemoryRequirements(device, buffer.buffer, &memoryRequirements[i]);
+		}
+	}
+
+	// One allocation per slot, big enough for its largest resource. A resource that cannot share the memory
+	// type of the rest of its slot gets an allocation of its own.
+	struct Allocation
+	{
+		VkDeviceSize size;
+		uint32_t memoryTypeBits;
+		bool tileOnly;
+	};
+	std::vector<Allocation> allocations(aliasSlotCount, { 0, ~0u, false });
+	std::vector<uint32_t> resourceAllocations(resources.size(), NO_ALIAS_SLOT);
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		if (aliasSlots[i] == NO_ALIAS_SLOT)
+		{
+			continue;
+		}
+		uint32_t allocation = aliasSlots[i];
+		if ((allocations[allocation].memoryTypeBits & memoryRequirements[i].memoryTypeBits) == 0)
+		{
+			allocation = static_cast<uint32_t>(allocations.size());
+			allocations.push_back({ 0, ~0u, false });
+		}
+		allocations[allocation].size = std::max(allocations[allocation].size, memoryRequirements[i].size);
+		allocations[allocation].memoryTypeBits &= memoryRequirements[i].memoryTypeBits;
+		allocations[allocation].tileOnly = tileOnly[i];
+		resourceAllocations[i] = allocation;
+
+		memoryStatistics.resourceCount++;
+		memoryStatistics.requiredBytes += memoryRequirements[i].size;
+	}
+
+	transientMemory.assign(allocations.size(), VK_NULL_HANDLE);
+	for (size_t a = 0; a < allocations.size(); a++)
+	{
+		if (allocations[a].size == 0)
+		{
+			continue;
+		}
+
+		// Attachments that never leave tile memory may not need backing at all, if the device has such a type
+		uint32_t memoryTypeIndex = 0;
+		bool lazy = allocations[a].tileOnly && findLazyMemoryTypeIndex(physicalDevice, allocations[a].memoryTypeBits,
+			&memoryTypeIndex);
+		if (!lazy && !memoryBudget->findMemoryTypeIndex(allocations[a].memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			allocations[a].size, &memoryTypeIndex))
+		{
+			throw std::runtime_error("Failed to find a suitable memory type");
+		}
+
+		VkMemoryAllocateInfo memoryAllocInfo = {};
+		memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memoryAllocInfo.allocationSize = allocations[a].size;
+		memoryAllocInfo.memoryTypeIndex = memoryTypeIndex;
+		VkResult result = memoryBudget->allocate(memoryAllocInfo, MemoryCategory::RenderTargets, MemoryPriority::Required,
+			&transientMemory[a]);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate render graph memory");
+		}
+
+		memoryStatistics.allocationCount++;
+		memoryStatistics.allocatedBytes += allocations[a].size;
+		if (lazy)
+		{
+			memoryStatistics.lazilyAllocatedBytes += allocations[a].size;
+		}
+	}
+
+	// Every resource starts at the beginning of its allocation, lifetimes keep them from overlapping in use
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		if (resourceAllocations[i] == NO_ALIAS_SLOT)
+		{
+			continue;
+		}
+		VkDeviceMemory memory = transientMemory[resourceAllocations[i]];
+		if (resources[i].isImage)
+		{
+			PhysicalImage& image = physicalImages[i];
+			vkBindImageMemory(device, image.image, memory, 0);
+			image.imageView = createImageView(device, image.image, image.desc.format, getAspectMask(image.desc.format));
+		}
+		else
+		{
+			vkBindBufferMemory(device, physicalBuffers[i].buffer, memory, 0);
+		}
+	}
+
+	if (memoryStatistics.resourceCount > 0)
+	{
+		const double mebibyte = 1024.0 * 1024.0;
+		VULKAN_CORE_INFO("Render graph transient memory: {:.2f} MiB allocated for {:.2f} MiB of resources, {:.2f} MiB lazily allocated",
+			memoryStatistics.allocatedBytes / mebibyte, memoryStatistics.requiredBytes / mebibyte,
+			memoryStatistics.lazilyAllocatedBytes / mebibyte);
+	}
+}
+
+void RenderGraph::releasePhysicalResources()
+{
+	RetiredObjects retired;
+	for (const PhysicalImage& image : physicalImages)
+	{
+		if (image.image != VK_NULL_HANDLE)
+		{
+			retired.images.push_back(image);
+		}
+	}
+	for (const PhysicalBuffer& buffer : physicalBuffers)
+	{
+		if (buffer.buffer != VK_NULL_HANDLE)
+		{
+			retired.buffers.push_back(buffer);
+		}
+	}
+	for (VkDeviceMemory memory : transientMemory)
+	{
+		if (memory != VK_NULL_HANDLE)
+		{
+			retired.memory.push_back(memory);
+		}
+	}
+	physicalImages.clear();
+	physicalBuffers.clear();
+	transientMemory.clear();
+	memoryStatistics = {};
+	if (retired.images.empty() && retired.buffers.empty() && retired.memory.empty())
+	{
+		return;
+	}
+
+	// Cached framebuffers can reference the replaced views
+	for (const auto& entry : framebufferCache)
+	{
+		retired.framebuffers.push_back(entry.second);
+	}
+	framebufferCache.clear();
+	retire(std::move(retired));
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers)
+{
+	if (barriers.empty())
+	{
+		return;
+	}
+
+	// Everything the pass needs is batched into a single call
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	std::vector<VkBufferMemoryBarrier> bufferBarriers;
+	VkPipelineStageFlags srcStageMask = 0;
+	VkPipelineStageFlags dstStageMask = 0;
+	for (const Barrier& barrier : barriers)
+	{
+		srcStageMask |= barrier.srcStageMask;
+		dstStageMask |= barrier.dstStageMask;
+		const Resource& resource = resources[barrier.resource];
+		if (resource.isImage)
+		{
+			VkImageMemoryBarrier imageBarrier = {};
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageBarrier.srcAccessMask = barrier.srcAccessMask;
+			imageBarrier.dstAccessMask = barrier.dstAccessMask;
+			imageBarrier.oldLayout = barrier.oldLayout;
+			imageBarrier.newLayout = barrier.newLayout;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = getImage(barrier.resource);
+			imageBarrier.subresourceRange.aspectMask = getAspectMask(resource.imageDesc.format);
+			imageBarrier.subresourceRange.baseMipLevel = 0;
+			imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+			imageBarrier.subresourceRange.baseArrayLayer = 0;
+			imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+			imageBarriers.push_back(imageBarrier);
+		}
+		else
+		{
+			VkBufferMemoryBarrier bufferBarrier = {};
+			bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			bufferBarrier.srcAccessMask = barrier.srcAccessMask;
+			bufferBarrier.dstAccessMask = barrier.dstAccessMask;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = getBuffer(barrier.resource);
+			bufferBarrier.offset = 0;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			bufferBarriers.push_back(bufferBarrier);
+		}
+	}
+
+	vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr,
+		static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+		static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+void RenderGraph::retire(RetiredObjects&& objects)
+{
+	// Everything submitted so far may still use them, the frame being recorded already uses the replacements
+	objects.timelineValue = timeline->getLastSubmittedValue();
+	retiredObjects.push_back(std::move(objects));
+}
+
+void RenderGraph::destroyRetiredObjects(bool destroyAll)
+{
+	while (!retiredObjects.empty())
+	{
+		RetiredObjects& retired = retiredObjects.front();
+		if (!destroyAll && !timeline->isComplete(retired.timelineValue))
+		{
+			break;
+		}
+		for (VkFramebuffer framebuffer : retired.framebuffers)
+		{
+			vkDestroyFramebuffer(device, framebuffer, nullptr);
+		}
+		for (const PhysicalImage& image : retired.images)
+		{
+			destroyImage(image);
+		}
+		for (const PhysicalBuffer& buffer : retired.buffers)
+		{
+			destroyBuffer(buffer);
+		}
+		for (VkDeviceMemory memory : retired.memory)
+		{
+			memoryBudget->free(memory);
+		}
+		retiredObjects.pop_front();
+	}
+}
+
+void RenderGraph::destroyImage(const PhysicalImage& image)
+{
+	if (image.image == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	vkDestroyImageView(device, image.imageView, nullptr);
+	vkDestroyImage(device, image.image, nullptr);
+}
+
+void RenderGraph::destroyBuffer(const PhysicalBuffer& buffer)
+{
+	if (buffer.buffer == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	vkDestroyBuffer(device, buffer.buffer, nullptr);
+}
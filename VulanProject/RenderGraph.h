@@ -0,0 +1,310 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "MemoryBudget.h"
+#include "QueueTimeline.h"
+
+// Index of a virtual resource, only valid for the frame it was declared in
+using RenderGraphResource = uint32_t;
+
+enum class RenderGraphPassType
+{
+	Graphics,
+	Compute
+};
+
+enum class RenderGraphUsage
+{
+	ColourAttachment,
+	DepthAttachment,
+	// Depth tested against but not written, e.g. an equal test after a depth prepass
+	DepthAttachmentReadOnly,
+	// Single sampled target a multisampled colour attachment is resolved into at the end of the subpass
+	ResolveAttachment,
+	// Read in the fragment shader at the same pixel, usually written by an earlier subpass of the same pass
+	InputAttachment,
+	DepthInputAttachment,
+	SampledImage,
+	StorageImageRead,
+	StorageImageWrite,
+	StorageBufferRead,
+	StorageBufferWrite,
+	IndirectBuffer
+};
+
+struct RenderGraphImageDesc
+{
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent = {};
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+// An image owned outside of the graph, such as the acquired swapchain image
+struct RenderGraphImportedImage
+{
+	VkImage image = VK_NULL_HANDLE;
+	VkImageView imageView = VK_NULL_HANDLE;
+	RenderGraphImageDesc desc;
+	// Layout at the start of the frame and the stages its first use has to wait for
+	VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkPipelineStageFlags initialStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	// Layout the image is handed over in after its last use, undefined leaves it as is
+	VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkPipelineStageFlags finalStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+};
+
+// Transient memory of the compiled graph, shared by every frame in flight
+struct RenderGraphMemoryStatistics
+{
+	uint32_t resourceCount = 0;
+	uint32_t allocationCount = 0;
+	// What the transient resources would take with an allocation each
+	VkDeviceSize requiredBytes = 0;
+	VkDeviceSize allocatedBytes = 0;
+	// Part of the allocated memory that tiled GPUs never have to back
+	VkDeviceSize lazilyAllocatedBytes = 0;
+};
+
+// What a pipeline drawing in a pass is created against, the render pass and subpass or with dynamic rendering the
+// formats of its attachments
+struct RenderGraphPipelineTarget
+{
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	uint32_t subpass = 0;
+	std::vector<VkFormat> colourFormats;
+	VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+	VkFormat stencilFormat = VK_FORMAT_UNDEFINED;
+};
+
+class RenderGraph;
+
+struct RenderGraphPassContext
+{
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	// Graphics passes are recorded inside their render pass with viewport and scissor covering the extent.
+	// With dynamic rendering it stays null and the pass is recorded between vkCmdBeginRenderingKHR and
+	// vkCmdEndRenderingKHR instead.
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	// Passes with several subpasses are executed once for each, the graph moves on to the next subpass in between
+	uint32_t subpass = 0;
+	VkExtent2D extent = {};
+	const RenderGraph* graph = nullptr;
+};
+
+// A pass only declares what it accesses, the graph works out the barriers and attachment operations around it
+class RenderGraphPass
+{
+public:
+	// Attachments are bound in the order they are declared. Without a clear value the previous
+	// contents are loaded if an earlier pass wrote them.
+	RenderGraphPass& writeColour(RenderGraphResource resource);
+	RenderGraphPass& writeColour(RenderGraphResource resource, const VkClearColorValue& clearColour);
+	RenderGraphPass& writeDepth(RenderGraphResource resource);
+	RenderGraphPass& writeDepth(RenderGraphResource resource, const VkClearDepthStencilValue& clearDepth);
+	RenderGraphPass& readDepth(RenderGraphResource resource);
+	// Resolves the multisampled colour attachment declared at the same position into the resource, inside the
+	// render pass so the samples never have to leave tile memory
+	RenderGraphPass& resolveColour(RenderGraphResource resource);
+	// Reads the attachment at the fragment's own pixel, in the order declared within the subpass. Colour inputs
+	// are read in shader read only layout, depth inputs in depth read only layout.
+	RenderGraphPass& readInput(RenderGraphResource resource);
+	RenderGraphPass& readDepthInput(RenderGraphResource resource);
+	// Accesses declared after this belong to the next subpass. Subpasses of a pass share one render pass, so
+	// attachments written in one and read as inputs in a later one can stay in tile memory. Such passes always
+	// use a render pass, even with dynamic rendering.
+	RenderGraphPass& nextSubpass();
+
+	RenderGraphPass& readTexture(RenderGraphResource resource);
+	RenderGraphPass& readStorageImage(RenderGraphResource resource);
+	// Storage writes are assumed to replace the whole resource, declare a read as well to keep earlier contents
+	RenderGraphPass& writeStorageImage(RenderGraphResource resource);
+	RenderGraphPass& readStorageBuffer(RenderGraphResource resource);
+	RenderGraphPass& writeStorageBuffer(RenderGraphResource resource);
+	RenderGraphPass& readIndirectBuffer(RenderGraphResource resource);
+
+	// Keeps the pass even when nothing in the graph reads what it writes
+	RenderGraphPass& setSideEffects();
+	RenderGraphPass& setExecute(std::function<void(const RenderGraphPassContext&)> newExecute);
+private:
+	friend class RenderGraph;
+
+	struct Access
+	{
+		RenderGraphResource resource;
+		RenderGraphUsage usage;
+		bool clear;
+		VkClearValue clearValue;
+		uint32_t subpass;
+	};
+
+	std::string name;
+	RenderGraphPassType type = RenderGraphPassType::Graphics;
+	std::vector<Access> accesses;
+	uint32_t subpassCount = 1;
+	bool sideEffects = false;
+	std::function<void(const RenderGraphPassContext&)> execute;
+
+	RenderGraphPass& addAccess(RenderGraphResource resource, RenderGraphUsage usage, const VkClearValue* clearValue);
+};
+
+// Passes and resources are declared again every frame. Compiling orders and culls the passes, works out
+// layouts, barriers and load/store operations, and is skipped while the declared topology stays the same.
+// Transient resources are created by the graph and shared by every frame in flight. With VK_KHR_dynamic_rendering
+// passes render straight into image views, otherwise render passes and framebuffers are created and cached.
+class RenderGraph
+{
+public:
+	RenderGraph();
+	void init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* newMemoryBudget,
+		QueueTimeline* newTimeline, bool dynamicRenderingSupported);
+	bool isDynamicRendering() const;
+
+	void reset();
+	RenderGraphResource importImage(const std::string& name, const RenderGraphImportedImage& image);
+	RenderGraphResource createImage(const std::string& name, const RenderGraphImageDesc& desc);
+	RenderGraphResource importBuffer(const std::string& name, VkBuffer buffer, VkDeviceSize size);
+	RenderGraphResource createBuffer(const std::string& name, VkDeviceSize size);
+	// The reference stays valid until the next reset
+	RenderGraphPass& addPass(const std::string& name, RenderGraphPassType type);
+
+	// Returns true when the topology changed and the graph was rebuilt
+	bool compile();
+	void execute(VkCommandBuffer commandBuffer);
+
+	// Null when the pass was culled or with dynamic rendering. Pipelines created against it stay compatible until
+	// the formats or sample counts of the pass's attachments change.
+	VkRenderPass getRenderPass(const std::string& passName) const;
+	RenderGraphPipelineTarget getPipelineTarget(const std::string& passName, uint32_t subpass = 0) const;
+	VkImage getImage(RenderGraphResource resource) const;
+	VkImageView getImageView(RenderGraphResource resource) const;
+	VkBuffer getBuffer(RenderGraphResource resource) const;
+
+	// Framebuffers hold on to image views, call before imported views are destroyed
+	void releaseFramebuffers();
+
+	uint32_t getPassCount() const;
+	uint32_t getCulledPassCount() const;
+	uint32_t getBarrierCount() const;
+	RenderGraphMemoryStatistics getMemoryStatistics() const;
+
+	void cleanup();
+private:
+	struct Resource
+	{
+		std::string name;
+		bool isImage;
+		bool imported;
+		RenderGraphImageDesc imageDesc;
+		VkDeviceSize bufferSize;
+		RenderGraphImportedImage importedImage;
+		VkBuffer importedBuffer;
+	};
+
+	struct Barrier
+	{
+		RenderGraphResource resource;
+		VkPipelineStageFlags srcStageMask;
+		VkPipelineStageFlags dstStageMask;
+		VkAccessFlags srcAccessMask;
+		VkAccessFlags dstAccessMask;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+	};
+
+	struct CompiledPass
+	{
+		uint32_t passIndex;
+		std::vector<Barrier> barriers;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		// Framebuffer attachments in render pass order, each resource once, with its first access in the pass for
+		// the clear value
+		std::vector<RenderGraphResource> attachments;
+		std::vector<uint32_t> attachmentAccesses;
+		std::vector<VkAttachmentLoadOp> loadOps;
+		std::vector<VkAttachmentStoreOp> storeOps;
+	};
+
+	// Bound to the memory of their alias slot rather than owning any
+	struct PhysicalImage
+	{
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView imageView = VK_NULL_HANDLE;
+		RenderGraphImageDesc desc;
+	};
+
+	struct PhysicalBuffer
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+	};
+
+	// Replaced objects are kept until every submit that could have used them has finished
+	struct RetiredObjects
+	{
+		uint64_t timelineValue = 0;
+		std::vector<VkFramebuffer> framebuffers;
+		std::vector<PhysicalImage> images;
+		std::vector<PhysicalBuffer> buffers;
+		std::vector<VkDeviceMemory> memory;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryBudget* memoryBudget = nullptr;
+	QueueTimeline* timeline = nullptr;
+	bool dynamicRendering = false;
+	PFN_vkCmdBeginRenderingKHR cmdBeginRendering = nullptr;
+	PFN_vkCmdEndRenderingKHR cmdEndRendering = nullptr;
+
+	// Declared this frame
+	std::vector<Resource> resources;
+	std::deque<RenderGraphPass> passes;
+
+	// Compiled from the last topology that differed
+	std::vector<uint64_t> compiledTopology;
+	std::vector<CompiledPass> compiledPasses;
+	std::vector<Barrier> finalBarriers;
+	std::vector<VkImageUsageFlags> imageUsages;
+	std::vector<VkBufferUsageFlags> bufferUsages;
+	std::vector<bool> tileOnly;
+	// Transient resources in one slot have disjoint lifetimes and share its memory
+	std::vector<uint32_t> aliasSlots;
+	uint32_t aliasSlotCount = 0;
+	uint32_t barrierCount = 0;
+
+	// Indexed by resource, only transient entries are filled in
+	std::vector<PhysicalImage> physicalImages;
+	std::vector<PhysicalBuffer> physicalBuffers;
+	std::vector<VkDeviceMemory> transientMemory;
+	bool physicalResourcesDirty = true;
+	RenderGraphMemoryStatistics memoryStatistics;
+
+	std::map<std::vector<uint32_t>, VkRenderPass> renderPassCache;
+	std::map<std::vector<uint64_t>, VkFramebuffer> framebufferCache;
+	std::deque<RetiredObjects> retiredObjects;
+
+	std::vector<uint64_t> buildTopology() const;
+	// True when an earlier subpass of the same pass replaced the contents this access sees
+	bool isWrittenInEarlierSubpass(const RenderGraphPass& pass, uint32_t accessIndex) const;
+	VkRenderPass getOrCreateRenderPass(const RenderGraphPass& pass, const std::vector<RenderGraphResource>& attachments,
+		const std::vector<uint32_t>& attachmentAccesses, const std::vector<VkAttachmentLoadOp>& loadOps,
+		const std::vector<VkAttachmentStoreOp>& storeOps);
+	VkFramebuffer getOrCreateFramebuffer(const CompiledPass& compiledPass, VkExtent2D extent);
+	void beginRenderPass(VkCommandBuffer commandBuffer, const CompiledPass& compiledPass, VkExtent2D extent);
+	void beginRendering(VkCommandBuffer commandBuffer, const CompiledPass& compiledPass, VkExtent2D extent);
+	void createPhysicalResources();
+	void releasePhysicalResources();
+	void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers);
+	void retire(RetiredObjects&& objects);
+	void destroyRetiredObjects(bool destroyAll);
+	void destroyImage(const PhysicalImage& image);
+	void destroyBuffer(const PhysicalBuffer& buffer);
+};
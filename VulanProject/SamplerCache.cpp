@@ -0,0 +1,87 @@
+#include "SamplerCache.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+bool SamplerState::operator==(const SamplerState& other) const
+{
+	return magFilter == other.magFilter && minFilter == other.minFilter && mipmapMode == other.mipmapMode &&
+		addressMode == other.addressMode && maxAnisotropy == other.maxAnisotropy && maxLod == other.maxLod;
+}
+
+size_t SamplerStateHash::operator()(const SamplerState& state) const
+{
+	size_t seed = std::hash<uint32_t>()(state.magFilter | (state.minFilter << 4) | (state.mipmapMode << 8) |
+		(state.addressMode << 12));
+	seed ^= std::hash<float>()(state.maxAnisotropy) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	seed ^= std::hash<float>()(state.maxLod) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	return seed;
+}
+
+SamplerCache::SamplerCache()
+{
+}
+
+void SamplerCache::init(VkDevice newDevice, float newDeviceMaxAnisotropy)
+{
+	device = newDevice;
+	deviceMaxAnisotropy = newDeviceMaxAnisotropy;
+}
+
+VkSampler SamplerCache::getSampler(const SamplerState& state)
+{
+	// Clamp first so requests that end up identical on this device share a sampler
+	SamplerState clampedState = state;
+	clampedState.maxAnisotropy = std::min(state.maxAnisotropy, deviceMaxAnisotropy);
+	if (clampedState.maxAnisotropy <= 1.0f)
+	{
+		clampedState.maxAnisotropy = 1.0f;
+	}
+
+	auto cached = samplers.find(clampedState);
+	if (cached != samplers.end())
+	{
+		return cached->second;
+	}
+
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter = clampedState.magFilter;
+	samplerCreateInfo.minFilter = clampedState.minFilter;
+	samplerCreateInfo.mipmapMode = clampedState.mipmapMode;
+	samplerCreateInfo.addressModeU = clampedState.addressMode;
+	samplerCreateInfo.addressModeV = clampedState.addressMode;
+	samplerCreateInfo.addressModeW = clampedState.addressMode;
+	samplerCreateInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerCreateInfo.mipLodBias = 0.0f;
+	samplerCreateInfo.minLod = 0.0f;
+	samplerCreateInfo.maxLod = clampedState.maxLod;
+	samplerCreateInfo.anisotropyEnable = clampedState.maxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+	samplerCreateInfo.maxAnisotropy = clampedState.maxAnisotropy;
+
+	VkSampler sampler;
+	VkResult result = vkCreateSampler(device, &samplerCreateInfo, nullptr, &sampler);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a texture sampler");
+	}
+
+	samplers.emplace(clampedState, sampler);
+	return sampler;
+}
+
+uint32_t SamplerCache::getSamplerCount()
+{
+	return static_cast<uint32_t>(samplers.size());
+}
+
+void SamplerCache::cleanup()
+{
+	for (auto& sampler : samplers)
+	{
+		vkDestroySampler(device, sampler.second, nullptr);
+	}
+	samplers.clear();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <unordered_map>
+
+// The subset of VkSamplerCreateInfo textures are allowed to vary, samplers are shared per unique state
+struct SamplerState
+{
+	VkFilter magFilter = VK_FILTER_LINEAR;
+	VkFilter minFilter = VK_FILTER_LINEAR;
+	VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	float maxAnisotropy = 16.0f;
+	float maxLod = VK_LOD_CLAMP_NONE;
+
+	bool operator==(const SamplerState& other) const;
+};
+
+struct SamplerStateHash
+{
+	size_t operator()(const SamplerState& state) const;
+};
+
+class SamplerCache
+{
+public:
+	SamplerCache();
+	void init(VkDevice newDevice, float newDeviceMaxAnisotropy);
+
+	VkSampler getSampler(const SamplerState& state);
+	uint32_t getSamplerCount();
+
+	void cleanup();
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	// Zero when the samplerAnisotropy feature is not enabled
+	float deviceMaxAnisotropy = 0.0f;
+
+	std::unordered_map<SamplerState, VkSampler, SamplerStateHash> samplers;
+};
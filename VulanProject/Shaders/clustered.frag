@@ -0,0 +1,64 @@
+#version 450
+
+layout(location = 0) in vec3 fragCol;
+
+layout(location = 0) out vec4 outColour;
+
+struct Light
+{
+	vec3 position;
+	float radius;
+	vec3 colour;
+	float intensity;
+};
+
+// Set 0 holds the texture table, the lights follow in set 1. Has to match cluster_lights.comp.
+layout(std430, set = 1, binding = 0) readonly buffer ClusterFrame
+{
+	mat4 inverseProjection;
+	uvec4 grid;
+	vec4 screen;
+	uvec4 indexList;
+	Light lights[];
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer Clusters
+{
+	uvec2 clusters[];
+};
+
+layout(std430, set = 1, binding = 2) readonly buffer LightIndices
+{
+	uint lightIndices[];
+};
+
+const vec3 AMBIENT = vec3(0.2);
+
+void main()
+{
+	// Geometry is already in clip space, the view position is recovered with the grid's projection
+	vec2 ndc = gl_FragCoord.xy / screen.xy * 2.0 - 1.0;
+	vec4 view = inverseProjection * vec4(ndc, gl_FragCoord.z, 1.0);
+	vec3 viewPosition = view.xyz / view.w;
+
+	uvec2 tile = min(uvec2(gl_FragCoord.xy / screen.xy * vec2(grid.xy)), grid.xy - 1u);
+	float slice = log(-viewPosition.z / screen.z) / log(screen.w / screen.z) * float(grid.z);
+	uint cluster = tile.x + grid.x * (tile.y + grid.y * uint(clamp(slice, 0.0, float(grid.z - 1u))));
+	uvec2 run = clusters[cluster];
+
+	// Flat shaded, facing the viewer
+	vec3 normal = normalize(cross(dFdx(viewPosition), dFdy(viewPosition)));
+	normal = dot(normal, viewPosition) > 0.0 ? -normal : normal;
+
+	vec3 lighting = AMBIENT;
+	for (uint i = 0; i < run.y; i++)
+	{
+		Light light = lights[lightIndices[run.x + i]];
+		vec3 toLight = light.position - viewPosition;
+		float distanceSquared = dot(toLight, toLight);
+		float falloff = max(1.0 - distanceSquared / (light.radius * light.radius), 0.0);
+		float diffuse = max(dot(normal, toLight * inversesqrt(max(distanceSquared, 1e-8))), 0.0);
+		lighting += light.colour * light.intensity * falloff * falloff * diffuse;
+	}
+	outColour = vec4(fragCol * lighting, 1.0);
+}
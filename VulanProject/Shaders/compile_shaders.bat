@@ -1,3 +1,12 @@
 E:\Vulkan\Bin\glslangValidator.exe -V shader.vert
 E:\Vulkan\Bin\glslangValidator.exe -V shader.frag
+E:\Vulkan\Bin\glslangValidator.exe -V depth.vert -o depth_vert.spv
+E:\Vulkan\Bin\glslangValidator.exe -V cluster_lights.comp -o cluster_lights_comp.spv
+E:\Vulkan\Bin\glslangValidator.exe -V clustered.frag -o clustered_frag.spv
+E:\Vulkan\Bin\glslangValidator.exe -V gbuffer.frag -o gbuffer_frag.spv
+E:\Vulkan\Bin\glslangValidator.exe -V fullscreen.vert -o fullscreen_vert.spv
+E:\Vulkan\Bin\glslangValidator.exe -V deferred_lighting.frag -o deferred_lighting_frag.spv
+E:\Vulkan\Bin\glslangValidator.exe -V depth_pyramid.comp -o depth_pyramid_comp.spv
+E:\Vulkan\Bin\glslangValidator.exe -V occlusion_cull.comp -o occlusion_cull_comp.spv
+E:\Vulkan\Bin\glslangValidator.exe -V -DLATE_CULL occlusion_cull.comp -o occlusion_cull_late_comp.spv
 pause
\ No newline at end of file
@@ -0,0 +1,81 @@
+#version 450
+
+layout(location = 0) out vec4 outColour;
+
+// Written by the G-buffer subpass, read at this pixel without leaving tile memory
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput albedoInput;
+layout(input_attachment_index = 1, set = 0, binding = 1) uniform subpassInput normalInput;
+layout(input_attachment_index = 2, set = 0, binding = 2) uniform subpassInput depthInput;
+
+struct Light
+{
+	vec3 position;
+	float radius;
+	vec3 colour;
+	float intensity;
+};
+
+// Has to match cluster_lights.comp
+layout(std430, set = 1, binding = 0) readonly buffer ClusterFrame
+{
+	mat4 inverseProjection;
+	uvec4 grid;
+	vec4 screen;
+	uvec4 indexList;
+	Light lights[];
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer Clusters
+{
+	uvec2 clusters[];
+};
+
+layout(std430, set = 1, binding = 2) readonly buffer LightIndices
+{
+	uint lightIndices[];
+};
+
+const vec3 AMBIENT = vec3(0.2);
+
+vec3 decodeOctahedral(vec2 encoded)
+{
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0);
+	normal.x += normal.x >= 0.0 ? -fold : fold;
+	normal.y += normal.y >= 0.0 ? -fold : fold;
+	return normalize(normal);
+}
+
+void main()
+{
+	// Nothing was drawn here, the clear colour shows through
+	float depth = subpassLoad(depthInput).r;
+	if (depth >= 1.0)
+	{
+		discard;
+	}
+	vec3 albedo = subpassLoad(albedoInput).rgb;
+	vec3 normal = decodeOctahedral(subpassLoad(normalInput).rg * 2.0 - 1.0);
+
+	vec2 ndc = gl_FragCoord.xy / screen.xy * 2.0 - 1.0;
+	vec4 view = inverseProjection * vec4(ndc, depth, 1.0);
+	vec3 viewPosition = view.xyz / view.w;
+
+	// Same clusters and falloff as clustered.frag
+	uvec2 tile = min(uvec2(gl_FragCoord.xy / screen.xy * vec2(grid.xy)), grid.xy - 1u);
+	float slice = log(-viewPosition.z / screen.z) / log(screen.w / screen.z) * float(grid.z);
+	uint cluster = tile.x + grid.x * (tile.y + grid.y * uint(clamp(slice, 0.0, float(grid.z - 1u))));
+	uvec2 run = clusters[cluster];
+
+	vec3 lighting = AMBIENT;
+	for (uint i = 0; i < run.y; i++)
+	{
+		Light light = lights[lightIndices[run.x + i]];
+		vec3 toLight = light.position - viewPosition;
+		float distanceSquared = dot(toLight, toLight);
+		float falloff = max(1.0 - distanceSquared / (light.radius * light.radius), 0.0);
+		float diffuse = max(dot(normal, toLight * inversesqrt(max(distanceSquared, 1e-8))), 0.0);
+		lighting += light.colour * light.intensity * falloff * falloff * diffuse;
+	}
+	outColour = vec4(albedo * lighting, 1.0);
+}
\ No newline at end of file
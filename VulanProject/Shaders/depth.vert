@@ -0,0 +1,11 @@
+#version 450
+
+// Positions only, computed exactly as in shader.vert so the colour pass can test for equal depth
+layout(location = 0) in vec3 pos;
+
+invariant gl_Position;
+
+void main()
+{
+	gl_Position = vec4(pos, 1.0);
+}
\ No newline at end of file
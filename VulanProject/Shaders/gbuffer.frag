@@ -0,0 +1,45 @@
+#version 450
+
+layout(location = 0) in vec3 fragCol;
+
+// Albedo at 8 bits per channel, the normal octahedral encoded into two 10 bit channels
+layout(location = 0) out vec4 outAlbedo;
+layout(location = 1) out vec4 outNormal;
+
+struct Light
+{
+	vec3 position;
+	float radius;
+	vec3 colour;
+	float intensity;
+};
+
+// Only the header is read here, for the projection the geometry is lit with. Has to match cluster_lights.comp.
+layout(std430, set = 1, binding = 0) readonly buffer ClusterFrame
+{
+	mat4 inverseProjection;
+	uvec4 grid;
+	vec4 screen;
+	uvec4 indexList;
+	Light lights[];
+};
+
+vec2 encodeOctahedral(vec3 normal)
+{
+	normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+	vec2 folded = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+	return normal.z >= 0.0 ? normal.xy : folded;
+}
+
+void main()
+{
+	// Same flat normal as the forward path, from the view position the lighting subpass reconstructs from depth
+	vec2 ndc = gl_FragCoord.xy / screen.xy * 2.0 - 1.0;
+	vec4 view = inverseProjection * vec4(ndc, gl_FragCoord.z, 1.0);
+	vec3 viewPosition = view.xyz / view.w;
+	vec3 normal = normalize(cross(dFdx(viewPosition), dFdy(viewPosition)));
+	normal = dot(normal, viewPosition) > 0.0 ? -normal : normal;
+
+	outAlbedo = vec4(fragCol, 1.0);
+	outNormal = vec4(encodeOctahedral(normal) * 0.5 + 0.5, 0.0, 0.0);
+}
\ No newline at end of file
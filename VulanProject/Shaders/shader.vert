@@ -5,6 +5,9 @@ layout(location = 1) in vec3 col;
 
 layout(location = 0) out vec3 fragCol;
 
+// Has to match the depth prepass bit for bit
+invariant gl_Position;
+
 void main()
 {
 	gl_Position = vec4(pos, 1.0);
@@ -0,0 +1,411 @@
+#include "Texture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <stdexcept>
+
+#include "Log.h"
+#include "Utilities.h"
+
+namespace
+{
+	// Eviction stops shrinking a texture once its longer side would drop below this
+	constexpr uint32_t MIN_EVICTED_TEXTURE_SIZE = 64;
+
+	// Transfer source as well, eviction copies the smaller levels out into a new image
+	constexpr VkImageUsageFlags TEXTURE_USAGE = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+		VK_IMAGE_USAGE_SAMPLED_BIT;
+}
+
+TextureManager::TextureManager()
+{
+}
+
+void TextureManager::init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* newMemoryBudget,
+	QueueTimeline* newTransferTimeline, DeletionQueue* newDeletionQueue, VkCommandPool newTransferCommandPool,
+	BindlessDescriptorTable* newDescriptorTable, float maxAnisotropy)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+	memoryBudget = newMemoryBudget;
+	transferTimeline = newTransferTimeline;
+	deletionQueue = newDeletionQueue;
+	transferCommandPool = newTransferCommandPool;
+	descriptorTable = newDescriptorTable;
+	samplerCache.init(device, maxAnisotropy);
+
+	memoryBudget->addEvictionHandler([this](uint32_t heapIndex, VkDeviceSize bytes)
+	{
+		return evictTextures(heapIndex, bytes);
+	});
+}
+
+uint32_t TextureManager::createTexture(const std::string& fileName, bool srgb, const SamplerState& samplerState)
+{
+	const std::string filePath = "Textures/" + fileName;
+	if (isTextureContainerFile(fileName))
+	{
+		return createTexture(loadTextureContainer(filePath), samplerState);
+	}
+
+	ImageData imageData = loadImage(filePath);
+	return createTexture(imageData, srgb, samplerState);
+}
+
+uint32_t TextureManager::createTexture(const ImageData& imageData, bool srgb, const SamplerState& samplerState)
+{
+	Texture texture = {};
+	texture.width = imageData.width;
+	texture.height = imageData.height;
+	texture.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	if (texture.width == 0 || texture.height == 0)
+	{
+		throw std::runtime_error("Texture image has no pixels");
+	}
+
+	// Full chain down to 1x1, blits need linear filtering support for the format
+	texture.mipLevels = 1;
+	if (supportsLinearBlit(texture.format))
+	{
+		texture.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texture.width, texture.height)))) + 1;
+	}
+	else
+	{
+		VULKAN_CORE_WARN("Texture format does not support linear blits, mip generation skipped");
+	}
+
+	TextureMipLevel baseLevel = {};
+	baseLevel.size = imageData.pixels.size();
+	baseLevel.width = texture.width;
+	baseLevel.height = texture.height;
+	uploadTexture(texture, imageData.pixels.data(), { baseLevel }, texture.mipLevels > 1);
+
+	return registerTexture(texture, samplerState);
+}
+
+uint32_t TextureManager::createTexture(const TextureContainer& container, const SamplerState& samplerState)
+{
+	Texture texture = {};
+	texture.width = container.width;
+	texture.height = container.height;
+	texture.mipLevels = static_cast<uint32_t>(container.mipLevels.size());
+	texture.format = container.format;
+
+	const uint8_t* fileData = container.fileData.getBytes();
+	if (supportsSampling(container.format))
+	{
+		uploadTexture(texture, fileData, container.mipLevels, false);
+		return registerTexture(texture, samplerState);
+	}
+
+	BlockFormat blockFormat;
+	bool srgb;
+	if (!getCpuDecodableFormat(container.format, &blockFormat, &srgb))
+	{
+		throw std::runtime_error("Texture format is not supported by the device and has no CPU decoder");
+	}
+	VULKAN_CORE_WARN("Block compressed format {} not supported by the device, transcoding on the CPU",
+		static_cast<int>(container.format));
+
+	std::vector<uint8_t> pixels;
+	std::vector<TextureMipLevel> decodedLevels;
+	for (const auto& mipLevel : container.mipLevels)
+	{
+		std::vector<uint8_t> decoded = decodeBlocks(blockFormat, fileData + mipLevel.offset, mipLevel.width, mipLevel.height);
+
+		TextureMipLevel decodedLevel = mipLevel;
+		decodedLevel.offset = pixels.size();
+		decodedLevel.size = decoded.size();
+		decodedLevels.push_back(decodedLevel);
+		pixels.insert(pixels.end(), decoded.begin(), decoded.end());
+	}
+
+	texture.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	uploadTexture(texture, pixels.data(), decodedLevels, false);
+	return registerTexture(texture, samplerState);
+}
+
+const Texture& TextureManager::getTexture(uint32_t descriptorIndex)
+{
+	return textures.at(descriptorIndex);
+}
+
+void TextureManager::destroyTexture(uint32_t descriptorIndex)
+{
+	auto texture = textures.find(descriptorIndex);
+	if (texture == textures.end())
+	{
+		return;
+	}
+
+	// Frames in flight may still sample it, and the index must not be handed to another texture before they finish
+	Texture retired = texture->second;
+	textures.erase(texture);
+	deletionQueue->retire([this, descriptorIndex, retired]() mutable
+	{
+		descriptorTable->removeTexture(descriptorIndex);
+		destroyTextureResources(retired);
+	});
+}
+
+void TextureManager::cleanup()
+{
+	for (auto& texture : textures)
+	{
+		destroyTextureResources(texture.second);
+	}
+	textures.clear();
+	samplerCache.cleanup();
+}
+
+uint32_t TextureManager::registerTexture(Texture& texture, const SamplerState& samplerState)
+{
+	texture.imageView = createImageView(device, texture.image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT,
+		texture.mipLevels);
+	texture.sampler = samplerCache.getSampler(samplerState);
+
+	uint32_t descriptorIndex = descriptorTable->addTexture(texture.imageView, texture.sampler);
+	textures[descriptorIndex] = texture;
+
+	VULKAN_CORE_TRACE("Created {}x{} texture with {} mip levels, {} unique samplers", texture.width, texture.height,
+		texture.mipLevels, samplerCache.getSamplerCount());
+	return descriptorIndex;
+}
+
+bool TextureManager::supportsLinearBlit(VkFormat format)
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+	return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+}
+
+bool TextureManager::supportsSampling(VkFormat format)
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+	return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+void TextureManager::uploadTexture(Texture& texture, const uint8_t* data, const std::vector<TextureMipLevel>& allLevels,
+	bool generateMips)
+{
+	// Every stored level but the smallest is optional, the largest are left out until the image fits the budget.
+	// Generated chains only have their base level to upload from and are always created whole.
+	size_t firstLevel = 0;
+	while (!createImage(physicalDevice, device, allLevels[firstLevel].width, allLevels[firstLevel].height,
+		texture.mipLevels - static_cast<uint32_t>(firstLevel), texture.format, VK_IMAGE_TILING_OPTIMAL, TEXTURE_USAGE,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture.image, &texture.imageMemory, memoryBudget, MemoryCategory::Textures,
+		firstLevel + 1 < allLevels.size() ? MemoryPriority::Optional : MemoryPriority::Required))
+	{
+		firstLevel++;
+	}
+	if (firstLevel > 0)
+	{
+		VULKAN_CORE_WARN("Texture memory over budget, {}x{} texture loaded from its {}x{} level", texture.width,
+			texture.height, allLevels[firstLevel].width, allLevels[firstLevel].height);
+		texture.width = allLevels[firstLevel].width;
+		texture.height = allLevels[firstLevel].height;
+		texture.mipLevels -= static_cast<uint32_t>(firstLevel);
+	}
+	const std::span<const TextureMipLevel> levels(allLevels.data() + firstLevel, allLevels.size() - firstLevel);
+
+	VkDeviceSize stagingSize = 0;
+	for (const auto& level : levels)
+	{
+		stagingSize += level.size;
+	}
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingBuffer, &stagingBufferMemory, memoryBudget, MemoryCategory::Staging);
+
+	// Levels are packed back to back in the staging buffer, one copy region each
+	std::vector<VkBufferImageCopy> imageRegions(levels.size());
+	uint8_t* stagingData;
+	vkMapMemory(device, stagingBufferMemory, 0, stagingSize, 0, reinterpret_cast<void**>(&stagingData));
+	VkDeviceSize stagingOffset = 0;
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		memcpy(stagingData + stagingOffset, data + levels[i].offset, levels[i].size);
+
+		VkBufferImageCopy& imageRegion = imageRegions[i];
+		imageRegion = {};
+		imageRegion.bufferOffset = stagingOffset;
+		imageRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		imageRegion.imageSubresource.mipLevel = static_cast<uint32_t>(i);
+		imageRegion.imageSubresource.baseArrayLayer = 0;
+		imageRegion.imageSubresource.layerCount = 1;
+		imageRegion.imageOffset = { 0, 0, 0 };
+		imageRegion.imageExtent = { levels[i].width, levels[i].height, 1 };
+
+		stagingOffset += levels[i].size;
+	}
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	VkCommandBuffer commandBuffer = beginCommandBuffer(device, transferCommandPool);
+
+	transitionImageLayout(commandBuffer, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0, texture.mipLevels);
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(imageRegions.size()), imageRegions.data());
+
+	if (generateMips)
+	{
+		generateMipmaps(commandBuffer, texture);
+	}
+	else
+	{
+		transitionImageLayout(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, texture.mipLevels);
+	}
+
+	endAndSubmitCommandBuffer(device, transferCommandPool, *transferTimeline, commandBuffer);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	freeMemory(device, stagingBufferMemory, memoryBudget);
+}
+
+void TextureManager::generateMipmaps(VkCommandBuffer commandBuffer, const Texture& texture)
+{
+	int32_t mipWidth = static_cast<int32_t>(texture.width);
+	int32_t mipHeight = static_cast<int32_t>(texture.height);
+
+	// Each level is blitted from the previous one, which is then done and can be handed to the shaders
+	for (uint32_t i = 1; i < texture.mipLevels; i++)
+	{
+		transitionImageLayout(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, i - 1, 1);
+
+		VkImageBlit blit = {};
+		blit.srcOffsets[0] = { 0, 0, 0 };
+		blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = i - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = 1;
+		blit.dstOffsets[0] = { 0, 0, 0 };
+		blit.dstOffsets[1] = { std::max(mipWidth / 2, 1), std::max(mipHeight / 2, 1), 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = i;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = 1;
+
+		vkCmdBlitImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		transitionImageLayout(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, i - 1, 1);
+
+		mipWidth = std::max(mipWidth / 2, 1);
+		mipHeight = std::max(mipHeight / 2, 1);
+	}
+
+	// Last level was only ever written to
+	transitionImageLayout(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.mipLevels - 1, 1);
+}
+
+VkDeviceSize TextureManager::evictTextures(uint32_t heapIndex, VkDeviceSize bytes)
+{
+	// Largest first, each texture loses at most one level per eviction
+	std::vector<std::pair<VkDeviceSize, uint32_t>> candidates;
+	for (const auto& [descriptorIndex, texture] : textures)
+	{
+		if (texture.mipLevels > 1 && std::max(texture.width, texture.height) / 2 >= MIN_EVICTED_TEXTURE_SIZE &&
+			memoryBudget->getHeapIndex(texture.imageMemory) == heapIndex)
+		{
+			candidates.push_back({ memoryBudget->getAllocationSize(texture.imageMemory), descriptorIndex });
+		}
+	}
+	if (candidates.empty())
+	{
+		return 0;
+	}
+	std::sort(candidates.begin(), candidates.end(), std::greater<>());
+
+	// Any frame in flight can be sampling the images and their descriptors are about to change
+	transferTimeline->wait(transferTimeline->getLastSubmittedValue());
+
+	VkDeviceSize freed = 0;
+	for (const auto& candidate : candidates)
+	{
+		if (freed >= bytes)
+		{
+			break;
+		}
+		freed += dropTopMipLevel(candidate.second);
+	}
+	return freed;
+}
+
+VkDeviceSize TextureManager::dropTopMipLevel(uint32_t descriptorIndex)
+{
+	Texture& texture = textures.at(descriptorIndex);
+
+	Texture reduced = texture;
+	reduced.width = std::max(texture.width / 2, 1u);
+	reduced.height = std::max(texture.height / 2, 1u);
+	reduced.mipLevels = texture.mipLevels - 1;
+	createImage(physicalDevice, device, reduced.width, reduced.height, reduced.mipLevels, reduced.format,
+		VK_IMAGE_TILING_OPTIMAL, TEXTURE_USAGE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &reduced.image,
+		&reduced.imageMemory, memoryBudget, MemoryCategory::Textures);
+
+	VkCommandBuffer commandBuffer = beginCommandBuffer(device, transferCommandPool);
+
+	transitionImageLayout(commandBuffer, texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 1, reduced.mipLevels);
+	transitionImageLayout(commandBuffer, reduced.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0, reduced.mipLevels);
+
+	// Level i + 1 of the old image becomes level i of the new one
+	std::vector<VkImageCopy> copyRegions(reduced.mipLevels);
+	for (uint32_t i = 0; i < reduced.mipLevels; i++)
+	{
+		VkImageCopy& copyRegion = copyRegions[i];
+		copyRegion = {};
+		copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copyRegion.srcSubresource.mipLevel = i + 1;
+		copyRegion.srcSubresource.baseArrayLayer = 0;
+		copyRegion.srcSubresource.layerCount = 1;
+		copyRegion.dstSubresource = copyRegion.srcSubresource;
+		copyRegion.dstSubresource.mipLevel = i;
+		copyRegion.extent = { std::max(reduced.width >> i, 1u), std::max(reduced.height >> i, 1u), 1 };
+	}
+	vkCmdCopyImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, reduced.image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+
+	transitionImageLayout(commandBuffer, reduced.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, reduced.mipLevels);
+
+	endAndSubmitCommandBuffer(device, transferCommandPool, *transferTimeline, commandBuffer);
+
+	reduced.imageView = createImageView(device, reduced.image, reduced.format, VK_IMAGE_ASPECT_COLOR_BIT,
+		reduced.mipLevels);
+	descriptorTable->updateTexture(descriptorIndex, reduced.imageView, reduced.sampler);
+
+	// The replacement may have been placed in another heap, then the whole old image counts
+	VkDeviceSize freed = memoryBudget->getAllocationSize(texture.imageMemory);
+	if (memoryBudget->getHeapIndex(reduced.imageMemory) == memoryBudget->getHeapIndex(texture.imageMemory))
+	{
+		freed -= memoryBudget->getAllocationSize(reduced.imageMemory);
+	}
+
+	VULKAN_CORE_TRACE("Evicted the top mip level of texture {}, now {}x{}", descriptorIndex, reduced.width,
+		reduced.height);
+	destroyTextureResources(texture);
+	texture = reduced;
+	return freed;
+}
+
+void TextureManager::destroyTextureResources(Texture& texture)
+{
+	vkDestroyImageView(device, texture.imageView, nullptr);
+	vkDestroyImage(device, texture.image, nullptr);
+	freeMemory(device, texture.imageMemory, memoryBudget);
+	texture = {};
+}
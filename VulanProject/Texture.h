@@ -0,0 +1,72 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "BindlessDescriptors.h"
+#include "DeletionQueue.h"
+#include "ImageLoader.h"
+#include "MemoryBudget.h"
+#include "QueueTimeline.h"
+#include "SamplerCache.h"
+#include "TextureContainer.h"
+
+struct Texture
+{
+	VkImage image = VK_NULL_HANDLE;
+	VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+	VkImageView imageView = VK_NULL_HANDLE;
+	VkSampler sampler = VK_NULL_HANDLE;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t mipLevels = 1;
+};
+
+// Textures give memory back to the budget by dropping their largest mip level, the descriptor index stays the same
+class TextureManager
+{
+public:
+	TextureManager();
+	void init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* newMemoryBudget,
+		QueueTimeline* newTransferTimeline, DeletionQueue* newDeletionQueue, VkCommandPool newTransferCommandPool,
+		BindlessDescriptorTable* newDescriptorTable, float maxAnisotropy);
+
+	// Returns the descriptor index shaders use to refer to the texture
+	uint32_t createTexture(const std::string& fileName, bool srgb = true, const SamplerState& samplerState = SamplerState());
+	uint32_t createTexture(const ImageData& imageData, bool srgb, const SamplerState& samplerState);
+	// Uploads the stored mip chain as is, transcoding on the CPU when the device cannot sample the format. Over
+	// budget the largest levels are left out.
+	uint32_t createTexture(const TextureContainer& container, const SamplerState& samplerState);
+
+	const Texture& getTexture(uint32_t descriptorIndex);
+	// The image and the descriptor index are released once the frames already submitted have finished
+	void destroyTexture(uint32_t descriptorIndex);
+
+	void cleanup();
+private:
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryBudget* memoryBudget = nullptr;
+	QueueTimeline* transferTimeline = nullptr;
+	DeletionQueue* deletionQueue = nullptr;
+	VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+	BindlessDescriptorTable* descriptorTable = nullptr;
+
+	SamplerCache samplerCache;
+	std::unordered_map<uint32_t, Texture> textures;
+
+	uint32_t registerTexture(Texture& texture, const SamplerState& samplerState);
+	bool supportsLinearBlit(VkFormat format);
+	bool supportsSampling(VkFormat format);
+	void uploadTexture(Texture& texture, const uint8_t* data, const std::vector<TextureMipLevel>& allLevels,
+		bool generateMips);
+	void generateMipmaps(VkCommandBuffer commandBuffer, const Texture& texture);
+	VkDeviceSize evictTextures(uint32_t heapIndex, VkDeviceSize bytes);
+	// Replaces the image with a copy of every level but the first, returns the bytes freed in its heap
+	VkDeviceSize dropTopMipLevel(uint32_t descriptorIndex);
+	void destroyTextureResources(Texture& texture);
+};
@@ -0,0 +1,336 @@
+#include "TextureContainer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+	constexpr size_t KTX2_HEADER_SIZE = 80;
+	constexpr size_t KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+
+	constexpr size_t DDS_HEADER_SIZE = 128;
+	constexpr size_t DDS_DX10_HEADER_SIZE = 20;
+	constexpr uint32_t DDS_PIXEL_FORMAT_FOURCC = 0x4;
+
+	// Larger than any device can create, keeps level sizes well inside size_t
+	constexpr uint32_t MAX_TEXTURE_DIMENSION = 65536;
+
+	constexpr uint32_t makeFourCC(char a, char b, char c, char d)
+	{
+		return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) |
+			(static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+	}
+
+	template <typename T>
+	T readValue(std::span<const char> data, size_t offset)
+	{
+		if (offset + sizeof(T) > data.size())
+		{
+			throw std::runtime_error("Texture container is truncated");
+		}
+		T value;
+		memcpy(&value, data.data() + offset, sizeof(T));
+		return value;
+	}
+
+	bool hasSuffix(const std::string& fileName, const std::string& suffix)
+	{
+		if (fileName.size() < suffix.size())
+		{
+			return false;
+		}
+		return std::equal(suffix.rbegin(), suffix.rend(), fileName.rbegin(), [](char a, char b)
+		{
+			return tolower(static_cast<unsigned char>(a)) == tolower(static_cast<unsigned char>(b));
+		});
+	}
+
+	// Bytes per 4x4 block, zero for formats that are not block compressed
+	uint32_t getBlockSize(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+			return 8;
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
+	// Bytes per texel for the uncompressed formats a KTX2 file may hold, zero for anything else
+	uint32_t getTexelSize(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R8_UNORM:
+		case VK_FORMAT_R8_SRGB:
+			return 1;
+		case VK_FORMAT_R8G8_UNORM:
+		case VK_FORMAT_R8G8_SRGB:
+		case VK_FORMAT_R16_UNORM:
+		case VK_FORMAT_R16_SFLOAT:
+			return 2;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+		case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+		case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+		case VK_FORMAT_R16G16_UNORM:
+		case VK_FORMAT_R16G16_SFLOAT:
+		case VK_FORMAT_R32_SFLOAT:
+			return 4;
+		case VK_FORMAT_R16G16B16A16_UNORM:
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+		case VK_FORMAT_R32G32_SFLOAT:
+			return 8;
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
+	// Bytes a level of the format needs, dimensions are already bounded by MAX_TEXTURE_DIMENSION
+	size_t getLevelSize(VkFormat format, uint32_t width, uint32_t height)
+	{
+		const uint32_t blockSize = getBlockSize(format);
+		if (blockSize > 0)
+		{
+			return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+		}
+		const uint32_t texelSize = getTexelSize(format);
+		if (texelSize == 0)
+		{
+			throw std::runtime_error("Unsupported texture container format");
+		}
+		return static_cast<size_t>(width) * height * texelSize;
+	}
+
+	// Rejects empty or oversized images and returns the level count clamped to a full mip chain, so the level
+	// loops never shift by 32 or more and never size their arrays from an untrusted count
+	uint32_t validateLevelCount(const TextureContainer& container, uint32_t levelCount)
+	{
+		if (container.width == 0 || container.height == 0 ||
+			container.width > MAX_TEXTURE_DIMENSION || container.height > MAX_TEXTURE_DIMENSION)
+		{
+			throw std::runtime_error("Texture container has invalid dimensions");
+		}
+		const uint32_t fullChainLength = static_cast<uint32_t>(std::bit_width(std::max(container.width, container.height)));
+		return std::clamp(levelCount, 1u, fullChainLength);
+	}
+
+	VkFormat getDxgiFormat(uint32_t dxgiFormat)
+	{
+		switch (dxgiFormat)
+		{
+		case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+		case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+		case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+		case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+		case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+		case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+		case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+		case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+		case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+		case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+		case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+		case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+		case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+		default: return VK_FORMAT_UNDEFINED;
+		}
+	}
+
+	VkFormat getFourCCFormat(uint32_t fourCC)
+	{
+		switch (fourCC)
+		{
+		case makeFourCC('D', 'X', 'T', '1'): return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		case makeFourCC('D', 'X', 'T', '3'): return VK_FORMAT_BC2_UNORM_BLOCK;
+		case makeFourCC('D', 'X', 'T', '5'): return VK_FORMAT_BC3_UNORM_BLOCK;
+		case makeFourCC('A', 'T', 'I', '1'):
+		case makeFourCC('B', 'C', '4', 'U'): return VK_FORMAT_BC4_UNORM_BLOCK;
+		case makeFourCC('A', 'T', 'I', '2'):
+		case makeFourCC('B', 'C', '5', 'U'): return VK_FORMAT_BC5_UNORM_BLOCK;
+		default: return VK_FORMAT_UNDEFINED;
+		}
+	}
+
+	void loadKtx2(TextureContainer& container)
+	{
+		std::span<const char> data = container.fileData.getData();
+		if (data.size() < KTX2_HEADER_SIZE || memcmp(data.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+		{
+			throw std::runtime_error("Not a KTX2 file");
+		}
+
+		container.format = static_cast<VkFormat>(readValue<uint32_t>(data, 12));
+		container.width = readValue<uint32_t>(data, 20);
+		container.height = readValue<uint32_t>(data, 24);
+		const uint32_t depth = readValue<uint32_t>(data, 28);
+		const uint32_t layerCount = readValue<uint32_t>(data, 32);
+		const uint32_t faceCount = readValue<uint32_t>(data, 36);
+		const uint32_t levelCount = validateLevelCount(container, readValue<uint32_t>(data, 40));
+		const uint32_t supercompressionScheme = readValue<uint32_t>(data, 44);
+
+		// Basis Universal and zstd payloads need a transcoder first
+		if (container.format == VK_FORMAT_UNDEFINED || supercompressionScheme != 0)
+		{
+			throw std::runtime_error("Supercompressed KTX2 files are not supported");
+		}
+		if (depth > 1 || layerCount > 1 || faceCount != 1)
+		{
+			throw std::runtime_error("Only single layer 2D KTX2 textures are supported");
+		}
+
+		container.mipLevels.resize(levelCount);
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			const size_t entry = KTX2_HEADER_SIZE + level * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+			TextureMipLevel& mipLevel = container.mipLevels[level];
+			mipLevel.offset = static_cast<size_t>(readValue<uint64_t>(data, entry));
+			mipLevel.size = static_cast<size_t>(readValue<uint64_t>(data, entry + 8));
+			mipLevel.width = std::max(container.width >> level, 1u);
+			mipLevel.height = std::max(container.height >> level, 1u);
+			if (mipLevel.size < getLevelSize(container.format, mipLevel.width, mipLevel.height))
+			{
+				throw std::runtime_error("KTX2 mip level is smaller than its dimensions require");
+			}
+		}
+	}
+
+	void loadDds(TextureContainer& container)
+	{
+		std::span<const char> data = container.fileData.getData();
+		if (data.size() < DDS_HEADER_SIZE || readValue<uint32_t>(data, 0) != makeFourCC('D', 'D', 'S', ' '))
+		{
+			throw std::runtime_error("Not a DDS file");
+		}
+
+		container.height = readValue<uint32_t>(data, 12);
+		container.width = readValue<uint32_t>(data, 16);
+		const uint32_t levelCount = validateLevelCount(container, readValue<uint32_t>(data, 28));
+		const uint32_t pixelFormatFlags = readValue<uint32_t>(data, 80);
+		const uint32_t fourCC = readValue<uint32_t>(data, 84);
+
+		if ((pixelFormatFlags & DDS_PIXEL_FORMAT_FOURCC) == 0)
+		{
+			throw std::runtime_error("Only block compressed DDS files are supported");
+		}
+
+		size_t offset = DDS_HEADER_SIZE;
+		if (fourCC == makeFourCC('D', 'X', '1', '0'))
+		{
+			container.format = getDxgiFormat(readValue<uint32_t>(data, DDS_HEADER_SIZE));
+			offset += DDS_DX10_HEADER_SIZE;
+		}
+		else
+		{
+			container.format = getFourCCFormat(fourCC);
+		}
+
+		if (container.format == VK_FORMAT_UNDEFINED)
+		{
+			throw std::runtime_error("Unsupported DDS pixel format");
+		}
+
+		container.mipLevels.resize(levelCount);
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			TextureMipLevel& mipLevel = container.mipLevels[level];
+			mipLevel.width = std::max(container.width >> level, 1u);
+			mipLevel.height = std::max(container.height >> level, 1u);
+			mipLevel.offset = offset;
+			mipLevel.size = getLevelSize(container.format, mipLevel.width, mipLevel.height);
+			offset += mipLevel.size;
+		}
+	}
+}
+
+bool isTextureContainerFile(const std::string& fileName)
+{
+	return hasSuffix(fileName, ".ktx2") || hasSuffix(fileName, ".dds");
+}
+
+TextureContainer loadTextureContainer(const std::string& fileName)
+{
+	TextureContainer container;
+	container.fileData.open(fileName);
+
+	if (hasSuffix(fileName, ".ktx2"))
+	{
+		loadKtx2(container);
+	}
+	else
+	{
+		loadDds(container);
+	}
+
+	const size_t fileSize = container.fileData.getSize();
+	for (const auto& mipLevel : container.mipLevels)
+	{
+		if (mipLevel.size > fileSize || mipLevel.offset > fileSize - mipLevel.size)
+		{
+			throw std::runtime_error("Texture container mip level is out of bounds: " + fileName);
+		}
+	}
+	return container;
+}
+
+bool getCpuDecodableFormat(VkFormat format, BlockFormat* blockFormat, bool* srgb)
+{
+	*srgb = false;
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		*srgb = true;
+		[[fallthrough]];
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		*blockFormat = BlockFormat::BC1;
+		return true;
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+		*srgb = true;
+		[[fallthrough]];
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+		*blockFormat = BlockFormat::BC2;
+		return true;
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+		*srgb = true;
+		[[fallthrough]];
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+		*blockFormat = BlockFormat::BC3;
+		return true;
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		*blockFormat = BlockFormat::BC4;
+		return true;
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+		*blockFormat = BlockFormat::BC5;
+		return true;
+	default:
+		return false;
+	}
+}
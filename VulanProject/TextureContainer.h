@@ -0,0 +1,35 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <vector>
+
+#include "BlockDecoder.h"
+#include "MappedFile.h"
+
+struct TextureMipLevel
+{
+	size_t offset = 0;
+	size_t size = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
+
+// Pre-built mip chain as stored in a KTX2 or DDS file, level 0 first
+struct TextureContainer
+{
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<TextureMipLevel> mipLevels;
+	// Level offsets point into the mapping, which stays open for as long as the container lives
+	MappedFile fileData;
+};
+
+bool isTextureContainerFile(const std::string& fileName);
+TextureContainer loadTextureContainer(const std::string& fileName);
+
+// CPU transcoding fallback for block formats the device cannot sample, false when no decoder exists
+bool getCpuDecodableFormat(VkFormat format, BlockFormat* blockFormat, bool* srgb);
@@ -0,0 +1,75 @@
+#include "UploadBatch.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "Utilities.h"
+
+namespace
+{
+	// Keeps every copy source suitably aligned for any vertex, index or storage data
+	constexpr VkDeviceSize UPLOAD_ALIGNMENT = 16;
+}
+
+UploadBatch::UploadBatch()
+{
+}
+
+void UploadBatch::begin(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* newMemoryBudget,
+	QueueTimeline* newTransferTimeline, VkCommandPool newTransferCommandPool, VkDeviceSize stagingSize)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+	memoryBudget = newMemoryBudget;
+	transferTimeline = newTransferTimeline;
+	transferCommandPool = newTransferCommandPool;
+	capacity = stagingSize > 0 ? stagingSize : UPLOAD_ALIGNMENT;
+	offset = 0;
+
+	createBuffer(physicalDevice, device, capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingBuffer, &stagingBufferMemory, memoryBudget, MemoryCategory::Staging);
+
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, capacity, 0, &data);
+	mappedData = static_cast<char*>(data);
+
+	commandBuffer = beginCommandBuffer(device, transferCommandPool);
+}
+
+void UploadBatch::uploadBuffer(VkBuffer destination, const void* data, VkDeviceSize size)
+{
+	if (offset + size > capacity)
+	{
+		throw std::runtime_error("Upload batch staging buffer is full");
+	}
+
+	memcpy(mappedData + offset, data, static_cast<size_t>(size));
+
+	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = offset;
+	copyRegion.dstOffset = 0;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer, destination, 1, &copyRegion);
+
+	offset += getAlignedSize(size);
+}
+
+void UploadBatch::submit()
+{
+	vkUnmapMemory(device, stagingBufferMemory);
+	mappedData = nullptr;
+
+	endAndSubmitCommandBuffer(device, transferCommandPool, *transferTimeline, commandBuffer);
+	commandBuffer = VK_NULL_HANDLE;
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	freeMemory(device, stagingBufferMemory, memoryBudget);
+	stagingBuffer = VK_NULL_HANDLE;
+	stagingBufferMemory = VK_NULL_HANDLE;
+}
+
+VkDeviceSize UploadBatch::getAlignedSize(VkDeviceSize size)
+{
+	return (size + UPLOAD_ALIGNMENT - 1) & ~(UPLOAD_ALIGNMENT - 1);
+}
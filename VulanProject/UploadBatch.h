@@ -0,0 +1,37 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "MemoryBudget.h"
+#include "QueueTimeline.h"
+
+// Collects many buffer uploads into one staging buffer and one command buffer so a whole
+// scene is transferred with a single submit and wait instead of one per buffer
+class UploadBatch
+{
+public:
+	UploadBatch();
+	void begin(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, MemoryBudget* newMemoryBudget,
+		QueueTimeline* newTransferTimeline, VkCommandPool newTransferCommandPool, VkDeviceSize stagingSize);
+
+	// Copies the data into staging memory now and records the transfer into the destination
+	void uploadBuffer(VkBuffer destination, const void* data, VkDeviceSize size);
+	void submit();
+
+	// Staging space an upload of the given size consumes
+	static VkDeviceSize getAlignedSize(VkDeviceSize size);
+private:
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryBudget* memoryBudget = nullptr;
+	QueueTimeline* transferTimeline = nullptr;
+	VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+	char* mappedData = nullptr;
+	VkDeviceSize capacity = 0;
+	VkDeviceSize offset = 0;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+};
@@ -1,12 +1,22 @@
 #pragma once
 
-#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
-const int MAX_FRAME_DRAWS = 2;
+#include "MemoryCategory.h"
+
+class MemoryBudget;
+class QueueTimeline;
+
+// Frames the CPU may record ahead of the GPU, the renderer's count is configurable up to the maximum
+const uint32_t MAX_FRAME_DRAWS = 4;
+const uint32_t DEFAULT_FRAME_DRAWS = 2;
 
 const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
@@ -35,68 +45,84 @@ struct SwapChainDetails {
 	std::vector<VkPresentModeKHR> presentationModes;
 };
 
+// Optional features probed on the chosen physical device
+struct DeviceCapabilities {
+	uint32_t apiVersion = VK_API_VERSION_1_0;
+	float maxSamplerAnisotropy = 0.0f;
+	bool textureCompressionBC = false;
+	bool textureCompressionETC2 = false;
+	bool textureCompressionASTC = false;
+	bool pipelineStatisticsQuery = false;
+	// Best supported of D32, D24S8 and D16
+	VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+	// Sample counts usable for both colour and depth attachments
+	VkSampleCountFlags msaaSampleCounts = VK_SAMPLE_COUNT_1_BIT;
+
+	bool descriptorIndexing = false;
+	uint32_t maxBindlessTextures = 0;
+
+	bool timelineSemaphore = false;
+	// VK_KHR_present_id + VK_KHR_present_wait
+	bool presentWait = false;
+	// VK_KHR_dynamic_rendering, core in 1.3 which the instance does not request
+	bool dynamicRendering = false;
+	// VK_EXT_extended_dynamic_state, lets cull and depth state be set while recording
+	bool extendedDynamicState = false;
+	// VK_EXT_memory_budget, heap budgets and usage as the driver sees them across every process
+	bool memoryBudget = false;
+};
+
 struct SwapchainImage
 {
 	VkImage image;
 	VkImageView imageView;
 };
 
-static std::vector<char> readFile(const std::string& filename)
-{
-	std::ifstream file(filename, std::ios::binary | std::ios::ate);
-	if (!file.is_open())
-	{
-		throw std::runtime_error("Failed to open a file");
-	}
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> fileBuffer(fileSize);
-	file.seekg(0);
-	file.read(fileBuffer.data(), fileSize);
-	file.close();
-	return fileBuffer;
-}
-
-static uint32_t findMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags properties)
+// Host visible buffer that stays mapped, for data the CPU rewrites every frame
+struct HostBuffer
 {
-	VkPhysicalDeviceMemoryProperties memoryProperties;
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	void* mapped = nullptr;
+	VkDeviceSize size = 0;
+};
 
-	for(uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
-	{
-		if((allowedTypes & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
-		{
-			return i;
-		}
-	}
-}
+uint32_t findMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags properties);
 
-static void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize bufferSize, VkBufferUsageFlags buffer_usage_flags,
-	VkMemoryPropertyFlags bufferProperties, VkBuffer* buffer, VkDeviceMemory* bufferMemory)
-{
-	VkBufferCreateInfo bufferInfo = {};
-	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferInfo.size = bufferSize;
-	bufferInfo.usage = buffer_usage_flags;
-	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-	VkResult result = vkCreateBuffer(device, &bufferInfo, nullptr, buffer);
-	if(result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create a vertex buffer");
-	}
+// Goes through the budget when there is one, which tracks the allocation and may place or refuse it,
+// otherwise takes the first memory type with the properties
+VkResult allocateMemory(VkPhysicalDevice physicalDevice, VkDevice device, const VkMemoryRequirements& memoryRequirements,
+	VkMemoryPropertyFlags properties, MemoryBudget* memoryBudget, MemoryCategory category, MemoryPriority priority,
+	VkDeviceMemory* memory);
 
-	VkMemoryRequirements memoryRequirements;
-	vkGetBufferMemoryRequirements(device, *buffer, &memoryRequirements);
+void freeMemory(VkDevice device, VkDeviceMemory memory, MemoryBudget* memoryBudget);
 
-	VkMemoryAllocateInfo memoryAllocInfo = {};
-	memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAllocInfo.allocationSize = memoryRequirements.size;
-	memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits,
-		bufferProperties);
-	result = vkAllocateMemory(device, &memoryAllocInfo, nullptr, bufferMemory);
-	if(result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate vertex buffer memory");
-	}
-	vkBindBufferMemory(device, *buffer, *bufferMemory, 0);
-}
\ No newline at end of file
+void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize bufferSize, VkBufferUsageFlags buffer_usage_flags,
+	VkMemoryPropertyFlags bufferProperties, VkBuffer* buffer, VkDeviceMemory* bufferMemory,
+	MemoryBudget* memoryBudget = nullptr, MemoryCategory category = MemoryCategory::Other);
+
+// Device local memory is only a preference, the budget falls back to plain host visible memory when no heap
+// with both has room
+HostBuffer createHostBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage,
+	MemoryBudget* memoryBudget, bool preferDeviceLocal = false);
+
+void destroyHostBuffer(VkDevice device, HostBuffer& hostBuffer, MemoryBudget* memoryBudget);
+
+VkCommandBuffer beginCommandBuffer(VkDevice device, VkCommandPool commandPool);
+
+// Only waits for this submission, frames already in flight on the same queue keep running
+void endAndSubmitCommandBuffer(VkDevice device, VkCommandPool commandPool, QueueTimeline& timeline, VkCommandBuffer commandBuffer);
+
+// Only returns false when the budget refused an optional image, nothing is left created then
+bool createImage(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t width, uint32_t height, uint32_t mipLevels,
+	VkFormat format, VkImageTiling tiling, VkImageUsageFlags usageFlags, VkMemoryPropertyFlags propertyFlags,
+	VkImage* image, VkDeviceMemory* imageMemory, MemoryBudget* memoryBudget = nullptr,
+	MemoryCategory category = MemoryCategory::Other, MemoryPriority priority = MemoryPriority::Required);
+
+VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags,
+	uint32_t mipLevels = 1, uint32_t baseMipLevel = 0);
+
+VkShaderModule createShaderModule(VkDevice device, std::span<const char> code);
+
+void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+	uint32_t baseMipLevel, uint32_t mipLevels);
@@ -1,12 +1,49 @@
 #include "VulkanRenderer.h"
 
+namespace
+{
+	const char* const DEPTH_PREPASS = "DepthPrepass";
+	const char* const FORWARD_PASS = "Forward";
+	// Second draw of the occlusion culled frame, for what the depth pyramid showed to be visible
+	const char* const LATE_FORWARD_PASS = "LateForward";
+	const char* const DEFERRED_PASS = "Deferred";
+	const uint32_t GBUFFER_SUBPASS = 0;
+	const uint32_t LIGHTING_SUBPASS = 1;
+
+	const VkDeviceSize GEOMETRY_BLOCK_SIZE = 32 * 1024 * 1024;
+	// Most a frame spends moving mesh buffers, in bytes copied and CPU time
+	const VkDeviceSize DEFRAGMENT_BYTES_PER_FRAME = 4 * 1024 * 1024;
+	const double DEFRAGMENT_MILLISECONDS_PER_FRAME = 0.5;
+
+	// Without a render pass, dynamic rendering pipelines name the formats they draw into instead
+	void setPipelineTarget(VkGraphicsPipelineCreateInfo& pipelineCreateInfo,
+		VkPipelineRenderingCreateInfoKHR& renderingCreateInfo, const RenderGraphPipelineTarget& target)
+	{
+		pipelineCreateInfo.renderPass = target.renderPass;
+		pipelineCreateInfo.subpass = target.subpass;
+		pipelineCreateInfo.pNext = nullptr;
+		if (target.renderPass != VK_NULL_HANDLE)
+		{
+			return;
+		}
+		renderingCreateInfo = {};
+		renderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+		renderingCreateInfo.colorAttachmentCount = static_cast<uint32_t>(target.colourFormats.size());
+		renderingCreateInfo.pColorAttachmentFormats = target.colourFormats.data();
+		renderingCreateInfo.depthAttachmentFormat = target.depthFormat;
+		renderingCreateInfo.stencilAttachmentFormat = target.stencilFormat;
+		pipelineCreateInfo.pNext = &renderingCreateInfo;
+	}
+}
+
 VulkanRenderer::VulkanRenderer()
 {
 }
 
-int VulkanRenderer::init(GLFWwindow* newWindow)
+int VulkanRenderer::init(GLFWwindow* newWindow, uint32_t newFramesInFlight)
 {
 	window = newWindow;
+	framesInFlight = std::clamp(newFramesInFlight, 1u, MAX_FRAME_DRAWS);
 
 	try
 	{
@@ -14,26 +51,37 @@ int VulkanRenderer::init(GLFWwindow* newWindow)
 		createDebugCallback();
 		createSurface();
 		getPhysicalDevice();
+		getDeviceCapabilities();
 		createLogicalDevice();
+		memoryBudget.init(mainDevice.physicalDevice, mainDevice.logicalDevice, deviceCapabilities.memoryBudget);
+		graphicsTimeline.init(mainDevice.logicalDevice, graphicsQueue, deviceCapabilities.timelineSemaphore);
+		deletionQueue.init(&graphicsTimeline);
+		geometryPool.init(mainDevice.physicalDevice, mainDevice.logicalDevice, &memoryBudget, &graphicsTimeline,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, GEOMETRY_BLOCK_SIZE,
+			MemoryCategory::Geometry);
+		descriptorAllocator.init(mainDevice.logicalDevice, framesInFlight);
+		createTextureDescriptors();
+		clusteredLighting.init(mainDevice.physicalDevice, mainDevice.logicalDevice, &memoryBudget, &descriptorAllocator,
+			framesInFlight, ClusterSettings());
+		createGBufferSetLayout();
+		occlusionCuller.init(mainDevice.physicalDevice, mainDevice.logicalDevice, &memoryBudget, &graphicsTimeline,
+			&descriptorAllocator, framesInFlight);
 
-		std::vector<Vertex> meshVertices = {
-			{{0.4,-0.4,0.0}, {1.0f,0.0f,0.0f}},
-			{{0.4, 0.4, 0.0}, {0.0f,1.0f,0.0f}},
-			{{-0.4,0.4,0.0}, {0.0f,0.0f,1.0f}},
-			{{-0.4,0.4,0.0}, {0.0f,0.0f,1.0f}},
-			{{-0.4,-0.4,0.0}, {1.0f,1.0f,0.0f}},
-			{{0.4, -0.4, 0.0}, {1.0f,0.0f,0.0f}},
-		};
-		firstMesh = Mesh(mainDevice.physicalDevice, mainDevice.logicalDevice, &meshVertices);
-		
 		createSwapChain();
-		createRenderPass();
+		// Pipelines are created against the render passes or attachment formats the graph compiles for the frame
+		renderGraph.init(mainDevice.physicalDevice, mainDevice.logicalDevice, &memoryBudget, &graphicsTimeline,
+			deviceCapabilities.dynamicRendering);
 		createGraphicsPipeline();
-		createFrameBuffers();
 		createCommandPool();
+		textureManager.init(mainDevice.physicalDevice, mainDevice.logicalDevice, &memoryBudget, &graphicsTimeline,
+			&deletionQueue, graphicsCommandPool, &bindlessTable, deviceCapabilities.maxSamplerAnisotropy);
+		createMesh("quad.mesh");
 		createCommandBuffers();
-		recordCommands();
+		lodSelector.init(LodSettings());
 		createSynchronisation();
+		framePacer.init(mainDevice.physicalDevice, mainDevice.logicalDevice,
+			getQueueFamilies(mainDevice.physicalDevice).graphicsFamily, deviceCapabilities.presentWait,
+			deviceCapabilities.pipelineStatisticsQuery, framesInFlight);
 	}
 	catch (const std::runtime_error& e)
 	{
@@ -46,33 +94,66 @@ int VulkanRenderer::init(GLFWwindow* newWindow)
 
 void VulkanRenderer::draw()
 {
-	vkWaitForFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame], VK_TRUE,
-		std::numeric_limits<uint64_t>::max());
-	vkResetFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame]);
-	
+	using Clock = std::chrono::steady_clock;
+	framePacer.beginFrame();
+	// Pick up any frame that finished since the last check before blocking on this slot
+	framePacer.collectCompletedFrames(graphicsTimeline.getCompletedValue());
+
+	const Clock::time_point gpuWaitStart = Clock::now();
+	graphicsTimeline.wait(frameTimelineValues[currentFrame]);
+	framePacer.frameSlotCompleted(currentFrame,
+		std::chrono::duration<double, std::milli>(Clock::now() - gpuWaitStart).count());
+	deletionQueue.collect();
+	// Evicts before anything of this frame is recorded
+	memoryBudget.update();
+
+	if (swapchainOutOfDate && !recreateSwapChain())
+	{
+		return;
+	}
+
 	uint32_t imageIndex;
-	vkAcquireNextImageKHR(mainDevice.logicalDevice, swapchain,
+	VkResult result = vkAcquireNextImageKHR(mainDevice.logicalDevice, swapchain,
 		std::numeric_limits<uint64_t>::max(), imageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex);
-	
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &imageAvailable[currentFrame];
-	VkPipelineStageFlags waitStages[] = {
-		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-	};
-	submitInfo.pWaitDstStageMask = waitStages;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &renderFinished[currentFrame];
+	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		// Nothing was submitted, the slot's timeline value is still complete so the next attempt does not wait
+		swapchainOutOfDate = true;
+		return;
+	}
+	if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+	{
+		throw std::runtime_error("Failed to acquire a swapchain image");
+	}
 
-	VkResult result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, drawFences[currentFrame]);
-	if (result != VK_SUCCESS)
+	// The image can still be in use by a different frame slot when images come back out of order,
+	// or when there are fewer swapchain images than frames in flight
+	if (!graphicsTimeline.isComplete(imageTimelineValues[imageIndex]))
 	{
-		throw std::runtime_error("Failed to submit command buffer to queue");
+		const Clock::time_point imageWaitStart = Clock::now();
+		graphicsTimeline.wait(imageTimelineValues[imageIndex]);
+		framePacer.addGpuWait(std::chrono::duration<double, std::milli>(Clock::now() - imageWaitStart).count());
 	}
 
+	descriptorAllocator.beginFrame(currentFrame);
+	recordCommands(imageIndex);
+
+	// The swapchain only works with binary semaphores, completion is tracked by the timeline value
+	VkPipelineStageFlags waitStages[] = {
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+	};
+	TimelineSubmitInfo submitInfo = {};
+	submitInfo.commandBuffers = std::span<const VkCommandBuffer>(&commandBuffers[currentFrame], 1);
+	submitInfo.waitSemaphores = std::span<const VkSemaphore>(&imageAvailable[currentFrame], 1);
+	submitInfo.waitStageMasks = waitStages;
+	submitInfo.signalSemaphores = std::span<const VkSemaphore>(&renderFinished[currentFrame], 1);
+
+	const uint64_t frameValue = graphicsTimeline.submit(submitInfo);
+	frameTimelineValues[currentFrame] = frameValue;
+	imageTimelineValues[imageIndex] = frameValue;
+	const uint64_t presentId = framePacer.frameSubmitted(currentFrame, frameValue, swapchain);
+	geometryPool.frameSubmitted(frameValue);
+
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.waitSemaphoreCount = 1;
@@ -81,42 +162,289 @@ void VulkanRenderer::draw()
 	presentInfo.pSwapchains = &swapchain;
 	presentInfo.pImageIndices = &imageIndex;
 
+	// Lets the frame pacer wait for and time this exact present
+	VkPresentIdKHR presentIdInfo = {};
+	presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+	presentIdInfo.swapchainCount = 1;
+	presentIdInfo.pPresentIds = &presentId;
+	if (presentId != 0)
+	{
+		presentInfo.pNext = &presentIdInfo;
+	}
+
 	result = vkQueuePresentKHR(presentationQueue, &presentInfo);
 
-	if (result != VK_SUCCESS)
+	// Suboptimal images were still presented, recreate before the next acquire
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+	{
+		swapchainOutOfDate = true;
+	}
+	else if (result != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to present image");
 	}
+	swapchainOutOfDate |= framebufferResized;
+
+	currentFrame = (currentFrame + 1) % framesInFlight;
+}
 
-	currentFrame = (currentFrame + 1) % MAX_FRAME_DRAWS;
+void VulkanRenderer::notifyFramebufferResized()
+{
+	framebufferResized = true;
+}
+
+void VulkanRenderer::setFramesInFlight(uint32_t count)
+{
+	count = std::clamp(count, 1u, MAX_FRAME_DRAWS);
+	if (count == framesInFlight)
+	{
+		return;
+	}
+
+	// Every per frame resource is rebuilt, nothing recorded against the old ones may still be running
+	vkDeviceWaitIdle(mainDevice.logicalDevice);
+	deletionQueue.flush();
+	destroySynchronisation();
+	vkFreeCommandBuffers(mainDevice.logicalDevice, graphicsCommandPool, static_cast<uint32_t>(commandBuffers.size()),
+		commandBuffers.data());
+
+	framesInFlight = count;
+	currentFrame = 0;
+	descriptorAllocator.setFrameCount(framesInFlight);
+	framePacer.setFrameCount(framesInFlight);
+	clusteredLighting.setFrameCount(framesInFlight);
+	occlusionCuller.setFrameCount(framesInFlight);
+	createCommandBuffers();
+	createSynchronisation();
+	VULKAN_CORE_INFO("Frames in flight set to {}", framesInFlight);
+}
+
+uint32_t VulkanRenderer::getFramesInFlight()
+{
+	return framesInFlight;
+}
+
+void VulkanRenderer::setLowLatencyMode(bool enabled)
+{
+	framePacer.setLowLatency(enabled);
+}
+
+bool VulkanRenderer::isLowLatencyMode()
+{
+	return framePacer.isLowLatency();
+}
+
+void VulkanRenderer::waitForFrameStart()
+{
+	framePacer.waitForFrameStart(swapchain);
+}
+
+FrameStatistics VulkanRenderer::getFrameStatistics()
+{
+	FrameStatistics statistics = framePacer.getStatistics();
+	statistics.descriptorSetsLastFrame = descriptorAllocator.getAllocationsLastFrame();
+	statistics.descriptorPoolCount = descriptorAllocator.getPoolCount();
+	return statistics;
+}
+
+void VulkanRenderer::resetFrameStatistics()
+{
+	framePacer.resetStatistics();
+}
+
+MemoryBudgetStatistics VulkanRenderer::getMemoryStatistics()
+{
+	return memoryBudget.getStatistics();
+}
+
+void VulkanRenderer::setMemoryBudgetLimit(VkDeviceSize limit)
+{
+	memoryBudget.setBudgetLimit(limit);
+}
+
+BufferPoolStatistics VulkanRenderer::getGeometryStatistics()
+{
+	return geometryPool.getStatistics();
+}
+
+void VulkanRenderer::setDepthPrepass(bool enabled)
+{
+	if (enabled && depthPrepassPipeline == VK_NULL_HANDLE)
+	{
+		VULKAN_CORE_WARN("Depth prepass is unavailable without Shaders/depth_vert.spv");
+		return;
+	}
+	// The graph picks up the different passes on the next frame, both sets of pipelines already exist
+	depthPrepass = enabled;
+}
+
+bool VulkanRenderer::isDepthPrepass()
+{
+	return depthPrepass;
+}
+
+void VulkanRenderer::setMsaaSamples(uint32_t samples)
+{
+	VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT;
+	for (VkSampleCountFlagBits candidate : { VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT })
+	{
+		if (candidate <= samples && (deviceCapabilities.msaaSampleCounts & candidate))
+		{
+			sampleCount = candidate;
+			break;
+		}
+	}
+	if (sampleCount == msaaSamples)
+	{
+		return;
+	}
+
+	// Pipelines are only compatible with render passes of the same sample count, frames still in flight keep
+	// the old ones until they finish
+	retireGraphicsPipelines();
+
+	msaaSamples = sampleCount;
+	createGraphicsPipeline();
+	VULKAN_CORE_INFO("MSAA set to {}x", static_cast<uint32_t>(msaaSamples));
+}
+
+uint32_t VulkanRenderer::getMsaaSamples()
+{
+	return msaaSamples;
+}
+
+void VulkanRenderer::setLights(const std::vector<PointLight>& lights)
+{
+	clusteredLighting.setLights(lights);
+}
+
+bool VulkanRenderer::isClusteredShading()
+{
+	return clusteredShading;
+}
+
+const ClusterSettings& VulkanRenderer::getClusterSettings()
+{
+	return clusteredLighting.getSettings();
+}
+
+ClusterValidationResult VulkanRenderer::validateClusteredLighting()
+{
+	return clusteredLighting.validate(graphicsCommandPool, graphicsTimeline, swapChainExtent);
+}
+
+void VulkanRenderer::setDeferredShading(bool enabled)
+{
+	if (enabled && gBufferPipeline == VK_NULL_HANDLE)
+	{
+		VULKAN_CORE_WARN("Deferred shading is unavailable without clustered lighting and the deferred shaders");
+		return;
+	}
+	// Pipelines for both paths already exist, the graph picks up the other passes on the next frame
+	deferredShading = enabled;
+}
+
+bool VulkanRenderer::isDeferredShading()
+{
+	return deferredShading;
+}
+
+void VulkanRenderer::setOcclusionCulling(bool enabled)
+{
+	// The pyramid samples the depth buffer, and views of a depth stencil format cannot be sampled as a whole
+	const bool depthOnly = deviceCapabilities.depthFormat != VK_FORMAT_D24_UNORM_S8_UINT;
+	if (enabled && (!occlusionCuller.isAvailable() || !depthOnly))
+	{
+		VULKAN_CORE_WARN("Occlusion culling is unavailable without the culling shaders and a depth only format");
+		return;
+	}
+	// Nothing is created up front, the culled frame draws with the forward pipeline
+	occlusionCulling = enabled;
+}
+
+bool VulkanRenderer::isOcclusionCulling()
+{
+	return occlusionCulling;
+}
+
+bool VulkanRenderer::recreateSwapChain()
+{
+	// A minimised window has no extent to create images for, try again on a later frame
+	VkSurfaceCapabilitiesKHR surfaceCapabilities;
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(mainDevice.physicalDevice, surface, &surfaceCapabilities);
+	const VkExtent2D extent = chooseSwapExtent(surfaceCapabilities);
+	if (extent.width == 0 || extent.height == 0)
+	{
+		return false;
+	}
+
+	// Frames still in flight keep using the old images, so they are retired rather than destroyed
+	const VkSwapchainKHR oldSwapchain = swapchain;
+	std::vector<SwapchainImage> oldImages = std::move(swapChainImages);
+
+	const VkFormat oldFormat = swapChainImageFormat;
+	renderGraph.releaseFramebuffers();
+	createSwapChain(oldSwapchain);
+
+	VkDevice device = mainDevice.logicalDevice;
+	deletionQueue.retire([device, oldSwapchain, oldImages = std::move(oldImages)]()
+	{
+		for (auto image : oldImages)
+		{
+			vkDestroyImageView(device, image.imageView, nullptr);
+		}
+		vkDestroySwapchainKHR(device, oldSwapchain, nullptr);
+	});
+
+	// The pipeline only depends on the format, which almost never changes
+	if (swapChainImageFormat != oldFormat)
+	{
+		retireGraphicsPipelines();
+		createGraphicsPipeline();
+	}
+	framePacer.swapchainChanged();
+
+	swapchainOutOfDate = false;
+	framebufferResized = false;
+	VULKAN_CORE_INFO("Recreated swapchain at {}x{}", swapChainExtent.width, swapChainExtent.height);
+	return true;
 }
 
 void VulkanRenderer::cleanup()
 {
 	vkDeviceWaitIdle(mainDevice.logicalDevice);
+	deletionQueue.cleanup();
 
-	firstMesh.destroyVertexBuffer();
-	
-	for(size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	for (auto& mesh : meshList)
 	{
-		vkDestroySemaphore(mainDevice.logicalDevice, renderFinished[i], nullptr);
-		vkDestroySemaphore(mainDevice.logicalDevice, imageAvailable[i], nullptr);
-		vkDestroyFence(mainDevice.logicalDevice, drawFences[i], nullptr);
+		mesh.destroyBuffers();
 	}
+	geometryPool.cleanup();
+	textureManager.cleanup();
+	descriptorAllocator.cleanup();
+	bindlessTable.cleanup();
+	framePacer.cleanup();
+	clusteredLighting.cleanup();
+	occlusionCuller.cleanup();
+	destroySynchronisation();
 	
 	vkDestroyCommandPool(mainDevice.logicalDevice, graphicsCommandPool, nullptr);
-	for (auto framebuffer : swapChainFrameBuffers)
-	{
-		vkDestroyFramebuffer(mainDevice.logicalDevice, framebuffer, nullptr);
-	}
+	renderGraph.cleanup();
 	vkDestroyPipeline(mainDevice.logicalDevice, graphicsPipeline, nullptr);
+	vkDestroyPipeline(mainDevice.logicalDevice, depthPrepassPipeline, nullptr);
+	vkDestroyPipeline(mainDevice.logicalDevice, depthEqualPipeline, nullptr);
 	vkDestroyPipelineLayout(mainDevice.logicalDevice, pipelineLayout, nullptr);
-	vkDestroyRenderPass(mainDevice.logicalDevice, renderPass, nullptr);
+	vkDestroyPipeline(mainDevice.logicalDevice, gBufferPipeline, nullptr);
+	vkDestroyPipeline(mainDevice.logicalDevice, deferredLightingPipeline, nullptr);
+	vkDestroyPipelineLayout(mainDevice.logicalDevice, deferredLightingLayout, nullptr);
+	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, gBufferSetLayout, nullptr);
 	for (auto image : swapChainImages)
 	{
 		vkDestroyImageView(mainDevice.logicalDevice, image.imageView, nullptr);
 	}
 	vkDestroySwapchainKHR(mainDevice.logicalDevice, swapchain, nullptr);
+	graphicsTimeline.cleanup();
+	memoryBudget.cleanup();
 	vkDestroySurfaceKHR(instance, surface, nullptr);
 	vkDestroyDevice(mainDevice.logicalDevice, nullptr);
 	if (validationEnabled)
@@ -127,6 +455,61 @@ void VulkanRenderer::cleanup()
 }
 
 
+uint32_t VulkanRenderer::createTexture(const std::string& fileName)
+{
+	return textureManager.createTexture(fileName);
+}
+
+void VulkanRenderer::destroyTexture(uint32_t descriptorIndex)
+{
+	textureManager.destroyTexture(descriptorIndex);
+}
+
+int VulkanRenderer::createMesh(const std::string& fileName)
+{
+	// The mapping is released once the streams are in device memory
+	MeshFile meshFile("Models/" + fileName);
+	meshList.push_back(Mesh(mainDevice.physicalDevice, mainDevice.logicalDevice, &memoryBudget, &geometryPool,
+		&graphicsTimeline, graphicsCommandPool, meshFile));
+	return static_cast<int>(meshList.size()) - 1;
+}
+
+void VulkanRenderer::destroyMesh(int meshIndex)
+{
+	// The pool keeps the buffers until the frames already submitted have finished with them
+	meshList.at(meshIndex).destroyBuffers();
+}
+
+std::vector<int> VulkanRenderer::createGltfMeshes(const std::string& fileName)
+{
+	std::vector<MeshData> meshData = loadGltf("Models/" + fileName);
+
+	VkDeviceSize stagingSize = 0;
+	for (const auto& mesh : meshData)
+	{
+		stagingSize += Mesh::getUploadSize(mesh.vertices.size(), mesh.indices.size());
+	}
+
+	UploadBatch uploadBatch;
+	uploadBatch.begin(mainDevice.physicalDevice, mainDevice.logicalDevice, &memoryBudget, &graphicsTimeline,
+		graphicsCommandPool, stagingSize);
+	std::vector<int> meshIndices;
+	for (const auto& mesh : meshData)
+	{
+		if (mesh.indices.empty())
+		{
+			continue;
+		}
+		meshList.push_back(Mesh(mainDevice.physicalDevice, mainDevice.logicalDevice, &geometryPool, uploadBatch,
+			mesh.vertices, mesh.indices, mesh.lods));
+		meshIndices.push_back(static_cast<int>(meshList.size()) - 1);
+	}
+	uploadBatch.submit();
+
+	VULKAN_CORE_INFO("Loaded {} meshes from {}", meshIndices.size(), fileName);
+	return meshIndices;
+}
+
 VulkanRenderer::~VulkanRenderer()
 {
 }
@@ -149,7 +532,17 @@ void VulkanRenderer::create_app_info(VkApplicationInfo& appInfo)
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+
+	// vkEnumerateInstanceVersion only exists on 1.1+ loaders
+	instanceApiVersion = VK_API_VERSION_1_0;
+	auto enumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(nullptr,
+		"vkEnumerateInstanceVersion");
+	if (enumerateInstanceVersion != nullptr)
+	{
+		enumerateInstanceVersion(&instanceApiVersion);
+	}
+	instanceApiVersion = std::min(instanceApiVersion, static_cast<uint32_t>(VK_API_VERSION_1_2));
+	appInfo.apiVersion = instanceApiVersion;
 }
 
 void VulkanRenderer::createInstance()
@@ -252,12 +645,87 @@ void VulkanRenderer::createLogicalDevice()
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
+	std::vector<const char*> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+	enabledExtensions.insert(enabledExtensions.end(), optionalDeviceExtensions.begin(), optionalDeviceExtensions.end());
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 	VkPhysicalDeviceFeatures deviceFeatures = {};
+	deviceFeatures.samplerAnisotropy = deviceCapabilities.maxSamplerAnisotropy > 0.0f ? VK_TRUE : VK_FALSE;
+	deviceFeatures.textureCompressionBC = deviceCapabilities.textureCompressionBC;
+	deviceFeatures.textureCompressionETC2 = deviceCapabilities.textureCompressionETC2;
+	deviceFeatures.textureCompressionASTC_LDR = deviceCapabilities.textureCompressionASTC;
+	deviceFeatures.pipelineStatisticsQuery = deviceCapabilities.pipelineStatisticsQuery;
+
+	// Optional feature structs are chained onto VkPhysicalDeviceFeatures2 when any are requested
+	void* featureChain = nullptr;
+
+	VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures = {};
+	descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+	if (deviceCapabilities.descriptorIndexing)
+	{
+		descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		descriptorIndexingFeatures.pNext = featureChain;
+		featureChain = &descriptorIndexingFeatures;
+	}
+
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = {};
+	timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	if (deviceCapabilities.timelineSemaphore)
+	{
+		timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+		timelineSemaphoreFeatures.pNext = featureChain;
+		featureChain = &timelineSemaphoreFeatures;
+	}
 
-	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	if (deviceCapabilities.presentWait)
+	{
+		presentIdFeatures.presentId = VK_TRUE;
+		presentIdFeatures.pNext = featureChain;
+		presentWaitFeatures.presentWait = VK_TRUE;
+		presentWaitFeatures.pNext = &presentIdFeatures;
+		featureChain = &presentWaitFeatures;
+	}
+
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+	dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+	if (deviceCapabilities.dynamicRendering)
+	{
+		dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+		dynamicRenderingFeatures.pNext = featureChain;
+		featureChain = &dynamicRenderingFeatures;
+	}
+
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures = {};
+	extendedDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+	if (deviceCapabilities.extendedDynamicState)
+	{
+		extendedDynamicStateFeatures.extendedDynamicState = VK_TRUE;
+		extendedDynamicStateFeatures.pNext = featureChain;
+		featureChain = &extendedDynamicStateFeatures;
+	}
+
+	VkPhysicalDeviceFeatures2 deviceFeatures2 = {};
+	deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	if (featureChain != nullptr)
+	{
+		deviceFeatures2.features = deviceFeatures;
+		deviceFeatures2.pNext = featureChain;
+		deviceCreateInfo.pNext = &deviceFeatures2;
+		deviceCreateInfo.pEnabledFeatures = nullptr;
+	}
+	else
+	{
+		deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
+	}
 
 	VkResult result = vkCreateDevice(mainDevice.physicalDevice, &deviceCreateInfo, nullptr, &mainDevice.logicalDevice);
 	if (result != VK_SUCCESS)
@@ -267,6 +735,18 @@ void VulkanRenderer::createLogicalDevice()
 
 	vkGetDeviceQueue(mainDevice.logicalDevice, indices.graphicsFamily, 0, &graphicsQueue);
 	vkGetDeviceQueue(mainDevice.logicalDevice, indices.presentationFamily, 0, &presentationQueue);
+
+	if (deviceCapabilities.extendedDynamicState)
+	{
+		cmdSetCullMode = (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(mainDevice.logicalDevice, "vkCmdSetCullModeEXT");
+		cmdSetFrontFace = (PFN_vkCmdSetFrontFaceEXT)vkGetDeviceProcAddr(mainDevice.logicalDevice, "vkCmdSetFrontFaceEXT");
+		cmdSetDepthTestEnable = (PFN_vkCmdSetDepthTestEnableEXT)vkGetDeviceProcAddr(mainDevice.logicalDevice,
+			"vkCmdSetDepthTestEnableEXT");
+		cmdSetDepthWriteEnable = (PFN_vkCmdSetDepthWriteEnableEXT)vkGetDeviceProcAddr(mainDevice.logicalDevice,
+			"vkCmdSetDepthWriteEnableEXT");
+		cmdSetDepthCompareOp = (PFN_vkCmdSetDepthCompareOpEXT)vkGetDeviceProcAddr(mainDevice.logicalDevice,
+			"vkCmdSetDepthCompareOpEXT");
+	}
 }
 
 void VulkanRenderer::createSurface()
@@ -279,7 +759,7 @@ void VulkanRenderer::createSurface()
 	}
 }
 
-void VulkanRenderer::createSwapChain()
+void VulkanRenderer::createSwapChain(VkSwapchainKHR oldSwapchain)
 {
 	SwapChainDetails swap_chain_details = getSwapChainDetails(mainDevice.physicalDevice);
 
@@ -326,7 +806,8 @@ void VulkanRenderer::createSwapChain()
 		swapChainCreateInfo.queueFamilyIndexCount = 0;
 		swapChainCreateInfo.pQueueFamilyIndices = nullptr;
 	}
-	swapChainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+	// Lets the driver hand over resources and keeps presentation going while the old swapchain drains
+	swapChainCreateInfo.oldSwapchain = oldSwapchain;
 	VkResult result = vkCreateSwapchainKHR(mainDevice.logicalDevice, &swapChainCreateInfo, nullptr, &swapchain);
 	if (result != VK_SUCCESS)
 	{
@@ -336,6 +817,7 @@ void VulkanRenderer::createSwapChain()
 	swapChainImageFormat = surfaceFormat.format;
 	swapChainExtent = extent;
 
+	swapChainImages.clear();
 	uint32_t swapChainImageCount;
 	vkGetSwapchainImagesKHR(mainDevice.logicalDevice, swapchain, &swapChainImageCount, nullptr);
 	std::vector<VkImage> images(swapChainImageCount);
@@ -345,74 +827,50 @@ void VulkanRenderer::createSwapChain()
 	{
 		SwapchainImage swapChainImage = {};
 		swapChainImage.image = image;
-		swapChainImage.imageView = createImageView(image, swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+		swapChainImage.imageView = createImageView(mainDevice.logicalDevice, image, swapChainImageFormat,
+			VK_IMAGE_ASPECT_COLOR_BIT);
 
 		swapChainImages.push_back(swapChainImage);
 	}
-}
-
-void VulkanRenderer::createRenderPass()
-{
-	VkAttachmentDescription colourAttachment = {};
-	colourAttachment.format = swapChainImageFormat;
-	colourAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	colourAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	colourAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colourAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colourAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-	VkAttachmentReference colourAttachmentReference = {};
-	colourAttachmentReference.attachment = 0;
-	colourAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colourAttachmentReference;
-
-	std::array<VkSubpassDependency, 2> subpassDependencies;
-	subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-	subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	subpassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-
-	subpassDependencies[0].dstSubpass = 0;
-	subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	subpassDependencies[0].dependencyFlags = 0;
-
-	subpassDependencies[1].srcSubpass = 0;
-	subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-						
-	subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-	subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	subpassDependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	subpassDependencies[1].dependencyFlags = 0;
-
-	VkRenderPassCreateInfo renderPassCreateInfo = {};
-	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassCreateInfo.attachmentCount = 1;
-	renderPassCreateInfo.pAttachments = &colourAttachment;
-	renderPassCreateInfo.subpassCount = 1;
-	renderPassCreateInfo.pSubpasses = &subpass;
-	renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(subpassDependencies.size());
-	renderPassCreateInfo.pDependencies = subpassDependencies.data();
-	VkResult result = vkCreateRenderPass(mainDevice.logicalDevice, &renderPassCreateInfo, nullptr, &renderPass);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create a render pass");
-	}
+	// New images have no frame rendering to them yet
+	imageTimelineValues.assign(swapChainImages.size(), 0);
 }
 
 void VulkanRenderer::createGraphicsPipeline()
 {
-	auto vertexShaderCode = readFile("Shaders/vert.spv");
-	auto fragmentShaderCode = readFile("Shaders/frag.spv");
-
-	VkShaderModule vertexShaderModule = createShaderModule(vertexShaderCode);
-	VkShaderModule fragmentShaderModule = createShaderModule(fragmentShaderCode);
+	// Lit through the light clusters when both of their shaders are present, otherwise frames skip the binning
+	VkShaderModule fragmentShaderModule = VK_NULL_HANDLE;
+	if (clusteredLighting.isAvailable())
+	{
+		try
+		{
+			MappedFile clusteredFragmentShaderCode("Shaders/clustered_frag.spv");
+			fragmentShaderModule = createShaderModule(clusteredFragmentShaderCode.getData());
+		}
+		catch (const std::runtime_error& e)
+		{
+			VULKAN_CORE_WARN("Clustered lighting unavailable: {}", e.what());
+		}
+	}
+	clusteredShading = fragmentShaderModule != VK_NULL_HANDLE;
+
+	// Both frame layouts are compiled up front so toggling the prepass never creates pipelines mid frame. The
+	// graph keeps their render passes cached, and the colour pass is compatible between the two.
+	buildRenderGraph(0, true, false, false);
+	renderGraph.compile();
+	const RenderGraphPipelineTarget depthPrepassTarget = renderGraph.getPipelineTarget(DEPTH_PREPASS);
+	buildRenderGraph(0, false, false, false);
+	renderGraph.compile();
+	const RenderGraphPipelineTarget forwardTarget = renderGraph.getPipelineTarget(FORWARD_PASS);
+
+	// Mapped SPIR-V is handed to the driver directly, the mappings only need to outlive module creation
+	MappedFile vertexShaderCode("Shaders/vert.spv");
+	VkShaderModule vertexShaderModule = createShaderModule(vertexShaderCode.getData());
+	if (!clusteredShading)
+	{
+		MappedFile fragmentShaderCode("Shaders/frag.spv");
+		fragmentShaderModule = createShaderModule(fragmentShaderCode.getData());
+	}
 
 	VkPipelineShaderStageCreateInfo vertexShaderCreateInfo = {};
 	vertexShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -456,28 +914,27 @@ void VulkanRenderer::createGraphicsPipeline()
 	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 	inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-	VkViewport viewport = {};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(swapChainExtent.width);
-	viewport.height = static_cast<float>(swapChainExtent.height);
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor = {};
-	scissor.offset = { 0,0 };
-	scissor.extent = swapChainExtent;
-
+	// Viewport and scissor are set while recording, so the pipeline survives swapchain resizes
 	VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
 	viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewportStateCreateInfo.viewportCount = 1;
-	viewportStateCreateInfo.pViewports = &viewport;
+	viewportStateCreateInfo.pViewports = nullptr;
 	viewportStateCreateInfo.scissorCount = 1;
-	viewportStateCreateInfo.pScissors = &scissor;
+	viewportStateCreateInfo.pScissors = nullptr;
 
 	std::vector<VkDynamicState> dynamicStateEnables;
 	dynamicStateEnables.push_back(VK_DYNAMIC_STATE_VIEWPORT);
 	dynamicStateEnables.push_back(VK_DYNAMIC_STATE_SCISSOR);
+	// With extended dynamic state one pipeline covers both depth modes, the values below are only the defaults
+	// recordDrawState sets again
+	if (deviceCapabilities.extendedDynamicState)
+	{
+		dynamicStateEnables.push_back(VK_DYNAMIC_STATE_CULL_MODE_EXT);
+		dynamicStateEnables.push_back(VK_DYNAMIC_STATE_FRONT_FACE_EXT);
+		dynamicStateEnables.push_back(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT);
+		dynamicStateEnables.push_back(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT);
+		dynamicStateEnables.push_back(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT);
+	}
 
 	VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
 	dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
@@ -497,7 +954,7 @@ void VulkanRenderer::createGraphicsPipeline()
 	VkPipelineMultisampleStateCreateInfo multisamplingCreateInfo = {};
 	multisamplingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
 	multisamplingCreateInfo.sampleShadingEnable = VK_FALSE;
-	multisamplingCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	multisamplingCreateInfo.rasterizationSamples = msaaSamples;
 
 	VkPipelineColorBlendAttachmentState colourState = {};
 	colourState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
@@ -517,10 +974,22 @@ void VulkanRenderer::createGraphicsPipeline()
 	colourBlendingCreateInfo.attachmentCount = 1;
 	colourBlendingCreateInfo.pAttachments = &colourState;
 
+	VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
+	depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilCreateInfo.depthTestEnable = VK_TRUE;
+	depthStencilCreateInfo.depthWriteEnable = VK_TRUE;
+	depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+	depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
+	depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
+
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
 	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutCreateInfo.setLayoutCount = 0;
-	pipelineLayoutCreateInfo.pSetLayouts = nullptr;
+	// Set 0 is kept for the texture table, no shader samples from it yet so it is never bound. Lit pipelines read
+	// the light clusters from set 1
+	const std::array<VkDescriptorSetLayout, 2> setLayouts = { bindlessTable.getDescriptorSetLayout(),
+		clusteredLighting.getDescriptorSetLayout() };
+	pipelineLayoutCreateInfo.setLayoutCount = clusteredShading ? 2 : 1;
+	pipelineLayoutCreateInfo.pSetLayouts = setLayouts.data();
 	pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
 	pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
 
@@ -539,14 +1008,15 @@ void VulkanRenderer::createGraphicsPipeline()
 	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;
 	pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
 	pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-	pipelineCreateInfo.pDynamicState = nullptr;
+	pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
 	pipelineCreateInfo.pRasterizationState = &rasterisationCreateInfo;
 	pipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
 	pipelineCreateInfo.pColorBlendState = &colourBlendingCreateInfo;
-	pipelineCreateInfo.pDepthStencilState = nullptr;
+	pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
 	pipelineCreateInfo.layout = pipelineLayout;
-	pipelineCreateInfo.renderPass = renderPass;
 	pipelineCreateInfo.subpass = 0;
+	VkPipelineRenderingCreateInfoKHR forwardRenderingCreateInfo = {};
+	setPipelineTarget(pipelineCreateInfo, forwardRenderingCreateInfo, forwardTarget);
 
 	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineCreateInfo.basePipelineIndex = -1;
@@ -558,34 +1028,208 @@ void VulkanRenderer::createGraphicsPipeline()
 		throw std::runtime_error("Failed to create a pipeline");
 	}
 
+	// The prepass is optional, without its shader the renderer only draws with the pipeline above
+	depthPrepassPipeline = VK_NULL_HANDLE;
+	depthEqualPipeline = VK_NULL_HANDLE;
+	VkShaderModule depthVertexShaderModule = VK_NULL_HANDLE;
+	try
+	{
+		MappedFile depthVertexShaderCode("Shaders/depth_vert.spv");
+		depthVertexShaderModule = createShaderModule(depthVertexShaderCode.getData());
+	}
+	catch (const std::runtime_error& e)
+	{
+		VULKAN_CORE_WARN("Depth prepass unavailable: {}", e.what());
+	}
+
+	if (depthVertexShaderModule != VK_NULL_HANDLE)
+	{
+		VkPipelineShaderStageCreateInfo depthVertexShaderCreateInfo = vertexShaderCreateInfo;
+		depthVertexShaderCreateInfo.module = depthVertexShaderModule;
+
+		// Positions only, and no fragment shader or colour attachment at all
+		VkPipelineVertexInputStateCreateInfo depthVertexInputCreateInfo = vertexInputCreateInfo;
+		depthVertexInputCreateInfo.vertexAttributeDescriptionCount = 1;
+
+		VkPipelineColorBlendStateCreateInfo depthColourBlendingCreateInfo = colourBlendingCreateInfo;
+		depthColourBlendingCreateInfo.attachmentCount = 0;
+		depthColourBlendingCreateInfo.pAttachments = nullptr;
+
+		// The prepass has already written the nearest depth, the colour pass only shades the fragments matching it
+		VkPipelineDepthStencilStateCreateInfo depthEqualCreateInfo = depthStencilCreateInfo;
+		depthEqualCreateInfo.depthWriteEnable = VK_FALSE;
+		depthEqualCreateInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+
+		std::array<VkGraphicsPipelineCreateInfo, 2> depthPipelineCreateInfos = { pipelineCreateInfo, pipelineCreateInfo };
+		depthPipelineCreateInfos[0].stageCount = 1;
+		depthPipelineCreateInfos[0].pStages = &depthVertexShaderCreateInfo;
+		depthPipelineCreateInfos[0].pVertexInputState = &depthVertexInputCreateInfo;
+		depthPipelineCreateInfos[0].pColorBlendState = &depthColourBlendingCreateInfo;
+		VkPipelineRenderingCreateInfoKHR depthPrepassRenderingCreateInfo = {};
+		setPipelineTarget(depthPipelineCreateInfos[0], depthPrepassRenderingCreateInfo, depthPrepassTarget);
+		depthPipelineCreateInfos[1].pDepthStencilState = &depthEqualCreateInfo;
+
+		// The equal test is dynamic state with extended dynamic state, so only the prepass pipeline is needed
+		std::array<VkPipeline, 2> depthPipelines = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+		const uint32_t depthPipelineCount = deviceCapabilities.extendedDynamicState ? 1 : 2;
+		result = vkCreateGraphicsPipelines(mainDevice.logicalDevice, VK_NULL_HANDLE,
+			depthPipelineCount, depthPipelineCreateInfos.data(), nullptr, depthPipelines.data());
+		vkDestroyShaderModule(mainDevice.logicalDevice, depthVertexShaderModule, nullptr);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create the depth prepass pipelines");
+		}
+		depthPrepassPipeline = depthPipelines[0];
+		depthEqualPipeline = depthPipelines[1];
+	}
+	depthPrepass = depthPrepass && depthPrepassPipeline != VK_NULL_HANDLE;
+
+	// The deferred lighting reads the same light clusters, without them only the forward path exists
+	gBufferPipeline = VK_NULL_HANDLE;
+	deferredLightingPipeline = VK_NULL_HANDLE;
+	deferredLightingLayout = VK_NULL_HANDLE;
+	if (clusteredShading)
+	{
+		createDeferredPipelines(pipelineCreateInfo);
+	}
+	deferredShading = deferredShading && gBufferPipeline != VK_NULL_HANDLE;
+
 	vkDestroyShaderModule(mainDevice.logicalDevice, fragmentShaderModule, nullptr);
 	vkDestroyShaderModule(mainDevice.logicalDevice, vertexShaderModule, nullptr);
 }
 
-void VulkanRenderer::createFrameBuffers()
+void VulkanRenderer::retireGraphicsPipelines()
 {
-	swapChainFrameBuffers.resize(swapChainImages.size());
-	for (size_t i = 0; i < swapChainFrameBuffers.size(); i++)
+	VkDevice device = mainDevice.logicalDevice;
+	const std::array<VkPipeline, 5> pipelines = { graphicsPipeline, depthPrepassPipeline, depthEqualPipeline,
+		gBufferPipeline, deferredLightingPipeline };
+	const std::array<VkPipelineLayout, 2> layouts = { pipelineLayout, deferredLightingLayout };
+	deletionQueue.retire([device, pipelines, layouts]()
 	{
-		std::array<VkImageView, 1> attachments = {
-			swapChainImages[i].imageView
-		};
-		VkFramebufferCreateInfo frameBufferCreateInfo = {};
-		frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		frameBufferCreateInfo.renderPass = renderPass;
-		frameBufferCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		frameBufferCreateInfo.pAttachments = attachments.data();
-		frameBufferCreateInfo.width = swapChainExtent.width;
-		frameBufferCreateInfo.height = swapChainExtent.height;
-		frameBufferCreateInfo.layers = 1;
-
-		VkResult result = vkCreateFramebuffer(mainDevice.logicalDevice, &frameBufferCreateInfo,
-			nullptr, &swapChainFrameBuffers.at(i));
-		if (result != VK_SUCCESS)
+		for (VkPipeline pipeline : pipelines)
+		{
+			vkDestroyPipeline(device, pipeline, nullptr);
+		}
+		for (VkPipelineLayout layout : layouts)
 		{
-			throw std::runtime_error("Failed to create a framebuffer");
+			vkDestroyPipelineLayout(device, layout, nullptr);
 		}
+	});
+}
+
+void VulkanRenderer::createDeferredPipelines(const VkGraphicsPipelineCreateInfo& forwardCreateInfo)
+{
+	VkShaderModule gBufferShaderModule = VK_NULL_HANDLE;
+	VkShaderModule fullscreenShaderModule = VK_NULL_HANDLE;
+	VkShaderModule lightingShaderModule = VK_NULL_HANDLE;
+	try
+	{
+		MappedFile gBufferShaderCode("Shaders/gbuffer_frag.spv");
+		MappedFile fullscreenShaderCode("Shaders/fullscreen_vert.spv");
+		MappedFile lightingShaderCode("Shaders/deferred_lighting_frag.spv");
+		gBufferShaderModule = createShaderModule(gBufferShaderCode.getData());
+		fullscreenShaderModule = createShaderModule(fullscreenShaderCode.getData());
+		lightingShaderModule = createShaderModule(lightingShaderCode.getData());
+	}
+	catch (const std::runtime_error& e)
+	{
+		VULKAN_CORE_WARN("Deferred shading unavailable: {}", e.what());
+		vkDestroyShaderModule(mainDevice.logicalDevice, gBufferShaderModule, nullptr);
+		vkDestroyShaderModule(mainDevice.logicalDevice, fullscreenShaderModule, nullptr);
+		return;
 	}
+
+	buildRenderGraph(0, false, true, false);
+	renderGraph.compile();
+	const RenderGraphPipelineTarget gBufferTarget = renderGraph.getPipelineTarget(DEFERRED_PASS, GBUFFER_SUBPASS);
+	const RenderGraphPipelineTarget lightingTarget = renderGraph.getPipelineTarget(DEFERRED_PASS, LIGHTING_SUBPASS);
+
+	// Input attachments are read per pixel, so the G-buffer is single sampled whatever the MSAA setting
+	VkPipelineMultisampleStateCreateInfo multisamplingCreateInfo = *forwardCreateInfo.pMultisampleState;
+	multisamplingCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// Same vertex stage and layout as the forward pipeline, writing the G-buffer instead of shading
+	std::array<VkPipelineShaderStageCreateInfo, 2> gBufferStages = { forwardCreateInfo.pStages[0],
+		forwardCreateInfo.pStages[1] };
+	gBufferStages[1].module = gBufferShaderModule;
+
+	std::array<VkPipelineColorBlendAttachmentState, 2> gBufferColourStates = {};
+	for (VkPipelineColorBlendAttachmentState& colourState : gBufferColourStates)
+	{
+		colourState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
+			| VK_COLOR_COMPONENT_A_BIT;
+		colourState.blendEnable = VK_FALSE;
+	}
+	VkPipelineColorBlendStateCreateInfo gBufferBlendingCreateInfo = *forwardCreateInfo.pColorBlendState;
+	gBufferBlendingCreateInfo.attachmentCount = static_cast<uint32_t>(gBufferColourStates.size());
+	gBufferBlendingCreateInfo.pAttachments = gBufferColourStates.data();
+
+	std::array<VkGraphicsPipelineCreateInfo, 2> pipelineCreateInfos = { forwardCreateInfo, forwardCreateInfo };
+	VkGraphicsPipelineCreateInfo& gBufferCreateInfo = pipelineCreateInfos[0];
+	gBufferCreateInfo.pStages = gBufferStages.data();
+	gBufferCreateInfo.pMultisampleState = &multisamplingCreateInfo;
+	gBufferCreateInfo.pColorBlendState = &gBufferBlendingCreateInfo;
+	VkPipelineRenderingCreateInfoKHR gBufferRenderingCreateInfo = {};
+	setPipelineTarget(gBufferCreateInfo, gBufferRenderingCreateInfo, gBufferTarget);
+
+	// The lighting subpass reads the G-buffer in set 0 and the light clusters in set 1
+	const std::array<VkDescriptorSetLayout, 2> lightingSetLayouts = { gBufferSetLayout,
+		clusteredLighting.getDescriptorSetLayout() };
+	VkPipelineLayoutCreateInfo lightingLayoutCreateInfo = {};
+	lightingLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	lightingLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(lightingSetLayouts.size());
+	lightingLayoutCreateInfo.pSetLayouts = lightingSetLayouts.data();
+	VkResult result = vkCreatePipelineLayout(mainDevice.logicalDevice, &lightingLayoutCreateInfo, nullptr,
+		&deferredLightingLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the deferred lighting pipeline layout");
+	}
+
+	std::array<VkPipelineShaderStageCreateInfo, 2> lightingStages = gBufferStages;
+	lightingStages[0].module = fullscreenShaderModule;
+	lightingStages[1].module = lightingShaderModule;
+
+	// One triangle generated in the vertex shader, no vertex input, culling or depth attachment
+	VkPipelineVertexInputStateCreateInfo lightingVertexInputCreateInfo = {};
+	lightingVertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineRasterizationStateCreateInfo lightingRasterisationCreateInfo = *forwardCreateInfo.pRasterizationState;
+	lightingRasterisationCreateInfo.cullMode = VK_CULL_MODE_NONE;
+
+	const std::array<VkDynamicState, 2> lightingDynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo lightingDynamicStateCreateInfo = {};
+	lightingDynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	lightingDynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(lightingDynamicStates.size());
+	lightingDynamicStateCreateInfo.pDynamicStates = lightingDynamicStates.data();
+
+	VkPipelineColorBlendStateCreateInfo lightingBlendingCreateInfo = gBufferBlendingCreateInfo;
+	lightingBlendingCreateInfo.attachmentCount = 1;
+
+	VkGraphicsPipelineCreateInfo& lightingCreateInfo = pipelineCreateInfos[1];
+	lightingCreateInfo.pStages = lightingStages.data();
+	lightingCreateInfo.pVertexInputState = &lightingVertexInputCreateInfo;
+	lightingCreateInfo.pRasterizationState = &lightingRasterisationCreateInfo;
+	lightingCreateInfo.pDynamicState = &lightingDynamicStateCreateInfo;
+	lightingCreateInfo.pMultisampleState = &multisamplingCreateInfo;
+	lightingCreateInfo.pColorBlendState = &lightingBlendingCreateInfo;
+	lightingCreateInfo.pDepthStencilState = nullptr;
+	lightingCreateInfo.layout = deferredLightingLayout;
+	VkPipelineRenderingCreateInfoKHR lightingRenderingCreateInfo = {};
+	setPipelineTarget(lightingCreateInfo, lightingRenderingCreateInfo, lightingTarget);
+
+	std::array<VkPipeline, 2> pipelines = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+	result = vkCreateGraphicsPipelines(mainDevice.logicalDevice, VK_NULL_HANDLE,
+		static_cast<uint32_t>(pipelineCreateInfos.size()), pipelineCreateInfos.data(), nullptr, pipelines.data());
+	vkDestroyShaderModule(mainDevice.logicalDevice, gBufferShaderModule, nullptr);
+	vkDestroyShaderModule(mainDevice.logicalDevice, fullscreenShaderModule, nullptr);
+	vkDestroyShaderModule(mainDevice.logicalDevice, lightingShaderModule, nullptr);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the deferred shading pipelines");
+	}
+	gBufferPipeline = pipelines[0];
+	deferredLightingPipeline = pipelines[1];
 }
 
 void VulkanRenderer::createCommandPool()
@@ -595,6 +1239,8 @@ void VulkanRenderer::createCommandPool()
 	VkCommandPoolCreateInfo poolInfo = {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+	// Frame command buffers are reset and re-recorded individually
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 	VkResult result = vkCreateCommandPool(mainDevice.logicalDevice, &poolInfo, nullptr, &graphicsCommandPool);
 	if (result != VK_SUCCESS)
@@ -605,7 +1251,7 @@ void VulkanRenderer::createCommandPool()
 
 void VulkanRenderer::createCommandBuffers()
 {
-	commandBuffers.resize(swapChainFrameBuffers.size());
+	commandBuffers.resize(framesInFlight);
 
 	VkCommandBufferAllocateInfo cbAllocInfo = {};
 	cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -621,71 +1267,447 @@ void VulkanRenderer::createCommandBuffers()
 
 void VulkanRenderer::createSynchronisation()
 {
-	imageAvailable.resize(MAX_FRAME_DRAWS);
-	renderFinished.resize(MAX_FRAME_DRAWS);
-	drawFences.resize(MAX_FRAME_DRAWS);
+	imageAvailable.resize(framesInFlight);
+	renderFinished.resize(framesInFlight);
+	// Zero is always complete, so the first use of each slot does not wait
+	frameTimelineValues.assign(framesInFlight, 0);
 	
 	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
 	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	VkFenceCreateInfo fenceCreateInfo = {};
-	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-	for(size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	for(size_t i = 0; i < framesInFlight; i++)
 	{
 		if (vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &imageAvailable[i]) != VK_SUCCESS ||
-			vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &renderFinished[i]) != VK_SUCCESS ||
-			vkCreateFence(mainDevice.logicalDevice, &fenceCreateInfo, nullptr, &drawFences[i]) != VK_SUCCESS)
+			vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &renderFinished[i]) != VK_SUCCESS)
 		{
-			throw std::runtime_error("Failed to create a semaphore and/or fence");
+			throw std::runtime_error("Failed to create a semaphore");
 		}
 	}
 }
 
-void VulkanRenderer::recordCommands()
+void VulkanRenderer::destroySynchronisation()
+{
+	for (size_t i = 0; i < imageAvailable.size(); i++)
+	{
+		vkDestroySemaphore(mainDevice.logicalDevice, renderFinished[i], nullptr);
+		vkDestroySemaphore(mainDevice.logicalDevice, imageAvailable[i], nullptr);
+	}
+	imageAvailable.clear();
+	renderFinished.clear();
+	frameTimelineValues.clear();
+}
+
+void VulkanRenderer::createTextureDescriptors()
 {
+	if (deviceCapabilities.descriptorIndexing)
+	{
+		bindlessTable.init(mainDevice.logicalDevice, deviceCapabilities.maxBindlessTextures, true);
+	}
+	else
+	{
+		bindlessTable.init(mainDevice.logicalDevice, BINDLESS_MAX_TEXTURES, false);
+	}
+}
+
+void VulkanRenderer::createGBufferSetLayout()
+{
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+	for (uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+	VkResult result = vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &layoutCreateInfo, nullptr,
+		&gBufferSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the G-buffer descriptor set layout");
+	}
+}
+
+void VulkanRenderer::buildRenderGraph(uint32_t imageIndex, bool withDepthPrepass, bool deferred, bool occlusionCulled)
+{
+	renderGraph.reset();
+
+	// The acquire semaphore is waited on at colour output, the image is handed back for presentation
+	RenderGraphImportedImage backBuffer = {};
+	backBuffer.image = swapChainImages[imageIndex].image;
+	backBuffer.imageView = swapChainImages[imageIndex].imageView;
+	backBuffer.desc.format = swapChainImageFormat;
+	backBuffer.desc.extent = swapChainExtent;
+	backBuffer.initialStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	backBuffer.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	const RenderGraphResource backBufferResource = renderGraph.importImage("BackBuffer", backBuffer);
+
+	// Lights are binned by compute before anything is drawn
+	ClusterResources clusterResources = {};
+	if (clusteredShading)
+	{
+		clusterResources = clusteredLighting.addBinningPass(renderGraph, currentFrame);
+	}
+
+	VkClearColorValue clearColour = { { 0.6f, 0.65f, 0.4f, 1.0f } };
+	VkClearDepthStencilValue clearDepth = { 1.0f, 0 };
+	if (deferred)
+	{
+		addDeferredPass(backBufferResource, clusterResources, clearColour, clearDepth);
+		return;
+	}
+
+	// Only needed within the frame, without a prepass it never has to leave tile memory
+	RenderGraphImageDesc depthDesc = {};
+	depthDesc.format = deviceCapabilities.depthFormat;
+	depthDesc.extent = swapChainExtent;
+	depthDesc.samples = msaaSamples;
+	const RenderGraphResource depthResource = renderGraph.createImage("Depth", depthDesc);
+
+	// Multisampled colour is resolved into the back buffer at the end of the forward pass, so the samples
+	// themselves are never stored
+	RenderGraphResource colourResource = backBufferResource;
+	if (msaaSamples != VK_SAMPLE_COUNT_1_BIT)
+	{
+		RenderGraphImageDesc colourDesc = backBuffer.desc;
+		colourDesc.samples = msaaSamples;
+		colourResource = renderGraph.createImage("MultisampledColour", colourDesc);
+	}
+
+	if (occlusionCulled)
+	{
+		addOcclusionCulledPasses(colourResource, depthResource, clusterResources, clearColour, clearDepth);
+		return;
+	}
+
+	if (withDepthPrepass)
+	{
+		renderGraph.addPass(DEPTH_PREPASS, RenderGraphPassType::Graphics)
+			.writeDepth(depthResource, clearDepth)
+			.setExecute([this](const RenderGraphPassContext& context)
+			{
+				recordDepthPrepass(context.commandBuffer);
+			});
+	}
+
+	RenderGraphPass& forwardPass = renderGraph.addPass(FORWARD_PASS, RenderGraphPassType::Graphics);
+	forwardPass.writeColour(colourResource, clearColour);
+	if (colourResource != backBufferResource)
+	{
+		forwardPass.resolveColour(backBufferResource);
+	}
+	if (withDepthPrepass)
+	{
+		forwardPass.readDepth(depthResource);
+	}
+	else
+	{
+		forwardPass.writeDepth(depthResource, clearDepth);
+	}
+	if (clusteredShading)
+	{
+		forwardPass.readStorageBuffer(clusterResources.lights)
+			.readStorageBuffer(clusterResources.clusters)
+			.readStorageBuffer(clusterResources.lightIndices);
+	}
+	forwardPass.setExecute([this, withDepthPrepass, clusterResources](const RenderGraphPassContext& context)
+	{
+		const VkDescriptorSet lightingSet = clusteredShading ?
+			clusteredLighting.createDescriptorSet(*context.graph, clusterResources) : VK_NULL_HANDLE;
+		recordForwardPass(context.commandBuffer, withDepthPrepass, lightingSet, VK_NULL_HANDLE);
+	});
+}
+
+void VulkanRenderer::addOcclusionCulledPasses(RenderGraphResource colour, RenderGraphResource depth,
+	const ClusterResources& clusterResources, const VkClearColorValue& clearColour,
+	const VkClearDepthStencilValue& clearDepth)
+{
+	// The first draw only has last frame's visible meshes, the second adds the ones the pyramid built in between
+	// shows, drawing over what the first left
+	OcclusionCullingResources cullingResources = occlusionCuller.addEarlyCullPass(renderGraph, currentFrame);
+	RenderGraphPass& earlyPass = renderGraph.addPass(FORWARD_PASS, RenderGraphPassType::Graphics)
+		.writeColour(colour, clearColour)
+		.writeDepth(depth, clearDepth)
+		.readIndirectBuffer(cullingResources.earlyCommands);
+	occlusionCuller.addLateCullPasses(renderGraph, currentFrame, depth, cullingResources);
+	RenderGraphPass& latePass = renderGraph.addPass(LATE_FORWARD_PASS, RenderGraphPassType::Graphics)
+		.writeColour(colour)
+		.writeDepth(depth)
+		.readIndirectBuffer(cullingResources.lateCommands);
+
+	const std::array<RenderGraphPass*, 2> passes = { &earlyPass, &latePass };
+	const std::array<RenderGraphResource, 2> passCommands = { cullingResources.earlyCommands,
+		cullingResources.lateCommands };
+	for (uint32_t i = 0; i < passes.size(); i++)
+	{
+		if (clusteredShading)
+		{
+			passes[i]->readStorageBuffer(clusterResources.lights)
+				.readStorageBuffer(clusterResources.clusters)
+				.readStorageBuffer(clusterResources.lightIndices);
+		}
+		const RenderGraphResource drawCommands = passCommands[i];
+		passes[i]->setExecute([this, clusterResources, drawCommands](const RenderGraphPassContext& context)
+		{
+			const VkDescriptorSet lightingSet = clusteredShading ?
+				clusteredLighting.createDescriptorSet(*context.graph, clusterResources) : VK_NULL_HANDLE;
+			recordForwardPass(context.commandBuffer, false, lightingSet, context.graph->getBuffer(drawCommands));
+		});
+	}
+}
+
+void VulkanRenderer::addDeferredPass(RenderGraphResource backBuffer, const ClusterResources& clusterResources,
+	const VkClearColorValue& clearColour, const VkClearDepthStencilValue& clearDepth)
+{
+	// 12 bytes a pixel, only ever written and read inside the one render pass so tiled GPUs keep all of it in tile
+	// memory and never allocate it
+	RenderGraphImageDesc albedoDesc = {};
+	albedoDesc.format = VK_FORMAT_R8G8B8A8_UNORM;
+	albedoDesc.extent = swapChainExtent;
+	const RenderGraphResource albedoResource = renderGraph.createImage("GBufferAlbedo", albedoDesc);
+
+	RenderGraphImageDesc normalDesc = albedoDesc;
+	normalDesc.format = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+	const RenderGraphResource normalResource = renderGraph.createImage("GBufferNormal", normalDesc);
+
+	// Input attachment views can only see one aspect, so a depth stencil format falls back to depth only
+	RenderGraphImageDesc depthDesc = albedoDesc;
+	depthDesc.format = deviceCapabilities.depthFormat == VK_FORMAT_D24_UNORM_S8_UINT ? VK_FORMAT_D16_UNORM :
+		deviceCapabilities.depthFormat;
+	const RenderGraphResource depthResource = renderGraph.createImage("GBufferDepth", depthDesc);
+
+	VkClearColorValue clearGBuffer = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+	renderGraph.addPass(DEFERRED_PASS, RenderGraphPassType::Graphics)
+		.writeColour(albedoResource, clearGBuffer)
+		.writeColour(normalResource, clearGBuffer)
+		.writeDepth(depthResource, clearDepth)
+		.readStorageBuffer(clusterResources.lights)
+		.readStorageBuffer(clusterResources.clusters)
+		.readStorageBuffer(clusterResources.lightIndices)
+		.nextSubpass()
+		.readInput(albedoResource)
+		.readInput(normalResource)
+		.readDepthInput(depthResource)
+		.writeColour(backBuffer, clearColour)
+		.setExecute([this, albedoResource, normalResource, depthResource, clusterResources](
+			const RenderGraphPassContext& context)
+		{
+			const VkDescriptorSet lightingSet = clusteredLighting.createDescriptorSet(*context.graph, clusterResources);
+			if (context.subpass == GBUFFER_SUBPASS)
+			{
+				recordGBuffer(context.commandBuffer, lightingSet);
+			}
+			else
+			{
+				recordDeferredLighting(context.commandBuffer, createGBufferDescriptorSet(*context.graph, albedoResource,
+					normalResource, depthResource), lightingSet);
+			}
+		});
+}
+
+void VulkanRenderer::recordCommands(uint32_t imageIndex)
+{
+	// Re-recorded every frame so draws can change, the slot's timeline wait guarantees the buffer is no longer in use
+	VkCommandBuffer commandBuffer = commandBuffers[currentFrame];
+
 	VkCommandBufferBeginInfo bufferBeginInfo = {};
 	bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-	VkRenderPassBeginInfo renderPassBeginInfo = {};
-	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassBeginInfo.renderPass = renderPass;
-	renderPassBeginInfo.renderArea.offset = { 0,0 };
-	renderPassBeginInfo.renderArea.extent = swapChainExtent;
-	VkClearValue clearValues[] = {
-		{0.6f,0.65f,0.4f,1.0f}
-	};
-	renderPassBeginInfo.pClearValues = clearValues;
-	renderPassBeginInfo.clearValueCount = 1;
-
-	for (size_t i = 0; i < commandBuffers.size(); i++)
+	auto result = vkBeginCommandBuffer(commandBuffer, &bufferBeginInfo);
+	if (result != VK_SUCCESS)
 	{
-		renderPassBeginInfo.framebuffer = swapChainFrameBuffers[i];
+		throw std::runtime_error("Failed to start recording a command buffer");
+	}
 
-		auto result = vkBeginCommandBuffer(commandBuffers[i], &bufferBeginInfo);
-		if (result != VK_SUCCESS)
+	framePacer.writeBeginQueries(commandBuffer, currentFrame);
+	// Copies ahead of every pass, the meshes bind the moved buffers from here on
+	geometryPool.defragment(commandBuffer, DEFRAGMENT_BYTES_PER_FRAME, DEFRAGMENT_MILLISECONDS_PER_FRAME);
+	selectLods();
+	if (clusteredShading)
+	{
+		clusteredLighting.update(currentFrame, swapChainExtent);
+	}
+	// The pyramid is built from single sampled depth laid down by the forward pass itself
+	const bool occlusionCulled = occlusionCulling && !deferredShading && !depthPrepass &&
+		msaaSamples == VK_SAMPLE_COUNT_1_BIT;
+	if (occlusionCulled)
+	{
+		cullingObjects.resize(meshList.size());
+		for (size_t i = 0; i < meshList.size(); i++)
 		{
-			throw std::runtime_error("Failed to start recording a command buffer");
+			const MeshFileLod& lod = meshList[i].getLods()[selectedLods[i]];
+			cullingObjects[i] = { meshList[i].getBoundingCentre(), meshList[i].getBoundingRadius(), lod.indexCount,
+				lod.firstIndex };
 		}
+		occlusionCuller.update(currentFrame, cullingObjects, swapChainExtent);
+	}
+	buildRenderGraph(imageIndex, depthPrepass, deferredShading, occlusionCulled);
+	renderGraph.compile();
+	renderGraph.execute(commandBuffer);
+	framePacer.writeEndQueries(commandBuffer, currentFrame);
 
-		vkCmdBeginRenderPass(commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	result = vkEndCommandBuffer(commandBuffer);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to end recording a command buffer");
+	}
+}
 
-		vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+void VulkanRenderer::selectLods()
+{
+	// Mesh positions are already in clip space, so one unit covers half the viewport height
+	const float pixelsPerUnit = swapChainExtent.height * 0.5f;
+	lodSelector.beginFrame();
+	selectedLods.resize(meshList.size());
+	for (size_t i = 0; i < meshList.size(); i++)
+	{
+		Mesh& mesh = meshList[i];
+		selectedLods[i] = lodSelector.selectLod(static_cast<uint32_t>(i), mesh.getLods(), mesh.getBoundingRadius(),
+			pixelsPerUnit);
+	}
+}
 
-		VkBuffer vertexBuffers[] = {firstMesh.getVertexBuffer()};
+void VulkanRenderer::recordDepthPrepass(VkCommandBuffer commandBuffer)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepassPipeline);
+	recordDrawState(commandBuffer, true, VK_COMPARE_OP_LESS);
+	drawMeshes(commandBuffer);
+}
+
+void VulkanRenderer::recordForwardPass(VkCommandBuffer commandBuffer, bool afterDepthPrepass,
+	VkDescriptorSet lightingSet, VkBuffer drawCommands)
+{
+	// Without extended dynamic state the equal test after the prepass needs its own pipeline
+	if (afterDepthPrepass && !deviceCapabilities.extendedDynamicState)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthEqualPipeline);
+	}
+	else
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	}
+	// The prepass has already written the nearest depth, only the fragments matching it are shaded
+	recordDrawState(commandBuffer, !afterDepthPrepass, afterDepthPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS);
+
+	// Bound once for the whole pass
+	if (lightingSet != VK_NULL_HANDLE)
+	{
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+			1, 1, &lightingSet, 0, nullptr);
+	}
+	if (drawCommands != VK_NULL_HANDLE)
+	{
+		drawMeshesIndirect(commandBuffer, drawCommands);
+	}
+	else
+	{
+		drawMeshes(commandBuffer);
+	}
+}
+
+void VulkanRenderer::recordGBuffer(VkCommandBuffer commandBuffer, VkDescriptorSet lightingSet)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gBufferPipeline);
+	recordDrawState(commandBuffer, true, VK_COMPARE_OP_LESS);
+
+	// Only the frame header is read, for the projection the normals are reconstructed with
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+		1, 1, &lightingSet, 0, nullptr);
+	drawMeshes(commandBuffer);
+}
+
+void VulkanRenderer::recordDeferredLighting(VkCommandBuffer commandBuffer, VkDescriptorSet gBufferSet,
+	VkDescriptorSet lightingSet)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, deferredLightingPipeline);
+	const std::array<VkDescriptorSet, 2> descriptorSets = { gBufferSet, lightingSet };
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, deferredLightingLayout,
+		0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
+	// Every pixel is lit once by a single triangle covering the screen
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+VkDescriptorSet VulkanRenderer::createGBufferDescriptorSet(const RenderGraph& graph, RenderGraphResource albedo,
+	RenderGraphResource normal, RenderGraphResource depth)
+{
+	// Transient, the graph's image views change whenever the swapchain does
+	VkDescriptorSet descriptorSet = descriptorAllocator.allocate(gBufferSetLayout);
+
+	const std::array<RenderGraphResource, 3> inputs = { albedo, normal, depth };
+	std::array<VkDescriptorImageInfo, 3> imageInfos = {};
+	std::array<VkWriteDescriptorSet, 3> writes = {};
+	for (uint32_t i = 0; i < inputs.size(); i++)
+	{
+		imageInfos[i].imageView = graph.getImageView(inputs[i]);
+		imageInfos[i].imageLayout = inputs[i] == depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL :
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = descriptorSet;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		writes[i].pImageInfo = &imageInfos[i];
+	}
+	vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	return descriptorSet;
+}
+
+void VulkanRenderer::recordDrawState(VkCommandBuffer commandBuffer, bool depthWrite, VkCompareOp depthCompareOp)
+{
+	// Baked into the pipelines when the state is not dynamic
+	if (!deviceCapabilities.extendedDynamicState)
+	{
+		return;
+	}
+	cmdSetCullMode(commandBuffer, VK_CULL_MODE_BACK_BIT);
+	cmdSetFrontFace(commandBuffer, VK_FRONT_FACE_CLOCKWISE);
+	cmdSetDepthTestEnable(commandBuffer, VK_TRUE);
+	cmdSetDepthWriteEnable(commandBuffer, depthWrite ? VK_TRUE : VK_FALSE);
+	cmdSetDepthCompareOp(commandBuffer, depthCompareOp);
+}
+
+void VulkanRenderer::drawMeshes(VkCommandBuffer commandBuffer)
+{
+	for (size_t i = 0; i < meshList.size(); i++)
+	{
+		Mesh& mesh = meshList[i];
+		if (!mesh.isLoaded())
+		{
+			continue;
+		}
+		VkBuffer vertexBuffers[] = {mesh.getVertexBuffer()};
 		VkDeviceSize offsets[] = {0};
-		vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-		
-		vkCmdDraw(commandBuffers[i], static_cast<uint32_t>(firstMesh.getVertexCount()), 1, 0, 0);
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, mesh.getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
 
-		vkCmdEndRenderPass(commandBuffers[i]);
+		const MeshFileLod& lod = mesh.getLods()[selectedLods[i]];
+		vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.firstIndex, 0, 0);
+	}
+}
 
-		result = vkEndCommandBuffer(commandBuffers[i]);
-		if (result != VK_SUCCESS)
+void VulkanRenderer::drawMeshesIndirect(VkCommandBuffer commandBuffer, VkBuffer drawCommands)
+{
+	// Every mesh has buffers of its own so each is still a draw, the culling pass decides whether it has an instance
+	for (size_t i = 0; i < meshList.size(); i++)
+	{
+		Mesh& mesh = meshList[i];
+		if (!mesh.isLoaded())
 		{
-			throw std::runtime_error("Failed to end recording a command buffer");
+			continue;
 		}
+		VkBuffer vertexBuffers[] = {mesh.getVertexBuffer()};
+		VkDeviceSize offsets[] = {0};
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, mesh.getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+		vkCmdDrawIndexedIndirect(commandBuffer, drawCommands, i * sizeof(VkDrawIndexedIndirectCommand), 1,
+			sizeof(VkDrawIndexedIndirectCommand));
 	}
 }
 
@@ -713,6 +1735,191 @@ void VulkanRenderer::getPhysicalDevice()
 	}
 }
 
+void VulkanRenderer::getDeviceCapabilities()
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(mainDevice.physicalDevice, &properties);
+
+	deviceCapabilities = {};
+	deviceCapabilities.apiVersion = std::min(properties.apiVersion, instanceApiVersion);
+	optionalDeviceExtensions.clear();
+
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(mainDevice.physicalDevice, &supportedFeatures);
+	if (supportedFeatures.samplerAnisotropy)
+	{
+		deviceCapabilities.maxSamplerAnisotropy = properties.limits.maxSamplerAnisotropy;
+	}
+	deviceCapabilities.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	deviceCapabilities.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+	deviceCapabilities.textureCompressionASTC = supportedFeatures.textureCompressionASTC_LDR;
+	deviceCapabilities.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+
+	// D16 has to be supported, the others are preferred for their precision
+	const VkFormat depthFormats[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D16_UNORM };
+	for (VkFormat format : depthFormats)
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(mainDevice.physicalDevice, format, &formatProperties);
+		if (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+		{
+			deviceCapabilities.depthFormat = format;
+			break;
+		}
+	}
+	if (deviceCapabilities.depthFormat == VK_FORMAT_UNDEFINED)
+	{
+		throw std::runtime_error("Failed to find a supported depth format");
+	}
+	deviceCapabilities.msaaSampleCounts = properties.limits.framebufferColorSampleCounts &
+		properties.limits.framebufferDepthSampleCounts;
+
+	// Feature and property structs past 1.0 can only be queried through the 1.1 entry points
+	if (deviceCapabilities.apiVersion < VK_API_VERSION_1_1)
+	{
+		VULKAN_CORE_INFO("Vulkan 1.0 device, optional features disabled");
+		return;
+	}
+
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(mainDevice.physicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(mainDevice.physicalDevice, nullptr, &extensionCount, extensions.data());
+
+	auto hasExtension = [&extensions](const char* extensionName)
+	{
+		return std::any_of(extensions.begin(), extensions.end(), [extensionName](const VkExtensionProperties& extension)
+		{
+			return strcmp(extension.extensionName, extensionName) == 0;
+		});
+	};
+
+	// Descriptor indexing is core in 1.2 and VK_EXT_descriptor_indexing before that
+	const bool coreDescriptorIndexing = deviceCapabilities.apiVersion >= VK_API_VERSION_1_2;
+	if (coreDescriptorIndexing || hasExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+	{
+		VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = {};
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &indexingFeatures;
+		vkGetPhysicalDeviceFeatures2(mainDevice.physicalDevice, &features);
+
+		VkPhysicalDeviceDescriptorIndexingProperties indexingProperties = {};
+		indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+		VkPhysicalDeviceProperties2 properties2 = {};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &indexingProperties;
+		vkGetPhysicalDeviceProperties2(mainDevice.physicalDevice, &properties2);
+
+		deviceCapabilities.descriptorIndexing = indexingFeatures.runtimeDescriptorArray &&
+			indexingFeatures.descriptorBindingPartiallyBound &&
+			indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+			indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+
+		deviceCapabilities.maxBindlessTextures = std::min({ BINDLESS_MAX_TEXTURES,
+			indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+			indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages });
+
+		if (deviceCapabilities.descriptorIndexing && !coreDescriptorIndexing)
+		{
+			optionalDeviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		}
+	}
+
+	// Timeline semaphores are core in 1.2 and VK_KHR_timeline_semaphore before that
+	const bool coreTimelineSemaphore = deviceCapabilities.apiVersion >= VK_API_VERSION_1_2;
+	if (coreTimelineSemaphore || hasExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+	{
+		VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &timelineFeatures;
+		vkGetPhysicalDeviceFeatures2(mainDevice.physicalDevice, &features);
+
+		deviceCapabilities.timelineSemaphore = timelineFeatures.timelineSemaphore;
+		if (deviceCapabilities.timelineSemaphore && !coreTimelineSemaphore)
+		{
+			optionalDeviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+		}
+	}
+
+	// Present wait is only usable together with present ids
+	if (hasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME) && hasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+	{
+		VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+		presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+		VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+		presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+		presentIdFeatures.pNext = &presentWaitFeatures;
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &presentIdFeatures;
+		vkGetPhysicalDeviceFeatures2(mainDevice.physicalDevice, &features);
+
+		deviceCapabilities.presentWait = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+		if (deviceCapabilities.presentWait)
+		{
+			optionalDeviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+			optionalDeviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+		}
+	}
+
+	// Dynamic rendering depends on depth stencil resolve and create render pass 2, both core in 1.2
+	const bool coreRenderPass2 = deviceCapabilities.apiVersion >= VK_API_VERSION_1_2;
+	if (hasExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) && (coreRenderPass2 ||
+		(hasExtension(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME) && hasExtension(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME))))
+	{
+		VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+		dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &dynamicRenderingFeatures;
+		vkGetPhysicalDeviceFeatures2(mainDevice.physicalDevice, &features);
+
+		deviceCapabilities.dynamicRendering = dynamicRenderingFeatures.dynamicRendering;
+		if (deviceCapabilities.dynamicRendering)
+		{
+			if (!coreRenderPass2)
+			{
+				optionalDeviceExtensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+				optionalDeviceExtensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+			}
+			optionalDeviceExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+		}
+	}
+
+	if (hasExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME))
+	{
+		VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures = {};
+		extendedDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &extendedDynamicStateFeatures;
+		vkGetPhysicalDeviceFeatures2(mainDevice.physicalDevice, &features);
+
+		deviceCapabilities.extendedDynamicState = extendedDynamicStateFeatures.extendedDynamicState;
+		if (deviceCapabilities.extendedDynamicState)
+		{
+			optionalDeviceExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+		}
+	}
+
+	// Only a properties query, there is no feature to enable
+	if (hasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+	{
+		deviceCapabilities.memoryBudget = true;
+		optionalDeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+
+	VULKAN_CORE_INFO("Device capabilities: Vulkan {}.{}, descriptor indexing {}, timeline semaphores {}, present wait {}, "
+		"dynamic rendering {}, extended dynamic state {}, memory budget {}",
+		VK_API_VERSION_MAJOR(deviceCapabilities.apiVersion), VK_API_VERSION_MINOR(deviceCapabilities.apiVersion),
+		deviceCapabilities.descriptorIndexing, deviceCapabilities.timelineSemaphore, deviceCapabilities.presentWait,
+		deviceCapabilities.dynamicRendering, deviceCapabilities.extendedDynamicState, deviceCapabilities.memoryBudget);
+}
+
 bool VulkanRenderer::check_extension_support(std::vector<VkExtensionProperties> extensions,
                                              const std::vector<const char*>::value_type& checkExtension)
 {
@@ -941,44 +2148,7 @@ VkExtent2D VulkanRenderer::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& surf
 	return newExtent;
 }
 
-VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
-{
-	VkImageViewCreateInfo viewCreateInfo = {};
-	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	viewCreateInfo.image = image;
-	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	viewCreateInfo.format = format;
-	viewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-	viewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-	viewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-	viewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-
-	viewCreateInfo.subresourceRange.aspectMask = aspectFlags;
-	viewCreateInfo.subresourceRange.baseMipLevel = 0;
-	viewCreateInfo.subresourceRange.levelCount = 1;
-	viewCreateInfo.subresourceRange.baseArrayLayer = 0;
-	viewCreateInfo.subresourceRange.layerCount = 1;
-
-	VkImageView imageView;
-	VkResult result = vkCreateImageView(mainDevice.logicalDevice, &viewCreateInfo, nullptr, &imageView);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create an Image view");
-	}
-	return imageView;
-}
-
-VkShaderModule VulkanRenderer::createShaderModule(const std::vector<char>& code)
+VkShaderModule VulkanRenderer::createShaderModule(std::span<const char> code)
 {
-	VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
-	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	shaderModuleCreateInfo.codeSize = code.size();
-	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-	VkShaderModule shaderModule;
-	VkResult result = vkCreateShaderModule(mainDevice.logicalDevice, &shaderModuleCreateInfo, nullptr, &shaderModule);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create a shader module");
-	}
-	return shaderModule;
+	return ::createShaderModule(mainDevice.logicalDevice, code);
 }
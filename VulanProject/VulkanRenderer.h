@@ -8,45 +8,152 @@
 #include <set>
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <span>
 
 #include "VulkanValidation.h"
 #include "Utilities.h"
 #include "Mesh.h"
+#include "DescriptorAllocator.h"
+#include "BindlessDescriptors.h"
+#include "Texture.h"
+#include "MappedFile.h"
+#include "GltfLoader.h"
+#include "UploadBatch.h"
+#include "LodSelector.h"
+#include "FramePacer.h"
+#include "QueueTimeline.h"
+#include "DeletionQueue.h"
+#include "MemoryBudget.h"
+#include "BufferPool.h"
+#include "RenderGraph.h"
+#include "ClusteredLighting.h"
+#include "OcclusionCulling.h"
 
 class VulkanRenderer
 {
 public:
 	VulkanRenderer();
-	int init(GLFWwindow* newWindow);
+	int init(GLFWwindow* newWindow, uint32_t newFramesInFlight = DEFAULT_FRAME_DRAWS);
 	void draw();
 	void cleanup();
+	// Called from the window's framebuffer size callback, the swapchain is rebuilt on the next frame
+	void notifyFramebufferResized();
+
+	// Frames recorded ahead of the GPU, clamped to 1 - MAX_FRAME_DRAWS. Fewer frames lower input latency,
+	// more absorb CPU and GPU spikes. Changing it waits for the device to go idle.
+	void setFramesInFlight(uint32_t count);
+	uint32_t getFramesInFlight();
+	// Holds back the start of each frame until just before the GPU needs it, trading throughput for
+	// fresher input. Call waitForFrameStart right before polling input.
+	void setLowLatencyMode(bool enabled);
+	bool isLowLatencyMode();
+	void waitForFrameStart();
+	FrameStatistics getFrameStatistics();
+	void resetFrameStatistics();
+	// Budget and usage of every memory heap with the bytes of each category, current as of the last allocation
+	MemoryBudgetStatistics getMemoryStatistics();
+	// Caps the budget of the device local heaps, e.g. to exercise eviction on a large GPU. Zero lifts the cap.
+	void setMemoryBudgetLimit(VkDeviceSize limit);
+	// Blocks and fragmentation of the pool the mesh buffers live in, with what defragmentation has moved so far
+	BufferPoolStatistics getGeometryStatistics();
+	// Lays down depth with a position only pass so the colour pass only shades the visible fragments.
+	// Stays off when the depth shader is missing.
+	void setDepthPrepass(bool enabled);
+	bool isDepthPrepass();
+	// 1, 2, 4 or 8 samples, rounded down to what the device supports. Samples are resolved inside the forward
+	// pass. The old pipelines are destroyed once the frames using them have finished.
+	void setMsaaSamples(uint32_t samples);
+	uint32_t getMsaaSamples();
+	// View space point lights, binned into clusters every frame so the forward pass only shades the ones that
+	// reach each fragment. Drawn unlit when the clustered shaders are missing.
+	void setLights(const std::vector<PointLight>& lights);
+	bool isClusteredShading();
+	const ClusterSettings& getClusterSettings();
+	// Bins the current lights once on the GPU and checks the result against the CPU reference
+	ClusterValidationResult validateClusteredLighting();
+	// Draws a compact G-buffer and lights it from the clusters in a second subpass of the same render pass, instead
+	// of shading every fragment in the forward pass. Always single sampled and without the depth prepass. Stays
+	// off without clustered lighting or the deferred shaders.
+	void setDeferredShading(bool enabled);
+	bool isDeferredShading();
+	// Draws what was visible last frame, builds a depth pyramid from it and draws whatever else it does not hide,
+	// with the meshes culled on the GPU into indirect draws. Only applies to the forward path at 1x MSAA without the
+	// depth prepass, the other paths keep drawing every mesh. Stays off without the culling shaders or with a depth
+	// stencil format.
+	void setOcclusionCulling(bool enabled);
+	bool isOcclusionCulling();
+
+	uint32_t createTexture(const std::string& fileName);
+	// Released once the frames already submitted have finished, draws must stop using the index first
+	void destroyTexture(uint32_t descriptorIndex);
+	// Loads a converted binary mesh from Models/, returns its index in the mesh list
+	int createMesh(const std::string& fileName);
+	// Releases the mesh's buffers once the frames drawing it have finished. Its index stays taken but it is no longer
+	// drawn, the space it leaves is compacted a little every frame.
+	void destroyMesh(int meshIndex);
+	// Imports every triangle primitive of a glTF file from Models/ with a single batched upload
+	std::vector<int> createGltfMeshes(const std::string& fileName);
 
 	~VulkanRenderer();
 private:
 	GLFWwindow* window;
 
-	int currentFrame = 0;
+	uint32_t framesInFlight = DEFAULT_FRAME_DRAWS;
+	uint32_t currentFrame = 0;
+	bool framebufferResized = false;
+	bool swapchainOutOfDate = false;
 
-	Mesh firstMesh;
+	std::vector<Mesh> meshList;
 	
 	VkInstance instance;
+	uint32_t instanceApiVersion = VK_API_VERSION_1_0;
 	VkDebugReportCallbackEXT callback;
 	struct {
 		VkPhysicalDevice physicalDevice;
 		VkDevice logicalDevice;
 	} mainDevice;
+	DeviceCapabilities deviceCapabilities;
+	std::vector<const char*> optionalDeviceExtensions;
+	// Every device memory allocation is tracked against its heap's budget here
+	MemoryBudget memoryBudget;
+	// Vertex and index buffers of every mesh, defragmented within a budget at the start of each frame
+	BufferPool geometryPool;
+	// Loaded when extendedDynamicState is supported
+	PFN_vkCmdSetCullModeEXT cmdSetCullMode = nullptr;
+	PFN_vkCmdSetFrontFaceEXT cmdSetFrontFace = nullptr;
+	PFN_vkCmdSetDepthTestEnableEXT cmdSetDepthTestEnable = nullptr;
+	PFN_vkCmdSetDepthWriteEnableEXT cmdSetDepthWriteEnable = nullptr;
+	PFN_vkCmdSetDepthCompareOpEXT cmdSetDepthCompareOp = nullptr;
 	VkQueue graphicsQueue;
 	VkQueue presentationQueue;
 	VkSurfaceKHR surface;
 	VkSwapchainKHR swapchain;
 	std::vector<SwapchainImage> swapChainImages;
-	std::vector<VkFramebuffer> swapChainFrameBuffers;
+	// One per frame in flight, recorded each frame
 	std::vector<VkCommandBuffer> commandBuffers;
 
 	VkPipeline graphicsPipeline;
+	// Only created when Shaders/depth_vert.spv is present, the equal pipeline shades after the prepass and is
+	// not needed when the depth state is dynamic
+	VkPipeline depthPrepassPipeline = VK_NULL_HANDLE;
+	VkPipeline depthEqualPipeline = VK_NULL_HANDLE;
+	bool depthPrepass = false;
+	VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+	// Set when the pipelines were created with the clustered fragment shader and the lights in set 1
+	bool clusteredShading = false;
+	// Only created when the deferred shaders are present and the lights are clustered
+	VkPipeline gBufferPipeline = VK_NULL_HANDLE;
+	VkPipeline deferredLightingPipeline = VK_NULL_HANDLE;
+	VkPipelineLayout deferredLightingLayout = VK_NULL_HANDLE;
+	// The G-buffer read as input attachments by the lighting subpass
+	VkDescriptorSetLayout gBufferSetLayout = VK_NULL_HANDLE;
+	bool deferredShading = false;
+	bool occlusionCulling = false;
 
 	VkPipelineLayout pipelineLayout;
-	VkRenderPass renderPass;
+	// Declared again every frame, only recompiled when the passes change
+	RenderGraph renderGraph;
 
 	VkCommandPool graphicsCommandPool;
 
@@ -55,7 +162,26 @@ private:
 
 	std::vector<VkSemaphore> imageAvailable;
 	std::vector<VkSemaphore> renderFinished;
-	std::vector<VkFence> drawFences;
+	// Every graphics queue submit, frames and uploads alike, advances one counter
+	QueueTimeline graphicsTimeline;
+	// Timeline value of the last frame submitted from each slot and to each swapchain image,
+	// images can be acquired out of order
+	std::vector<uint64_t> frameTimelineValues;
+	std::vector<uint64_t> imageTimelineValues;
+	// Swapchains, pipelines and textures replaced or unloaded at runtime, destroyed once the frames using them finish
+	DeletionQueue deletionQueue;
+
+	DescriptorAllocator descriptorAllocator;
+	BindlessDescriptorTable bindlessTable;
+	TextureManager textureManager;
+	LodSelector lodSelector;
+	// Chosen once per frame and shared by every pass that draws the meshes
+	std::vector<uint32_t> selectedLods;
+	FramePacer framePacer;
+	ClusteredLighting clusteredLighting;
+	OcclusionCulling occlusionCuller;
+	// Bounds and chosen level of detail of every mesh, rewritten each frame the meshes are culled
+	std::vector<CullingObject> cullingObjects;
 
 	void create_app_info(VkApplicationInfo& appInfo);
 
@@ -63,17 +189,40 @@ private:
 	void createDebugCallback();
 	void createLogicalDevice();
 	void createSurface();
-	void createSwapChain();
-	void createRenderPass();
+	void createSwapChain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
+	bool recreateSwapChain();
 	void createGraphicsPipeline();
-	void createFrameBuffers();
+	// Hands every pipeline and pipeline layout createGraphicsPipeline made to the deletion queue
+	void retireGraphicsPipelines();
+	void createDeferredPipelines(const VkGraphicsPipelineCreateInfo& forwardCreateInfo);
 	void createCommandPool();
 	void createCommandBuffers();
 	void createSynchronisation();
-
-	void recordCommands();
+	void destroySynchronisation();
+	void createTextureDescriptors();
+	void createGBufferSetLayout();
+
+	void buildRenderGraph(uint32_t imageIndex, bool withDepthPrepass, bool deferred, bool occlusionCulled);
+	void addDeferredPass(RenderGraphResource backBuffer, const ClusterResources& clusterResources,
+		const VkClearColorValue& clearColour, const VkClearDepthStencilValue& clearDepth);
+	void addOcclusionCulledPasses(RenderGraphResource colour, RenderGraphResource depth,
+		const ClusterResources& clusterResources, const VkClearColorValue& clearColour,
+		const VkClearDepthStencilValue& clearDepth);
+	void recordCommands(uint32_t imageIndex);
+	void selectLods();
+	void recordDepthPrepass(VkCommandBuffer commandBuffer);
+	void recordForwardPass(VkCommandBuffer commandBuffer, bool afterDepthPrepass, VkDescriptorSet lightingSet,
+		VkBuffer drawCommands);
+	void recordDrawState(VkCommandBuffer commandBuffer, bool depthWrite, VkCompareOp depthCompareOp);
+	void recordGBuffer(VkCommandBuffer commandBuffer, VkDescriptorSet lightingSet);
+	void recordDeferredLighting(VkCommandBuffer commandBuffer, VkDescriptorSet gBufferSet, VkDescriptorSet lightingSet);
+	VkDescriptorSet createGBufferDescriptorSet(const RenderGraph& graph, RenderGraphResource albedo,
+		RenderGraphResource normal, RenderGraphResource depth);
+	void drawMeshes(VkCommandBuffer commandBuffer);
+	void drawMeshesIndirect(VkCommandBuffer commandBuffer, VkBuffer drawCommands);
 
 	void getPhysicalDevice();
+	void getDeviceCapabilities();
 	bool check_extension_support(std::vector<VkExtensionProperties> extensions,
 	               const std::vector<const char*>::value_type& checkExtension);
 
@@ -89,7 +238,6 @@ private:
 	VkPresentModeKHR chooseBestPresentationMode(const std::vector<VkPresentModeKHR>& presentationModes);
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& surfaceCabalities);
 
-	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
-	VkShaderModule createShaderModule(const std::vector<char>& code);
+	VkShaderModule createShaderModule(std::span<const char> code);
 };
 
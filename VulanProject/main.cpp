@@ -1,39 +1,233 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <stdexcept>
 #include <vector>
 #include "Log.h"
+#include "Benchmark.h"
+#include "MeshConverter.h"
 #include "VulkanRenderer.h"
 
 GLFWwindow* window;
 VulkanRenderer vulkanRenderer;
 
+// Writes out whatever the async sink still holds on every return from main
+struct LogShutdownGuard
+{
+	~LogShutdownGuard()
+	{
+		Log::shutdown();
+	}
+};
+
 void initWindow(std::string wName = "Test Window", const int width = 800, const int height = 600)
 {
 	glfwInit();
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
 	window = glfwCreateWindow(width, height, wName.c_str(), nullptr, nullptr);
 }
 
 
-int main()
+int main(int argc, char** argv)
 {
 	Log::init();
+
+	// Offline asset conversion, e.g. --convert-mesh Models/quad.obj Models/quad.mesh
+	if (argc == 4 && std::string(argv[1]) == "--convert-mesh")
+	{
+		try
+		{
+			convertMesh(argv[2], argv[3]);
+		}
+		catch (const std::runtime_error& e)
+		{
+			VULKAN_CORE_ERROR(e.what());
+			return EXIT_FAILURE;
+		}
+		return 0;
+	}
+
+	// --bench-gltf scene.glb [iterations]
+	if (argc >= 3 && std::string(argv[1]) == "--bench-gltf")
+	{
+		return runGltfLoadBenchmark(argv[2], argc >= 4 ? std::atoi(argv[3]) : 10);
+	}
+
+	// Renderer options: --frames-in-flight N (1 - 4), --low-latency, --depth-prepass, --msaa N (1, 2, 4 or 8),
+	// --lights N, --deferred, --occlusion-culling, --memory-budget MiB, --memory-stats,
+	// --async-log, --log-overflow drop|block,
+	// --bench-frames [seconds per setting], --bench-depth-prepass [seconds per setting],
+	// --bench-lights [seconds per setting], --bench-occlusion [seconds per setting]
+	uint32_t framesInFlight = DEFAULT_FRAME_DRAWS;
+	bool lowLatency = false;
+	bool depthPrepass = false;
+	uint32_t msaaSamples = 1;
+	uint32_t lightCount = 0;
+	bool deferred = false;
+	bool occlusionCulling = false;
+	VkDeviceSize memoryBudgetLimit = 0;
+	bool memoryStatistics = false;
+	bool asyncLogging = false;
+	AsyncLogSettings asyncLogSettings;
+	double benchmarkSeconds = 0.0;
+	double depthPrepassBenchmarkSeconds = 0.0;
+	double lightingBenchmarkSeconds = 0.0;
+	double occlusionBenchmarkSeconds = 0.0;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string argument = argv[i];
+		if (argument == "--frames-in-flight" && i + 1 < argc)
+		{
+			framesInFlight = static_cast<uint32_t>(std::max(std::atoi(argv[++i]), 1));
+		}
+		else if (argument == "--low-latency")
+		{
+			lowLatency = true;
+		}
+		else if (argument == "--depth-prepass")
+		{
+			depthPrepass = true;
+		}
+		else if (argument == "--msaa" && i + 1 < argc)
+		{
+			msaaSamples = static_cast<uint32_t>(std::max(std::atoi(argv[++i]), 1));
+		}
+		else if (argument == "--lights" && i + 1 < argc)
+		{
+			lightCount = static_cast<uint32_t>(std::max(std::atoi(argv[++i]), 0));
+		}
+		else if (argument == "--deferred")
+		{
+			deferred = true;
+		}
+		else if (argument == "--occlusion-culling")
+		{
+			occlusionCulling = true;
+		}
+		else if (argument == "--memory-budget" && i + 1 < argc)
+		{
+			memoryBudgetLimit = static_cast<VkDeviceSize>(std::max(std::atoi(argv[++i]), 0)) * 1024 * 1024;
+		}
+		else if (argument == "--memory-stats")
+		{
+			memoryStatistics = true;
+		}
+		else if (argument == "--async-log")
+		{
+			asyncLogging = true;
+		}
+		else if (argument == "--log-overflow" && i + 1 < argc)
+		{
+			asyncLogSettings.overflowPolicy = std::string(argv[++i]) == "block" ? LogOverflowPolicy::Block :
+				LogOverflowPolicy::Drop;
+		}
+		else if (argument == "--bench-frames")
+		{
+			benchmarkSeconds = i + 1 < argc && argv[i + 1][0] != '-' ? std::atof(argv[++i]) : 5.0;
+		}
+		else if (argument == "--bench-depth-prepass")
+		{
+			depthPrepassBenchmarkSeconds = i + 1 < argc && argv[i + 1][0] != '-' ? std::atof(argv[++i]) : 5.0;
+		}
+		else if (argument == "--bench-lights")
+		{
+			lightingBenchmarkSeconds = i + 1 < argc && argv[i + 1][0] != '-' ? std::atof(argv[++i]) : 5.0;
+		}
+		else if (argument == "--bench-occlusion")
+		{
+			occlusionBenchmarkSeconds = i + 1 < argc && argv[i + 1][0] != '-' ? std::atof(argv[++i]) : 5.0;
+		}
+	}
+
+	// Before the renderer starts any worker threads that log
+	if (asyncLogging)
+	{
+		Log::enableAsync(asyncLogSettings);
+	}
+	LogShutdownGuard logShutdownGuard;
+
 	VULKAN_CORE_TRACE("Creating vulkan {}", "app");
 	initWindow();
 
-	if (vulkanRenderer.init(window) == EXIT_FAILURE)
+	if (vulkanRenderer.init(window, framesInFlight) == EXIT_FAILURE)
 	{
 		return EXIT_FAILURE;
 	}
+	glfwSetFramebufferSizeCallback(window, [](GLFWwindow*, int, int)
+	{
+		vulkanRenderer.notifyFramebufferResized();
+	});
+	vulkanRenderer.setLowLatencyMode(lowLatency);
+	vulkanRenderer.setDepthPrepass(depthPrepass);
+	vulkanRenderer.setMsaaSamples(msaaSamples);
+	vulkanRenderer.setDeferredShading(deferred);
+	vulkanRenderer.setOcclusionCulling(occlusionCulling);
+	vulkanRenderer.setMemoryBudgetLimit(memoryBudgetLimit);
+	if (lightCount > 0)
+	{
+		int width = 0;
+		int height = 0;
+		glfwGetFramebufferSize(window, &width, &height);
+		vulkanRenderer.setLights(generateTestLights(vulkanRenderer.getClusterSettings(),
+			static_cast<float>(width) / std::max(height, 1), lightCount));
+	}
+
+	if (benchmarkSeconds > 0.0)
+	{
+		const int result = runFramesInFlightBenchmark(vulkanRenderer, window, benchmarkSeconds);
+		vulkanRenderer.cleanup();
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return result;
+	}
+	if (depthPrepassBenchmarkSeconds > 0.0)
+	{
+		const int result = runDepthPrepassBenchmark(vulkanRenderer, window, depthPrepassBenchmarkSeconds);
+		vulkanRenderer.cleanup();
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return result;
+	}
+	if (lightingBenchmarkSeconds > 0.0)
+	{
+		const int result = runClusteredLightingBenchmark(vulkanRenderer, window, lightingBenchmarkSeconds);
+		vulkanRenderer.cleanup();
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return result;
+	}
+	if (occlusionBenchmarkSeconds > 0.0)
+	{
+		const int result = runOcclusionCullingBenchmark(vulkanRenderer, window, occlusionBenchmarkSeconds);
+		vulkanRenderer.cleanup();
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return result;
+	}
 
+	// Live budget, usage and descriptor allocations, logged once a second with --memory-stats
+	std::chrono::steady_clock::time_point lastMemoryReport = std::chrono::steady_clock::now();
 	while (!glfwWindowShouldClose(window))
 	{
+		// Input is polled as late as frame pacing allows
+		vulkanRenderer.waitForFrameStart();
 		glfwPollEvents();
+
+		// Nothing can be presented while minimised, sleep until the window comes back
+		int width = 0;
+		int height = 0;
+		glfwGetFramebufferSize(window, &width, &height);
+		if (width == 0 || height == 0)
+		{
+			glfwWaitEvents();
+			continue;
+		}
+
 		try
 		{
 			vulkanRenderer.draw();
@@ -42,6 +236,16 @@ int main()
 		{
 			VULKAN_CORE_ERROR(e.what());
 		}
+
+		if (memoryStatistics && std::chrono::steady_clock::now() - lastMemoryReport >= std::chrono::seconds(1))
+		{
+			logMemoryBudgetStatistics(vulkanRenderer.getMemoryStatistics());
+			logBufferPoolStatistics("geometry", vulkanRenderer.getGeometryStatistics());
+			const FrameStatistics frameStatistics = vulkanRenderer.getFrameStatistics();
+			VULKAN_CORE_INFO("Descriptors: {} sets allocated last frame, {} pools", frameStatistics.descriptorSetsLastFrame,
+				frameStatistics.descriptorPoolCount);
+			lastMemoryReport = std::chrono::steady_clock::now();
+		}
 	}
 	vulkanRenderer.cleanup();
 	glfwDestroyWindow(window);